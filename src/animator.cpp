@@ -31,6 +31,7 @@ void Animator::update(Scene& scene, float dt) {
                 break;
             }
         }
+        scene.markEntityDirty(e->id);
     }
 }
 
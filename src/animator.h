@@ -23,6 +23,9 @@ public:
     void removeAnimationsForEntity(int entityId);
     void clear();
 
+    // True when at least one animation is running (main loop must keep rendering continuously)
+    bool hasAnimations() const { return !anims_.empty(); }
+
     // Persistence
     bool saveToFile(const std::string& path) const;
     bool loadFromFile(const std::string& path);
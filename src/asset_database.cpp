@@ -0,0 +1,314 @@
+#include "asset_database.h"
+#include "asset_loader.h"
+#include "mesh_cache.h"
+#include "mapped_file.h"
+#include "xxhash.h"
+#include "scene.h"
+#include "thumbnail_cache.h"
+#include "thumbnail_renderer.h"
+#include "log.h"
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <chrono>
+#include <unordered_map>
+#include <algorithm>
+#include <cerrno>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace AssetDatabase {
+
+static std::vector<Record> s_records;
+static std::string s_dbPath;
+static bool s_open = false;
+
+// changes are applied once the file has been quiet this long (editors write in several steps)
+static const double kSettleSeconds = 0.3;
+// polling interval when inotify is unavailable
+static const double kPollSeconds = 1.0;
+static double s_lastPoll = 0.0;
+
+#ifdef __linux__
+static int s_inotify = -1;
+static std::unordered_map<int, std::string> s_watchDirs;    // watch descriptor -> directory
+#endif
+
+static double now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::string normalize(const std::string& path) {
+    std::error_code ec;
+    std::filesystem::path p = std::filesystem::absolute(path, ec);
+    return (ec ? std::filesystem::path(path) : p).lexically_normal().string();
+}
+
+static Record* find(const std::string& source) {
+    for(Record& r : s_records) if(r.source == source) return &r;
+    return nullptr;
+}
+
+uint64_t contentHash(const std::string& path) {
+    MappedFile file;
+    if(file.open(path)) return XXHash::hash64(file.data(), file.size());
+    std::error_code ec;
+    // empty files cannot be mapped
+    if(std::filesystem::exists(path, ec) && std::filesystem::file_size(path, ec) == 0 && !ec) return XXHash::hash64(nullptr, 0);
+    return 0;
+}
+
+// ---- Persistence: one tab-separated line per record ----
+// source, size, mtime, content hash, settings key, artifacts ('|'-separated)
+
+static void save() {
+    if(s_dbPath.empty()) return;
+    std::string tmp = s_dbPath + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::trunc);
+        if(!f) { LOG_WARN("Asset database: cannot write " << tmp); return; }
+        f << "# asset database v1\n" << std::hex;
+        for(const Record& r : s_records) {
+            f << r.source << '\t' << r.size << '\t' << r.mtime << '\t' << r.contentHash << '\t' << r.settingsKey << '\t';
+            for(size_t i = 0; i < r.artifacts.size(); ++i) f << (i ? "|" : "") << r.artifacts[i];
+            f << '\n';
+        }
+        if(!f) return;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, s_dbPath, ec);
+    if(ec) LOG_WARN("Asset database: cannot replace " << s_dbPath << ": " << ec.message());
+}
+
+static bool parseRecord(const std::string& line, Record& r) {
+    std::vector<std::string> fields;
+    std::stringstream ss(line);
+    std::string field;
+    while(std::getline(ss, field, '\t')) fields.push_back(field);
+    if(fields.size() < 5) return false;
+    try {
+        r.source = fields[0];
+        r.size = std::stoull(fields[1], nullptr, 16);
+        r.mtime = (int64_t)std::stoull(fields[2], nullptr, 16);
+        r.contentHash = std::stoull(fields[3], nullptr, 16);
+        r.settingsKey = std::stoull(fields[4], nullptr, 16);
+    } catch(const std::exception&) {
+        return false;
+    }
+    if(fields.size() > 5) {
+        std::stringstream as(fields[5]);
+        while(std::getline(as, field, '|')) if(!field.empty()) r.artifacts.push_back(field);
+    }
+    return !r.source.empty();
+}
+
+// ---- Watching ----
+
+static void watchDirectory(const std::string& source) {
+#ifdef __linux__
+    if(s_inotify < 0) return;
+    std::string dir = std::filesystem::path(source).parent_path().string();
+    for(const auto& w : s_watchDirs) if(w.second == dir) return;
+    // close-after-write and rename-into-place cover in-place saves and atomic-replace saves
+    int wd = inotify_add_watch(s_inotify, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if(wd < 0) { LOG_WARN("Asset database: cannot watch " << dir << " (errno " << errno << ")"); return; }
+    s_watchDirs[wd] = dir;
+#else
+    (void)source;
+#endif
+}
+
+static void markChanged(const std::string& path) {
+    if(Record* r = find(path)) r->changedAt = now();
+}
+
+#ifdef __linux__
+static void readWatchEvents() {
+    alignas(struct inotify_event) char buf[4096];
+    for(;;) {
+        ssize_t n = read(s_inotify, buf, sizeof(buf));
+        if(n <= 0) return; // EAGAIN: nothing pending
+        for(char* p = buf; p < buf + n;) {
+            const struct inotify_event* ev = (const struct inotify_event*)p;
+            p += sizeof(struct inotify_event) + ev->len;
+            if(ev->len == 0) continue;
+            auto it = s_watchDirs.find(ev->wd);
+            if(it != s_watchDirs.end()) markChanged((std::filesystem::path(it->second) / ev->name).string());
+        }
+    }
+}
+#endif
+
+// Fallback watcher: compare every source's size and mtime with its record
+static void pollSources() {
+    double t = now();
+    if(t - s_lastPoll < kPollSeconds) return;
+    s_lastPoll = t;
+    for(Record& r : s_records) {
+        MeshCache::SourceKey key;
+        if(!MeshCache::sourceKey(r.source, r.settingsKey, key)) continue;
+        if(key.size != r.size || key.time != r.mtime) {
+            // keep reporting the change until the reimport picks it up, but don't restart the settle timer
+            if(r.changedAt < 0.0 && !r.job) r.changedAt = t;
+        }
+    }
+}
+
+void open(const std::string& dbPath) {
+    s_dbPath = dbPath;
+    s_records.clear();
+    s_open = true;
+#ifdef __linux__
+    s_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(s_inotify < 0) LOG_WARN("Asset database: inotify unavailable, polling sources instead");
+#endif
+    std::ifstream f(dbPath);
+    std::string line;
+    while(std::getline(f, line)) {
+        if(line.empty() || line[0] == '#') continue;
+        Record r;
+        if(parseRecord(line, r) && !find(r.source)) s_records.push_back(std::move(r));
+    }
+    for(const Record& r : s_records) watchDirectory(r.source);
+    if(!s_records.empty()) LOG_INFO("Asset database: " << s_records.size() << " assets (" << dbPath << ")");
+}
+
+void close() {
+    if(!s_open) return;
+    for(Record& r : s_records) {
+        if(r.job) r.job->cancel();
+        r.job.reset();
+    }
+    save();
+#ifdef __linux__
+    if(s_inotify >= 0) ::close(s_inotify);
+    s_inotify = -1;
+    s_watchDirs.clear();
+#endif
+    s_records.clear();
+    s_open = false;
+}
+
+static void artifactsOf(const std::string& source, std::vector<std::string>& out) {
+    out.clear();
+    std::error_code ec;
+    for(const std::string& path : { MeshCache::cachePath(source), source + ".meshopt" })
+        if(std::filesystem::exists(path, ec)) out.push_back(path);
+}
+
+// Refresh the stored state of a record from a finished import
+static void updateRecord(Record& r, const AssetLoader::ImportJob& job) {
+    r.size = job.source.size;
+    r.mtime = job.source.time;
+    r.contentHash = job.contentHash;
+    r.settingsKey = job.source.settings;
+    artifactsOf(r.source, r.artifacts);
+}
+
+void recordImport(const AssetLoader::ImportJob& job) {
+    if(!s_open) return;
+    std::string source = normalize(job.path);
+    Record* r = find(source);
+    if(!r) {
+        s_records.emplace_back();
+        r = &s_records.back();
+        r->source = source;
+        watchDirectory(source);
+    }
+    updateRecord(*r, job);
+    // a file imported again (another copy in the scene) keeps following the latest import
+    r->users = job.meshUsers;
+    r->meshes.assign(job.meshes.begin(), job.meshes.end());
+    save();
+}
+
+void reimport(const std::string& source) {
+    if(Record* r = find(source)) r->changedAt = 0.0;
+}
+
+// Point every entity of the asset still showing the old mesh at the new one
+static size_t swapMeshes(Record& r, const std::vector<std::shared_ptr<primitives::MeshGL>>& fresh, Scene& scene) {
+    size_t swapped = 0;
+    for(size_t i = 0; i < r.users.size() && i < fresh.size(); ++i) {
+        std::shared_ptr<primitives::MeshGL> old = i < r.meshes.size() ? r.meshes[i].lock() : nullptr;
+        const std::shared_ptr<primitives::MeshGL>& m = fresh[i];
+        if(!m || m == old) continue; // gone from the file, or unchanged (the registry returned the same mesh)
+        for(int id : r.users[i]) {
+            SceneEntity* e = scene.findById(id);
+            if(!e || e->mesh != old) continue; // deleted, or given another mesh since
+            e->mesh = m;
+            scene.markEntityDirty(id);
+            swapped++;
+        }
+    }
+    r.meshes.assign(fresh.begin(), fresh.end());
+    return swapped;
+}
+
+// A finished reimport: upload the meshes entities will use, swap once they are all drawable so the
+// asset never flickers. Returns true when the record is done with the job.
+static bool finishReimport(Record& r, Scene& scene) {
+    AssetLoader::ImportJob& job = *r.job;
+    if(job.state != AssetLoader::ImportJob::Done) {
+        if(job.state == AssetLoader::ImportJob::Failed) LOG_ERROR("Reimport failed: " << r.source);
+        // wait for the next change instead of retrying this state of the file
+        r.size = job.source.size;
+        r.mtime = job.source.time;
+        return true;
+    }
+    if(job.unchanged) {
+        // touched or rewritten with the same bytes
+        updateRecord(r, job);
+        save();
+        return true;
+    }
+    bool drawable = true;
+    for(size_t i = 0; i < job.meshes.size() && i < r.users.size(); ++i) {
+        const auto& m = job.meshes[i];
+        if(!m || r.users[i].empty()) continue;
+        if(m->vao == 0) m->uploadStreamed();
+        if(m->uploadPending) drawable = false;
+    }
+    if(!drawable) return false;
+    size_t swapped = swapMeshes(r, job.meshes, scene);
+    updateRecord(r, job);
+    save();
+    // the content hash changed: the browser must look the thumbnail up again under the new hash, which
+    // this import already computed. Content seen before keeps its thumbnail; new content gets one drawn.
+    ThumbnailCache::recordHash(r.source, job.source.size, job.source.time, job.contentHash);
+    if(job.contentHash != 0 && !ThumbnailCache::exists(job.contentHash)) ThumbnailRenderer::request(r.source, job.contentHash);
+    ThumbnailCache::invalidate(r.source);
+    LOG_INFO("Reimported " << r.source << ": " << swapped << " entities updated");
+    return true;
+}
+
+bool pump(Scene& scene) {
+    if(!s_open) return false;
+#ifdef __linux__
+    if(s_inotify >= 0) readWatchEvents();
+    else pollSources();
+#else
+    pollSources();
+#endif
+    bool busy = false;
+    double t = now();
+    for(Record& r : s_records) {
+        if(r.job) {
+            if(!r.job->finished() || !finishReimport(r, scene)) { busy = true; continue; }
+            r.job.reset();
+        }
+        if(r.changedAt < 0.0) continue;
+        busy = true;
+        if(t - r.changedAt < kSettleSeconds) continue;
+        r.changedAt = -1.0;
+        LOG_INFO("Asset changed, reimporting: " << r.source);
+        r.job = AssetLoader::reimportAsync(r.source, r.contentHash);
+    }
+    return busy;
+}
+
+const std::vector<Record>& records() { return s_records; }
+
+} // namespace AssetDatabase
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+class Scene;
+namespace primitives { struct MeshGL; }
+namespace AssetLoader { struct ImportJob; }
+
+// Project asset database: one record per imported source file with its size, modification time,
+// content hash (XXH64), import settings key and the derived artifacts written next to it (mesh cache,
+// optimizer cache). Records are kept in a text file in the project directory.
+//
+// The directories of recorded sources are watched (inotify on Linux, polling elsewhere). When a source
+// changes, only that asset is reimported in the background; once its new meshes are on the GPU they
+// replace the old ones on every entity the asset created this session, without reloading the scene.
+// A save that leaves the content unchanged only refreshes the record.
+//
+// All functions must be called on the main (GL) thread, except contentHash().
+namespace AssetDatabase {
+    struct Record {
+        std::string source;          // absolute path
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        uint64_t contentHash = 0;
+        uint64_t settingsKey = 0;
+        std::vector<std::string> artifacts;
+
+        // session state (not stored): entities and meshes created by the import, by source mesh index
+        std::vector<std::vector<int>> users;
+        std::vector<std::weak_ptr<primitives::MeshGL>> meshes;
+        double changedAt = -1.0;     // last change seen by the watcher, waiting to settle
+        std::shared_ptr<AssetLoader::ImportJob> job;
+    };
+
+    // Load the database file (missing is fine) and start watching its sources
+    void open(const std::string& dbPath);
+    // Save, stop watching and drop pending reimports
+    void close();
+
+    // XXH64 of the file's bytes (0 when it cannot be read). Thread-safe.
+    uint64_t contentHash(const std::string& path);
+
+    // Called by AssetLoader when an import has been added to the scene
+    void recordImport(const AssetLoader::ImportJob& job);
+
+    // Queue a reimport of the recorded source regardless of its state
+    void reimport(const std::string& source);
+
+    // Handle file changes, start reimports and swap in finished ones. Call once per frame.
+    // Returns true while changes are settling or reimports are in flight.
+    bool pump(Scene& scene);
+
+    const std::vector<Record>& records();
+}
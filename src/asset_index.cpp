@@ -0,0 +1,156 @@
+#include "asset_index.h"
+#include "asset_loader.h"
+#include "thread_pool.h"
+#include "log.h"
+#include <filesystem>
+#include <chrono>
+#include <algorithm>
+#include <cctype>
+
+// entries merged per pump(), so a burst from the scanner is spread over frames
+static const size_t kMergePerFrame = 4096;
+// the scanner hands over a batch when it has this many entries or this much time has passed
+static const size_t kBatchEntries = 1024;
+static const double kBatchSeconds = 0.05;
+
+static std::string toLower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c){ return (char)std::tolower(c); });
+    return s;
+}
+
+AssetIndex::~AssetIndex() { stop(); }
+
+void AssetIndex::stop() {
+    m_stop = true;
+    if(m_thread.joinable()) m_thread.join();
+    m_stop = false;
+    m_scanning = false;
+}
+
+void AssetIndex::scan(const std::string& root) {
+    stop();
+    {
+        std::lock_guard<std::mutex> lk(m_mtx);
+        m_found.clear();
+        m_scanDone = false;
+    }
+    // the first scan of a root fills the index directly; later ones go to m_next
+    m_rescan = root == m_root && !m_entries.empty();
+    if(!m_rescan) {
+        m_entries.clear();
+        m_matches.clear();
+        m_filterCursor = 0;
+        m_root = root;
+    }
+    m_next.clear();
+    m_dirsScanned = 0;
+    m_scanning = true;
+    m_thread = std::thread(&AssetIndex::worker, this, root);
+}
+
+// Runs on the scan thread: walk the tree and publish importable files in batches
+void AssetIndex::worker(std::string root) {
+    namespace fs = std::filesystem;
+    std::vector<Entry> batch;
+    auto lastFlush = std::chrono::steady_clock::now();
+    auto flush = [&]{
+        std::lock_guard<std::mutex> lk(m_mtx);
+        m_found.insert(m_found.end(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+        batch.clear();
+        lastFlush = std::chrono::steady_clock::now();
+    };
+
+    std::error_code ec;
+    fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, ec), end;
+    if(ec) LOG_WARN("Asset index: cannot open " << root << ": " << ec.message());
+    for(; !ec && it != end && !m_stop; it.increment(ec)) {
+        const fs::directory_entry& de = *it;
+        std::error_code fec;
+        std::string name = de.path().filename().string();
+        if(de.is_directory(fec)) {
+            // hidden directories (.git, .cache ...) hold no assets worth browsing
+            if(!name.empty() && name[0] == '.') it.disable_recursion_pending();
+            else m_dirsScanned++;
+            continue;
+        }
+        if(!de.is_regular_file(fec) || !AssetLoader::canImport(name)) continue;
+        Entry e;
+        e.path = de.path().string();
+        e.nameOffset = (uint32_t)(e.path.size() - name.size());
+        e.lowerName = toLower(name);
+        e.size = (uint64_t)de.file_size(fec);
+        e.mtime = (int64_t)de.last_write_time(fec).time_since_epoch().count();
+        batch.push_back(std::move(e));
+        if(batch.size() >= kBatchEntries ||
+           std::chrono::duration<double>(std::chrono::steady_clock::now() - lastFlush).count() > kBatchSeconds) flush();
+    }
+    if(ec) LOG_WARN("Asset index: scan of " << root << " stopped: " << ec.message());
+    flush();
+    std::lock_guard<std::mutex> lk(m_mtx);
+    m_scanDone = !m_stop;
+}
+
+void AssetIndex::pump() {
+    std::vector<Entry> found;
+    bool done = false;
+    {
+        std::lock_guard<std::mutex> lk(m_mtx);
+        if(m_found.size() <= kMergePerFrame) {
+            found.assign(std::make_move_iterator(m_found.begin()), std::make_move_iterator(m_found.end()));
+            m_found.clear();
+            done = m_scanDone;
+            m_scanDone = false;
+        } else {
+            found.assign(std::make_move_iterator(m_found.begin()), std::make_move_iterator(m_found.begin() + kMergePerFrame));
+            m_found.erase(m_found.begin(), m_found.begin() + kMergePerFrame);
+        }
+    }
+    std::deque<Entry>& target = m_rescan ? m_next : m_entries;
+    for(Entry& e : found) target.push_back(std::move(e));
+    if(!done) return;
+
+    m_scanning = false;
+    if(!m_rescan) return;
+    // rescan complete: swap in the new index and search it from the start
+    auto old = std::make_shared<std::deque<Entry>>();
+    old->swap(m_entries);
+    m_entries.swap(m_next);
+    m_matches.clear();
+    m_filterCursor = 0;
+    m_rescan = false;
+    // freeing 100k strings is not free either; let a worker do it
+    ThreadPool::instance().submit([old]() mutable { old.reset(); });
+}
+
+void AssetIndex::setQuery(const std::string& query) {
+    if(query == m_query) return;
+    m_query = query;
+    m_terms.clear();
+    std::string lower = toLower(query);
+    size_t pos = 0;
+    while(pos < lower.size()) {
+        size_t space = lower.find(' ', pos);
+        if(space == std::string::npos) space = lower.size();
+        if(space > pos) m_terms.push_back(lower.substr(pos, space - pos));
+        pos = space + 1;
+    }
+    m_matches.clear();
+    m_filterCursor = 0;
+}
+
+bool AssetIndex::matchesQuery(const Entry& e) const {
+    for(const std::string& t : m_terms) if(e.lowerName.find(t) == std::string::npos) return false;
+    return true;
+}
+
+bool AssetIndex::refine(double budgetMs) {
+    auto start = std::chrono::steady_clock::now();
+    while(m_filterCursor < m_entries.size()) {
+        // check the clock every few hundred entries
+        size_t stop = std::min(m_entries.size(), m_filterCursor + 256);
+        for(; m_filterCursor < stop; ++m_filterCursor)
+            if(matchesQuery(m_entries[m_filterCursor])) m_matches.push_back((uint32_t)m_filterCursor);
+        if(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() > budgetMs) break;
+    }
+    return m_filterCursor == m_entries.size();
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+
+// In-memory index of the importable files under a directory tree, for the asset browser.
+// A background thread walks the tree and hands over entries in batches, so the index grows while
+// large trees (network shares, 100k+ files) are still being scanned. A rescan builds the new index
+// next to the current one, which stays browsable, and replaces it when the walk is complete.
+// Entries live in a deque: growing the index never moves the existing ones.
+//
+// Filename search is incremental too: refine() matches entries against the query within a time
+// budget per call and resumes where it stopped, covering entries merged in later.
+//
+// All member functions must be called from one thread (the UI thread).
+class AssetIndex {
+public:
+    struct Entry {
+        std::string path;
+        std::string lowerName;   // file name, lower case (search key)
+        uint32_t nameOffset = 0; // file name within 'path'
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        const char* name() const { return path.c_str() + nameOffset; }
+    };
+
+    AssetIndex() = default;
+    ~AssetIndex();
+    AssetIndex(const AssetIndex&) = delete;
+    AssetIndex& operator=(const AssetIndex&) = delete;
+
+    // Start (re)scanning 'root'. A different root clears the index first.
+    void scan(const std::string& root);
+    void stop();
+    const std::string& root() const { return m_root; }
+    bool scanning() const { return m_scanning.load(); }
+    size_t directoriesScanned() const { return m_dirsScanned.load(); }
+
+    // Merge the entries found since the last call. Call once per frame.
+    void pump();
+    const std::deque<Entry>& entries() const { return m_entries; }
+
+    // Case-insensitive search; space-separated terms must all occur in the file name
+    void setQuery(const std::string& query);
+    const std::string& query() const { return m_query; }
+    // Continue matching for about 'budgetMs'. Returns true when every entry has been checked.
+    bool refine(double budgetMs);
+    bool searchDone() const { return m_filterCursor == m_entries.size(); }
+    // Indices into entries() of the matches found so far, in index order
+    const std::vector<uint32_t>& matches() const { return m_matches; }
+
+private:
+    void worker(std::string root);
+    bool matchesQuery(const Entry& e) const;
+
+    std::string m_root;
+    std::thread m_thread;
+    std::atomic<bool> m_stop{false};
+    std::atomic<bool> m_scanning{false};
+    std::atomic<size_t> m_dirsScanned{0};
+
+    // handed over by the worker
+    std::mutex m_mtx;
+    std::deque<Entry> m_found;
+    bool m_scanDone = false;
+
+    std::deque<Entry> m_entries;
+    std::deque<Entry> m_next;     // rescan in progress
+    bool m_rescan = false;
+
+    std::string m_query;
+    std::vector<std::string> m_terms;
+    std::vector<uint32_t> m_matches;
+    size_t m_filterCursor = 0;
+};
@@ -1,53 +1,684 @@
 #include "asset_loader.h"
 #include "scene.h"
 #include "primitive_factory.h"
+#include "mesh_optimizer.h"
+#include "mesh_cache.h"
+#include "mesh_registry.h"
+#include "mesh_streamer.h"
+#include "asset_database.h"
+#include "gltf_loader.h"
+#include "mesh_parsers.h"
+#include "point_cloud.h"
+#include "point_cloud_builder.h"
+#include "cluster_mesh.h"
+#include "cluster_mesh_builder.h"
+#include "log.h"
+#include "thread_pool.h"
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
-#include <tiny_gltf.h>
 #include <iostream>
 #include <vector>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <exception>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <filesystem>
+
+bool g_importQuantizePositions = false;
+bool g_importOptimizeMeshes = true;
+bool g_importWeldVertices = true;
+float g_importWeldTolerance = 1e-6f;
+bool g_importUseMeshCache = true;
+int g_importOutOfCoreMTris = 20;
 
 namespace AssetLoader {
 
-static primitives::MeshGL meshFromAssimp(const aiMesh* amesh) {
-    std::vector<float> verts;
-    std::vector<unsigned int> idx;
+// Import options captured when an import starts (the UI may change the globals meanwhile)
+struct ImportSettings {
+    bool quantize = false;
+    bool weld = true;
+    float weldTolerance = 0.0f;
+    bool optimize = true;
+    bool useMeshCache = true;
+};
+
+static ImportSettings currentSettings() {
+    ImportSettings s;
+    s.quantize = g_importQuantizePositions;
+    s.weld = g_importWeldVertices;
+    s.weldTolerance = g_importWeldTolerance;
+    s.optimize = g_importOptimizeMeshes;
+    s.useMeshCache = g_importUseMeshCache;
+    return s;
+}
+
+// Everything that changes the built meshes; bump kPipelineVersion when the import pipeline changes
+static uint64_t settingsKey(const ImportSettings& s) {
+    static const uint64_t kPipelineVersion = 1;
+    uint32_t tol; memcpy(&tol, &s.weldTolerance, sizeof(tol));
+    uint64_t key = kPipelineVersion;
+    key = key * 31 + (s.quantize ? 1 : 0);
+    key = key * 31 + (s.weld ? 1 : 0);
+    key = key * 31 + (s.weld ? tol : 0);
+    key = key * 31 + (s.optimize ? 1 : 0);
+    return key;
+}
+
+// Optimize the mesh in place, reusing the result cached for the same input when available
+static void optimizeMesh(std::vector<float>& verts, std::vector<unsigned int>& idx, MeshOptimizer::Cache& cache) {
+    if(idx.size() < 3) return;
+    uint64_t key = MeshOptimizer::hashMesh(verts, idx);
+    if(cache.find(key, verts, idx)) return;
+    MeshOptimizer::Result r = MeshOptimizer::optimize(verts, idx);
+    LOG_INFO("Optimized mesh (" << idx.size() / 3 << " tris): ACMR " << r.acmrBefore << " -> " << r.acmrAfter);
+    cache.store(key, verts, idx);
+}
+
+// Weld duplicate vertices in place and report the reduction
+static void weldMesh(std::vector<float>& verts, std::vector<unsigned int>& idx, float tolerance) {
+    size_t n = verts.size() / 3;
+    if(n == 0) return;
+    glm::vec3 mn(verts[0], verts[1], verts[2]), mx = mn;
+    for(size_t i = 1; i < n; ++i) {
+        glm::vec3 p(verts[i * 3], verts[i * 3 + 1], verts[i * 3 + 2]);
+        mn = glm::min(mn, p); mx = glm::max(mx, p);
+    }
+    float epsilon = tolerance * glm::length(mx - mn);
+    MeshOptimizer::WeldResult r = MeshOptimizer::weldVertices(verts, idx, epsilon);
+    if(r.verticesAfter == r.verticesBefore) return;
+    float pct = 100.0f * (float)(r.verticesBefore - r.verticesAfter) / (float)r.verticesBefore;
+    LOG_INFO("Welded mesh: " << r.verticesBefore << " -> " << r.verticesAfter << " vertices (-" << pct << "%), "
+             << r.trianglesRemoved << " degenerate triangles removed");
+}
+
+// Coarse level for progressive loading (drawn and picked until the full mesh is resident). Meshes below
+// a few thousand triangles upload fast enough without one.
+static void buildCoarseLevel(primitives::MeshGL& mesh, const std::vector<float>& verts, const std::vector<unsigned int>& idx) {
+    static const size_t kMinTriangles = 2048;
+    static const size_t kMaxCoarseTriangles = 16384;
+    size_t tris = idx.size() / 3;
+    if(tris < kMinTriangles) return;
+    std::vector<float> coarseVerts;
+    std::vector<unsigned int> coarseIdx;
+    if(MeshOptimizer::simplifyClusters(verts, idx, std::min(tris / 32, kMaxCoarseTriangles), coarseVerts, coarseIdx))
+        mesh.buildCoarse(coarseVerts, coarseIdx);
+}
+
+// Parsed file: number of source meshes, a converter to positions/indices and the node hierarchy
+// instancing them. 'owner' keeps the parser's data (Assimp importer, glTF model) alive while workers
+// convert from it.
+struct MeshSource {
+    size_t count = 0;
+    std::function<bool(size_t, std::vector<float>&, std::vector<unsigned int>&)> convert;
+    // optional: source mesh i is stored quantized and should keep a 16-bit GPU vertex format
+    std::function<bool(size_t)> quantized;
+    std::vector<ImportNode> nodes;
+    std::shared_ptr<void> owner;
+};
+
+// Files without a node hierarchy: one root node per mesh
+static void flatNodes(size_t meshCount, std::vector<ImportNode>& nodes) {
+    nodes.resize(meshCount);
+    for(size_t i = 0; i < meshCount; ++i) nodes[i].meshes.assign(1, (uint32_t)i);
+}
+
+static glm::mat4 toGlm(const aiMatrix4x4& m) {
+    // aiMatrix4x4 is row-major (a1..a4 is the first row), glm takes columns
+    return glm::mat4(m.a1, m.b1, m.c1, m.d1,
+                     m.a2, m.b2, m.c2, m.d2,
+                     m.a3, m.b3, m.c3, m.d3,
+                     m.a4, m.b4, m.c4, m.d4);
+}
+
+static void readAssimpNodes(const aiScene* ascene, std::vector<ImportNode>& out) {
+    std::vector<std::pair<const aiNode*, int>> stack{ { ascene->mRootNode, -1 } };
+    while(!stack.empty()) {
+        auto [an, parent] = stack.back();
+        stack.pop_back();
+        if(!an) continue;
+        int self = (int)out.size();
+        ImportNode n;
+        n.parent = parent;
+        n.local = toGlm(an->mTransformation);
+        n.name = an->mName.C_Str();
+        for(unsigned int k = 0; k < an->mNumMeshes; ++k) if(an->mMeshes[k] < ascene->mNumMeshes) n.meshes.push_back(an->mMeshes[k]);
+        out.push_back(std::move(n));
+        for(unsigned int c = an->mNumChildren; c-- > 0;) stack.push_back({ an->mChildren[c], self });
+    }
+}
+
+static bool convertAssimpMesh(const aiMesh* amesh, std::vector<float>& verts, std::vector<unsigned int>& idx) {
     verts.reserve(amesh->mNumVertices * 3);
     for(unsigned int i=0;i<amesh->mNumVertices;++i){ verts.push_back(amesh->mVertices[i].x); verts.push_back(amesh->mVertices[i].y); verts.push_back(amesh->mVertices[i].z); }
-    for(unsigned int f=0; f<amesh->mNumFaces; ++f){ const aiFace& face = amesh->mFaces[f]; for(unsigned int k=0;k<face.mNumIndices;++k) idx.push_back(face.mIndices[k]); }
-    primitives::MeshGL m; m.upload(verts, idx); return m;
+    // point and line faces are skipped, everything else is triangulated on read
+    idx.reserve(amesh->mNumFaces * 3);
+    for(unsigned int f=0; f<amesh->mNumFaces; ++f){ const aiFace& face = amesh->mFaces[f]; if(face.mNumIndices != 3) continue; for(unsigned int k=0;k<3;++k) idx.push_back(face.mIndices[k]); }
+    return !verts.empty();
+}
+
+static bool parseWithAssimp(const std::string& path, MeshSource& src) {
+    auto importer = std::make_shared<Assimp::Importer>();
+    // only triangulation: welding and other mesh processing happen in our own pipeline
+    const aiScene* ascene = importer->ReadFile(path, aiProcess_Triangulate);
+    if(!ascene) { std::cerr << "Assimp failed to load: " << importer->GetErrorString() << "\n"; return false; }
+    src.count = ascene->mNumMeshes;
+    src.convert = [ascene](size_t i, std::vector<float>& verts, std::vector<unsigned int>& idx){
+        return convertAssimpMesh(ascene->mMeshes[i], verts, idx);
+    };
+    readAssimpNodes(ascene, src.nodes);
+    src.owner = importer;
+    return true;
 }
 
-bool loadModelWithAssimp(const std::string& path, Scene& scene) {
-    Assimp::Importer importer;
-    const aiScene* ascene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_JoinIdenticalVertices);
-    if(!ascene) { std::cerr << "Assimp failed to load: " << importer.GetErrorString() << "\n"; return false; }
-    // iterate meshes
-    for(unsigned int i=0;i<ascene->mNumMeshes;++i){ const aiMesh* am = ascene->mMeshes[i]; primitives::MeshGL m = meshFromAssimp(am); SceneEntity e; e.type = primitives::PrimitiveType::Cube; e.mesh = std::make_unique<primitives::MeshGL>(std::move(m)); scene.addEntity(std::move(e)); }
+static bool parseWithGltfLoader(const std::string& path, MeshSource& src) {
+    std::string err;
+    std::shared_ptr<const GltfLoader::Document> doc = GltfLoader::open(path, err);
+    if(!doc) { LOG_WARN("glTF loader: " << err << " (" << path << ")"); return false; }
+    // one scene mesh per glTF primitive, instanced by every node using its glTF mesh
+    src.count = GltfLoader::primitiveCount(*doc);
+    GltfLoader::readNodes(*doc, src.nodes);
+    const GltfLoader::Document* d = doc.get();
+    src.convert = [d](size_t i, std::vector<float>& verts, std::vector<unsigned int>& idx){
+        return GltfLoader::readPrimitive(*d, i, verts, idx);
+    };
+    src.quantized = [d](size_t i){ return GltfLoader::primitiveQuantized(*d, i); };
+    src.owner = std::const_pointer_cast<GltfLoader::Document>(doc);
     return true;
 }
 
-bool loadModelWithTinyGLTF(const std::string& path, Scene& scene) {
-    tinygltf::Model model; tinygltf::TinyGLTF loader; std::string err, warn;
-    bool ret = loader.LoadASCIIFromFile(&model, &err, &warn, path);
-    if(!warn.empty()) std::cerr << "tinygltf warn: " << warn << "\n";
-    if(!err.empty()) std::cerr << "tinygltf err: " << err << "\n";
-    if(!ret) return false;
-    // minimal: load first mesh primitives positions only
-    for(size_t mi=0; mi<model.meshes.size(); ++mi){ const tinygltf::Mesh& mesh = model.meshes[mi]; for(const auto& prim : mesh.primitives){ if(prim.attributes.count("POSITION")==0) continue; const tinygltf::Accessor& acc = model.accessors[prim.attributes.at("POSITION")]; const tinygltf::BufferView& bv = model.bufferViews[acc.bufferView]; const tinygltf::Buffer& buf = model.buffers[bv.buffer]; const unsigned char* data = buf.data.data() + bv.byteOffset + acc.byteOffset; size_t vc = acc.count; std::vector<float> verts; verts.resize(vc*3); memcpy(verts.data(), data, vc*3*sizeof(float)); std::vector<unsigned int> idx; if(prim.indices >= 0){ const tinygltf::Accessor& ia = model.accessors[prim.indices]; const tinygltf::BufferView& ibv = model.bufferViews[ia.bufferView]; const tinygltf::Buffer& ibuf = model.buffers[ibv.buffer]; const unsigned char* idata = ibuf.data.data() + ibv.byteOffset + ia.byteOffset; size_t ic = ia.count; idx.resize(ic); if(ia.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT){ const unsigned short* s = (const unsigned short*)idata; for(size_t k=0;k<ic;++k) idx[k] = s[k]; } else if(ia.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT){ const unsigned int* s = (const unsigned int*)idata; for(size_t k=0;k<ic;++k) idx[k] = s[k]; } }
-    primitives::MeshGL m; m.upload(verts, idx); SceneEntity e; e.type = primitives::PrimitiveType::Cube; e.mesh = std::make_unique<primitives::MeshGL>(std::move(m)); scene.addEntity(std::move(e)); } }
+static bool parseWithNativeParser(const std::string& path, MeshSource& src) {
+    std::string err;
+    auto meshes = std::make_shared<std::vector<MeshParsers::Mesh>>();
+    if(!MeshParsers::load(path, *meshes, err)) { LOG_WARN("Mesh parser: " << err << " (" << path << ")"); return false; }
+    if(!err.empty()) LOG_WARN("Mesh parser: " << err << " (" << path << ")");
+    src.count = meshes->size();
+    src.nodes.resize(meshes->size());
+    for(size_t i = 0; i < meshes->size(); ++i) {
+        src.nodes[i].name = (*meshes)[i].name;
+        src.nodes[i].meshes.assign(1, (uint32_t)i);
+    }
+    // each source mesh is converted exactly once, so hand the arrays over instead of copying them
+    std::vector<MeshParsers::Mesh>* m = meshes.get();
+    src.convert = [m](size_t i, std::vector<float>& verts, std::vector<unsigned int>& idx){
+        verts.swap((*m)[i].positions);
+        idx.swap((*m)[i].indices);
+        return !verts.empty();
+    };
+    src.owner = meshes;
+    return true;
+}
+
+static std::string lowerExtension(const std::string& path) {
+    std::string ext = std::filesystem::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext;
+}
+
+bool canImport(const std::string& path) {
+    static const char* kExtensions[] = { ".gltf", ".glb", ".vrm", ".fbx", ".obj", ".dae", ".3ds", ".stl", ".ply", ".las" };
+    std::string ext = lowerExtension(path);
+    for(const char* e : kExtensions) if(ext == e) return true;
+    return false;
+}
+
+// Stage 1: parse. glb/gltf/vrm go through the mapped glTF reader (Assimp is the fallback for
+// files it rejects, e.g. required extensions); obj/stl/ply go through the native parallel parsers,
+// also falling back to Assimp; everything else goes to Assimp.
+static bool parseModel(const std::string& path, MeshSource& src) {
+    std::string ext = lowerExtension(path);
+    bool ok = false;
+    if(ext == ".gltf" || ext == ".glb" || ext == ".vrm") ok = parseWithGltfLoader(path, src);
+    else if(MeshParsers::handles(ext)) ok = parseWithNativeParser(path, src);
+    if(!ok) {
+        src = MeshSource();
+        ok = parseWithAssimp(path, src);
+    }
+    if(ok && src.nodes.empty()) flatNodes(src.count, src.nodes);
+    return ok;
+}
+
+// Stage 2 (worker threads): convert source mesh i, weld, optimize, then build bounds/BVH/GPU buffers
+// and the coarse level.
+// onReady(i, mesh) is called from the worker as each mesh finishes; skipped meshes are not reported.
+// Stops early when 'cancel' becomes true.
+static void buildMeshes(const MeshSource& src, const ImportSettings& settings, MeshOptimizer::Cache& cache, const std::atomic<bool>* cancel,
+                        const std::function<void(size_t, std::unique_ptr<primitives::MeshGL>)>& onReady) {
+    ThreadPool::instance().parallelFor(src.count, 1, [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; ++i) {
+            if(cancel && cancel->load()) return;
+            std::vector<float> verts;
+            std::vector<unsigned int> idx;
+            if(!src.convert(i, verts, idx)) continue;
+            if(settings.weld) weldMesh(verts, idx, settings.weldTolerance);
+            if(settings.optimize) optimizeMesh(verts, idx, cache);
+            auto m = std::make_unique<primitives::MeshGL>();
+            m->build(verts, idx, settings.quantize || (src.quantized && src.quantized(i)));
+            buildCoarseLevel(*m, verts, idx);
+            onReady(i, std::move(m));
+        }
+    });
+}
+
+// Stage 3a (GL thread): one entity per node, parented like the file's hierarchy. A node drawing a
+// single mesh holds it directly, a node with several gets a child entity per mesh. 'users' receives
+// the entities waiting for each source mesh; meshes are attached by attachMesh() as they finish,
+// so the hierarchy is in the scene before any geometry.
+static void addNodes(const std::vector<ImportNode>& nodes, Scene& scene, std::vector<std::vector<int>>& users) {
+    std::vector<int> ids(nodes.size(), 0);
+    for(size_t i = 0; i < nodes.size(); ++i) {
+        const ImportNode& n = nodes[i];
+        SceneEntity e;
+        e.type = primitives::PrimitiveType::Mesh;
+        e.parentId = n.parent >= 0 && n.parent < (int)i ? ids[n.parent] : 0;
+        e.name = n.name;
+        e.setLocalMatrix(n.local);
+        ids[i] = scene.addEntity(std::move(e));
+        for(uint32_t m : n.meshes) {
+            int id = ids[i];
+            if(n.meshes.size() > 1) {
+                SceneEntity part;
+                part.type = primitives::PrimitiveType::Mesh;
+                part.parentId = ids[i];
+                id = scene.addEntity(std::move(part));
+            }
+            if(m >= users.size()) users.resize(m + 1);
+            users[m].push_back(id);
+        }
+    }
+}
+
+// Stage 3b (GL thread): queue the mesh's upload and share it with every entity instancing it.
+// The entities draw once UploadQueue has streamed the buffers. Meshes come from MeshRegistry, so a
+// mesh another import already uploaded is only shared.
+static void attachMesh(size_t index, const std::shared_ptr<primitives::MeshGL>& shared, const std::vector<std::vector<int>>& users, Scene& scene) {
+    if(index >= users.size() || users[index].empty()) return; // not used by any node
+    // a shell shows its coarse level until MeshStreamer pages it in
+    if(shared->pagedOut) shared->uploadCoarse();
+    else if(shared->vao == 0) shared->uploadStreamed();
+    for(int id : users[index]) {
+        // entities deleted during a background import just drop their reference
+        SceneEntity* e = scene.findById(id);
+        if(!e) continue;
+        e->mesh = shared;
+        scene.markEntityDirty(id);
+    }
+}
+
+static double msSince(std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+}
+
+// Meshes and nodes from the asset's binary mesh cache, when it exists and matches the file and settings.
+// The meshes are interned in MeshRegistry (null entries stay null). With 'shells' they are paged-out
+// shells for MeshStreamer; those have no GPU data to key them by, so they are not deduplicated.
+static bool loadFromMeshCache(const std::string& path, const ImportSettings& settings, const MeshCache::SourceKey& key,
+                              std::vector<std::shared_ptr<primitives::MeshGL>>& meshes, std::vector<ImportNode>& nodes, bool shells = false) {
+    if(!settings.useMeshCache || key.size == 0) return false;
+    std::vector<std::unique_ptr<primitives::MeshGL>> loaded;
+    if(!MeshCache::load(path, key, loaded, nodes, shells)) return false;
+    meshes.resize(loaded.size());
+    for(size_t i = 0; i < loaded.size(); ++i) {
+        if(shells) meshes[i] = std::move(loaded[i]);
+        else meshes[i] = MeshRegistry::intern(std::move(loaded[i]));
+    }
+    if(nodes.empty()) flatNodes(meshes.size(), nodes);
     return true;
 }
 
+// Build (or reuse) the octree container of a point cloud and map it
+static std::shared_ptr<PointCloud> openPointCloud(const std::string& path, std::atomic<float>* progress, const std::atomic<bool>* cancel) {
+    auto t0 = std::chrono::steady_clock::now();
+    std::string err;
+    std::shared_ptr<PointCloud> cloud;
+    if(PointCloudBuilder::build(path, err, progress, cancel)) cloud = PointCloud::open(path, err);
+    if(cancel && *cancel) return nullptr;
+    if(!cloud) { LOG_ERROR("Point cloud import failed: " << path << ": " << err); return nullptr; }
+    LOG_INFO("Opened point cloud of " << cloud->pointCount() << " points, " << cloud->nodes().size() << " nodes from " << path << " in " << msSince(t0) << " ms");
+    return cloud;
+}
+
+static bool isOutOfCore(const std::string& path) {
+    return g_importOutOfCoreMTris > 0 && ClusterMeshBuilder::triangleCount(path) >= (uint64_t)g_importOutOfCoreMTris * 1000000;
+}
+
+// Build (or reuse) the BVH container of an out-of-core mesh and map it
+static std::shared_ptr<ClusterMesh> openClusterMesh(const std::string& path, std::atomic<float>* progress, const std::atomic<bool>* cancel) {
+    auto t0 = std::chrono::steady_clock::now();
+    std::string err;
+    std::shared_ptr<ClusterMesh> mesh;
+    if(ClusterMeshBuilder::build(path, err, progress, cancel)) mesh = ClusterMesh::open(path, err);
+    if(cancel && *cancel) return nullptr;
+    if(!mesh) { LOG_ERROR("Out-of-core mesh import failed: " << path << ": " << err); return nullptr; }
+    LOG_INFO("Opened cluster mesh of " << mesh->triangleCount() << " triangles, " << mesh->nodes().size() << " nodes from " << path << " in " << msSince(t0) << " ms");
+    return mesh;
+}
+
+static std::string entityName(const std::string& path) { return std::filesystem::path(path).filename().string(); }
+
+// Add a synchronous import to the scene and the asset database
+static void addImport(const std::string& path, const MeshCache::SourceKey& key, uint64_t contentHash, const std::vector<ImportNode>& nodes,
+                      const std::vector<std::shared_ptr<primitives::MeshGL>>& meshes, Scene& scene) {
+    ImportJob done;
+    done.path = path;
+    done.source = key;
+    done.contentHash = contentHash;
+    done.meshes = meshes;
+    addNodes(nodes, scene, done.meshUsers);
+    for(size_t i = 0; i < meshes.size(); ++i) if(meshes[i]) attachMesh(i, meshes[i], done.meshUsers, scene);
+    AssetDatabase::recordImport(done);
+}
+
 bool loadModel(const std::string& path, Scene& scene) {
-    // choose tinygltf for glb/gltf/vrm otherwise use assimp
-    std::string p = path;
-    std::transform(p.begin(), p.end(), p.begin(), ::tolower);
-    if(p.size() >= 4 && (p.substr(p.size()-4)==".gltf" || p.substr(p.size()-4)==".glb" || p.substr(p.size()-4)==".vrm")){
-        if(loadModelWithTinyGLTF(path, scene)) return true;
+    if(PointCloudBuilder::isPointCloud(path)) {
+        std::shared_ptr<PointCloud> cloud = openPointCloud(path, nullptr, nullptr);
+        if(!cloud) return false;
+        scene.addPointCloud(std::move(cloud), entityName(path));
+        return true;
+    }
+    if(isOutOfCore(path)) {
+        std::shared_ptr<ClusterMesh> mesh = openClusterMesh(path, nullptr, nullptr);
+        if(!mesh) return false;
+        scene.addClusterMesh(std::move(mesh), entityName(path));
+        return true;
+    }
+    ImportSettings settings = currentSettings();
+    auto t0 = std::chrono::steady_clock::now();
+    MeshCache::SourceKey key;
+    MeshCache::sourceKey(path, settingsKey(settings), key);
+    uint64_t contentHash = AssetDatabase::contentHash(path);
+    std::vector<std::shared_ptr<primitives::MeshGL>> meshes;
+    std::vector<ImportNode> nodes;
+    if(loadFromMeshCache(path, settings, key, meshes, nodes)) {
+        MeshStreamer::track(path, key, meshes);
+        addImport(path, key, contentHash, nodes, meshes, scene);
+        LOG_INFO("Loaded " << meshes.size() << " meshes, " << nodes.size() << " nodes from " << MeshCache::cachePath(path) << " in " << msSince(t0) << " ms");
+        return true;
+    }
+    MeshSource src;
+    if(!parseModel(path, src)) return false;
+    double parseMs = msSince(t0);
+
+    auto t1 = std::chrono::steady_clock::now();
+    MeshOptimizer::Cache cache;
+    if(settings.optimize) cache.load(path);
+    MeshCache::Writer writer;
+    bool writeCache = settings.useMeshCache && key.size > 0 && writer.begin(path, key);
+    meshes.resize(src.count);
+    buildMeshes(src, settings, cache, nullptr, [&](size_t i, std::unique_ptr<primitives::MeshGL> m){
+        if(writeCache) writer.add((uint32_t)i, *m, settings.optimize);
+        meshes[i] = MeshRegistry::intern(std::move(m));
+    });
+    if(cache.dirty()) cache.save();
+    if(writeCache) {
+        writer.setNodes(src.nodes);
+        // the meshes can be paged out once the cache they are read back from exists
+        if(writer.finish()) MeshStreamer::track(path, key, meshes);
+    }
+    double buildMs = msSince(t1);
+
+    auto t2 = std::chrono::steady_clock::now();
+    addImport(path, key, contentHash, src.nodes, meshes, scene);
+    LOG_INFO("Imported " << src.count << " meshes, " << src.nodes.size() << " nodes from " << path << " (parse " << parseMs << " ms, build " << buildMs << " ms, upload " << msSince(t2) << " ms)");
+    return true;
+}
+
+bool loadPreview(const std::string& path, std::vector<PreviewPart>& parts) {
+    parts.clear();
+    // too large to parse for a thumbnail
+    if(isOutOfCore(path)) return false;
+    ImportSettings settings = currentSettings();
+    MeshCache::SourceKey key;
+    MeshCache::sourceKey(path, settingsKey(settings), key);
+    std::vector<std::shared_ptr<primitives::MeshGL>> meshes;
+    std::vector<ImportNode> nodes;
+    if(!loadFromMeshCache(path, settings, key, meshes, nodes)) {
+        MeshSource src;
+        if(!parseModel(path, src)) return false;
+        // a preview only needs the shape: skip the costly passes, whose results would not be kept
+        settings.weld = false;
+        settings.optimize = false;
+        MeshOptimizer::Cache cache;
+        meshes.resize(src.count);
+        buildMeshes(src, settings, cache, nullptr, [&](size_t i, std::unique_ptr<primitives::MeshGL> m){
+            meshes[i] = MeshRegistry::intern(std::move(m));
+        });
+        nodes.swap(src.nodes);
+    }
+    // parents come before children, so one pass resolves the world transforms
+    std::vector<glm::mat4> world(nodes.size());
+    for(size_t i = 0; i < nodes.size(); ++i) {
+        const ImportNode& n = nodes[i];
+        world[i] = n.parent >= 0 && n.parent < (int)i ? world[n.parent] * n.local : n.local;
+        for(uint32_t m : n.meshes)
+            if(m < meshes.size() && meshes[m]) parts.push_back({ world[i], meshes[m] });
+    }
+    return !parts.empty();
+}
+
+// ---- Background import ----
+
+static std::vector<std::shared_ptr<ImportJob>> s_jobs;
+
+float ImportJob::progress() const {
+    int st = state.load();
+    if(st == Done) return 1.0f;
+    if(isPointCloud || isClusterMesh) return buildProgress.load();
+    size_t total = meshTotal.load();
+    if(st == Parsing || total == 0) return 0.0f;
+    // parsing counts as the first 10%
+    return 0.1f + 0.9f * (float)meshesBuilt.load() / (float)total;
+}
+
+bool ImportJob::finished() const {
+    int st = state.load();
+    if(st == Parsing || st == Building) return false;
+    std::lock_guard<std::mutex> lk(mtx);
+    return ready.empty() && nodes.empty() && !pointCloud && !clusterMesh;
+}
+
+// Body of a background import, on a worker
+static void runImport(const std::shared_ptr<ImportJob>& job, const ImportSettings& settings, uint64_t unchangedHash) {
+    auto t0 = std::chrono::steady_clock::now();
+    MeshCache::SourceKey& key = job->source;
+    MeshCache::sourceKey(job->path, settingsKey(settings), key);
+    job->contentHash = AssetDatabase::contentHash(job->path);
+    if(job->reimport && job->contentHash != 0 && job->contentHash == unchangedHash) {
+        job->unchanged = true;
+        job->state = ImportJob::Done;
+        glfwPostEmptyEvent();
+        return;
+    }
+    // point clouds skip the mesh pipeline and the asset database
+    if(!job->reimport && PointCloudBuilder::isPointCloud(job->path)) {
+        job->isPointCloud = true;
+        job->state = ImportJob::Building;
+        glfwPostEmptyEvent();
+        std::shared_ptr<PointCloud> cloud = openPointCloud(job->path, &job->buildProgress, &job->cancelRequested);
+        bool opened = cloud != nullptr;
+        if(opened) {
+            std::lock_guard<std::mutex> lk(job->mtx);
+            job->pointCloud = std::move(cloud);
+        }
+        if(job->cancelRequested) {
+            job->state = ImportJob::Cancelled;
+            LOG_INFO("Import cancelled: " << job->path);
+        } else {
+            job->state = opened ? ImportJob::Done : ImportJob::Failed;
+        }
+        glfwPostEmptyEvent();
+        return;
+    }
+    // so do meshes too large to import into memory
+    if(!job->reimport && isOutOfCore(job->path)) {
+        job->isClusterMesh = true;
+        job->state = ImportJob::Building;
+        glfwPostEmptyEvent();
+        std::shared_ptr<ClusterMesh> mesh = openClusterMesh(job->path, &job->buildProgress, &job->cancelRequested);
+        bool opened = mesh != nullptr;
+        if(opened) {
+            std::lock_guard<std::mutex> lk(job->mtx);
+            job->clusterMesh = std::move(mesh);
+        }
+        if(job->cancelRequested) {
+            job->state = ImportJob::Cancelled;
+            LOG_INFO("Import cancelled: " << job->path);
+        } else {
+            job->state = opened ? ImportJob::Done : ImportJob::Failed;
+        }
+        glfwPostEmptyEvent();
+        return;
+    }
+    std::vector<std::shared_ptr<primitives::MeshGL>> cached;
+    std::vector<ImportNode> cachedNodes;
+    // a plain import (not a reimport swapping meshes in) opens the meshes paged out: their coarse levels
+    // show at once and MeshStreamer pages the full meshes in, visible ones first
+    if(loadFromMeshCache(job->path, settings, key, cached, cachedNodes, !job->reimport)) {
+        MeshStreamer::track(job->path, key, cached);
+        size_t count = 0;
+        {
+            std::lock_guard<std::mutex> lk(job->mtx);
+            job->nodes = std::move(cachedNodes);
+            for(size_t i = 0; i < cached.size(); ++i) {
+                if(!cached[i]) continue;
+                job->ready.emplace_back(i, std::move(cached[i]));
+                count++;
+            }
+        }
+        job->meshTotal = count;
+        job->meshesBuilt = count;
+        job->state = ImportJob::Done;
+        LOG_INFO("Loaded " << count << " meshes from " << MeshCache::cachePath(job->path) << " in " << msSince(t0) << " ms (background)");
+        glfwPostEmptyEvent();
+        return;
+    }
+    MeshSource src;
+    if(!parseModel(job->path, src)) {
+        LOG_ERROR("Import failed: " << job->path);
+        job->state = ImportJob::Failed;
+        glfwPostEmptyEvent();
+        return;
+    }
+    job->meshTotal = src.count;
+    {
+        // entities for the hierarchy are created before any mesh arrives
+        std::lock_guard<std::mutex> lk(job->mtx);
+        job->nodes = src.nodes;
+    }
+    job->state = ImportJob::Building;
+    glfwPostEmptyEvent();
+
+    MeshOptimizer::Cache cache;
+    if(settings.optimize) cache.load(job->path);
+    MeshCache::Writer writer;
+    bool writeCache = settings.useMeshCache && key.size > 0 && writer.begin(job->path, key);
+    std::vector<std::shared_ptr<primitives::MeshGL>> built(src.count);
+    buildMeshes(src, settings, cache, &job->cancelRequested, [&](size_t i, std::unique_ptr<primitives::MeshGL> m){
+        // serialize before interning: a shared mesh may already have released its pending GPU data
+        if(writeCache) writer.add((uint32_t)i, *m, settings.optimize);
+        std::shared_ptr<primitives::MeshGL> shared = MeshRegistry::intern(std::move(m));
+        {
+            std::lock_guard<std::mutex> lk(job->mtx);
+            built[i] = shared;
+            job->ready.emplace_back(i, std::move(shared));
+        }
+        job->meshesBuilt++;
+        // wake the main loop so the mesh gets uploaded even when the UI is idle
+        glfwPostEmptyEvent();
+    });
+    if(job->cancelRequested) {
+        job->state = ImportJob::Cancelled;
+        LOG_INFO("Import cancelled: " << job->path);
+    } else {
+        if(cache.dirty()) cache.save();
+        if(writeCache) {
+            writer.setNodes(src.nodes);
+            if(writer.finish()) MeshStreamer::track(job->path, key, built);
+        }
+        job->state = ImportJob::Done;
+        LOG_INFO("Imported " << src.count << " meshes from " << job->path << " in " << msSince(t0) << " ms (background)");
+    }
+    glfwPostEmptyEvent();
+}
+
+static std::shared_ptr<ImportJob> startImport(const std::string& path, bool reimport, uint64_t unchangedHash) {
+    auto job = std::make_shared<ImportJob>();
+    job->path = path;
+    job->reimport = reimport;
+    ImportSettings settings = currentSettings();
+    s_jobs.push_back(job);
+    ThreadPool::instance().submit([job, settings, unchangedHash]{
+        // nobody waits on the task's future: an escaping exception would leave the job Parsing or Building forever
+        try {
+            runImport(job, settings, unchangedHash);
+        } catch(const std::exception& e) {
+            LOG_ERROR("Import failed: " << job->path << ": " << e.what());
+            job->state = ImportJob::Failed;
+            glfwPostEmptyEvent();
+        }
+    });
+    return job;
+}
+
+std::shared_ptr<ImportJob> importAsync(const std::string& path) { return startImport(path, false, 0); }
+
+std::shared_ptr<ImportJob> reimportAsync(const std::string& path, uint64_t unchangedHash) { return startImport(path, true, unchangedHash); }
+
+bool pumpImports(Scene& scene) {
+    if(s_jobs.empty()) return false;
+    for(auto& job : s_jobs) {
+        std::vector<ImportNode> nodes;
+        std::deque<std::pair<size_t, std::shared_ptr<primitives::MeshGL>>> batch;
+        std::shared_ptr<PointCloud> cloud;
+        std::shared_ptr<ClusterMesh> clusterMesh;
+        {
+            std::lock_guard<std::mutex> lk(job->mtx);
+            if(job->cancelRequested) { job->nodes.clear(); job->ready.clear(); job->pointCloud.reset(); job->clusterMesh.reset(); continue; }
+            nodes.swap(job->nodes);
+            batch.swap(job->ready);
+            cloud.swap(job->pointCloud);
+            clusterMesh.swap(job->clusterMesh);
+        }
+        if(cloud) scene.addPointCloud(std::move(cloud), entityName(job->path));
+        if(clusterMesh) scene.addClusterMesh(std::move(clusterMesh), entityName(job->path));
+        if(!nodes.empty() && !job->reimport) addNodes(nodes, scene, job->meshUsers);
+        // GPU transfer is paced by UploadQueue, so every finished mesh can be handed over at once
+        for(auto& r : batch) {
+            if(r.first >= job->meshes.size()) job->meshes.resize(r.first + 1);
+            job->meshes[r.first] = r.second;
+            if(!job->reimport) attachMesh(r.first, r.second, job->meshUsers, scene);
+            job->meshesAdded++;
+        }
+    }
+    // finished jobs are dropped here; callers holding the shared_ptr can still read the final state
+    for(size_t i = 0; i < s_jobs.size();) {
+        ImportJob& job = *s_jobs[i];
+        if(!job.finished()) { ++i; continue; }
+        if(job.state == ImportJob::Done && !job.reimport && !job.isPointCloud && !job.isClusterMesh) AssetDatabase::recordImport(job);
+        s_jobs.erase(s_jobs.begin() + i);
+    }
+    return true;
+}
+
+const std::vector<std::shared_ptr<ImportJob>>& activeImports() { return s_jobs; }
+
+void cancelAllImports() {
+    for(auto& job : s_jobs) job->cancel();
+}
+
+void shutdown() {
+    cancelAllImports();
+    // a file that is still being parsed cannot be interrupted; wait for it
+    for(auto& job : s_jobs) {
+        while(job->state == ImportJob::Parsing || job->state == ImportJob::Building)
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
     }
-    return loadModelWithAssimp(path, scene);
+    s_jobs.clear();
 }
 
 } // namespace AssetLoader
@@ -1,9 +1,114 @@
 #pragma once
 #include <string>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+
+#include <glm/glm.hpp>
+
+#include "primitive_factory.h"
+#include "import_node.h"
+#include "mesh_cache.h"
 
 class Scene;
+class PointCloud;
+class ClusterMesh;
+
+// Store imported mesh positions as 16-bit unorm relative to each mesh's bounds
+extern bool g_importQuantizePositions;
+// Merge duplicate vertices of imported meshes; near matches within
+// g_importWeldTolerance x (bounds diagonal) are merged too (0 = exact matches only)
+extern bool g_importWeldVertices;
+extern float g_importWeldTolerance;
+// Reorder imported meshes for vertex cache, overdraw and fetch locality (cached next to the asset)
+extern bool g_importOptimizeMeshes;
+// Load from / write to the binary mesh cache next to the asset ("<asset>.nvmesh", see MeshCache)
+extern bool g_importUseMeshCache;
+// Binary PLY/STL meshes of at least this many million triangles are imported out of core (0 = never)
+extern int g_importOutOfCoreMTris;
 
 namespace AssetLoader {
+    // True when the file extension is one the importer handles. Thread-safe.
+    bool canImport(const std::string& path);
+
     // Load model at path and append to scene. Returns true on success.
     bool loadModel(const std::string& path, Scene& scene);
+
+    // LAS files and PLY files without faces are imported as one point-cloud entity instead: the octree
+    // container is built next to the asset (PointCloudBuilder) and streamed by PointCloudStreamer.
+    // Binary PLY and STL meshes over g_importOutOfCoreMTris become one cluster-mesh entity the same way
+    // (ClusterMeshBuilder, ClusterMeshStreamer), without the mesh pipeline or the asset database.
+
+    // Imports recreate the file's node hierarchy as parented entities. Each source mesh is built and
+    // uploaded once and shared by every entity that instances it; meshes identical to one already
+    // loaded (same file or another) resolve to that mesh through MeshRegistry.
+
+    // Background import. Parsing and mesh conversion run on the thread pool; finished meshes
+    // are queued and added to the scene by pumpImports() on the main thread.
+    struct ImportJob {
+        enum State { Parsing, Building, Done, Failed, Cancelled };
+
+        std::string path;
+        std::atomic<int> state{Parsing};
+        std::atomic<size_t> meshTotal{0};
+        std::atomic<size_t> meshesBuilt{0};
+        size_t meshesAdded = 0; // main thread only
+        std::atomic<bool> cancelRequested{false};
+
+        // node hierarchy (published before the first mesh) and built meshes waiting for GPU upload,
+        // with their source mesh index
+        mutable std::mutex mtx;
+        std::vector<ImportNode> nodes;
+        std::deque<std::pair<size_t, std::shared_ptr<primitives::MeshGL>>> ready;
+        // entities waiting for each source mesh, and the meshes handed over so far (main thread only)
+        std::vector<std::vector<int>> meshUsers;
+        std::vector<std::shared_ptr<primitives::MeshGL>> meshes;
+
+        // source file state for the asset database; written by the worker, read once finished()
+        MeshCache::SourceKey source;
+        uint64_t contentHash = 0;
+        // reimport of a recorded asset: meshes are only collected, AssetDatabase swaps them in
+        bool reimport = false;
+        // the reimported file still has the recorded content hash; nothing was built
+        bool unchanged = false;
+
+        // point-cloud import: build progress, and the opened cloud waiting to be added (under mtx)
+        std::atomic<bool> isPointCloud{false};
+        std::atomic<float> buildProgress{0.0f};
+        std::shared_ptr<PointCloud> pointCloud;
+        // out-of-core mesh import, as above (progress in buildProgress)
+        std::atomic<bool> isClusterMesh{false};
+        std::shared_ptr<ClusterMesh> clusterMesh;
+
+        float progress() const; // 0..1
+        void cancel() { cancelRequested = true; }
+        // no more work will arrive and every node and built mesh has been added
+        bool finished() const;
+    };
+
+    std::shared_ptr<ImportJob> importAsync(const std::string& path);
+    // Background rebuild of an imported file for AssetDatabase. Skips the build when the file's
+    // content hash equals 'unchangedHash'.
+    std::shared_ptr<ImportJob> reimportAsync(const std::string& path, uint64_t unchangedHash);
+
+    // Add meshes finished by background imports to the scene and queue their GPU upload (UploadQueue).
+    // Call once per frame on the GL thread. Returns true while imports are in flight.
+    bool pumpImports(Scene& scene);
+
+    // Meshes of a file placed by its node hierarchy, for offline rendering (thumbnails). Uses the mesh
+    // cache when it matches the current settings; otherwise the meshes are built on the thread pool
+    // without welding or optimization and nothing is written next to the asset. Meshes are shared
+    // through MeshRegistry and not uploaded. Thread-safe.
+    struct PreviewPart {
+        glm::mat4 world = glm::mat4(1.0f);
+        std::shared_ptr<primitives::MeshGL> mesh;
+    };
+    bool loadPreview(const std::string& path, std::vector<PreviewPart>& parts);
+
+    const std::vector<std::shared_ptr<ImportJob>>& activeImports();
+    void cancelAllImports();
+    // Cancel imports and wait for their workers (call before tearing down GLFW)
+    void shutdown();
 }
@@ -1,4 +1,142 @@
 #include "assets_window.h"
+#include "asset_loader.h"
+#include "asset_database.h"
+#include "asset_index.h"
+#include "thumbnail_cache.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include <deque>
+#ifdef NOVA_HAVE_TINYFD
+#include <tinyfiledialogs.h>
+#endif
+
+// Import progress rows with a cancel button per background job
+static void DrawImportJobs() {
+    for(const auto& job : AssetLoader::activeImports()) {
+        ImGui::PushID(job.get());
+        std::string name = job->path.substr(job->path.find_last_of("/\\") + 1);
+        char overlay[64];
+        if(job->state == AssetLoader::ImportJob::Parsing) snprintf(overlay, sizeof(overlay), "parsing...");
+        else snprintf(overlay, sizeof(overlay), "%zu / %zu meshes", job->meshesAdded, job->meshTotal.load());
+        ImGui::TextUnformatted(name.c_str());
+        ImGui::ProgressBar(job->progress(), ImVec2(-70.0f, 0.0f), overlay);
+        ImGui::SameLine();
+        if(job->cancelRequested) ImGui::TextDisabled("Cancelling");
+        else if(ImGui::Button("Cancel")) job->cancel();
+        ImGui::PopID();
+    }
+}
+
+// Recorded assets with their watch state; changed sources reimport by themselves
+static void DrawAssetDatabase() {
+    const auto& records = AssetDatabase::records();
+    if(!ImGui::CollapsingHeader("Asset database")) return;
+    if(records.empty()) ImGui::TextDisabled("No imported assets yet");
+    for(const auto& r : records) {
+        ImGui::PushID(r.source.c_str());
+        std::string name = r.source.substr(r.source.find_last_of("/\\") + 1);
+        ImGui::TextUnformatted(name.c_str());
+        if(ImGui::IsItemHovered()) ImGui::SetTooltip("%s\nhash %016llx", r.source.c_str(), (unsigned long long)r.contentHash);
+        ImGui::SameLine();
+        if(r.job) ImGui::TextDisabled("reimporting");
+        else if(r.changedAt >= 0.0) ImGui::TextDisabled("changed");
+        else if(ImGui::SmallButton("Reimport")) AssetDatabase::reimport(r.source);
+        ImGui::PopID();
+    }
+}
+
+// ---- Asset browser ----
+
+static AssetIndex s_index;
+static char s_browseRoot[1024] = ".";
+static char s_search[256] = "";
+static std::string s_selectedAsset;
+static float s_thumbSize = 96.0f;
+// time the search may spend per frame; the grid itself only touches visible cells
+static const double kSearchBudgetMs = 0.3;
+
+bool AssetBrowserBusy() {
+    return s_index.scanning() || !s_index.searchDone();
+}
+
+// One grid cell: thumbnail (or the extension as a placeholder) and the clipped file name
+static void DrawAssetCell(const AssetIndex::Entry& e, float size) {
+    const ImGuiStyle& style = ImGui::GetStyle();
+    float textH = ImGui::GetTextLineHeight();
+    ImVec2 cell(size, size + textH + style.ItemInnerSpacing.y);
+    ImVec2 p0 = ImGui::GetCursorScreenPos();
+    ImGui::InvisibleButton("cell", cell);
+    bool hovered = ImGui::IsItemHovered();
+    if(ImGui::IsItemClicked()) s_selectedAsset = e.path;
+    if(hovered && ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left)) AssetLoader::importAsync(e.path);
+    if(hovered) ImGui::SetTooltip("%s\n%.1f KB\nDouble-click to import", e.path.c_str(), (double)e.size / 1024.0);
+
+    ImDrawList* dl = ImGui::GetWindowDrawList();
+    ImVec2 p1(p0.x + size, p0.y + size);
+    bool selected = s_selectedAsset == e.path;
+    dl->AddRectFilled(p0, p1, ImGui::GetColorU32(selected ? ImGuiCol_HeaderActive : hovered ? ImGuiCol_HeaderHovered : ImGuiCol_FrameBg));
+    GLuint tex = ThumbnailCache::get(e.path);
+    if(tex) {
+        dl->AddImage((ImTextureID)(intptr_t)tex, ImVec2(p0.x + 2.0f, p0.y + 2.0f), ImVec2(p1.x - 2.0f, p1.y - 2.0f));
+    } else {
+        const char* ext = strrchr(e.name(), '.');
+        ext = ext ? ext + 1 : e.name();
+        ImVec2 ts = ImGui::CalcTextSize(ext);
+        dl->AddText(ImVec2(p0.x + (size - ts.x) * 0.5f, p0.y + (size - ts.y) * 0.5f), ImGui::GetColorU32(ImGuiCol_TextDisabled), ext);
+    }
+    ImVec4 clip(p0.x, p1.y, p1.x, p0.y + cell.y);
+    dl->AddText(ImGui::GetFont(), ImGui::GetFontSize(), ImVec2(p0.x, p1.y + style.ItemInnerSpacing.y), ImGui::GetColorU32(ImGuiCol_Text), e.name(), nullptr, 0.0f, &clip);
+}
+
+// Folder picker, search and a virtualized thumbnail grid over the index. The scan, the merge of
+// scanned entries and the search are all incremental, so the panel costs the same for any library size.
+static void DrawAssetBrowser() {
+    if(s_index.root().empty()) s_index.scan(s_browseRoot);
+    s_index.pump();
+
+    ImGui::SetNextItemWidth(-90.0f);
+    bool enter = ImGui::InputText("##root", s_browseRoot, sizeof(s_browseRoot), ImGuiInputTextFlags_EnterReturnsTrue);
+    ImGui::SameLine();
+    if(ImGui::Button("Rescan") || enter) s_index.scan(s_browseRoot);
+    ImGui::SetNextItemWidth(-90.0f);
+    ImGui::InputTextWithHint("##search", "Search file names", s_search, sizeof(s_search));
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(-1.0f);
+    ImGui::SliderFloat("##thumb", &s_thumbSize, 48.0f, 192.0f, "%.0f px");
+    s_index.setQuery(s_search);
+    bool searched = s_index.refine(kSearchBudgetMs);
+
+    const std::vector<uint32_t>& matches = s_index.matches();
+    const std::deque<AssetIndex::Entry>& entries = s_index.entries();
+    if(s_index.scanning()) ImGui::TextDisabled("Indexing... %zu assets in %zu folders", entries.size(), s_index.directoriesScanned());
+    else ImGui::TextDisabled("%zu assets", entries.size());
+    if(s_search[0]) { ImGui::SameLine(); ImGui::TextDisabled(searched ? "- %zu matches" : "- %zu matches so far", matches.size()); }
+
+    ImGui::BeginChild("asset_grid", ImVec2(0.0f, ImGui::GetContentRegionAvail().y * 0.6f), true);
+    const ImGuiStyle& style = ImGui::GetStyle();
+    float cellW = s_thumbSize + style.ItemSpacing.x;
+    float cellH = s_thumbSize + ImGui::GetTextLineHeight() + style.ItemInnerSpacing.y + style.ItemSpacing.y;
+    int columns = std::max(1, (int)((ImGui::GetContentRegionAvail().x + style.ItemSpacing.x) / cellW));
+    int rows = (int)((matches.size() + columns - 1) / columns);
+    ImGuiListClipper clipper;
+    clipper.Begin(rows, cellH);
+    while(clipper.Step()) {
+        for(int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+            for(int c = 0; c < columns; ++c) {
+                size_t i = (size_t)row * columns + c;
+                if(i >= matches.size()) break;
+                if(c > 0) ImGui::SameLine();
+                ImGui::PushID((int)i);
+                DrawAssetCell(entries[matches[i]], s_thumbSize);
+                ImGui::PopID();
+            }
+        }
+    }
+    clipper.End();
+    ImGui::EndChild();
+}
 
 void DrawAssetsWindow(Scene& scene, bool& showAssetsWindow, bool& pinAssets) {
     ImGuiWindowFlags assetsFlags = 0;
@@ -7,8 +145,49 @@ void DrawAssetsWindow(Scene& scene, bool& showAssetsWindow, bool& pinAssets) {
     ImGui::Begin("Assets", &showAssetsWindow, assetsFlags);
     ShowHeaderPin("pin_assets", pinAssets);
 
-    ImGui::Text("Asset Browser (placeholder)");
-    if(ImGui::Button("Import...")) { /* TODO */ }
+    if(ImGui::Button("Import...")) {
+#ifdef NOVA_HAVE_TINYFD
+        const char* filters[] = { "*.gltf", "*.glb", "*.vrm", "*.fbx", "*.obj", "*.dae", "*.3ds", "*.stl", "*.ply" };
+        const char* file = tinyfd_openFileDialog("Import model", "", (int)(sizeof(filters) / sizeof(filters[0])), filters, "3D models", 0);
+        if(file) AssetLoader::importAsync(file);
+#else
+        ImGui::OpenPopup("Import model");
+#endif
+    }
+#ifndef NOVA_HAVE_TINYFD
+    // no native file dialog in this build: ask for a path
+    if(ImGui::BeginPopup("Import model")) {
+        static char s_importPath[1024] = "";
+        ImGui::SetNextItemWidth(360.0f);
+        bool enter = ImGui::InputText("Path", s_importPath, sizeof(s_importPath), ImGuiInputTextFlags_EnterReturnsTrue);
+        if((ImGui::Button("Import") || enter) && s_importPath[0]) {
+            AssetLoader::importAsync(s_importPath);
+            ImGui::CloseCurrentPopup();
+        }
+        ImGui::SameLine();
+        if(ImGui::Button("Cancel")) ImGui::CloseCurrentPopup();
+        ImGui::EndPopup();
+    }
+#endif
+    ImGui::SameLine();
+    ImGui::Checkbox("Quantize positions", &g_importQuantizePositions);
+    ImGui::SameLine();
+    ImGui::Checkbox("Optimize meshes", &g_importOptimizeMeshes);
+    ImGui::Checkbox("Weld vertices", &g_importWeldVertices);
+    if(g_importWeldVertices) {
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(120.0f);
+        ImGui::InputFloat("Weld tolerance", &g_importWeldTolerance, 0.0f, 0.0f, "%.1e");
+        if(g_importWeldTolerance < 0.0f) g_importWeldTolerance = 0.0f;
+    }
+    ImGui::Checkbox("Use mesh cache", &g_importUseMeshCache);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(120.0f);
+    ImGui::DragInt("Out of core from (M tris)", &g_importOutOfCoreMTris, 1.0f, 0, 10000);
+    DrawImportJobs();
+    DrawAssetDatabase();
+    ImGui::Separator();
+    DrawAssetBrowser();
     ImGui::Separator();
 
     // Show entity list for selection
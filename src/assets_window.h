@@ -5,3 +5,5 @@
 #include "ui_helpers.h"
 
 void DrawAssetsWindow(Scene& scene, bool& showAssetsWindow, bool& pinAssets);
+// True while the asset browser is indexing or searching (keeps frames coming in idle mode)
+bool AssetBrowserBusy();
@@ -1,6 +1,14 @@
 #include "bottom_window.h"
+#include "render_target_pool.h"
+#include "gl_state.h"
+#include "upload_queue.h"
+#include "point_cloud_streamer.h"
+#include "cluster_mesh_streamer.h"
+#include "mesh_streamer.h"
+#include "mesh_registry.h"
+#include <unordered_set>
 
-void DrawBottomWindow(bool& showBottomWindow, bool& pinBottom) {
+void DrawBottomWindow(Scene& scene, bool& showBottomWindow, bool& pinBottom) {
     ImGuiWindowFlags bottomFlags = 0;
     bottomFlags |= ImGuiWindowFlags_MenuBar;
     if (pinBottom) bottomFlags |= ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoResize;
@@ -32,6 +40,33 @@ void DrawBottomWindow(bool& showBottomWindow, bool& pinBottom) {
             ImGui::EndChild();
             ImGui::EndTabItem();
         }
+        if(ImGui::BeginTabItem("Stats")) {
+            ImGui::Text("Render targets: %d (%d free)", RenderTargetPool::targetCount(), RenderTargetPool::freeCount());
+            ImGui::Text("Render target memory: %.2f MB", (double)RenderTargetPool::bytesAllocated() / (1024.0 * 1024.0));
+            ImGui::Separator();
+            const RenderQueue::Stats& rq = scene.renderQueue().lastStats();
+            ImGui::Text("Draw items: %d", rq.items);
+            ImGui::Text("Program binds: %d  Mesh binds: %d", rq.programBinds, rq.meshBinds);
+            // instanced entities share one mesh; count each mesh once
+            size_t meshBytes = 0;
+            std::unordered_set<const primitives::MeshGL*> meshes;
+            for(const auto& e : scene.entities()) if(e.mesh && meshes.insert(e.mesh.get()).second) meshBytes += e.mesh->gpuBytes;
+            ImGui::Text("Mesh GPU memory: %.2f MB (%zu meshes, %d entities)", (double)meshBytes / (1024.0 * 1024.0), meshes.size(), scene.getEntityCount());
+            MeshRegistry::Stats mr = MeshRegistry::stats();
+            ImGui::Text("Mesh dedup: %zu duplicates shared, %.2f MB saved (%zu unique meshes)", mr.duplicates, (double)mr.bytesSaved / (1024.0 * 1024.0), mr.liveMeshes);
+            UploadQueue::Stats uq = UploadQueue::stats();
+            ImGui::Text("Uploads: %zu queued (%.2f MB), %zu in flight, %.2f MB last frame", uq.queuedMeshes, (double)uq.queuedBytes / (1024.0 * 1024.0), uq.inFlightMeshes, (double)uq.bytesLastFrame / (1024.0 * 1024.0));
+            ImGui::Text("Upload staging: %.2f MB", (double)uq.stagingBytes / (1024.0 * 1024.0));
+            MeshStreamer::Stats ms = MeshStreamer::stats();
+            ImGui::Text("Mesh streaming: %zu/%zu resident, %zu wanted, %zu loading, GPU %.2f MB, RAM %.2f MB (%zu paged in, %zu out)", ms.residentMeshes, ms.trackedMeshes, ms.wantedMeshes, ms.loadsInFlight, (double)ms.gpuBytes / (1024.0 * 1024.0), (double)ms.cpuBytes / (1024.0 * 1024.0), ms.pagedIn, ms.pagedOut);
+            PointCloudStreamer::Stats pc = PointCloudStreamer::stats();
+            ImGui::Text("Point clouds: %zu points in %zu nodes drawn, %zu nodes resident (%.2f MB), %zu loading", pc.drawnPoints, pc.selectedNodes, pc.residentNodes, (double)pc.residentBytes / (1024.0 * 1024.0), pc.loadsInFlight);
+            ClusterMeshStreamer::Stats cm = ClusterMeshStreamer::stats();
+            ImGui::Text("Out-of-core meshes: %zu triangles in %zu nodes drawn, %zu nodes resident (%.2f MB), %zu loading", cm.drawnTriangles, cm.selectedNodes, cm.residentNodes, (double)cm.residentBytes / (1024.0 * 1024.0), cm.loadsInFlight);
+            const GLState::Stats& gs = GLState::lastFrameStats();
+            ImGui::Text("GL state calls: %d issued, %d filtered", gs.issued, gs.filtered);
+            ImGui::EndTabItem();
+        }
         ImGui::EndTabBar();
     }
     ImGui::End();
@@ -1,7 +1,8 @@
 #pragma once
 
 #include "gui_console.h"
+#include "scene.h"
 #include "imgui.h"
 #include "ui_helpers.h"
 
-void DrawBottomWindow(bool& showBottomWindow, bool& pinBottom);
+void DrawBottomWindow(Scene& scene, bool& showBottomWindow, bool& pinBottom);
@@ -29,6 +29,7 @@ glm::vec3 Camera::getPosition() const {
 void Camera::onScroll(double yoff) {
     distance_ *= (1.0f - (float)yoff*0.12f);
     if(distance_ < 0.2f) distance_ = 0.2f;
+    ++revision_;
 }
 
 void Camera::beginMiddleDrag(const glm::vec2& pos) {
@@ -50,6 +51,7 @@ void Camera::updateMiddleDrag(const glm::vec2& pos, bool alt) {
         angles_.x += delta.y * 0.008f;
         angles_.y += delta.x * 0.008f;
     }
+    if(delta.x != 0.0f || delta.y != 0.0f) ++revision_;
 }
 
 void Camera::endMiddleDrag() {
@@ -64,6 +66,12 @@ void Camera::setPosition(const glm::vec3& camPos) {
     float pitch = asinf(glm::clamp(delta.y / dist, -1.0f, 1.0f));
     float yaw = atan2f(delta.x, delta.z);
     angles_.x = pitch; angles_.y = yaw;
+    ++revision_;
+}
+
+void Camera::orbit(float yawRadians) {
+    angles_.y += yawRadians;
+    ++revision_;
 }
 
 void Camera::handleViewportInput(GLFWwindow* window, bool mouseOnViewport) {
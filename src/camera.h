@@ -22,6 +22,14 @@ public:
 
     // Set camera world position and recompute spherical params relative to current target
     void setPosition(const glm::vec3& camPos);
+    // Rotate the camera around its target about the world up axis
+    void orbit(float yawRadians);
+
+    // True while an orbit/pan drag is in progress
+    bool isDragging() const { return dragging_; }
+
+    // Bumped whenever the view changes; lets the viewport skip re-rendering an unchanged view
+    unsigned int getRevision() const { return revision_; }
 
     // Install GLFW callbacks for this camera instance (uses window user pointer)
     void installCallbacks(GLFWwindow* window);
@@ -35,6 +43,9 @@ private:
     glm::vec2 angles_ = glm::vec2(0.3f, -1.0f); // pitch, yaw
     glm::vec3 target_ = glm::vec3(0.0f);
 
+    // change counter (see getRevision)
+    unsigned int revision_ = 0;
+
     // dragging state
     bool dragging_ = false;
     glm::vec2 lastMouse_ = glm::vec2(0.0f);
@@ -0,0 +1,170 @@
+#include "cluster_mesh.h"
+#include "mesh_cache.h"
+#include "gl_state.h"
+#include "xxhash.h"
+#include "log.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <cstddef>
+#include <type_traits>
+
+static_assert(sizeof(ClusterMesh::FileHeader) == 128, "header must stay 128 bytes");
+static_assert(sizeof(ClusterMesh::Node) == 80 && std::is_trivially_copyable<ClusterMesh::Node>::value, "nodes are stored verbatim");
+static_assert(sizeof(glm::vec3) == 12, "positions are stored as packed float xyz");
+
+// Entry distance of a ray into a box ('invDir' = 1 / dir); false when it misses or starts beyond 'maxT'
+static bool rayBox(const glm::vec3& orig, const glm::vec3& invDir, const glm::vec3& mn, const glm::vec3& mx, float maxT, float& tEnter) {
+    float t0 = 0.0f, t1 = maxT;
+    for(int k = 0; k < 3; ++k) {
+        float a = (mn[k] - orig[k]) * invDir[k];
+        float b = (mx[k] - orig[k]) * invDir[k];
+        if(a > b) std::swap(a, b);
+        // NaN (ray in the slab's plane) leaves the interval unchanged
+        t0 = a > t0 ? a : t0;
+        t1 = b < t1 ? b : t1;
+        if(t0 > t1) return false;
+    }
+    tEnter = t0;
+    return true;
+}
+
+// Moller-Trumbore, both faces
+static bool rayTriangle(const glm::vec3& orig, const glm::vec3& dir, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, float& t) {
+    glm::vec3 e1 = v1 - v0, e2 = v2 - v0;
+    glm::vec3 h = glm::cross(dir, e2);
+    float a = glm::dot(e1, h);
+    if(a > -1e-12f && a < 1e-12f) return false;
+    float f = 1.0f / a;
+    glm::vec3 s = orig - v0;
+    float u = f * glm::dot(s, h);
+    if(u < 0.0f || u > 1.0f) return false;
+    glm::vec3 q = glm::cross(s, e1);
+    float v = f * glm::dot(dir, q);
+    if(v < 0.0f || u + v > 1.0f) return false;
+    t = f * glm::dot(e2, q);
+    return t > 0.0f;
+}
+
+ClusterMesh::~ClusterMesh() {
+    for(size_t i = 0; i < m_gpu.size(); ++i) releaseNode(i);
+}
+
+std::string ClusterMesh::containerPath(const std::string& assetPath) { return assetPath + ".nvcm"; }
+
+std::shared_ptr<ClusterMesh> ClusterMesh::open(const std::string& assetPath, std::string& err) {
+    MeshCache::SourceKey key;
+    if(!MeshCache::sourceKey(assetPath, 0, key)) { err = "cannot read " + assetPath; return nullptr; }
+    std::shared_ptr<ClusterMesh> cm(new ClusterMesh());
+    cm->m_source = assetPath;
+    MappedFile& file = cm->m_file;
+    if(!file.open(containerPath(assetPath))) { err = "no cluster mesh container"; return nullptr; }
+
+    FileHeader h;
+    if(file.size() < sizeof(h)) { err = "truncated cluster mesh container"; return nullptr; }
+    memcpy(&h, file.data(), sizeof(h));
+    if(h.magic != kMagic || h.version != kVersion || h.headerBytes != sizeof(h)
+       || h.headerChecksum != XXHash::hash64(&h, offsetof(FileHeader, headerChecksum))) {
+        err = "unknown version or corrupt header";
+        return nullptr;
+    }
+    if(h.sourceSize != key.size || h.sourceTime != key.time) { err = "cluster mesh container is out of date"; return nullptr; }
+    uint64_t tableBytes = (uint64_t)h.nodeCount * sizeof(Node);
+    if(h.nodeCount == 0 || h.nodeTableOffset > file.size() || tableBytes > file.size() - h.nodeTableOffset
+       || XXHash::hash64(file.data() + h.nodeTableOffset, tableBytes) != h.nodeTableChecksum) {
+        err = "corrupt node table";
+        return nullptr;
+    }
+    cm->m_nodes.resize(h.nodeCount);
+    memcpy(cm->m_nodes.data(), file.data() + h.nodeTableOffset, tableBytes);
+    for(size_t i = 0; i < cm->m_nodes.size(); ++i) {
+        const Node& n = cm->m_nodes[i];
+        bool ok = n.offset >= sizeof(h) && n.offset % kPageSize == 0 && n.offset <= h.nodeTableOffset
+               && geometryBytes(n) <= h.nodeTableOffset - n.offset;
+        // children come after their parent, so the table cannot loop
+        for(int32_t c : n.children) ok = ok && c >= -1 && c < (int32_t)h.nodeCount && (c < 0 || c > (int32_t)i);
+        if(!ok) { err = "corrupt node table"; return nullptr; }
+    }
+    cm->m_gpu.resize(h.nodeCount);
+    cm->m_triangleCount = h.triangleCount;
+    memcpy(cm->m_origin, h.origin, sizeof(h.origin));
+    cm->m_boundsMin = glm::vec3(h.boundsMin[0], h.boundsMin[1], h.boundsMin[2]);
+    cm->m_boundsMax = glm::vec3(h.boundsMax[0], h.boundsMax[1], h.boundsMax[2]);
+    return cm;
+}
+
+bool ClusterMesh::rayIntersect(const glm::vec3& orig, const glm::vec3& dir, float& outT, glm::vec3& outNormal) const {
+    glm::vec3 invDir(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+    float best = FLT_MAX;
+    bool hit = false;
+    struct Entry { int32_t node; float t; };
+    std::vector<Entry> stack;
+    float t0;
+    if(!rayBox(orig, invDir, m_nodes[0].min, m_nodes[0].max, best, t0)) return false;
+    stack.push_back({ 0, t0 });
+    Entry hits[8];
+    while(!stack.empty()) {
+        Entry e = stack.back();
+        stack.pop_back();
+        if(e.t > best) continue;
+        const Node& n = m_nodes[e.node];
+        if(isLeaf(n)) {
+            const glm::vec3* pos = positions(n);
+            const uint32_t* idx = indices(n);
+            for(uint32_t t = 0; t < n.triangleCount; ++t) {
+                uint32_t a = idx[t * 3], b = idx[t * 3 + 1], c = idx[t * 3 + 2];
+                if(a >= n.vertexCount || b >= n.vertexCount || c >= n.vertexCount) continue;
+                float d;
+                if(rayTriangle(orig, dir, pos[a], pos[b], pos[c], d) && d < best) {
+                    best = d;
+                    outNormal = glm::cross(pos[b] - pos[a], pos[c] - pos[a]);
+                    hit = true;
+                }
+            }
+            continue;
+        }
+        // nearest child on top of the stack
+        int count = 0;
+        for(int32_t c : n.children) {
+            if(c < 0) continue;
+            const Node& child = m_nodes[c];
+            if(rayBox(orig, invDir, child.min, child.max, best, t0)) hits[count++] = { c, t0 };
+        }
+        std::sort(hits, hits + count, [](const Entry& a, const Entry& b){ return a.t > b.t; });
+        stack.insert(stack.end(), hits, hits + count);
+    }
+    if(!hit) return false;
+    outT = best;
+    float len = glm::length(outNormal);
+    outNormal = len > 0.0f ? outNormal / len : glm::vec3(0.0f, 1.0f, 0.0f);
+    return true;
+}
+
+void ClusterMesh::uploadNode(size_t index, const glm::vec3* positions, const uint32_t* indices) {
+    GpuNode& g = m_gpu[index];
+    const Node& n = m_nodes[index];
+    if(g.vao == 0) {
+        glGenVertexArrays(1, &g.vao);
+        glGenBuffers(1, &g.vbo);
+        glGenBuffers(1, &g.ebo);
+        m_residentNodes++;
+        m_residentBytes += geometryBytes(n);
+    }
+    GLState::bindVertexArray(g.vao);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, g.vbo);
+    glBufferData(GL_ARRAY_BUFFER, (size_t)n.vertexCount * 12, positions, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, g.ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (size_t)n.triangleCount * 12, indices, GL_STATIC_DRAW);
+}
+
+void ClusterMesh::releaseNode(size_t index) {
+    GpuNode& g = m_gpu[index];
+    if(g.vao == 0) return;
+    GLState::deleteBuffer(g.ebo);
+    GLState::deleteBuffer(g.vbo);
+    GLState::deleteVertexArray(g.vao);
+    m_residentBytes -= geometryBytes(m_nodes[index]);
+    m_residentNodes--;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "mapped_file.h"
+
+// Triangle mesh stored as a disk-backed BVH ("<asset>.nvcm", written by ClusterMeshBuilder), for single
+// meshes too large to import into a MeshGL. The leaves are clusters of at most kClusterTriangles
+// triangles at full detail; every inner node holds a simplified version of everything below it, of
+// about the same size, with its geometric error. Nodes replace each other: a view draws a cut through
+// the tree (ClusterMeshStreamer), and ray queries descend to the leaves.
+//
+// Only the node table is read when the container is opened; it is small (one record per cluster) and
+// stays resident. Node geometry starts on a page boundary, and the nodes of one subtree are stored
+// together, so ray queries and streaming page in little beyond the clusters they touch and the OS can
+// drop those pages again under memory pressure.
+//
+// Layout: a 128-byte header, the node geometry (float xyz positions, then uint32 triangle indices local
+// to the node), then the node table. Positions are relative to the center of the source bounds
+// (origin()), as in PointCloud.
+class ClusterMesh {
+public:
+    struct Node {
+        glm::vec3 min;          // bounds, relative to origin()
+        glm::vec3 max;
+        float error;            // geometric error of the node's geometry (0 for leaves)
+        uint32_t vertexCount;
+        uint32_t triangleCount;
+        uint32_t reserved;      // zero
+        uint64_t offset;        // byte offset of the geometry in the container
+        int32_t children[8];    // -1 when unused; none for leaves
+    };
+
+    // GPU copy of a node, managed by ClusterMeshStreamer on the GL thread
+    struct GpuNode {
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        GLuint ebo = 0;
+        uint64_t lastUsedFrame = 0;
+        bool loading = false;
+    };
+
+    // triangles per leaf cluster, and the target size of the simplified inner nodes
+    static const uint32_t kClusterTriangles = 4096;
+    // node geometry alignment
+    static const uint64_t kPageSize = 4096;
+
+    // Container layout, shared with ClusterMeshBuilder
+    static const uint32_t kMagic = 0x4D43564E; // "NVCM"
+    static const uint32_t kVersion = 1;
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t headerBytes;
+        uint32_t nodeCount;
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        uint64_t triangleCount;  // at full detail (the leaves)
+        double origin[3];
+        float boundsMin[3];
+        float boundsMax[3];
+        uint64_t nodeTableOffset;
+        uint64_t nodeTableChecksum;
+        uint64_t reserved[2];    // zero
+        uint64_t headerChecksum; // XXH64 of all fields above
+    };
+
+    ~ClusterMesh();
+    ClusterMesh(const ClusterMesh&) = delete;
+    ClusterMesh& operator=(const ClusterMesh&) = delete;
+
+    static std::string containerPath(const std::string& assetPath);
+    // Map the container of an asset. Returns null (with 'err') when it is missing, corrupt, or was built
+    // from a different version of the source file.
+    static std::shared_ptr<ClusterMesh> open(const std::string& assetPath, std::string& err);
+
+    const std::string& sourcePath() const { return m_source; }
+    uint64_t triangleCount() const { return m_triangleCount; }
+    const std::vector<Node>& nodes() const { return m_nodes; }
+    static bool isLeaf(const Node& node) { return node.children[0] < 0; }
+    // bounds relative to origin()
+    const glm::vec3& boundsMin() const { return m_boundsMin; }
+    const glm::vec3& boundsMax() const { return m_boundsMax; }
+    // source coordinates of the mesh's local origin
+    const double* origin() const { return m_origin; }
+
+    // Geometry of a node, straight from the mapping (first access pages it in)
+    const glm::vec3* positions(const Node& node) const { return (const glm::vec3*)(m_file.data() + node.offset); }
+    const uint32_t* indices(const Node& node) const { return (const uint32_t*)(m_file.data() + node.offset + (uint64_t)node.vertexCount * 12); }
+    static size_t geometryBytes(const Node& node) { return (size_t)node.vertexCount * 12 + (size_t)node.triangleCount * 12; }
+
+    // Nearest hit of a ray (in the mesh's local space) with the full-detail triangles. Descends the node
+    // bounds nearest first, so only the clusters along the ray are read. Thread-safe.
+    bool rayIntersect(const glm::vec3& orig, const glm::vec3& dir, float& outT, glm::vec3& outNormal) const;
+
+    // GPU residency (GL thread)
+    std::vector<GpuNode>& gpuNodes() { return m_gpu; }
+    // 'positions' and 'indices' hold the node's geometry, indices already checked against its vertices
+    void uploadNode(size_t index, const glm::vec3* positions, const uint32_t* indices);
+    void releaseNode(size_t index);
+    size_t residentBytes() const { return m_residentBytes; }
+    size_t residentNodes() const { return m_residentNodes; }
+
+private:
+    ClusterMesh() = default;
+
+    std::string m_source;
+    MappedFile m_file;
+    std::vector<Node> m_nodes;
+    std::vector<GpuNode> m_gpu;
+    uint64_t m_triangleCount = 0;
+    double m_origin[3] = { 0.0, 0.0, 0.0 };
+    glm::vec3 m_boundsMin = glm::vec3(0.0f);
+    glm::vec3 m_boundsMax = glm::vec3(0.0f);
+    size_t m_residentBytes = 0;
+    size_t m_residentNodes = 0;
+};
@@ -0,0 +1,674 @@
+#include "cluster_mesh_builder.h"
+#include "cluster_mesh.h"
+#include "octree_chunks.h"
+#include "mesh_parsers.h"
+#include "mesh_optimizer.h"
+#include "mesh_cache.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include "xxhash.h"
+#include "log.h"
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+#include <cmath>
+#include <cfloat>
+
+namespace {
+
+using Node = ClusterMesh::Node;
+
+// triangles decoded per source block
+static const size_t kBlockTriangles = 1 << 18;
+// chunks are octree cells of at most this many triangles (see OctreeChunks)
+static const uint64_t kMaxChunkTriangles = 1 << 20;
+
+struct SourceTriangle {
+    double v[9];
+};
+
+// Triangle as stored in the scratch file: corners relative to the origin
+struct Triangle {
+    float v[9];
+};
+
+template<typename T> static T readLE(const uint8_t* p) { T v; memcpy(&v, p, sizeof(T)); return v; }
+
+// Sequential block reader over a mapped source file
+class TriangleReader {
+public:
+    virtual ~TriangleReader() = default;
+    // Decode the next block into 'out'; false when the file is exhausted. Triangles referring to
+    // missing vertices come out with NaN corners.
+    virtual bool next(std::vector<SourceTriangle>& out) = 0;
+    virtual void rewind() = 0;
+    // fraction of the file read so far
+    virtual float position() const = 0;
+    // bounds from a cheaper pass than one over the triangles, when the format allows it
+    virtual bool quickBounds(double mn[3], double mx[3]) { (void)mn; (void)mx; return false; }
+};
+
+// Binary STL: 80-byte header, triangle count, 50-byte records (normal, 3 corners, attribute word)
+class StlReader : public TriangleReader {
+public:
+    bool open(const std::string& path, std::string& err) {
+        if(!m_file.open(path)) { err = "cannot open file"; return false; }
+        if(m_file.size() < 84) { err = "not a binary STL file"; return false; }
+        m_count = readLE<uint32_t>(m_file.data() + 80);
+        if(84 + m_count * 50 != m_file.size()) { err = "only binary STL files can be imported out of core"; return false; }
+        return true;
+    }
+
+    bool next(std::vector<SourceTriangle>& out) override {
+        if(m_next >= m_count) return false;
+        size_t n = (size_t)std::min<uint64_t>(kBlockTriangles, m_count - m_next);
+        out.resize(n);
+        const uint8_t* base = m_file.data() + 84 + m_next * 50 + 12;
+        ThreadPool::instance().parallelFor(n, 1 << 14, [&](size_t b, size_t e){
+            for(size_t i = b; i < e; ++i)
+                for(int k = 0; k < 9; ++k) out[i].v[k] = readLE<float>(base + i * 50 + k * 4);
+        });
+        m_next += n;
+        return true;
+    }
+
+    void rewind() override { m_next = 0; }
+    float position() const override { return m_count ? (float)m_next / (float)m_count : 1.0f; }
+
+private:
+    MappedFile m_file;
+    uint64_t m_count = 0;
+    uint64_t m_next = 0;
+};
+
+// Binary PLY: vertex records with x/y/z and no lists; faces with a single index list of the same length
+// throughout (fan-triangulated), so every record can be addressed directly
+class PlyMeshReader : public TriangleReader {
+public:
+    bool open(const std::string& path, std::string& err) {
+        using namespace MeshParsers;
+        if(!m_file.open(path)) { err = "cannot open file"; return false; }
+        PlyHeader h;
+        if(!readPlyHeader((const char*)m_file.data(), m_file.size(), h, err)) return false;
+        if(h.format == PlyFormat::Ascii) { err = "only binary PLY files can be imported out of core"; return false; }
+        m_swap = h.format == PlyFormat::BinaryBE;
+        const uint64_t size = m_file.size();
+        uint64_t offset = h.bodyOffset;
+        bool haveVertices = false, haveFaces = false;
+        for(const PlyElement& e : h.elements) {
+            if(offset > size) { err = "PLY file is truncated"; return false; }
+            if(e.name == "face" && !haveFaces) {
+                if(e.props.size() != 1 || !e.props[0].list) { err = "PLY faces must have a single index list to be imported out of core"; return false; }
+                m_countType = e.props[0].countType;
+                m_indexType = e.props[0].type;
+                if(e.count == 0 || offset + plySize(m_countType) > size) { err = "PLY file has no faces"; return false; }
+                double n = readPlyValue(m_file.data() + offset, m_countType, m_swap);
+                if(n < 3 || n > 64) { err = "unsupported PLY face size"; return false; }
+                m_corners = (size_t)n;
+                m_faceStride = plySize(m_countType) + m_corners * plySize(m_indexType);
+                if((size - offset) / m_faceStride < e.count) { err = "PLY file is truncated"; return false; }
+                m_faceBegin = offset;
+                m_faceCount = e.count;
+                std::atomic<bool> uniform{true};
+                ThreadPool::instance().parallelFor(e.count, 1 << 16, [&](size_t b, size_t f){
+                    for(size_t i = b; i < f && uniform; ++i)
+                        if(readPlyValue(m_file.data() + m_faceBegin + i * m_faceStride, m_countType, m_swap) != n) uniform = false;
+                });
+                if(!uniform) { err = "PLY faces must all have the same number of corners to be imported out of core"; return false; }
+                offset += m_faceStride * e.count;
+                haveFaces = true;
+                continue;
+            }
+            size_t stride = 0;
+            std::vector<size_t> offsets;
+            for(const PlyProperty& p : e.props) {
+                if(p.list) { err = "PLY element " + e.name + " has a list property"; return false; }
+                offsets.push_back(stride);
+                stride += plySize(p.type);
+            }
+            if(stride && (size - offset) / stride < e.count) { err = "PLY file is truncated"; return false; }
+            if(e.name == "vertex" && !haveVertices) {
+                int f[3] = { -1, -1, -1 };
+                for(size_t i = 0; i < e.props.size(); ++i) {
+                    const std::string& name = e.props[i].name;
+                    if(name == "x") f[0] = (int)i;
+                    else if(name == "y") f[1] = (int)i;
+                    else if(name == "z") f[2] = (int)i;
+                }
+                if(f[0] < 0 || f[1] < 0 || f[2] < 0) { err = "PLY vertices have no x, y, z"; return false; }
+                for(int k = 0; k < 3; ++k) { m_fieldOffset[k] = offsets[f[k]]; m_fieldType[k] = e.props[f[k]].type; }
+                m_vertexBegin = offset;
+                m_vertexStride = stride;
+                m_vertexCount = e.count;
+                haveVertices = true;
+            }
+            offset += (uint64_t)stride * e.count;
+        }
+        if(!haveVertices) { err = "PLY file has no vertices"; return false; }
+        if(!haveFaces) { err = "PLY file has no faces"; return false; }
+        return true;
+    }
+
+    bool next(std::vector<SourceTriangle>& out) override {
+        if(m_next >= m_faceCount) return false;
+        size_t perFace = m_corners - 2;
+        size_t n = (size_t)std::min<uint64_t>(std::max<size_t>(kBlockTriangles / perFace, 1), m_faceCount - m_next);
+        out.resize(n * perFace);
+        uint64_t base = m_next;
+        size_t cs = MeshParsers::plySize(m_countType), is = MeshParsers::plySize(m_indexType);
+        ThreadPool::instance().parallelFor(n, 1 << 13, [&](size_t b, size_t e){
+            double corners[64][3];
+            for(size_t i = b; i < e; ++i) {
+                const uint8_t* rec = m_file.data() + m_faceBegin + (base + i) * m_faceStride + cs;
+                for(size_t k = 0; k < m_corners; ++k) vertex(MeshParsers::readPlyValue(rec + k * is, m_indexType, m_swap), corners[k]);
+                for(size_t k = 2; k < m_corners; ++k) {
+                    double* v = out[i * perFace + k - 2].v;
+                    memcpy(v, corners[0], sizeof(corners[0]));
+                    memcpy(v + 3, corners[k - 1], sizeof(corners[0]));
+                    memcpy(v + 6, corners[k], sizeof(corners[0]));
+                }
+            }
+        });
+        m_next += n;
+        return true;
+    }
+
+    void rewind() override { m_next = 0; }
+    float position() const override { return m_faceCount ? (float)m_next / (float)m_faceCount : 1.0f; }
+
+    // every vertex, referenced or not; slightly loose bounds only cost grid resolution
+    bool quickBounds(double mn[3], double mx[3]) override {
+        std::mutex mtx;
+        for(int k = 0; k < 3; ++k) { mn[k] = DBL_MAX; mx[k] = -DBL_MAX; }
+        ThreadPool::instance().parallelFor(m_vertexCount, 1 << 16, [&](size_t b, size_t e){
+            double lo[3] = { DBL_MAX, DBL_MAX, DBL_MAX }, hi[3] = { -DBL_MAX, -DBL_MAX, -DBL_MAX };
+            double p[3];
+            for(size_t i = b; i < e; ++i) {
+                vertex((double)i, p);
+                for(int k = 0; k < 3; ++k) if(std::isfinite(p[k])) { lo[k] = std::min(lo[k], p[k]); hi[k] = std::max(hi[k], p[k]); }
+            }
+            std::lock_guard<std::mutex> lk(mtx);
+            for(int k = 0; k < 3; ++k) { mn[k] = std::min(mn[k], lo[k]); mx[k] = std::max(mx[k], hi[k]); }
+        });
+        return mn[0] <= mx[0];
+    }
+
+private:
+    // position of vertex 'index'; NaN when it does not exist
+    void vertex(double index, double p[3]) const {
+        if(!(index >= 0.0 && index < (double)m_vertexCount)) { p[0] = p[1] = p[2] = NAN; return; }
+        const uint8_t* rec = m_file.data() + m_vertexBegin + (uint64_t)index * m_vertexStride;
+        for(int k = 0; k < 3; ++k) p[k] = MeshParsers::readPlyValue(rec + m_fieldOffset[k], m_fieldType[k], m_swap);
+    }
+
+    MappedFile m_file;
+    bool m_swap = false;
+    uint64_t m_vertexBegin = 0;
+    size_t m_vertexStride = 0;
+    uint64_t m_vertexCount = 0;
+    size_t m_fieldOffset[3] = { 0, 0, 0 };
+    MeshParsers::PlyType m_fieldType[3] = { MeshParsers::Float32, MeshParsers::Float32, MeshParsers::Float32 };
+    uint64_t m_faceBegin = 0;
+    size_t m_faceStride = 0;
+    uint64_t m_faceCount = 0;
+    size_t m_corners = 3;
+    MeshParsers::PlyType m_countType = MeshParsers::UInt8;
+    MeshParsers::PlyType m_indexType = MeshParsers::Int32;
+    uint64_t m_next = 0;
+};
+
+static std::string lowerExtension(const std::string& path) {
+    std::string ext = std::filesystem::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext;
+}
+
+static std::unique_ptr<TriangleReader> openReader(const std::string& path, std::string& err) {
+    if(lowerExtension(path) == ".stl") {
+        auto r = std::make_unique<StlReader>();
+        if(r->open(path, err)) return r;
+    } else {
+        auto r = std::make_unique<PlyMeshReader>();
+        if(r->open(path, err)) return r;
+    }
+    return nullptr;
+}
+
+static inline bool validTriangle(const SourceTriangle& t) {
+    for(double v : t.v) if(!std::isfinite(v)) return false;
+    return true;
+}
+
+// ---- Node geometry ----
+
+struct Geometry {
+    std::vector<float> positions; // xyz
+    std::vector<unsigned int> indices;
+};
+
+static float meanEdge(const Geometry& g) {
+    size_t tris = g.indices.size() / 3;
+    if(tris == 0) return 0.0f;
+    double sum = 0.0;
+    const glm::vec3* p = (const glm::vec3*)g.positions.data();
+    for(size_t t = 0; t < tris; ++t) {
+        const glm::vec3& a = p[g.indices[t * 3]];
+        const glm::vec3& b = p[g.indices[t * 3 + 1]];
+        const glm::vec3& c = p[g.indices[t * 3 + 2]];
+        sum += glm::length(b - a) + glm::length(c - b) + glm::length(a - c);
+    }
+    return (float)(sum / (double)(tris * 3));
+}
+
+// Inner node geometry: its children's, simplified to about kClusterTriangles. The node's error adds the
+// simplification's mean edge length to the largest child error; inputs already small enough are kept.
+static void simplifyChildren(const std::vector<Geometry>& children, Geometry& out, float childError, float& error) {
+    Geometry all;
+    for(const Geometry& g : children) {
+        unsigned int base = (unsigned int)(all.positions.size() / 3);
+        all.positions.insert(all.positions.end(), g.positions.begin(), g.positions.end());
+        for(unsigned int i : g.indices) all.indices.push_back(base + i);
+    }
+    if(MeshOptimizer::simplifyClusters(all.positions, all.indices, ClusterMesh::kClusterTriangles, out.positions, out.indices)) {
+        error = childError + meanEdge(out);
+    } else {
+        out = std::move(all);
+        error = childError;
+    }
+}
+
+static void geometryBounds(const Geometry& g, Node& node) {
+    node.min = glm::vec3(FLT_MAX);
+    node.max = glm::vec3(-FLT_MAX);
+    for(size_t i = 0; i + 2 < g.positions.size(); i += 3) {
+        glm::vec3 p(g.positions[i], g.positions[i + 1], g.positions[i + 2]);
+        node.min = glm::min(node.min, p);
+        node.max = glm::max(node.max, p);
+    }
+}
+
+// The container being written: node geometry is appended page-aligned by the chunk workers, the node
+// table and the header are written last
+class ContainerWriter {
+public:
+    bool open(const std::string& path) {
+        m_file.open(path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+        ClusterMesh::FileHeader h = {};
+        m_file.write((const char*)&h, sizeof(h));
+        m_end = sizeof(h);
+        return (bool)m_file;
+    }
+
+    // Offset of the written geometry; 0 on failure. Thread-safe.
+    uint64_t append(const Geometry& g) {
+        static const char zeros[ClusterMesh::kPageSize] = {};
+        std::lock_guard<std::mutex> lk(m_mtx);
+        uint64_t pad = (ClusterMesh::kPageSize - m_end % ClusterMesh::kPageSize) % ClusterMesh::kPageSize;
+        uint64_t offset = m_end + pad;
+        m_file.seekp((std::streamoff)m_end);
+        m_file.write(zeros, (std::streamsize)pad);
+        m_file.write((const char*)g.positions.data(), (std::streamsize)(g.positions.size() * sizeof(float)));
+        m_file.write((const char*)g.indices.data(), (std::streamsize)(g.indices.size() * sizeof(unsigned int)));
+        m_end = offset + g.positions.size() * sizeof(float) + g.indices.size() * sizeof(unsigned int);
+        return m_file ? offset : 0;
+    }
+
+    bool read(const Node& n, Geometry& g) {
+        std::lock_guard<std::mutex> lk(m_mtx);
+        g.positions.resize((size_t)n.vertexCount * 3);
+        g.indices.resize((size_t)n.triangleCount * 3);
+        m_file.seekg((std::streamoff)n.offset);
+        m_file.read((char*)g.positions.data(), (std::streamsize)(g.positions.size() * sizeof(float)));
+        m_file.read((char*)g.indices.data(), (std::streamsize)(g.indices.size() * sizeof(unsigned int)));
+        return (bool)m_file;
+    }
+
+    // Node table and header; closes the file
+    bool finish(ClusterMesh::FileHeader& h, const std::vector<Node>& nodes) {
+        std::lock_guard<std::mutex> lk(m_mtx);
+        h.nodeTableOffset = (m_end + 7) / 8 * 8;
+        h.nodeTableChecksum = XXHash::hash64(nodes.data(), nodes.size() * sizeof(Node));
+        h.headerChecksum = XXHash::hash64(&h, offsetof(ClusterMesh::FileHeader, headerChecksum));
+        static const char zeros[8] = {};
+        m_file.seekp((std::streamoff)m_end);
+        m_file.write(zeros, (std::streamsize)(h.nodeTableOffset - m_end));
+        m_file.write((const char*)nodes.data(), (std::streamsize)(nodes.size() * sizeof(Node)));
+        m_file.seekp(0);
+        m_file.write((const char*)&h, sizeof(h));
+        bool ok = (bool)m_file;
+        m_file.close();
+        return ok;
+    }
+
+private:
+    std::mutex m_mtx;
+    std::fstream m_file;
+    uint64_t m_end = 0;
+};
+
+// BVH of one chunk's welded triangles, split at the centroid median down to clusters
+struct ChunkTree {
+    const std::vector<float>& verts;
+    const std::vector<unsigned int>& idx;
+    ContainerWriter& writer;
+    std::vector<glm::vec3> centroids;
+    std::vector<uint32_t> order;
+    std::vector<Node> nodes;
+    bool ok = true;
+
+    ChunkTree(const std::vector<float>& v, const std::vector<unsigned int>& i, ContainerWriter& w) : verts(v), idx(i), writer(w) {
+        size_t tris = idx.size() / 3;
+        centroids.resize(tris);
+        order.resize(tris);
+        const glm::vec3* p = (const glm::vec3*)verts.data();
+        for(size_t t = 0; t < tris; ++t) {
+            centroids[t] = (p[idx[t * 3]] + p[idx[t * 3 + 1]] + p[idx[t * 3 + 2]]) / 3.0f;
+            order[t] = (uint32_t)t;
+        }
+    }
+
+    // Subtree of the triangles order[b, e), nodes in pre-order; 'geo' receives the root's geometry
+    int32_t build(size_t b, size_t e, Geometry& geo) {
+        int32_t self = (int32_t)nodes.size();
+        Node node = {};
+        for(int32_t& c : node.children) c = -1;
+        nodes.push_back(node);
+        if(e - b <= ClusterMesh::kClusterTriangles) {
+            // leaf: the triangles with their vertices numbered locally
+            std::unordered_map<unsigned int, unsigned int> local;
+            for(size_t i = b; i < e; ++i) {
+                for(int k = 0; k < 3; ++k) {
+                    unsigned int v = idx[order[i] * 3 + k];
+                    auto it = local.emplace(v, (unsigned int)local.size());
+                    if(it.second) geo.positions.insert(geo.positions.end(), &verts[v * 3], &verts[v * 3] + 3);
+                    geo.indices.push_back(it.first->second);
+                }
+            }
+            geometryBounds(geo, nodes[self]);
+        } else {
+            glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+            for(size_t i = b; i < e; ++i) { lo = glm::min(lo, centroids[order[i]]); hi = glm::max(hi, centroids[order[i]]); }
+            glm::vec3 ext = hi - lo;
+            int axis = ext.x >= ext.y && ext.x >= ext.z ? 0 : ext.y >= ext.z ? 1 : 2;
+            size_t mid = b + (e - b) / 2;
+            std::nth_element(order.begin() + b, order.begin() + mid, order.begin() + e, [&](uint32_t x, uint32_t y){ return centroids[x][axis] < centroids[y][axis]; });
+            std::vector<Geometry> children(2);
+            int32_t left = build(b, mid, children[0]);
+            int32_t right = build(mid, e, children[1]);
+            Node& n = nodes[self];
+            n.children[0] = left;
+            n.children[1] = right;
+            n.min = glm::min(nodes[left].min, nodes[right].min);
+            n.max = glm::max(nodes[left].max, nodes[right].max);
+            float error = 0.0f;
+            simplifyChildren(children, geo, std::max(nodes[left].error, nodes[right].error), error);
+            nodes[self].error = error;
+        }
+        Node& n = nodes[self];
+        n.vertexCount = (uint32_t)(geo.positions.size() / 3);
+        n.triangleCount = (uint32_t)(geo.indices.size() / 3);
+        n.offset = writer.append(geo);
+        if(n.offset == 0) ok = false;
+        return self;
+    }
+};
+
+static bool readTriangles(std::fstream& f, uint64_t first, Triangle* dst, size_t count) {
+    f.seekg((std::streamoff)(first * sizeof(Triangle)));
+    f.read((char*)dst, (std::streamsize)(count * sizeof(Triangle)));
+    return (bool)f;
+}
+
+static bool writeTriangles(std::fstream& f, uint64_t first, const Triangle* src, size_t count) {
+    f.seekp((std::streamoff)(first * sizeof(Triangle)));
+    f.write((const char*)src, (std::streamsize)(count * sizeof(Triangle)));
+    return (bool)f;
+}
+
+} // anonymous
+
+namespace ClusterMeshBuilder {
+
+uint64_t triangleCount(const std::string& path) {
+    std::string ext = lowerExtension(path);
+    if(ext != ".ply" && ext != ".stl") return 0;
+    MappedFile file;
+    if(!file.open(path)) return 0;
+    if(ext == ".stl") {
+        if(file.size() < 84) return 0;
+        uint64_t count = readLE<uint32_t>(file.data() + 80);
+        return 84 + count * 50 == file.size() ? count : 0;
+    }
+    MeshParsers::PlyHeader h;
+    std::string err;
+    if(!MeshParsers::readPlyHeader((const char*)file.data(), file.size(), h, err) || h.format == MeshParsers::PlyFormat::Ascii) return 0;
+    for(const MeshParsers::PlyElement& e : h.elements) if(e.name == "face") return e.count;
+    return 0;
+}
+
+bool build(const std::string& path, std::string& err, std::atomic<float>* progress, const std::atomic<bool>* cancel) {
+    MeshCache::SourceKey key;
+    if(!MeshCache::sourceKey(path, 0, key)) { err = "cannot read file"; return false; }
+    {
+        std::string stale;
+        if(ClusterMesh::open(path, stale)) return true;
+    }
+    std::unique_ptr<TriangleReader> reader = openReader(path, err);
+    if(!reader) return false;
+    ThreadPool& pool = ThreadPool::instance();
+    auto report = [&](float begin, float end, float f){ if(progress) *progress = begin + (end - begin) * f; };
+    auto cancelled = [&]{ return cancel && cancel->load(); };
+    std::vector<SourceTriangle> block;
+    auto dropInvalid = [&]{ block.erase(std::remove_if(block.begin(), block.end(), [](const SourceTriangle& t){ return !validTriangle(t); }), block.end()); };
+
+    // 1. bounds
+    double mn[3], mx[3];
+    if(!reader->quickBounds(mn, mx)) {
+        for(int k = 0; k < 3; ++k) { mn[k] = DBL_MAX; mx[k] = -DBL_MAX; }
+        while(reader->next(block)) {
+            if(cancelled()) { err = "cancelled"; return false; }
+            dropInvalid();
+            for(const SourceTriangle& t : block)
+                for(int c = 0; c < 9; ++c) { mn[c % 3] = std::min(mn[c % 3], t.v[c]); mx[c % 3] = std::max(mx[c % 3], t.v[c]); }
+            report(0.0f, 0.1f, reader->position());
+        }
+        reader->rewind();
+    }
+    if(mn[0] > mx[0]) { err = "no triangles"; return false; }
+    double origin[3], rootSize = 0.0;
+    for(int k = 0; k < 3; ++k) { origin[k] = 0.5 * (mn[k] + mx[k]); rootSize = std::max(rootSize, mx[k] - mn[k]); }
+    rootSize = rootSize > 0.0 ? rootSize * 1.001 : 1.0;
+    double rootMin[3] = { origin[0] - rootSize * 0.5, origin[1] - rootSize * 0.5, origin[2] - rootSize * 0.5 };
+    const OctreeChunks::Grid grid(rootMin, rootSize);
+    // triangles are placed by centroid
+    auto countCell = [&](const SourceTriangle& t){
+        return grid.cell((t.v[0] + t.v[3] + t.v[6]) / 3.0, (t.v[1] + t.v[4] + t.v[7]) / 3.0, (t.v[2] + t.v[5] + t.v[8]) / 3.0);
+    };
+
+    // 2. triangles per counting cell, and the tight bounds
+    auto counts = std::make_unique<OctreeChunks::Counts>();
+    glm::vec3 tightMin(FLT_MAX), tightMax(-FLT_MAX);
+    std::mutex boundsMtx;
+    uint64_t total = 0;
+    while(reader->next(block)) {
+        if(cancelled()) { err = "cancelled"; return false; }
+        dropInvalid();
+        pool.parallelFor(block.size(), 1 << 14, [&](size_t b, size_t e){
+            glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+            for(size_t i = b; i < e; ++i) {
+                counts->add(countCell(block[i]));
+                for(int c = 0; c < 3; ++c) {
+                    const double* v = block[i].v + c * 3;
+                    glm::vec3 p((float)(v[0] - origin[0]), (float)(v[1] - origin[1]), (float)(v[2] - origin[2]));
+                    lo = glm::min(lo, p);
+                    hi = glm::max(hi, p);
+                }
+            }
+            std::lock_guard<std::mutex> lk(boundsMtx);
+            tightMin = glm::min(tightMin, lo);
+            tightMax = glm::max(tightMax, hi);
+        });
+        total += block.size();
+        report(0.1f, 0.25f, reader->position());
+    }
+    if(total == 0) { err = "no triangles"; return false; }
+
+    const OctreeChunks::Layout layout = OctreeChunks::build(*counts, kMaxChunkTriangles);
+    counts.reset();
+
+    // 3. copy the triangles into their chunk's range of the scratch file
+    std::string outPath = ClusterMesh::containerPath(path);
+    std::string tmpPath = outPath + ".tmp";
+    std::string scratchPath = outPath + ".tris.tmp";
+    auto fail = [&](const std::string& message){
+        err = message;
+        std::error_code ec;
+        std::filesystem::remove(tmpPath, ec);
+        std::filesystem::remove(scratchPath, ec);
+        return false;
+    };
+    {
+        std::fstream f(scratchPath, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+        if(!f) return fail("cannot write " + scratchPath);
+        OctreeChunks::Scatter<Triangle> scatter(layout);
+        std::vector<uint32_t> chunkOf;
+        std::vector<Triangle> packed;
+        reader->rewind();
+        while(reader->next(block)) {
+            if(cancelled()) return fail("cancelled");
+            dropInvalid();
+            size_t n = block.size();
+            chunkOf.resize(n);
+            packed.resize(n);
+            pool.parallelFor(n, 1 << 14, [&](size_t b, size_t e){
+                for(size_t i = b; i < e; ++i) {
+                    chunkOf[i] = layout.cellChunk[countCell(block[i])];
+                    for(int c = 0; c < 9; ++c) packed[i].v[c] = (float)(block[i].v[c] - origin[c % 3]);
+                }
+            });
+            if(!scatter.add(chunkOf, packed, [&](uint64_t first, const Triangle* src, size_t count){ return writeTriangles(f, first, src, count); }))
+                return fail(scatter.overflowed() ? "the file changed during the import" : "cannot write " + scratchPath);
+            report(0.25f, 0.4f, reader->position());
+        }
+        if(!scatter.complete()) return fail("the file changed during the import");
+    }
+    reader.reset();
+
+    // 4. BVH of every chunk, in parallel; workers append node geometry to the container as they go
+    ContainerWriter writer;
+    if(!writer.open(tmpPath)) return fail("cannot write " + tmpPath);
+    std::vector<std::vector<Node>> chunkNodes(layout.chunks.size());
+    std::atomic<uint64_t> trianglesDone{0}, leafTriangles{0};
+    std::atomic<bool> ioError{false};
+    pool.parallelFor(layout.chunks.size(), 1, [&](size_t b, size_t e){
+        for(size_t c = b; c < e; ++c) {
+            if(cancelled() || ioError) return;
+            const OctreeChunks::Chunk& ch = layout.chunks[c];
+            std::vector<float> verts(ch.count * 9);
+            {
+                std::fstream f(scratchPath, std::ios::in | std::ios::binary);
+                if(!f || !readTriangles(f, ch.first, (Triangle*)verts.data(), ch.count)) { ioError = true; return; }
+            }
+            std::vector<unsigned int> idx(ch.count * 3);
+            for(size_t i = 0; i < idx.size(); ++i) idx[i] = (unsigned int)i;
+            // shared corners become shared vertices; collapsed triangles are dropped
+            MeshOptimizer::weldVertices(verts, idx, 0.0f);
+            if(!idx.empty()) {
+                ChunkTree tree(verts, idx, writer);
+                Geometry root;
+                tree.build(0, idx.size() / 3, root);
+                if(!tree.ok) { ioError = true; return; }
+                for(const Node& n : tree.nodes) if(ClusterMesh::isLeaf(n)) leafTriangles += n.triangleCount;
+                chunkNodes[c] = std::move(tree.nodes);
+            }
+            trianglesDone += ch.count;
+            report(0.4f, 0.95f, (float)trianglesDone.load() / (float)total);
+        }
+    });
+    {
+        std::error_code ec;
+        std::filesystem::remove(scratchPath, ec);
+    }
+    if(cancelled()) return fail("cancelled");
+    if(ioError) return fail("cannot write " + tmpPath);
+
+    // node table: the nodes above the chunks first (root = 0), then every chunk's subtree
+    std::vector<Node> nodes(layout.uppers.size());
+    std::vector<int32_t> chunkBase(layout.chunks.size(), -1);
+    for(size_t c = 0; c < layout.chunks.size(); ++c) {
+        if(chunkNodes[c].empty()) continue; // every triangle was degenerate
+        chunkBase[c] = (int32_t)nodes.size();
+        for(Node n : chunkNodes[c]) {
+            for(int32_t& child : n.children) if(child >= 0) child += chunkBase[c];
+            nodes.push_back(n);
+        }
+        std::vector<Node>().swap(chunkNodes[c]);
+    }
+    std::vector<bool> emptyUpper(layout.uppers.size(), false);
+    auto resolve = [&](int32_t ref){ return ref <= -2 ? chunkBase[-2 - ref] : ref >= 0 && emptyUpper[ref] ? -1 : ref; };
+
+    // 5. nodes above the chunks, children before parents, each simplified from its children's geometry
+    for(size_t u = layout.uppers.size(); u-- > 0;) {
+        Node& node = nodes[u];
+        node = Node();
+        for(int32_t& c : node.children) c = -1;
+        node.min = glm::vec3(FLT_MAX);
+        node.max = glm::vec3(-FLT_MAX);
+        std::vector<Geometry> children;
+        float childError = 0.0f;
+        int count = 0;
+        for(int32_t ref : layout.uppers[u].children) {
+            int32_t c = resolve(ref);
+            if(c < 0) continue;
+            // children are packed at the front; a node without children[0] is a leaf
+            node.children[count++] = c;
+            const Node& child = nodes[c];
+            node.min = glm::min(node.min, child.min);
+            node.max = glm::max(node.max, child.max);
+            childError = std::max(childError, child.error);
+            children.emplace_back();
+            if(!writer.read(child, children.back())) return fail("cannot read " + tmpPath);
+        }
+        if(count == 0) {
+            emptyUpper[u] = true;
+            // unreachable; any page-aligned offset inside the file passes validation
+            node.offset = ClusterMesh::kPageSize;
+            continue;
+        }
+        Geometry geo;
+        simplifyChildren(children, geo, childError, node.error);
+        node.vertexCount = (uint32_t)(geo.positions.size() / 3);
+        node.triangleCount = (uint32_t)(geo.indices.size() / 3);
+        node.offset = writer.append(geo);
+        if(node.offset == 0) return fail("cannot write " + tmpPath);
+        if(cancelled()) return fail("cancelled");
+    }
+    if(nodes.empty() || (!layout.uppers.empty() && emptyUpper[0])) return fail("no triangles");
+
+    ClusterMesh::FileHeader h = {};
+    h.magic = ClusterMesh::kMagic;
+    h.version = ClusterMesh::kVersion;
+    h.headerBytes = sizeof(h);
+    h.nodeCount = (uint32_t)nodes.size();
+    h.sourceSize = key.size;
+    h.sourceTime = key.time;
+    h.triangleCount = leafTriangles;
+    memcpy(h.origin, origin, sizeof(origin));
+    for(int k = 0; k < 3; ++k) { h.boundsMin[k] = tightMin[k]; h.boundsMax[k] = tightMax[k]; }
+    if(!writer.finish(h, nodes)) return fail("cannot write " + tmpPath);
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, outPath, ec);
+    if(ec) return fail("cannot write " + outPath);
+    report(0.0f, 1.0f, 1.0f);
+    LOG_INFO("Built cluster mesh " << outPath << ": " << h.triangleCount << " triangles, " << nodes.size() << " nodes, "
+             << layout.chunks.size() << " chunks");
+    return true;
+}
+
+} // namespace ClusterMeshBuilder
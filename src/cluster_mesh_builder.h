@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+// Converts a single large triangle mesh (binary PLY with uniform faces, or binary STL) into the BVH
+// container read by ClusterMesh, without ever holding the whole mesh in memory:
+//   1. bounds (a pass over the PLY vertices, or over the STL triangles)
+//   2. a pass counting triangle centroids per cell of a 128^3 grid; cells are merged up into chunks of
+//      at most about a million triangles
+//   3. a pass copying the triangles into their chunk's range of a scratch file
+//   4. per chunk, in parallel: vertices welded, a BVH split at the centroid median down to clusters of
+//      ClusterMesh::kClusterTriangles, and every inner node simplified from its children's geometry
+//   5. the nodes above the chunks (the occupied cells of the counting octree), simplified bottom-up
+// The source is memory-mapped and read in blocks decoded on the thread pool.
+namespace ClusterMeshBuilder {
+    // Triangles (faces for PLY) of a file the builder can read, from its header only; 0 for anything
+    // else, including ASCII files
+    uint64_t triangleCount(const std::string& path);
+
+    // Write "<asset>.nvcm" unless an up-to-date one exists. 'progress' (0..1) and 'cancel' are optional.
+    bool build(const std::string& path, std::string& err, std::atomic<float>* progress = nullptr, const std::atomic<bool>* cancel = nullptr);
+}
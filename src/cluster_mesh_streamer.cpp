@@ -0,0 +1,176 @@
+#include "cluster_mesh_streamer.h"
+#include "cluster_mesh.h"
+#include "node_residency.h"
+#include "scene.h"
+#include <algorithm>
+#include <memory>
+#include <queue>
+
+int g_clusterMeshTriangleBudget = 20000000;
+int g_clusterMeshMemoryMB = 1024;
+float g_clusterMeshScreenError = 2.0f;
+
+namespace {
+
+// Bytes uploaded per pump(); a node is about 100 KB, so a frame uploads a few hundred at most
+static const size_t kFrameUploadBytes = 48u << 20;
+// Node reads queued on the thread pool at once; more would only delay the nodes selected next frame
+static const size_t kMaxLoadsInFlight = 64;
+
+// Geometry of a node, copied out of the mapped container. Out-of-range indices are pointed at vertex 0,
+// so a damaged container cannot make the GPU read outside the vertex buffer.
+struct NodeGeometry {
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+
+    void read(const ClusterMesh& mesh, size_t node) {
+        const ClusterMesh::Node& n = mesh.nodes()[node];
+        const glm::vec3* p = mesh.positions(n);
+        const uint32_t* i = mesh.indices(n);
+        positions.assign(p, p + n.vertexCount);
+        indices.assign(i, i + (size_t)n.triangleCount * 3);
+        for(uint32_t& v : indices) if(v >= n.vertexCount) v = 0;
+    }
+    size_t bytes() const { return positions.size() * sizeof(glm::vec3) + indices.size() * sizeof(uint32_t); }
+    void upload(ClusterMesh& mesh, size_t node) const { mesh.uploadNode(node, positions.data(), indices.data()); }
+};
+
+// the root (node 0) is never evicted, so every mesh stays drawable
+static NodeResidency<ClusterMesh, NodeGeometry> s_residency(1, kMaxLoadsInFlight, kFrameUploadBytes);
+static bool s_synchronous = false;
+static ClusterMeshStreamer::Stats s_stats;
+
+struct MeshView {
+    std::shared_ptr<ClusterMesh> mesh;
+    glm::mat4 mvp;
+    glm::vec3 camera; // in the mesh's local space
+    Frustum frustum;
+    glm::vec3 color;
+};
+
+struct Candidate {
+    float priority; // projected error in pixels, largest first
+    uint32_t mesh;
+    int32_t node;
+    bool operator<(const Candidate& o) const { return priority < o.priority; }
+};
+
+static std::vector<const ClusterMesh*> sceneMeshes(const Scene& scene) {
+    return NodeResidency<ClusterMesh, NodeGeometry>::inScene(scene, scene.clusterMeshIds(), &SceneEntity::clusterMesh);
+}
+
+static size_t memoryBudget() { return (size_t)std::max(g_clusterMeshMemoryMB, 0) << 20; }
+
+} // namespace
+
+namespace ClusterMeshStreamer {
+
+void select(const Scene& scene, const glm::mat4& view, const glm::mat4& proj, int viewportHeight, std::vector<DrawNode>& out) {
+    out.clear();
+    // nothing calls pump() between offline frames; keep to the memory budget here
+    if(s_synchronous) s_residency.evict(sceneMeshes(scene), memoryBudget());
+    s_residency.beginFrame();
+    s_stats.selectedNodes = 0;
+    s_stats.drawnTriangles = 0;
+
+    std::vector<MeshView> meshes;
+    for(int id : scene.clusterMeshIds()) {
+        const SceneEntity* e = scene.findById(id);
+        if(!e || !e->clusterMesh || e->clusterMesh->nodes().empty()) continue;
+        glm::mat4 mv = view * e->world;
+        glm::mat4 mvp = proj * mv;
+        glm::vec3 color = id == scene.getSelectedId() ? e->color + glm::vec3(0.2f) : e->color;
+        meshes.push_back({ e->clusterMesh, mvp, glm::vec3(glm::inverse(mv)[3]), Frustum(mvp), color });
+        s_residency.track(e->clusterMesh);
+    }
+    if(meshes.empty()) return;
+
+    // pixels covered by one unit at distance one
+    float pixelsPerUnit = proj[1][1] * (float)viewportHeight * 0.5f;
+    auto projectedError = [&](const MeshView& mv, const ClusterMesh::Node& node) {
+        glm::vec3 center = (node.min + node.max) * 0.5f;
+        float radius = glm::length(node.max - node.min) * 0.5f;
+        // nearest distance to the node's bounding sphere; a node around the camera is refined first
+        float nearest = std::max(glm::length(center - mv.camera) - radius, radius * 1e-4f + 1e-12f);
+        return node.error * pixelsPerUnit / nearest;
+    };
+
+    // the cut starts at the roots; every node in it is drawn unless it is replaced by its children
+    std::priority_queue<Candidate> queue;
+    size_t triangles = 0;
+    for(uint32_t m = 0; m < meshes.size(); ++m) {
+        const MeshView& mv = meshes[m];
+        const ClusterMesh::Node& root = mv.mesh->nodes()[0];
+        if(!mv.frustum.intersects(root.min, root.max)) continue;
+        if(mv.mesh->gpuNodes()[0].vao == 0) s_residency.uploadNow(*mv.mesh, 0);
+        triangles += root.triangleCount;
+        queue.push({ projectedError(mv, root), m, 0 });
+    }
+
+    size_t budget = (size_t)std::max(g_clusterMeshTriangleBudget, 0);
+    int32_t visible[8];
+    while(!queue.empty()) {
+        Candidate cand = queue.top();
+        queue.pop();
+        const MeshView& mv = meshes[cand.mesh];
+        ClusterMesh& mesh = *mv.mesh;
+        const ClusterMesh::Node& node = mesh.nodes()[cand.node];
+        auto& gpu = mesh.gpuNodes();
+
+        bool replace = false;
+        if(!ClusterMesh::isLeaf(node) && cand.priority > g_clusterMeshScreenError) {
+            int count = 0;
+            size_t childTriangles = 0;
+            bool resident = true;
+            for(int32_t c : node.children) {
+                if(c < 0) continue;
+                const ClusterMesh::Node& child = mesh.nodes()[c];
+                if(!mv.frustum.intersects(child.min, child.max)) continue;
+                visible[count++] = c;
+                childTriangles += child.triangleCount;
+            }
+            if(triangles - node.triangleCount + childTriangles <= budget) {
+                for(int i = 0; i < count; ++i) {
+                    ClusterMesh::GpuNode& g = gpu[visible[i]];
+                    if(g.vao == 0 && s_synchronous) s_residency.uploadNow(mesh, visible[i]);
+                    if(g.vao != 0) {
+                        // kept until the whole set is resident
+                        g.lastUsedFrame = s_residency.frame();
+                    } else {
+                        resident = false;
+                        if(!g.loading && s_residency.canLoad()) s_residency.requestLoad(mv.mesh, visible[i]);
+                    }
+                }
+                replace = resident;
+            }
+            if(replace) {
+                triangles = triangles - node.triangleCount + childTriangles;
+                for(int i = 0; i < count; ++i) queue.push({ projectedError(mv, mesh.nodes()[visible[i]]), cand.mesh, visible[i] });
+            }
+        }
+        if(replace || node.triangleCount == 0) continue;
+
+        ClusterMesh::GpuNode& g = gpu[cand.node];
+        g.lastUsedFrame = s_residency.frame();
+        out.push_back({ g.vao, (GLsizei)(node.triangleCount * 3), mv.mvp, mv.color });
+        s_stats.selectedNodes++;
+        s_stats.drawnTriangles += node.triangleCount;
+    }
+}
+
+bool pump(const Scene& scene) { return s_residency.pump(sceneMeshes(scene), memoryBudget()); }
+
+unsigned int revision() { return s_residency.revision(); }
+
+void setSynchronous(bool synchronous) { s_synchronous = synchronous; }
+
+Stats stats() {
+    Stats st = s_stats;
+    s_residency.residentTotals(st.residentNodes, st.residentBytes);
+    st.loadsInFlight = s_residency.loadsInFlight();
+    return st;
+}
+
+void destroy() { s_residency.destroy(); }
+
+} // namespace ClusterMeshStreamer
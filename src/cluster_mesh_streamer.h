@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+class Scene;
+
+// Triangles drawn per frame over all cluster meshes
+extern int g_clusterMeshTriangleBudget;
+// GPU memory kept for loaded nodes (MB); the least recently drawn nodes beyond it are released
+extern int g_clusterMeshMemoryMB;
+// Screen-space error: a node is replaced by its children while its geometric error covers more pixels than this
+extern float g_clusterMeshScreenError;
+
+// Level-of-detail selection and GPU streaming for the cluster-mesh entities of a scene.
+// Each frame a cut through the BVH is refined largest-error-on-screen first: a node is replaced by its
+// children in the view frustum once all of them are on the GPU, while the triangle budget allows and its
+// error is above the screen-space threshold. Missing children are read from the mapped container on the
+// thread pool and uploaded by pump() within a per-frame byte budget; meanwhile the node itself is drawn.
+// The root is uploaded on first sight, so every mesh is always drawn at some level.
+//
+// All functions must be called on the GL thread.
+namespace ClusterMeshStreamer {
+    struct DrawNode {
+        GLuint vao = 0;
+        GLsizei count = 0; // indices
+        glm::mat4 mvp = glm::mat4(1.0f);
+        glm::vec3 color = glm::vec3(1.0f);
+    };
+
+    // Nodes to draw for the given view, and queue loads for the missing ones
+    void select(const Scene& scene, const glm::mat4& view, const glm::mat4& proj, int viewportHeight, std::vector<DrawNode>& out);
+
+    // Upload loaded nodes of the scene's meshes and release nodes over the memory budget, and those of
+    // meshes removed from the scene. Call once per frame. Returns true while loads are in flight.
+    bool pump(const Scene& scene);
+
+    // Bumped whenever nodes become resident or are released; a view showing cluster meshes is stale
+    // when it changes
+    unsigned int revision();
+
+    // Load missing nodes inside select() instead of streaming them (offline rendering wants complete frames)
+    void setSynchronous(bool synchronous);
+
+    struct Stats {
+        size_t selectedNodes = 0;
+        size_t drawnTriangles = 0;
+        size_t residentNodes = 0;
+        size_t residentBytes = 0;
+        size_t loadsInFlight = 0;
+    };
+    Stats stats();
+
+    // Drop queued loads and forget the tracked meshes (their GPU nodes are freed with the meshes)
+    void destroy();
+}
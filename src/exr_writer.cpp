@@ -0,0 +1,73 @@
+#include "exr_writer.h"
+#include <cstring>
+
+namespace ExrWriter {
+
+// little-endian appenders
+static void put32(std::vector<uint8_t>& out, uint32_t v) { for(int i = 0; i < 4; ++i) out.push_back((uint8_t)(v >> (8 * i))); }
+static void put64(std::vector<uint8_t>& out, uint64_t v) { for(int i = 0; i < 8; ++i) out.push_back((uint8_t)(v >> (8 * i))); }
+static void putFloat(std::vector<uint8_t>& out, float f) { uint32_t v; memcpy(&v, &f, 4); put32(out, v); }
+static void putString(std::vector<uint8_t>& out, const char* s) { out.insert(out.end(), s, s + strlen(s) + 1); }
+
+static void attribute(std::vector<uint8_t>& out, const char* name, const char* type, uint32_t size) {
+    putString(out, name);
+    putString(out, type);
+    put32(out, size);
+}
+
+bool encodeRGBAHalf(const uint16_t* rgba, int width, int height, std::vector<uint8_t>& out) {
+    if(!rgba || width <= 0 || height <= 0) return false;
+    // channels are stored in alphabetical order; index into the RGBA pixel
+    static const char* kNames[4] = { "A", "B", "G", "R" };
+    static const int kComponent[4] = { 3, 2, 1, 0 };
+    static const uint32_t kHalf = 1;
+
+    out.clear();
+    put32(out, 20000630); // magic
+    put32(out, 2);        // version 2, single-part scanline
+
+    attribute(out, "channels", "chlist", 4 * (2 + 16) + 1);
+    for(const char* name : kNames) {
+        putString(out, name);
+        put32(out, kHalf);
+        put32(out, 0); // pLinear + reserved
+        put32(out, 1); // x sampling
+        put32(out, 1); // y sampling
+    }
+    out.push_back(0);
+    attribute(out, "compression", "compression", 1);
+    out.push_back(0); // none
+    for(const char* window : { "dataWindow", "displayWindow" }) {
+        attribute(out, window, "box2i", 16);
+        put32(out, 0); put32(out, 0); put32(out, (uint32_t)(width - 1)); put32(out, (uint32_t)(height - 1));
+    }
+    attribute(out, "lineOrder", "lineOrder", 1);
+    out.push_back(0); // increasing y
+    attribute(out, "pixelAspectRatio", "float", 4);
+    putFloat(out, 1.0f);
+    attribute(out, "screenWindowCenter", "v2f", 8);
+    putFloat(out, 0.0f); putFloat(out, 0.0f);
+    attribute(out, "screenWindowWidth", "float", 4);
+    putFloat(out, 1.0f);
+    out.push_back(0); // end of header
+
+    // one scanline per chunk: y, byte count, then each channel's row
+    const uint32_t rowBytes = (uint32_t)width * 4 * 2;
+    uint64_t chunkStart = out.size() + (uint64_t)height * 8;
+    for(int y = 0; y < height; ++y) put64(out, chunkStart + (uint64_t)y * (8 + rowBytes));
+    out.reserve(out.size() + (size_t)height * (8 + rowBytes));
+    for(int y = 0; y < height; ++y) {
+        put32(out, (uint32_t)y);
+        put32(out, rowBytes);
+        const uint16_t* row = rgba + (size_t)y * width * 4;
+        for(int c = 0; c < 4; ++c)
+            for(int x = 0; x < width; ++x) {
+                uint16_t h = row[x * 4 + kComponent[c]];
+                out.push_back((uint8_t)h);
+                out.push_back((uint8_t)(h >> 8));
+            }
+    }
+    return true;
+}
+
+} // namespace ExrWriter
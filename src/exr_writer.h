@@ -0,0 +1,11 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+// Minimal OpenEXR writer: single-part scanline file, uncompressed, half-float R, G, B and A channels.
+// Enough for compositing and review tools to read rendered frames; nothing here reads EXR.
+namespace ExrWriter {
+    // Encode 'width' x 'height' pixels of 4 halves (IEEE binary16, RGBA), rows top to bottom. Thread-safe.
+    bool encodeRGBAHalf(const uint16_t* rgba, int width, int height, std::vector<uint8_t>& out);
+}
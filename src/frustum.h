@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// Planes of a clip matrix, in the space the matrix maps from (Gribb/Hartmann). The planes are
+// normalized, so a point's signed distance to a plane is dot(plane.xyz, p) + plane.w.
+struct Frustum {
+    glm::vec4 planes[6];
+
+    explicit Frustum(const glm::mat4& m) {
+        glm::vec4 rows[4];
+        for(int i = 0; i < 4; ++i) rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+        for(int i = 0; i < 3; ++i) {
+            planes[i * 2] = rows[3] + rows[i];
+            planes[i * 2 + 1] = rows[3] - rows[i];
+        }
+        for(glm::vec4& p : planes) {
+            float len = glm::length(glm::vec3(p));
+            if(len > 0.0f) p /= len;
+        }
+    }
+
+    bool intersects(const glm::vec3& mn, const glm::vec3& mx) const {
+        for(const glm::vec4& p : planes) {
+            // corner furthest along the plane normal
+            glm::vec3 v(p.x >= 0.0f ? mx.x : mn.x, p.y >= 0.0f ? mx.y : mn.y, p.z >= 0.0f ? mx.z : mn.z);
+            if(p.x * v.x + p.y * v.y + p.z * v.z + p.w < 0.0f) return false;
+        }
+        return true;
+    }
+
+    bool intersects(const glm::vec3& center, float radius) const {
+        for(const glm::vec4& p : planes)
+            if(glm::dot(glm::vec3(p), center) + p.w < -radius) return false;
+        return true;
+    }
+};
@@ -17,6 +17,7 @@ public:
     bool drawGizmo(const glm::mat4& vp, const glm::vec2& viewPos, const glm::vec2& viewSize, class Scene& scene);
 
     void setOperation(Operation op) { op_ = op; }
+    bool isDragging() const { return dragging_; }
 
 private:
     bool dragging_ = false;
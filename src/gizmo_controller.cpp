@@ -29,10 +29,7 @@ bool manipulate(Scene& scene, const glm::mat4& view, const glm::mat4& proj, cons
     SceneEntity* ent = scene.findById(scene.getSelectedId());
     if(!ent) return false;
 
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, ent->position);
-    model *= glm::toMat4(glm::quat(glm::radians(ent->rotation)));
-    model = glm::scale(model, ent->scale);
+    glm::mat4 model = ent->world;
 
     float viewMat[16]; float projMat[16]; float modelMat[16];
     memcpy(viewMat, &view[0][0], sizeof(viewMat));
@@ -41,6 +38,10 @@ bool manipulate(Scene& scene, const glm::mat4& view, const glm::mat4& proj, cons
 
     ImGuizmo::Manipulate(viewMat, projMat, op, mode, modelMat, NULL);
     if(ImGuizmo::IsUsing()) {
+        // the gizmo edits the world matrix; entity components are relative to the parent
+        glm::mat4 world; memcpy(&world[0][0], modelMat, sizeof(modelMat));
+        glm::mat4 local = glm::inverse(scene.parentWorld(*ent)) * world;
+        memcpy(modelMat, &local[0][0], sizeof(modelMat));
         float t[3], r[3], s[3];
         ImGuizmo::DecomposeMatrixToComponents(modelMat, t, r, s);
         // push undo on begin is handled by main (g_imguizmoActive)
@@ -117,6 +117,7 @@ bool Gizmo::drawGizmo(const glm::mat4& vp, const glm::vec2& viewPos, const glm::
             if(dragAxis == Axis::Y) newPos.y = initialPos.y - delta.y * moveScale;
             if(dragAxis == Axis::Z) newPos.z = initialPos.z + (delta.x - delta.y) * 0.01f;
             ent->position = newPos;
+            scene.markEntityDirty(sel);
         } else if(op_ == Operation::Rotate) {
             // Simple rotation: mouse X affects rotation around Y, mouse Y affects rotation around X
             glm::vec3 newRot = initialRot;
@@ -124,12 +125,14 @@ bool Gizmo::drawGizmo(const glm::mat4& vp, const glm::vec2& viewPos, const glm::
             if(dragAxis == Axis::Y) newRot.y = initialRot.y + delta.x * rotScale;
             if(dragAxis == Axis::Z) newRot.z = initialRot.z + (delta.x - delta.y) * rotScale;
             ent->rotation = newRot;
+            scene.markEntityDirty(sel);
         } else if(op_ == Operation::Scale) {
             glm::vec3 newScale = initialScale;
             if(dragAxis == Axis::X) newScale.x = std::max(0.001f, initialScale.x + delta.x * scaleScale);
             if(dragAxis == Axis::Y) newScale.y = std::max(0.001f, initialScale.y - delta.y * scaleScale);
             if(dragAxis == Axis::Z) newScale.z = std::max(0.001f, initialScale.z + (delta.x - delta.y) * scaleScale);
             ent->scale = newScale;
+            scene.markEntityDirty(sel);
         }
         return true;
     }
@@ -37,11 +37,7 @@ void DrawAxisOverlay(const SceneEntity* ent, const glm::mat4& view, const glm::m
     ImFont* font = ImGui::GetFont();
     float fontSize = ImGui::GetFontSize();
 
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, ent->position);
-    glm::quat q = glm::quat(glm::radians(ent->rotation));
-    model *= glm::toMat4(q);
-    model = glm::scale(model, ent->scale);
+    const glm::mat4& model = ent->world;
 
     glm::vec3 origin = glm::vec3(0.0f);
     glm::vec3 ax = glm::vec3(1.0f, 0.0f, 0.0f);
@@ -91,11 +87,7 @@ void DrawRotationArcs(Scene& scene, int entId, const glm::mat4& view, const glm:
     ImDrawList* dl = ImGui::GetForegroundDrawList();
     ImVec2 mouse = ImGui::GetIO().MousePos;
 
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, ent->position);
-    glm::quat q = glm::quat(glm::radians(ent->rotation));
-    model *= glm::toMat4(q);
-    model = glm::scale(model, ent->scale);
+    const glm::mat4& model = ent->world;
 
     float radius = std::max({ ent->scale.x, ent->scale.y, ent->scale.z }) * 1.5f;
     const int samples = 96;
@@ -118,7 +110,7 @@ void DrawRotationArcs(Scene& scene, int entId, const glm::mat4& view, const glm:
         glm::vec3 axis = axes[ai].axis;
         glm::vec3 ex, ey;
         if(mode == ImGuizmo::LOCAL) {
-            glm::vec3 ax_w = glm::normalize(glm::vec3(glm::toMat4(q) * glm::vec4(axis, 0.0f)));
+            glm::vec3 ax_w = glm::normalize(glm::vec3(model * glm::vec4(axis, 0.0f)));
             if (fabs(ax_w.y) < 0.9f) ex = glm::normalize(glm::cross(ax_w, glm::vec3(0,1,0)));
             else ex = glm::normalize(glm::cross(ax_w, glm::vec3(1,0,0)));
             ey = glm::normalize(glm::cross(ax_w, ex));
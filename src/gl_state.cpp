@@ -0,0 +1,140 @@
+#include "gl_state.h"
+
+namespace {
+
+// Sentinel for "unknown" object bindings and enums
+static const GLuint kUnknown = ~0u;
+
+struct Shadow {
+    GLuint program = kUnknown;
+    GLuint vao = kUnknown;
+    GLuint arrayBuffer = kUnknown;
+    GLuint elementBuffer = kUnknown;
+    GLuint framebuffer = kUnknown;
+    GLint viewport[4] = { -1, -1, -1, -1 };
+    int blend = -1; // -1 unknown, 0 off, 1 on
+    GLenum blendSrc = kUnknown;
+    GLenum blendDst = kUnknown;
+    int depthTest = -1;
+    int scissorTest = -1;
+    GLenum polygonMode = kUnknown;
+    float lineWidth = -1.0f;
+};
+
+static Shadow s_state;
+static GLState::Stats s_frame;
+static GLState::Stats s_lastFrame;
+
+// Returns true (and records the new value) when the call has to reach the driver
+template<typename T>
+static bool changed(T& shadow, T value) {
+    if(shadow == value) { s_frame.filtered++; return false; }
+    shadow = value;
+    s_frame.issued++;
+    return true;
+}
+
+static void setCap(int& shadow, GLenum cap, bool enabled) {
+    if(changed(shadow, enabled ? 1 : 0)) {
+        if(enabled) glEnable(cap); else glDisable(cap);
+    }
+}
+
+} // anonymous
+
+namespace GLState {
+
+void invalidate() { s_state = Shadow(); }
+
+void useProgram(GLuint prog) {
+    if(changed(s_state.program, prog)) glUseProgram(prog);
+}
+
+void bindVertexArray(GLuint vao) {
+    if(changed(s_state.vao, vao)) {
+        glBindVertexArray(vao);
+        s_state.elementBuffer = kUnknown;
+    }
+}
+
+void bindBuffer(GLenum target, GLuint buffer) {
+    if(target == GL_ARRAY_BUFFER) {
+        if(changed(s_state.arrayBuffer, buffer)) glBindBuffer(target, buffer);
+    } else if(target == GL_ELEMENT_ARRAY_BUFFER) {
+        if(changed(s_state.elementBuffer, buffer)) glBindBuffer(target, buffer);
+    } else {
+        glBindBuffer(target, buffer);
+        s_frame.issued++;
+    }
+}
+
+void bindFramebuffer(GLuint fbo) {
+    if(changed(s_state.framebuffer, fbo)) glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+}
+
+void viewport(GLint x, GLint y, GLsizei w, GLsizei h) {
+    GLint* v = s_state.viewport;
+    if(v[0] == x && v[1] == y && v[2] == w && v[3] == h) { s_frame.filtered++; return; }
+    v[0] = x; v[1] = y; v[2] = w; v[3] = h;
+    s_frame.issued++;
+    glViewport(x, y, w, h);
+}
+
+void setBlend(bool enabled) { setCap(s_state.blend, GL_BLEND, enabled); }
+
+void blendFunc(GLenum src, GLenum dst) {
+    if(s_state.blendSrc == src && s_state.blendDst == dst) { s_frame.filtered++; return; }
+    s_state.blendSrc = src; s_state.blendDst = dst;
+    s_frame.issued++;
+    glBlendFunc(src, dst);
+}
+
+void setDepthTest(bool enabled) { setCap(s_state.depthTest, GL_DEPTH_TEST, enabled); }
+
+void setScissorTest(bool enabled) { setCap(s_state.scissorTest, GL_SCISSOR_TEST, enabled); }
+
+void polygonMode(GLenum mode) {
+    if(changed(s_state.polygonMode, mode)) glPolygonMode(GL_FRONT_AND_BACK, mode);
+}
+
+void lineWidth(float width) {
+    if(changed(s_state.lineWidth, width)) glLineWidth(width);
+}
+
+void deleteProgram(GLuint& prog) {
+    if(!prog) return;
+    glDeleteProgram(prog);
+    if(s_state.program == prog) s_state.program = kUnknown;
+    prog = 0;
+}
+
+void deleteVertexArray(GLuint& vao) {
+    if(!vao) return;
+    glDeleteVertexArrays(1, &vao);
+    if(s_state.vao == vao) { s_state.vao = 0; s_state.elementBuffer = kUnknown; }
+    vao = 0;
+}
+
+void deleteBuffer(GLuint& buffer) {
+    if(!buffer) return;
+    glDeleteBuffers(1, &buffer);
+    if(s_state.arrayBuffer == buffer) s_state.arrayBuffer = 0;
+    if(s_state.elementBuffer == buffer) s_state.elementBuffer = 0;
+    buffer = 0;
+}
+
+void deleteFramebuffer(GLuint& fbo) {
+    if(!fbo) return;
+    glDeleteFramebuffers(1, &fbo);
+    if(s_state.framebuffer == fbo) s_state.framebuffer = 0;
+    fbo = 0;
+}
+
+const Stats& lastFrameStats() { return s_lastFrame; }
+
+void endFrame() {
+    s_lastFrame = s_frame;
+    s_frame = Stats();
+}
+
+} // namespace GLState
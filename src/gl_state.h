@@ -0,0 +1,47 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Shadow copy of the GL pipeline state touched by the renderer and viewport.
+// Every setter compares against the shadow value and only forwards changes to the driver;
+// nothing is ever read back with glGet*/glIsEnabled. Until a state has been set once through
+// this module it is "unknown" and the first call is always issued.
+//
+// Code that changes these states behind the cache's back must call invalidate() afterwards.
+// The ImGui OpenGL3 backend saves and restores everything it touches, so it needs no special care.
+namespace GLState {
+    // Forget all shadow values (next call for each state is issued unconditionally)
+    void invalidate();
+
+    // Object bindings
+    void useProgram(GLuint prog);
+    void bindVertexArray(GLuint vao);
+    // GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER (the latter is per-VAO and forgotten on VAO change)
+    void bindBuffer(GLenum target, GLuint buffer);
+    void bindFramebuffer(GLuint fbo);
+
+    // Fixed-function state
+    void viewport(GLint x, GLint y, GLsizei w, GLsizei h);
+    void setBlend(bool enabled);
+    void blendFunc(GLenum src, GLenum dst);
+    void setDepthTest(bool enabled);
+    void setScissorTest(bool enabled);
+    void polygonMode(GLenum mode); // GL_FRONT_AND_BACK
+    void lineWidth(float width);
+
+    // Deleting through the cache keeps bindings of deleted objects in sync (GL rebinds them to 0).
+    // The handle is reset to 0.
+    void deleteProgram(GLuint& prog);
+    void deleteVertexArray(GLuint& vao);
+    void deleteBuffer(GLuint& buffer);
+    void deleteFramebuffer(GLuint& fbo);
+
+    // Counters for the last finished frame
+    struct Stats {
+        int issued = 0;   // calls forwarded to GL
+        int filtered = 0; // redundant calls dropped
+    };
+    const Stats& lastFrameStats();
+    // Latch the counters of the current frame. Call once per frame.
+    void endFrame();
+}
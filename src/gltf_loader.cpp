@@ -0,0 +1,786 @@
+#include "gltf_loader.h"
+#include "mapped_file.h"
+#include "meshopt_decoder.h"
+#include "thread_pool.h"
+#include "log.h"
+#include <filesystem>
+#include <charconv>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NOVA_GLTF_SSE2 1
+#endif
+
+namespace {
+
+// ---- Minimal JSON DOM (only what glTF needs) ----
+
+struct JsonValue {
+    enum Type { Null, Bool, Number, String, Array, Object };
+    Type type = Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    const JsonValue* get(const char* key) const {
+        if(type != Object) return nullptr;
+        for(const auto& kv : object) if(kv.first == key) return &kv.second;
+        return nullptr;
+    }
+    // 'def' as well for numbers outside the int64_t range (and NaN), whose conversion is undefined
+    int64_t getInt(const char* key, int64_t def) const {
+        const JsonValue* v = get(key);
+        if(!v || v->type != Number || !(v->number >= -9223372036854775808.0 && v->number < 9223372036854775808.0)) return def;
+        return (int64_t)v->number;
+    }
+    bool getBool(const char* key, bool def) const {
+        const JsonValue* v = get(key);
+        return v && v->type == Bool ? v->boolean : def;
+    }
+    const std::string* getString(const char* key) const {
+        const JsonValue* v = get(key);
+        return v && v->type == String ? &v->string : nullptr;
+    }
+    const std::vector<JsonValue>& getArray(const char* key) const {
+        static const std::vector<JsonValue> empty;
+        const JsonValue* v = get(key);
+        return v && v->type == Array ? v->array : empty;
+    }
+};
+
+class JsonParser {
+public:
+    JsonParser(const char* begin, const char* end) : m_p(begin), m_end(end) {}
+
+    bool parse(JsonValue& out) {
+        if(!value(out, 0)) return false;
+        skipSpace();
+        return m_p == m_end;
+    }
+
+private:
+    static const int kMaxDepth = 64;
+
+    void skipSpace() { while(m_p < m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r')) ++m_p; }
+    bool literal(const char* word) {
+        size_t n = strlen(word);
+        if((size_t)(m_end - m_p) < n || memcmp(m_p, word, n) != 0) return false;
+        m_p += n;
+        return true;
+    }
+
+    bool value(JsonValue& out, int depth) {
+        if(depth > kMaxDepth) return false;
+        skipSpace();
+        if(m_p >= m_end) return false;
+        switch(*m_p) {
+        case '{': return object(out, depth);
+        case '[': return array(out, depth);
+        case '"': out.type = JsonValue::String; return string(out.string);
+        case 't': out.type = JsonValue::Bool; out.boolean = true; return literal("true");
+        case 'f': out.type = JsonValue::Bool; out.boolean = false; return literal("false");
+        case 'n': out.type = JsonValue::Null; return literal("null");
+        default: {
+            out.type = JsonValue::Number;
+            const char* start = m_p;
+            if(*start == '+') return false;
+            auto r = std::from_chars(start, m_end, out.number);
+            if(r.ec != std::errc()) return false;
+            m_p = r.ptr;
+            return true;
+        }
+        }
+    }
+
+    bool object(JsonValue& out, int depth) {
+        out.type = JsonValue::Object;
+        ++m_p;
+        skipSpace();
+        if(m_p < m_end && *m_p == '}') { ++m_p; return true; }
+        for(;;) {
+            skipSpace();
+            out.object.emplace_back();
+            if(m_p >= m_end || *m_p != '"' || !string(out.object.back().first)) return false;
+            skipSpace();
+            if(m_p >= m_end || *m_p != ':') return false;
+            ++m_p;
+            if(!value(out.object.back().second, depth + 1)) return false;
+            skipSpace();
+            if(m_p >= m_end) return false;
+            if(*m_p == ',') { ++m_p; continue; }
+            if(*m_p == '}') { ++m_p; return true; }
+            return false;
+        }
+    }
+
+    bool array(JsonValue& out, int depth) {
+        out.type = JsonValue::Array;
+        ++m_p;
+        skipSpace();
+        if(m_p < m_end && *m_p == ']') { ++m_p; return true; }
+        for(;;) {
+            out.array.emplace_back();
+            if(!value(out.array.back(), depth + 1)) return false;
+            skipSpace();
+            if(m_p >= m_end) return false;
+            if(*m_p == ',') { ++m_p; continue; }
+            if(*m_p == ']') { ++m_p; return true; }
+            return false;
+        }
+    }
+
+    static void appendUtf8(std::string& s, uint32_t cp) {
+        if(cp < 0x80) s += (char)cp;
+        else if(cp < 0x800) { s += (char)(0xC0 | (cp >> 6)); s += (char)(0x80 | (cp & 0x3F)); }
+        else if(cp < 0x10000) { s += (char)(0xE0 | (cp >> 12)); s += (char)(0x80 | ((cp >> 6) & 0x3F)); s += (char)(0x80 | (cp & 0x3F)); }
+        else { s += (char)(0xF0 | (cp >> 18)); s += (char)(0x80 | ((cp >> 12) & 0x3F)); s += (char)(0x80 | ((cp >> 6) & 0x3F)); s += (char)(0x80 | (cp & 0x3F)); }
+    }
+
+    bool hex4(uint32_t& out) {
+        if(m_end - m_p < 4) return false;
+        out = 0;
+        for(int i = 0; i < 4; ++i) {
+            char c = *m_p++;
+            out <<= 4;
+            if(c >= '0' && c <= '9') out |= (uint32_t)(c - '0');
+            else if(c >= 'a' && c <= 'f') out |= (uint32_t)(c - 'a' + 10);
+            else if(c >= 'A' && c <= 'F') out |= (uint32_t)(c - 'A' + 10);
+            else return false;
+        }
+        return true;
+    }
+
+    bool string(std::string& out) {
+        ++m_p; // opening quote
+        for(;;) {
+            const char* run = m_p;
+            while(m_p < m_end && *m_p != '"' && *m_p != '\\') ++m_p;
+            out.append(run, m_p);
+            if(m_p >= m_end) return false;
+            if(*m_p++ == '"') return true;
+            if(m_p >= m_end) return false;
+            char e = *m_p++;
+            switch(e) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                uint32_t cp;
+                if(!hex4(cp)) return false;
+                // surrogate pair
+                if(cp >= 0xD800 && cp < 0xDC00 && m_end - m_p >= 6 && m_p[0] == '\\' && m_p[1] == 'u') {
+                    m_p += 2;
+                    uint32_t lo;
+                    if(!hex4(lo)) return false;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                }
+                appendUtf8(out, cp);
+                break;
+            }
+            default: return false;
+            }
+        }
+    }
+
+    const char* m_p;
+    const char* m_end;
+};
+
+// ---- Buffers ----
+
+static const uint32_t kGlbMagic = 0x46546C67;     // "glTF"
+static const uint32_t kChunkJson = 0x4E4F534A;    // "JSON"
+static const uint32_t kChunkBin = 0x004E4942;     // "BIN\0"
+
+static const int kByte = 5120, kUnsignedByte = 5121, kShort = 5122, kUnsignedShort = 5123, kUnsignedInt = 5125, kFloat = 5126;
+static const int kModeTriangles = 4;
+// Elements of an accessor without a bufferView (all zeros): nothing in the file bounds its count
+static const int64_t kMaxZeroAccessorCount = 1 << 24;
+
+// Extensions this reader implements; any other entry in extensionsRequired rejects the file
+static bool supportedExtension(const std::string& name) {
+    return name == "EXT_mesh_gpu_instancing" || name == "EXT_meshopt_compression" || name == "KHR_mesh_quantization";
+}
+
+// The object of extension 'name' in v's "extensions", if present
+static const JsonValue* extension(const JsonValue& v, const char* name) {
+    const JsonValue* exts = v.get("extensions");
+    return exts ? exts->get(name) : nullptr;
+}
+
+static size_t componentSize(int type) {
+    switch(type) {
+    case kByte: case kUnsignedByte: return 1;
+    case kShort: case kUnsignedShort: return 2;
+    case kUnsignedInt: case kFloat: return 4;
+    default: return 0;
+    }
+}
+
+static int componentCount(const std::string& type) {
+    if(type == "SCALAR") return 1;
+    if(type == "VEC2") return 2;
+    if(type == "VEC3") return 3;
+    if(type == "VEC4") return 4;
+    if(type == "MAT2") return 4;
+    if(type == "MAT3") return 9;
+    if(type == "MAT4") return 16;
+    return 0;
+}
+
+static bool decodeBase64(const char* p, const char* end, std::vector<uint8_t>& out) {
+    struct Table {
+        int8_t v[256];
+        Table() {
+            memset(v, -1, sizeof(v));
+            const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+            for(int i = 0; i < 64; ++i) v[(uint8_t)alphabet[i]] = (int8_t)i;
+        }
+    };
+    static const Table table;
+    out.reserve((size_t)(end - p) / 4 * 3);
+    uint32_t acc = 0; int bits = 0;
+    for(; p < end; ++p) {
+        if(*p == '=') break;
+        int8_t v = table.v[(uint8_t)*p];
+        if(v < 0) return false;
+        acc = (acc << 6) | (uint32_t)v;
+        bits += 6;
+        if(bits >= 8) { bits -= 8; out.push_back((uint8_t)(acc >> bits)); }
+    }
+    return true;
+}
+
+static std::string decodeUri(const std::string& uri) {
+    std::string out;
+    for(size_t i = 0; i < uri.size(); ++i) {
+        if(uri[i] == '%' && i + 2 < uri.size()) {
+            char hex[3] = { uri[i + 1], uri[i + 2], 0 };
+            out += (char)strtol(hex, nullptr, 16);
+            i += 2;
+        } else out += uri[i];
+    }
+    return out;
+}
+
+} // anonymous
+
+namespace GltfLoader {
+
+struct Document {
+    struct Span { const uint8_t* data = nullptr; size_t size = 0; };
+    struct Primitive { int position = -1; int indices = -1; int mode = kModeTriangles; };
+
+    std::vector<std::shared_ptr<MappedFile>> files; // the .gltf/.glb and external buffers
+    std::vector<std::vector<uint8_t>> decoded;      // data: URI buffers
+    JsonValue json;
+    std::vector<Span> buffers;
+    std::vector<std::vector<uint8_t>> views;        // decoded EXT_meshopt_compression bufferViews (by index)
+    std::vector<Primitive> primitives;
+    std::vector<size_t> meshFirstPrimitive; // per mesh, plus one past the end
+};
+
+// Resolved accessor: element i starts at data + i * stride
+struct AccessorView {
+    const uint8_t* data = nullptr;
+    size_t count = 0;
+    size_t stride = 0;
+    int componentType = 0;
+    int components = 0;
+    bool normalized = false;
+};
+
+static bool resolveAccessor(const Document& doc, int index, AccessorView& out, std::string& err) {
+    const auto& accessors = doc.json.getArray("accessors");
+    if(index < 0 || index >= (int)accessors.size()) { err = "accessor index out of range"; return false; }
+    const JsonValue& acc = accessors[index];
+    if(acc.get("sparse")) { err = "sparse accessors are not supported"; return false; }
+    int64_t count = acc.getInt("count", 0);
+    if(count < 0) { err = "negative accessor count"; return false; }
+    out.count = (size_t)count;
+    out.componentType = (int)acc.getInt("componentType", 0);
+    const std::string* type = acc.getString("type");
+    out.components = type ? componentCount(*type) : 0;
+    out.normalized = acc.getBool("normalized", false);
+    size_t elemSize = componentSize(out.componentType) * (size_t)out.components;
+    if(elemSize == 0) { err = "invalid accessor type"; return false; }
+
+    int viewIndex = (int)acc.getInt("bufferView", -1);
+    if(viewIndex < 0) {
+        // all zeros per spec
+        if(count > kMaxZeroAccessorCount) { err = "accessor without a bufferView is too large"; return false; }
+        out.data = nullptr;
+        out.stride = elemSize;
+        return true;
+    }
+    const auto& views = doc.json.getArray("bufferViews");
+    if(viewIndex >= (int)views.size()) { err = "bufferView index out of range"; return false; }
+    const JsonValue& view = views[viewIndex];
+    const uint8_t* viewData = nullptr;
+    size_t viewLength = 0;
+    if((size_t)viewIndex < doc.views.size() && !doc.views[viewIndex].empty()) {
+        viewData = doc.views[viewIndex].data();
+        viewLength = doc.views[viewIndex].size();
+    } else {
+        int bufferIndex = (int)view.getInt("buffer", -1);
+        if(bufferIndex < 0 || bufferIndex >= (int)doc.buffers.size()) { err = "buffer index out of range"; return false; }
+        const Document::Span& buf = doc.buffers[bufferIndex];
+        size_t viewOffset = (size_t)view.getInt("byteOffset", 0);
+        viewLength = (size_t)view.getInt("byteLength", 0);
+        if(viewOffset > buf.size || viewLength > buf.size - viewOffset) { err = "bufferView exceeds its buffer"; return false; }
+        viewData = buf.data + viewOffset;
+    }
+    size_t accOffset = (size_t)acc.getInt("byteOffset", 0);
+    out.stride = (size_t)view.getInt("byteStride", 0);
+    if(out.stride == 0) out.stride = elemSize;
+    // by division: a huge count from the JSON would wrap the multiplication
+    if(out.count > 0 && (accOffset > viewLength || elemSize > viewLength - accOffset
+                         || out.count - 1 > (viewLength - accOffset - elemSize) / out.stride)) {
+        err = "accessor exceeds its bufferView"; return false;
+    }
+    out.data = viewData + accOffset;
+    return true;
+}
+
+// Read 'n' components per element as floats (normalized integers are mapped to [0,1] / [-1,1])
+template<typename T>
+static void readComponents(const AccessorView& a, int n, float* out) {
+    float scale = 1.0f;
+    if(a.normalized) scale = 1.0f / (float)std::numeric_limits<T>::max();
+    for(size_t i = 0; i < a.count; ++i) {
+        const uint8_t* e = a.data + i * a.stride;
+        for(int c = 0; c < n; ++c) {
+            T v; memcpy(&v, e + c * sizeof(T), sizeof(T));
+            float f = (float)v * scale;
+            out[i * n + c] = (a.normalized && std::numeric_limits<T>::is_signed) ? std::max(f, -1.0f) : f;
+        }
+    }
+}
+
+static bool readFloats(const AccessorView& a, int n, std::vector<float>& out) {
+    if(a.data && a.components < n) return false;
+    try {
+        out.assign(a.count * n, 0.0f);
+    } catch(const std::bad_alloc&) {
+        return false;
+    }
+    if(!a.data || a.count == 0) return true;
+    switch(a.componentType) {
+    case kFloat:
+        if(a.stride == (size_t)n * 4) { memcpy(out.data(), a.data, out.size() * 4); return true; }
+        readComponents<float>(a, n, out.data()); return true;
+    case kByte: readComponents<int8_t>(a, n, out.data()); return true;
+    case kUnsignedByte: readComponents<uint8_t>(a, n, out.data()); return true;
+    case kShort: readComponents<int16_t>(a, n, out.data()); return true;
+    case kUnsignedShort: readComponents<uint16_t>(a, n, out.data()); return true;
+    case kUnsignedInt: readComponents<uint32_t>(a, n, out.data()); return true;
+    default: return false;
+    }
+}
+
+// Widen 16-bit indices, 8 per iteration with SSE2
+static void widenIndices16(const uint8_t* src, size_t count, unsigned int* dst) {
+    size_t i = 0;
+#ifdef NOVA_GLTF_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for(; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i * 2));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi16(v, zero));
+        _mm_storeu_si128((__m128i*)(dst + i + 4), _mm_unpackhi_epi16(v, zero));
+    }
+#endif
+    for(; i < count; ++i) { uint16_t v; memcpy(&v, src + i * 2, 2); dst[i] = v; }
+}
+
+// Widen 8-bit indices, 16 per iteration with SSE2
+static void widenIndices8(const uint8_t* src, size_t count, unsigned int* dst) {
+    size_t i = 0;
+#ifdef NOVA_GLTF_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for(; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i lo = _mm_unpacklo_epi8(v, zero), hi = _mm_unpackhi_epi8(v, zero);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi16(lo, zero));
+        _mm_storeu_si128((__m128i*)(dst + i + 4), _mm_unpackhi_epi16(lo, zero));
+        _mm_storeu_si128((__m128i*)(dst + i + 8), _mm_unpacklo_epi16(hi, zero));
+        _mm_storeu_si128((__m128i*)(dst + i + 12), _mm_unpackhi_epi16(hi, zero));
+    }
+#endif
+    for(; i < count; ++i) dst[i] = src[i];
+}
+
+static bool readIndices(const AccessorView& a, std::vector<unsigned int>& out) {
+    if(a.count == 0) { out.clear(); return true; }
+    if(!a.data || a.components != 1) return false;
+    try {
+        out.resize(a.count);
+    } catch(const std::bad_alloc&) {
+        return false;
+    }
+    size_t size = componentSize(a.componentType);
+    if(a.stride == size) {
+        // index views are tightly packed (the spec forbids byteStride on them)
+        switch(a.componentType) {
+        case kUnsignedInt: memcpy(out.data(), a.data, a.count * 4); return true;
+        case kUnsignedShort: widenIndices16(a.data, a.count, out.data()); return true;
+        case kUnsignedByte: widenIndices8(a.data, a.count, out.data()); return true;
+        default: return false;
+        }
+    }
+    for(size_t i = 0; i < a.count; ++i) {
+        const uint8_t* e = a.data + i * a.stride;
+        switch(a.componentType) {
+        case kUnsignedInt: { uint32_t v; memcpy(&v, e, 4); out[i] = v; break; }
+        case kUnsignedShort: { uint16_t v; memcpy(&v, e, 2); out[i] = v; break; }
+        case kUnsignedByte: out[i] = *e; break;
+        default: return false;
+        }
+    }
+    return true;
+}
+
+static bool mapBuffers(Document& doc, const std::filesystem::path& baseDir, const Document::Span& glbBin, std::string& err) {
+    const auto& buffers = doc.json.getArray("buffers");
+    doc.buffers.resize(buffers.size());
+    for(size_t i = 0; i < buffers.size(); ++i) {
+        const JsonValue& b = buffers[i];
+        size_t length = (size_t)b.getInt("byteLength", 0);
+        const std::string* uri = b.getString("uri");
+        Document::Span span;
+        const JsonValue* meshopt = extension(b, "EXT_meshopt_compression");
+        if(meshopt && meshopt->getBool("fallback", false)) {
+            continue;   // placeholder for the uncompressed data; compressed views are decoded instead
+        } else if(!uri) {
+            // GLB-stored buffer: only the first buffer may omit its uri
+            if(i != 0 || !glbBin.data) { err = "buffer without uri"; return false; }
+            span = glbBin;
+        } else if(uri->compare(0, 5, "data:") == 0) {
+            size_t comma = uri->find(',');
+            if(comma == std::string::npos || uri->find(";base64") > comma) { err = "unsupported data uri"; return false; }
+            doc.decoded.emplace_back();
+            if(!decodeBase64(uri->data() + comma + 1, uri->data() + uri->size(), doc.decoded.back())) { err = "invalid base64 buffer"; return false; }
+            span.data = doc.decoded.back().data();
+            span.size = doc.decoded.back().size();
+        } else {
+            auto file = std::make_shared<MappedFile>();
+            std::filesystem::path p = baseDir / std::filesystem::path(decodeUri(*uri));
+            if(!file->open(p.string())) { err = "could not open buffer " + p.string(); return false; }
+            span.data = file->data();
+            span.size = file->size();
+            doc.files.push_back(file);
+        }
+        if(span.size < length) { err = "buffer is shorter than its byteLength"; return false; }
+        span.size = length;
+        doc.buffers[i] = span;
+    }
+    return true;
+}
+
+// EXT_meshopt_compression: the view's data is a meshopt stream stored in another buffer
+static bool decodeView(const Document& doc, const JsonValue& view, const JsonValue& ext, std::vector<uint8_t>& out) {
+    int bufferIndex = (int)ext.getInt("buffer", -1);
+    if(bufferIndex < 0 || bufferIndex >= (int)doc.buffers.size()) return false;
+    const Document::Span& buf = doc.buffers[bufferIndex];
+    size_t offset = (size_t)ext.getInt("byteOffset", 0);
+    size_t length = (size_t)ext.getInt("byteLength", 0);
+    if(offset > buf.size || length > buf.size - offset) return false;
+    size_t count = (size_t)ext.getInt("count", 0);
+    size_t stride = (size_t)ext.getInt("byteStride", 0);
+    if(stride == 0 || stride > 256 || count > (size_t)1 << 32) return false;
+    // the decoded data must fit the view's declared (uncompressed) length, which bounds the allocation
+    int64_t viewLength = view.getInt("byteLength", -1);
+    if(viewLength < 0 || count * stride > (uint64_t)viewLength) return false;
+    const std::string* mode = ext.getString("mode");
+    const std::string* filter = ext.getString("filter");
+    const uint8_t* src = buf.data + offset;
+    if(!mode) return false;
+    try { out.resize(count * stride); } catch(const std::bad_alloc&) { return false; }
+    if(*mode == "ATTRIBUTES") {
+        if(!MeshoptDecoder::decodeVertexBuffer(out.data(), count, stride, src, length)) return false;
+        MeshoptDecoder::Filter f = MeshoptDecoder::Filter::None;
+        if(filter && *filter == "OCTAHEDRAL") f = MeshoptDecoder::Filter::Octahedral;
+        else if(filter && *filter == "QUATERNION") f = MeshoptDecoder::Filter::Quaternion;
+        else if(filter && *filter == "EXPONENTIAL") f = MeshoptDecoder::Filter::Exponential;
+        else if(filter && *filter != "NONE") return false;
+        return MeshoptDecoder::applyFilter(out.data(), count, stride, f);
+    }
+    if(*mode == "TRIANGLES") return MeshoptDecoder::decodeIndexBuffer(out.data(), count, stride, src, length);
+    if(*mode == "INDICES") return MeshoptDecoder::decodeIndexSequence(out.data(), count, stride, src, length);
+    return false;
+}
+
+// Decode the compressed views behind the accessors the import reads (positions, indices, instance
+// transforms); normals, UVs etc. stay compressed. Views are decoded in parallel.
+static bool decodeViews(Document& doc, std::string& err) {
+    const auto& accessors = doc.json.getArray("accessors");
+    const auto& views = doc.json.getArray("bufferViews");
+    std::vector<int> used;
+    auto useAccessor = [&](int64_t a){
+        if(a < 0 || a >= (int64_t)accessors.size()) return;
+        int64_t v = accessors[a].getInt("bufferView", -1);
+        if(v >= 0 && v < (int64_t)views.size() && extension(views[v], "EXT_meshopt_compression")) used.push_back((int)v);
+    };
+    for(const Document::Primitive& p : doc.primitives) {
+        if(p.mode != kModeTriangles) continue;
+        useAccessor(p.position);
+        useAccessor(p.indices);
+    }
+    for(const JsonValue& n : doc.json.getArray("nodes")) {
+        const JsonValue* inst = extension(n, "EXT_mesh_gpu_instancing");
+        const JsonValue* attrs = inst ? inst->get("attributes") : nullptr;
+        if(!attrs) continue;
+        for(const char* name : { "TRANSLATION", "ROTATION", "SCALE" }) useAccessor(attrs->getInt(name, -1));
+    }
+    if(used.empty()) return true;
+    std::sort(used.begin(), used.end());
+    used.erase(std::unique(used.begin(), used.end()), used.end());
+
+    doc.views.resize(views.size());
+    std::vector<char> ok(used.size(), 0);
+    ThreadPool::instance().parallelFor(used.size(), 1, [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; ++i) {
+            int v = used[i];
+            ok[i] = decodeView(doc, views[v], *extension(views[v], "EXT_meshopt_compression"), doc.views[v]);
+        }
+    });
+    for(size_t i = 0; i < used.size(); ++i) {
+        if(!ok[i]) { err = "could not decode compressed bufferView " + std::to_string(used[i]); return false; }
+    }
+    return true;
+}
+
+std::shared_ptr<const Document> open(const std::string& path, std::string& err) {
+    auto doc = std::make_shared<Document>();
+    auto file = std::make_shared<MappedFile>();
+    if(!file->open(path)) { err = "could not open " + path; return nullptr; }
+    doc->files.push_back(file);
+
+    // A GLB is a 12-byte header followed by a JSON chunk and an optional BIN chunk
+    const uint8_t* data = file->data();
+    size_t size = file->size();
+    const char* jsonBegin = (const char*)data;
+    const char* jsonEnd = (const char*)data + size;
+    Document::Span bin;
+    uint32_t magic = 0;
+    if(size >= 4) memcpy(&magic, data, 4);
+    if(magic == kGlbMagic) {
+        uint32_t header[3];
+        if(size < 20) { err = "truncated GLB header"; return nullptr; }
+        memcpy(header, data, 12);
+        if(header[1] != 2) { err = "unsupported GLB version"; return nullptr; }
+        size_t total = std::min<size_t>(header[2], size);
+        size_t offset = 12;
+        bool haveJson = false;
+        while(offset + 8 <= total) {
+            uint32_t chunk[2];
+            memcpy(chunk, data + offset, 8);
+            offset += 8;
+            if(chunk[0] > total - offset) { err = "truncated GLB chunk"; return nullptr; }
+            if(chunk[1] == kChunkJson && !haveJson) {
+                jsonBegin = (const char*)data + offset;
+                jsonEnd = jsonBegin + chunk[0];
+                haveJson = true;
+            } else if(chunk[1] == kChunkBin && !bin.data) {
+                bin.data = data + offset;
+                bin.size = chunk[0];
+            }
+            offset += (chunk[0] + 3) & ~3u;
+        }
+        if(!haveJson) { err = "GLB has no JSON chunk"; return nullptr; }
+    }
+
+    if(!JsonParser(jsonBegin, jsonEnd).parse(doc->json) || doc->json.type != JsonValue::Object) { err = "invalid JSON"; return nullptr; }
+    const JsonValue* asset = doc->json.get("asset");
+    const std::string* version = asset ? asset->getString("version") : nullptr;
+    if(!version || version->compare(0, 2, "2.") != 0) { err = "not a glTF 2.0 file"; return nullptr; }
+    for(const JsonValue& ext : doc->json.getArray("extensionsRequired")) {
+        if(supportedExtension(ext.string)) continue;
+        err = "requires unsupported extension " + ext.string;
+        return nullptr;
+    }
+
+    std::filesystem::path baseDir = std::filesystem::path(path).parent_path();
+    if(!mapBuffers(*doc, baseDir, bin, err)) return nullptr;
+
+    for(const JsonValue& mesh : doc->json.getArray("meshes")) {
+        doc->meshFirstPrimitive.push_back(doc->primitives.size());
+        for(const JsonValue& prim : mesh.getArray("primitives")) {
+            Document::Primitive p;
+            const JsonValue* attrs = prim.get("attributes");
+            p.position = attrs ? (int)attrs->getInt("POSITION", -1) : -1;
+            p.indices = (int)prim.getInt("indices", -1);
+            p.mode = (int)prim.getInt("mode", kModeTriangles);
+            doc->primitives.push_back(p);
+        }
+    }
+    doc->meshFirstPrimitive.push_back(doc->primitives.size());
+    if(!decodeViews(*doc, err)) return nullptr;
+    return doc;
+}
+
+size_t primitiveCount(const Document& doc) { return doc.primitives.size(); }
+
+bool primitiveQuantized(const Document& doc, size_t i) {
+    const auto& accessors = doc.json.getArray("accessors");
+    int position = doc.primitives[i].position;
+    if(position < 0 || position >= (int)accessors.size()) return false;
+    return accessors[position].getInt("componentType", kFloat) != kFloat;
+}
+
+static glm::mat4 trsMatrix(const glm::vec3& t, const glm::quat& r, const glm::vec3& s) {
+    return glm::scale(glm::translate(glm::mat4(1.0f), t) * glm::mat4_cast(r), s);
+}
+
+static glm::vec3 jsonVec3(const std::vector<JsonValue>& a, float def) {
+    glm::vec3 v(def);
+    if(a.size() == 3) for(int k = 0; k < 3; ++k) v[k] = (float)a[k].number;
+    return v;
+}
+
+// Local transform of a node: 'matrix' (column-major) or translation/rotation (xyzw)/scale
+static glm::mat4 nodeMatrix(const JsonValue& node) {
+    const auto& m = node.getArray("matrix");
+    if(m.size() == 16) {
+        glm::mat4 r;
+        for(int k = 0; k < 16; ++k) r[k / 4][k % 4] = (float)m[k].number;
+        return r;
+    }
+    const auto& q = node.getArray("rotation");
+    glm::quat rot(1.0f, 0.0f, 0.0f, 0.0f);
+    if(q.size() == 4) rot = glm::quat((float)q[3].number, (float)q[0].number, (float)q[1].number, (float)q[2].number);
+    return trsMatrix(jsonVec3(node.getArray("translation"), 0.0f), rot, jsonVec3(node.getArray("scale"), 1.0f));
+}
+
+// EXT_mesh_gpu_instancing: per-instance TRS accessors; the node's mesh is drawn once per instance.
+// Returns false when the node has no (readable) instancing data.
+static bool readInstances(const Document& doc, const JsonValue& node, std::vector<glm::mat4>& out) {
+    const JsonValue* inst = extension(node, "EXT_mesh_gpu_instancing");
+    const JsonValue* attrs = inst ? inst->get("attributes") : nullptr;
+    if(!attrs) return false;
+    std::vector<float> t, r, s;
+    size_t count = 0;
+    bool any = false;
+    auto read = [&](const char* name, int n, std::vector<float>& dst){
+        int index = (int)attrs->getInt(name, -1);
+        if(index < 0) return true;
+        AccessorView a;
+        std::string err;
+        if(!resolveAccessor(doc, index, a, err) || !readFloats(a, n, dst) || (any && a.count != count)) {
+            LOG_WARN("glTF instancing: bad " << name << " accessor " << err);
+            return false;
+        }
+        count = a.count;
+        any = true;
+        return true;
+    };
+    if(!read("TRANSLATION", 3, t) || !read("ROTATION", 4, r) || !read("SCALE", 3, s) || !any) return false;
+    out.resize(count);
+    for(size_t i = 0; i < count; ++i) {
+        glm::vec3 tr = t.empty() ? glm::vec3(0.0f) : glm::vec3(t[i * 3], t[i * 3 + 1], t[i * 3 + 2]);
+        glm::quat rot = r.empty() ? glm::quat(1.0f, 0.0f, 0.0f, 0.0f) : glm::quat(r[i * 4 + 3], r[i * 4], r[i * 4 + 1], r[i * 4 + 2]);
+        glm::vec3 sc = s.empty() ? glm::vec3(1.0f) : glm::vec3(s[i * 3], s[i * 3 + 1], s[i * 3 + 2]);
+        out[i] = trsMatrix(tr, rot, sc);
+    }
+    return true;
+}
+
+bool readNodes(const Document& doc, std::vector<ImportNode>& out) {
+    out.clear();
+    const auto& nodes = doc.json.getArray("nodes");
+    if(nodes.empty()) return false;
+    auto validNode = [&](const JsonValue& v){ return v.type == JsonValue::Number && v.number >= 0 && v.number < (double)nodes.size(); };
+
+    // roots: the default scene's nodes, or every node that is nobody's child when there are no scenes
+    std::vector<int> roots;
+    const auto& scenes = doc.json.getArray("scenes");
+    size_t sceneIndex = (size_t)std::max<int64_t>(0, doc.json.getInt("scene", 0));
+    if(sceneIndex < scenes.size()) {
+        for(const JsonValue& n : scenes[sceneIndex].getArray("nodes")) if(validNode(n)) roots.push_back((int)n.number);
+    } else {
+        std::vector<bool> isChild(nodes.size(), false);
+        for(const JsonValue& n : nodes) for(const JsonValue& c : n.getArray("children")) if(validNode(c)) isChild[(size_t)c.number] = true;
+        for(size_t i = 0; i < nodes.size(); ++i) if(!isChild[i]) roots.push_back((int)i);
+    }
+
+    // depth-first so parents come before their children; a node reached twice (invalid glTF) is imported once
+    std::vector<bool> visited(nodes.size(), false);
+    std::vector<std::pair<int, int>> stack; // glTF node, parent index in 'out'
+    for(auto it = roots.rbegin(); it != roots.rend(); ++it) stack.push_back({*it, -1});
+    std::vector<glm::mat4> instances;
+    while(!stack.empty()) {
+        auto [index, parent] = stack.back();
+        stack.pop_back();
+        if(visited[index]) continue;
+        visited[index] = true;
+        const JsonValue& n = nodes[index];
+        int self = (int)out.size();
+        ImportNode node;
+        node.parent = parent;
+        node.local = nodeMatrix(n);
+        if(const std::string* name = n.getString("name")) node.name = *name;
+        std::vector<uint32_t> prims;
+        int64_t mesh = n.getInt("mesh", -1);
+        if(mesh >= 0 && mesh + 1 < (int64_t)doc.meshFirstPrimitive.size()) {
+            for(size_t p = doc.meshFirstPrimitive[mesh]; p < doc.meshFirstPrimitive[mesh + 1]; ++p) prims.push_back((uint32_t)p);
+        }
+        if(!prims.empty() && readInstances(doc, n, instances)) {
+            out.push_back(std::move(node));
+            for(const glm::mat4& m : instances) {
+                ImportNode inst;
+                inst.parent = self;
+                inst.local = m;
+                inst.meshes = prims;
+                out.push_back(std::move(inst));
+            }
+        } else {
+            node.meshes = std::move(prims);
+            out.push_back(std::move(node));
+        }
+        const auto& children = n.getArray("children");
+        for(auto it = children.rbegin(); it != children.rend(); ++it) if(validNode(*it)) stack.push_back({(int)it->number, self});
+    }
+    return true;
+}
+
+bool readPrimitive(const Document& doc, size_t i, std::vector<float>& verts, std::vector<unsigned int>& idx) {
+    const Document::Primitive& p = doc.primitives[i];
+    // points and lines are skipped like in the Assimp path
+    if(p.position < 0 || p.mode != kModeTriangles) return false;
+    std::string err;
+    AccessorView pos;
+    if(!resolveAccessor(doc, p.position, pos, err) || !readFloats(pos, 3, verts)) {
+        LOG_WARN("glTF primitive " << i << ": bad POSITION accessor (" << err << ")");
+        return false;
+    }
+    size_t vcount = pos.count;
+    if(p.indices >= 0) {
+        AccessorView ia;
+        if(!resolveAccessor(doc, p.indices, ia, err) || !readIndices(ia, idx)) {
+            LOG_WARN("glTF primitive " << i << ": bad index accessor (" << err << ")");
+            return false;
+        }
+        unsigned int maxIndex = 0;
+        for(unsigned int v : idx) maxIndex = std::max(maxIndex, v);
+        if(!idx.empty() && maxIndex >= vcount) { LOG_WARN("glTF primitive " << i << ": index out of range"); return false; }
+    } else {
+        idx.resize(vcount);
+        for(size_t k = 0; k < vcount; ++k) idx[k] = (unsigned int)k;
+    }
+    idx.resize(idx.size() / 3 * 3);
+    return !verts.empty();
+}
+
+} // namespace GltfLoader
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "import_node.h"
+
+// glTF 2.0 reader for mesh import (.gltf, .glb, .vrm).
+// The file and any external .bin buffers are memory-mapped; accessors are decoded straight from the
+// mapped buffer views (any byteStride, any component type, normalized or not) into the import arrays,
+// so buffer data is never copied as a whole. Only base64 data: URIs and EXT_meshopt_compression views
+// (see MeshoptDecoder) are decoded into memory. KHR_mesh_quantization accessors are read like any other
+// integer accessor; the dequantization transform lives in the node hierarchy.
+namespace GltfLoader {
+    struct Document;
+
+    // Parse the JSON and map the buffers. Returns null and sets 'err' when the file is not valid
+    // glTF 2.0 or requires an extension this reader does not implement.
+    std::shared_ptr<const Document> open(const std::string& path, std::string& err);
+
+    // Mesh primitives in file order (mesh 0 primitive 0, mesh 0 primitive 1, ...)
+    size_t primitiveCount(const Document& doc);
+
+    // True when primitive i's positions are stored as integers (KHR_mesh_quantization)
+    bool primitiveQuantized(const Document& doc, size_t i);
+
+    // Positions (xyz floats) and triangle list of primitive i. Thread-safe for distinct outputs.
+    bool readPrimitive(const Document& doc, size_t i, std::vector<float>& verts, std::vector<unsigned int>& idx);
+
+    // Node hierarchy of the default scene; node meshes are primitive indices, so every node using a glTF
+    // mesh refers to the same primitives. EXT_mesh_gpu_instancing nodes get one child node per instance.
+    // Returns false when the file has no nodes.
+    bool readNodes(const Document& doc, std::vector<ImportNode>& out);
+}
@@ -0,0 +1,144 @@
+#include "headless_gl.h"
+#include "log.h"
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <cstring>
+#ifdef NOVA_HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+namespace HeadlessGL {
+
+static std::string s_api;
+
+#ifdef NOVA_HAVE_EGL
+static EGLDisplay s_display = EGL_NO_DISPLAY;
+static EGLContext s_context = EGL_NO_CONTEXT;
+static EGLSurface s_surface = EGL_NO_SURFACE;
+
+static bool hasExtension(const char* list, const char* name) {
+    if(!list) return false;
+    size_t n = strlen(name);
+    for(const char* p = strstr(list, name); p; p = strstr(p + n, name))
+        if((p == list || p[-1] == ' ') && (p[n] == ' ' || p[n] == '\0')) return true;
+    return false;
+}
+
+// A display that needs no window system: GPU device first, then Mesa surfaceless (software rendering)
+static EGLDisplay openDisplay() {
+    const char* clientExt = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if(getPlatformDisplay && hasExtension(clientExt, "EGL_EXT_platform_device")) {
+        auto queryDevices = (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+        EGLDeviceEXT devices[8];
+        EGLint count = 0;
+        if(queryDevices && queryDevices(8, devices, &count)) {
+            for(EGLint i = 0; i < count; ++i) {
+                EGLDisplay d = getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, devices[i], nullptr);
+                if(d != EGL_NO_DISPLAY && eglInitialize(d, nullptr, nullptr)) { s_api = "EGL device"; return d; }
+            }
+        }
+    }
+    if(getPlatformDisplay && hasExtension(clientExt, "EGL_MESA_platform_surfaceless")) {
+        EGLDisplay d = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if(d != EGL_NO_DISPLAY && eglInitialize(d, nullptr, nullptr)) { s_api = "EGL surfaceless"; return d; }
+    }
+    EGLDisplay d = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if(d != EGL_NO_DISPLAY && eglInitialize(d, nullptr, nullptr)) { s_api = "EGL default display"; return d; }
+    return EGL_NO_DISPLAY;
+}
+
+static bool initEGL(std::string& err) {
+    s_display = openDisplay();
+    if(s_display == EGL_NO_DISPLAY) { err = "no EGL display"; return false; }
+    if(!eglBindAPI(EGL_OPENGL_API)) { err = "EGL has no desktop OpenGL"; return false; }
+    bool surfaceless = hasExtension(eglQueryString(s_display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint count = 0;
+    if(!eglChooseConfig(s_display, configAttribs, &config, 1, &count) || count == 0) { err = "no EGL config for OpenGL"; return false; }
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    s_context = eglCreateContext(s_display, config, EGL_NO_CONTEXT, contextAttribs);
+    if(s_context == EGL_NO_CONTEXT) { err = "cannot create an OpenGL 3.3 core context"; return false; }
+    // everything renders into FBOs; a 1x1 pbuffer only stands in when surfaceless contexts are unsupported
+    if(!surfaceless) {
+        const EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        s_surface = eglCreatePbufferSurface(s_display, config, pbufferAttribs);
+        if(s_surface == EGL_NO_SURFACE) { err = "cannot create a pbuffer surface"; return false; }
+    }
+    if(!eglMakeCurrent(s_display, s_surface, s_surface, s_context)) { err = "eglMakeCurrent failed"; return false; }
+    if(!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) { err = "cannot load OpenGL functions"; return false; }
+    return true;
+}
+
+static void shutdownEGL() {
+    if(s_display == EGL_NO_DISPLAY) return;
+    eglMakeCurrent(s_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if(s_surface != EGL_NO_SURFACE) eglDestroySurface(s_display, s_surface);
+    if(s_context != EGL_NO_CONTEXT) eglDestroyContext(s_display, s_context);
+    eglTerminate(s_display);
+    s_display = EGL_NO_DISPLAY;
+    s_context = EGL_NO_CONTEXT;
+    s_surface = EGL_NO_SURFACE;
+}
+#endif
+
+static GLFWwindow* s_window = nullptr;
+
+static bool initGLFW(std::string& err) {
+    if(!glfwInit()) { err = "cannot initialize GLFW"; return false; }
+#if defined(__APPLE__)
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    s_window = glfwCreateWindow(16, 16, "NovaDCC (headless)", nullptr, nullptr);
+    if(!s_window) { err = "cannot create a hidden GLFW window"; glfwTerminate(); return false; }
+    glfwMakeContextCurrent(s_window);
+    if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) { err = "cannot load OpenGL functions"; return false; }
+    s_api = "hidden GLFW window";
+    return true;
+}
+
+bool init(std::string& err) {
+#ifdef NOVA_HAVE_EGL
+    std::string eglErr;
+    if(initEGL(eglErr)) return true;
+    shutdownEGL();
+    LOG_WARN("Headless GL: EGL unavailable (" << eglErr << "), trying a hidden window");
+#endif
+    return initGLFW(err);
+}
+
+std::string describe() {
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    const char* version = (const char*)glGetString(GL_VERSION);
+    return s_api + ", " + (renderer ? renderer : "?") + ", OpenGL " + (version ? version : "?");
+}
+
+void shutdown() {
+#ifdef NOVA_HAVE_EGL
+    shutdownEGL();
+#endif
+    if(s_window) {
+        glfwDestroyWindow(s_window);
+        s_window = nullptr;
+        glfwTerminate();
+    }
+}
+
+} // namespace HeadlessGL
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+
+// OpenGL 3.3 core context without a visible window, for batch work such as rendering thumbnails.
+// Built with EGL (NOVA_HAVE_EGL) it needs no display server: it uses a surfaceless context on the
+// first EGL device, then Mesa's surfaceless platform (llvmpipe works), then the default display.
+// Without EGL it falls back to a hidden GLFW window, which still needs a display.
+// The context is current on the calling thread and GL functions are loaded through glad.
+namespace HeadlessGL {
+    bool init(std::string& err);
+    // Short description of the context (API, renderer), for logs
+    std::string describe();
+    void shutdown();
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// One node of an imported file's hierarchy (glTF node, Assimp aiNode). Node lists are ordered so a
+// parent always comes before its children.
+struct ImportNode {
+    int parent = -1; // index of the parent node, -1 for roots
+    glm::mat4 local = glm::mat4(1.0f);
+    std::string name;
+    std::vector<uint32_t> meshes; // source meshes drawn at this node; several nodes may share one
+};
@@ -10,6 +10,7 @@
 #include <vector>
 #include <string>
 #include <cstring>
+#include <cstdlib>
 #include <cmath>
 #include <algorithm>
 #include <memory>
@@ -43,6 +44,18 @@
 #include "assets_window.h"
 #include "bottom_window.h"
 #include "animator.h"
+#include "render_target_pool.h"
+#include "gl_state.h"
+#include "asset_loader.h"
+#include "asset_database.h"
+#include "upload_queue.h"
+#include "point_cloud_streamer.h"
+#include "cluster_mesh_streamer.h"
+#include "mesh_streamer.h"
+#include "thumbnail_cache.h"
+#include "thumbnail_renderer.h"
+#include "headless_gl.h"
+#include "sequence_renderer.h"
 
 static Gizmo g_gizmo;
 
@@ -92,61 +105,105 @@ static bool g_imguizmoActive = false;
 static int g_imguizmoEntity = 0;
 static Scene::Transform g_imguizmoBefore;
 
-// Offscreen framebuffer for viewport
-static GLuint g_fbo = 0;
-static GLuint g_fboColor = 0;
-static GLuint g_fboDepth = 0;
-static int g_fbo_width = 0;
-static int g_fbo_height = 0;
-
-static void destroyFBO() {
-    if(g_fboDepth) { glDeleteRenderbuffers(1, &g_fboDepth); g_fboDepth = 0; }
-    if(g_fboColor) { glDeleteTextures(1, &g_fboColor); g_fboColor = 0; }
-    if(g_fbo) { glDeleteFramebuffers(1, &g_fbo); g_fbo = 0; }
-    g_fbo_width = g_fbo_height = 0;
-}
-
-static void createFBO(int w, int h) {
-    if(w <= 0 || h <= 0) return;
-    if(g_fbo && g_fbo_width == w && g_fbo_height == h) return;
-    destroyFBO();
-    g_fbo_width = w; g_fbo_height = h;
-    glGenFramebuffers(1, &g_fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, g_fbo);
-
-    glGenTextures(1, &g_fboColor);
-    glBindTexture(GL_TEXTURE_2D, g_fboColor);
-    // ensure correct alignment for the texture data
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, g_fboColor, 0);
-
-    glGenRenderbuffers(1, &g_fboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, g_fboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, w, h);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, g_fboDepth);
-
-    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-    if(status != GL_FRAMEBUFFER_COMPLETE) {
-        std::cerr << "Failed to create framebuffer, status: " << status << '\n';
-        destroyFBO();
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-}
-
 static void framebuffer_size_callback(GLFWwindow* /*w*/, int w, int h) {
     g_window_width = w; g_window_height = h;
-    glViewport(0,0,w,h);
+    GLState::viewport(0,0,w,h);
 }
 
+// Idle mode: block in glfwWaitEventsTimeout instead of spinning when nothing is changing
+static bool g_idleMode = true;
+static const double g_idleTimeout = 0.5; // seconds; periodic wake-up keeps console/log output flowing
+// ImGui needs a couple of frames after an input event to settle hover/active states
+static const int g_framesAfterEvent = 3;
+
 bool g_useFixedTimestep = false;
 float g_fixedTimestep = 1.0f / 60.0f;
 float g_timeAccumulator = 0.0f;
 
+// Batch mode: NovaDCC --thumbnails [--size N] [--cache DIR] [--force] <files or directories...>
+// Renders missing thumbnails without a window (EGL when available) and exits.
+static int runThumbnailBatch(int argc, char** argv) {
+    ThumbnailRenderer::Options options;
+    std::vector<std::string> paths;
+    for(int i = 0; i < argc; ++i) {
+        std::string arg = argv[i];
+        if(arg == "--size" && i + 1 < argc) options.tileSize = std::atoi(argv[++i]);
+        else if(arg == "--cache" && i + 1 < argc) ThumbnailCache::setDirectory(argv[++i]);
+        else if(arg == "--force") options.force = true;
+        else paths.push_back(arg);
+    }
+    if(paths.empty()) { std::cerr << "usage: NovaDCC --thumbnails [--size N] [--cache DIR] [--force] <files or directories...>\n"; return 2; }
+    std::string err;
+    if(!HeadlessGL::init(err)) { std::cerr << "Headless OpenGL context failed: " << err << "\n"; return 1; }
+    std::cout << "Rendering thumbnails with " << HeadlessGL::describe() << "\n";
+    Renderer::init();
+    ThumbnailRenderer::Stats stats = ThumbnailRenderer::render(paths, options);
+    Renderer::destroy();
+    HeadlessGL::shutdown();
+    std::cout << stats.rendered << " rendered, " << stats.cached << " already cached, " << stats.failed << " failed\n";
+    return stats.failed > 0 ? 1 : 0;
+}
+
+// Batch mode: NovaDCC --render-sequence [--scene FILE] [--import FILE]... [--animations FILE] [--out PATTERN]
+//   [--frames N] [--size WxH] [--fps F] [--timestep S] [--camera X Y Z] [--turntable] [--wireframe]
+// Renders an animated scene to numbered PNG/EXR files without a window and exits.
+static int runSequenceBatch(int argc, char** argv) {
+    SequenceRenderer::Settings settings;
+    std::string scenePath, animPath;
+    std::vector<std::string> imports;
+    glm::vec3 cameraPos(5.0f, 5.0f, 5.0f);
+    for(int i = 0; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool more = i + 1 < argc;
+        if(arg == "--scene" && more) scenePath = argv[++i];
+        else if(arg == "--import" && more) imports.push_back(argv[++i]);
+        else if(arg == "--animations" && more) animPath = argv[++i];
+        else if(arg == "--out" && more) settings.outputPattern = argv[++i];
+        else if(arg == "--frames" && more) settings.frameCount = std::atoi(argv[++i]);
+        else if(arg == "--size" && more) { if(sscanf(argv[++i], "%dx%d", &settings.width, &settings.height) != 2) { std::cerr << "--size expects WxH\n"; return 2; } }
+        else if(arg == "--fps" && more) settings.fps = (float)std::atof(argv[++i]);
+        else if(arg == "--timestep" && more) g_fixedTimestep = (float)std::atof(argv[++i]);
+        else if(arg == "--camera" && i + 3 < argc) { cameraPos = glm::vec3((float)std::atof(argv[i + 1]), (float)std::atof(argv[i + 2]), (float)std::atof(argv[i + 3])); i += 3; }
+        else if(arg == "--turntable") settings.turntable = true;
+        else if(arg == "--wireframe") settings.wireframe = true;
+        else { std::cerr << "unknown option for --render-sequence: " << arg << "\n"; return 2; }
+    }
+    std::string err;
+    if(!HeadlessGL::init(err)) { std::cerr << "Headless OpenGL context failed: " << err << "\n"; return 1; }
+    std::cout << "Rendering sequence with " << HeadlessGL::describe() << "\n";
+    Renderer::init();
+    int result = 0;
+    {
+        Scene scene;
+        if(!scenePath.empty() && !scene.loadFromFile(scenePath)) { std::cerr << "cannot load scene " << scenePath << "\n"; result = 1; }
+        for(const std::string& path : imports) if(!AssetLoader::loadModel(path, scene)) { std::cerr << "cannot import " << path << "\n"; result = 1; }
+        if(!animPath.empty() && !g_animator.loadFromFile(animPath)) { std::cerr << "cannot load animations " << animPath << "\n"; result = 1; }
+        // the sequence is rendered at full speed; every mesh must be on the GPU before frame 0
+        UploadQueue::flush();
+        // and every point-cloud node or cluster-mesh node a frame selects is loaded before it is drawn
+        PointCloudStreamer::setSynchronous(true);
+        ClusterMeshStreamer::setSynchronous(true);
+        if(result == 0) {
+            Camera camera;
+            camera.setPosition(cameraPos);
+            g_useFixedTimestep = true;
+            SequenceRenderer::Stats stats = SequenceRenderer::render(scene, camera, settings);
+            std::cout << stats.written << " frames written, " << stats.failed << " failed, " << stats.seconds << " s\n";
+            if(stats.failed > 0) result = 1;
+        }
+    }
+    MeshStreamer::destroy();
+    PointCloudStreamer::destroy();
+    ClusterMeshStreamer::destroy();
+    UploadQueue::destroy();
+    Renderer::destroy();
+    HeadlessGL::shutdown();
+    return result;
+}
+
 int main(int argc, char** argv) {
-    (void)argc; (void)argv;
+    if(argc > 1 && std::strcmp(argv[1], "--thumbnails") == 0) return runThumbnailBatch(argc - 2, argv + 2);
+    if(argc > 1 && std::strcmp(argv[1], "--render-sequence") == 0) return runSequenceBatch(argc - 2, argv + 2);
     if(!glfwInit()){
         std::cerr << "Failed to init GLFW\n"; return -1;
     }
@@ -208,7 +265,7 @@ int main(int argc, char** argv) {
     // Initialize renderer resources
     Renderer::init();
     g_prog = Renderer::getProgram();
-    glEnable(GL_DEPTH_TEST);
+    GLState::setDepthTest(true);
 
     // Default camera: look at origin from a 45-degree-ish direction
     g_camera.setPosition(glm::vec3(5.0f, 5.0f, 5.0f));
@@ -227,9 +284,58 @@ int main(int argc, char** argv) {
     // bool dock_initialized = false;
     // (docking removed) 
 
+    // Change tracking for idle mode
+    int framesToRender = g_framesAfterEvent;
+    unsigned int lastSceneRevision = scene.getRevision();
+    unsigned int lastCameraRevision = g_camera.getRevision();
+    bool uploadsPending = false;
+    bool assetChanges = false;
+    bool browserBusy = false;
+    bool pointCloudsLoading = false;
+    bool clusterMeshesLoading = false;
+    bool meshesPaging = false;
+
+    // Project asset database in the working directory; watches imported sources for changes
+    AssetDatabase::open("assets.db");
+
     // Main loop
     while(!glfwWindowShouldClose(window)){
-        glfwPollEvents();
+        // Something is in motion when animations run, a gizmo or the camera is being dragged,
+        // or the scene/camera changed during the previous frame (it still has to reach the viewport).
+        bool active = g_animator.hasAnimations() || g_imguizmoActive || g_gizmo.isDragging() || g_camera.isDragging();
+        if(scene.getRevision() != lastSceneRevision || g_camera.getRevision() != lastCameraRevision) active = true;
+        // keep import progress moving on screen, and redraw as streamed meshes become drawable
+        if(!AssetLoader::activeImports().empty() || uploadsPending || assetChanges || browserBusy || pointCloudsLoading || clusterMeshesLoading || meshesPaging) active = true;
+        lastSceneRevision = scene.getRevision();
+        lastCameraRevision = g_camera.getRevision();
+        if(active) framesToRender = g_framesAfterEvent;
+
+        if(g_idleMode && framesToRender <= 0) {
+            double waitStart = glfwGetTime();
+            glfwWaitEventsTimeout(g_idleTimeout);
+            // returning before the timeout means an event arrived
+            if(glfwGetTime() - waitStart < g_idleTimeout) framesToRender = g_framesAfterEvent;
+        } else {
+            glfwPollEvents();
+            --framesToRender;
+        }
+
+        // Add meshes finished by background imports (the scene revision change keeps frames coming)
+        // and stream queued GPU uploads within the frame budget
+        AssetLoader::pumpImports(scene);
+        // changed sources are reimported in the background and swapped in once uploaded
+        assetChanges = AssetDatabase::pump(scene);
+        // meshes paged in by the last view update are queued before this frame's uploads
+        meshesPaging = MeshStreamer::pump();
+        uploadsPending = UploadQueue::pump();
+        // point-cloud nodes read in the background, uploaded within a byte budget
+        pointCloudsLoading = PointCloudStreamer::pump(scene);
+        // cluster-mesh nodes likewise
+        clusterMeshesLoading = ClusterMeshStreamer::pump(scene);
+        // asset browser: thumbnails requested by last frame's grid, and whether indexing/search continue
+        // thumbnails of reimported assets are drawn into a small offscreen tile
+        bool thumbnailsRendering = ThumbnailRenderer::pump();
+        browserBusy = ThumbnailCache::pump() || AssetBrowserBusy() || thumbnailsRendering;
 
         // ImGui frame
         ImGui_ImplOpenGL3_NewFrame();
@@ -264,6 +370,8 @@ int main(int argc, char** argv) {
                 ImGui::MenuItem("Wireframe", NULL, &g_showWireframe);
                 ImGui::MenuItem("Use ImGuizmo", NULL, &g_useImGuizmo);
                 ImGui::MenuItem("Show numeric fields", NULL, &g_showNumericWidgets);
+                ImGui::Separator();
+                ImGui::MenuItem("Idle when inactive", NULL, &g_idleMode);
                 ImGui::EndMenu();
             }
             ImGui::EndMainMenuBar();
@@ -283,7 +391,7 @@ int main(int argc, char** argv) {
 
         // Bottom panel (tabs)
         if(g_showBottomWindow) {
-            DrawBottomWindow(g_showBottomWindow, g_pinBottom);
+            DrawBottomWindow(scene, g_showBottomWindow, g_pinBottom);
         }
 
         // Viewport window (central) - extracted
@@ -323,6 +431,8 @@ int main(int argc, char** argv) {
 
         // Update animator: either use fixed timestep accumulator or ImGui::GetIO().DeltaTime
         float dt = ImGui::GetIO().DeltaTime;
+        // time spent waiting while idle must not be replayed as animation steps
+        if(!g_animator.hasAnimations()) g_timeAccumulator = 0.0f;
         if(g_useFixedTimestep) {
             g_timeAccumulator += dt;
             while(g_timeAccumulator >= g_fixedTimestep) {
@@ -334,41 +444,43 @@ int main(int argc, char** argv) {
         }
 
         // Prepare full-window GL state for ImGui rendering
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glDisable(GL_SCISSOR_TEST);
-        glViewport(0, 0, g_window_width, g_window_height);
+        GLState::bindFramebuffer(0);
+        GLState::setScissorTest(false);
+        GLState::viewport(0, 0, g_window_width, g_window_height);
 
         // Clear both color and depth to remove previous UI/scene pixels before ImGui draw
         glClearColor(0.09f, 0.09f, 0.11f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
-        // Ensure blending is enabled with the standard alpha blend for ImGui
-        GLboolean blendEnabled = glIsEnabled(GL_BLEND);
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-        // Disable depth test for UI rendering and remember previous state
-        GLboolean depthEnabled = glIsEnabled(GL_DEPTH_TEST);
-        if(depthEnabled) glDisable(GL_DEPTH_TEST);
+        // Standard alpha blend and no depth test for the UI; the scene passes set their own state
+        GLState::setBlend(true);
+        GLState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        GLState::setDepthTest(false);
 
-        // ImGui render
+        // ImGui render (the backend restores every state it changes, so the cache stays valid)
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
-        // Restore depth test state for correctness next frame
-        if(depthEnabled) glEnable(GL_DEPTH_TEST);
-        if(!blendEnabled) glDisable(GL_BLEND);
-
+        RenderTargetPool::endFrame();
+        GLState::endFrame();
         glfwSwapBuffers(window);
     }
 
-    // Cleanup
+    // Cleanup (GL resources first, while the context is still current)
+    AssetDatabase::close();
+    AssetLoader::shutdown();
+    MeshStreamer::destroy();
+    PointCloudStreamer::destroy();
+    ClusterMeshStreamer::destroy();
+    UploadQueue::destroy();
+    ThumbnailRenderer::destroy();
+    ThumbnailCache::destroy();
+    Renderer::destroy();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
     glfwDestroyWindow(window);
     glfwTerminate();
-    Renderer::destroy();
     return 0;
 }
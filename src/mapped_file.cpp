@@ -0,0 +1,77 @@
+#include "mapped_file.h"
+#include "log.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path) {
+    close();
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size) || size.QuadPart == 0) { CloseHandle(file); return false; }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(!mapping) { CloseHandle(file); return false; }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if(!view) {
+        LOG_WARN("Could not map " << path);
+        CloseHandle(mapping); CloseHandle(file);
+        return false;
+    }
+    m_file = file;
+    m_mapping = mapping;
+    m_data = (const uint8_t*)view;
+    m_size = (size_t)size.QuadPart;
+    m_path = path;
+    return true;
+}
+
+void MappedFile::close() {
+    if(m_data) UnmapViewOfFile(m_data);
+    if(m_mapping) CloseHandle((HANDLE)m_mapping);
+    if(m_file) CloseHandle((HANDLE)m_file);
+    m_data = nullptr; m_mapping = nullptr; m_file = nullptr;
+    m_size = 0;
+    m_path.clear();
+}
+
+#else
+
+bool MappedFile::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) return false;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0) { ::close(fd); return false; }
+    void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+    if(p == MAP_FAILED) { LOG_WARN("Could not map " << path); return false; }
+    m_data = (const uint8_t*)p;
+    m_size = (size_t)st.st_size;
+    m_path = path;
+    return true;
+}
+
+void MappedFile::close() {
+    if(m_data) munmap((void*)m_data, m_size);
+    m_data = nullptr;
+    m_size = 0;
+    m_path.clear();
+}
+
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Read-only memory mapping of a whole file (mmap / MapViewOfFile).
+// Pages are loaded on first access, so opening a large file is cheap and unused parts are never read.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return m_data != nullptr; }
+    const uint8_t* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    const std::string& path() const { return m_path; }
+
+private:
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    std::string m_path;
+#ifdef _WIN32
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#endif
+};
@@ -0,0 +1,452 @@
+#include "mesh_cache.h"
+#include "mapped_file.h"
+#include "primitive_factory.h"
+#include "thread_pool.h"
+#include "log.h"
+#include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
+#include <cstring>
+#include <cstddef>
+#include <string>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+static const uint32_t kMagic = 0x434D564E; // "NVMC"
+static const uint32_t kVersion = 3;
+static const uint64_t kAlign = 64;
+
+enum SectionId { Positions, GpuVertices, BvhIndices, Bvh, DrawIndices, CoarsePositions, CoarseIndices, SectionCount };
+
+enum MeshFlags : uint32_t {
+    Quantized = 1u << 0,  // GPU vertices are 16-bit unorm
+    Index16   = 1u << 1,  // draw indices are uint16
+    Optimized = 1u << 2,  // draw indices are in mesh optimizer order
+};
+
+struct Section {
+    uint64_t offset;
+    uint64_t size;
+    uint64_t checksum;
+};
+
+struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t meshCount;
+    uint32_t headerBytes;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t settingsKey;
+    uint64_t tableOffset;
+    uint64_t tableChecksum;
+    uint32_t nodeCount;
+    uint32_t nodeMeshRefs;
+    Section nodes; // NodeRecord[nodeCount], uint32 mesh refs[nodeMeshRefs], name bytes
+    uint64_t reserved[4];
+    uint64_t headerChecksum; // of all fields above
+};
+static_assert(sizeof(FileHeader) == 128, "header must stay 128 bytes");
+
+struct NodeRecord {
+    int32_t parent;
+    uint32_t meshFirst;
+    uint32_t meshCount;
+    uint32_t nameFirst;
+    uint32_t nameLength;
+    float local[16];
+};
+
+// mesh records carry the source index; anything beyond this is a corrupt table
+static const uint32_t kMaxSourceIndex = 1u << 24;
+
+struct MeshRecord {
+    uint32_t sourceIndex;
+    uint32_t flags;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t coarseVertexCount; // zero when the mesh has no coarse level
+    uint32_t coarseIndexCount;
+    float aabbMin[3];
+    float aabbMax[3];
+    Section sections[SectionCount];
+};
+
+static_assert(std::is_trivially_copyable<primitives::MeshGL::BVHNode>::value && sizeof(primitives::MeshGL::BVHNode) == 40,
+              "BVH nodes are stored verbatim");
+static_assert(sizeof(glm::vec3) == 12, "positions are stored as packed float xyz");
+
+// FNV-1a over 64-bit words (bytewise for the tail)
+static uint64_t checksum(const uint8_t* p, size_t n) {
+    uint64_t h = 14695981039346656037ull;
+    size_t words = n / 8;
+    for(size_t i = 0; i < words; ++i) {
+        uint64_t w; memcpy(&w, p + i * 8, 8);
+        h = (h ^ w) * 1099511628211ull;
+    }
+    for(size_t i = words * 8; i < n; ++i) h = (h ^ p[i]) * 1099511628211ull;
+    return h;
+}
+
+static uint64_t headerChecksum(const FileHeader& h) {
+    return checksum((const uint8_t*)&h, offsetof(FileHeader, headerChecksum));
+}
+
+static bool sectionValid(const Section& s, const MappedFile& file, uint64_t expectedSize) {
+    if(s.size != expectedSize) return false;
+    if(s.size == 0) return true;
+    if(s.offset % kAlign != 0 || s.offset > file.size() || s.size > file.size() - s.offset) return false;
+    return checksum(file.data() + s.offset, s.size) == s.checksum;
+}
+
+// Node table of a validated nodes section; false when an index or name range is out of bounds
+static bool readNodeTable(const FileHeader& h, const uint8_t* data, std::vector<ImportNode>& out) {
+    uint64_t recordBytes = (uint64_t)h.nodeCount * sizeof(NodeRecord);
+    uint64_t refBytes = (uint64_t)h.nodeMeshRefs * 4;
+    if(recordBytes + refBytes > h.nodes.size) return false;
+    const uint8_t* refs = data + recordBytes;
+    const char* names = (const char*)refs + refBytes;
+    uint64_t nameBytes = h.nodes.size - recordBytes - refBytes;
+    out.resize(h.nodeCount);
+    for(uint32_t i = 0; i < h.nodeCount; ++i) {
+        NodeRecord r;
+        memcpy(&r, data + (uint64_t)i * sizeof(r), sizeof(r));
+        if(r.parent >= (int32_t)i || r.parent < -1) return false;
+        if((uint64_t)r.meshFirst + r.meshCount > h.nodeMeshRefs || (uint64_t)r.nameFirst + r.nameLength > nameBytes) return false;
+        ImportNode& n = out[i];
+        n.parent = r.parent;
+        memcpy(&n.local[0][0], r.local, sizeof(r.local));
+        n.name.assign(names + r.nameFirst, r.nameLength);
+        n.meshes.resize(r.meshCount);
+        if(r.meshCount) memcpy(n.meshes.data(), refs + (uint64_t)r.meshFirst * 4, (size_t)r.meshCount * 4);
+    }
+    return true;
+}
+
+static bool recordValid(const MeshRecord& r, const MappedFile& file) {
+    uint64_t vc = r.vertexCount, ic = r.indexCount;
+    bool quantized = (r.flags & Quantized) != 0;
+    const Section& bvh = r.sections[Bvh];
+    return sectionValid(r.sections[Positions], file, vc * 12)
+        && sectionValid(r.sections[GpuVertices], file, quantized ? vc * 8 : 0)
+        && sectionValid(r.sections[BvhIndices], file, ic * 4)
+        && bvh.size % sizeof(primitives::MeshGL::BVHNode) == 0 && sectionValid(bvh, file, bvh.size)
+        && sectionValid(r.sections[DrawIndices], file, ic * ((r.flags & Index16) ? 2 : 4));
+}
+
+// The coarse level is read for shells too, so it is checked on its own
+static bool coarseValid(const MeshRecord& r, const MappedFile& file) {
+    return sectionValid(r.sections[CoarsePositions], file, (uint64_t)r.coarseVertexCount * 12)
+        && sectionValid(r.sections[CoarseIndices], file, (uint64_t)r.coarseIndexCount * 4);
+}
+
+// Map a container and check its header and mesh table against the source key
+static bool openContainer(const std::string& assetPath, const MeshCache::SourceKey& key, std::shared_ptr<MappedFile>& file,
+                          FileHeader& h, const MeshRecord*& records) {
+    file = std::make_shared<MappedFile>();
+    if(!file->open(MeshCache::cachePath(assetPath))) return false;
+    if(file->size() < sizeof(h)) return false;
+    memcpy(&h, file->data(), sizeof(h));
+    if(h.magic != kMagic || h.version != kVersion || h.headerBytes != sizeof(h) || h.headerChecksum != headerChecksum(h)) {
+        LOG_WARN("Ignoring mesh cache " << file->path() << " (unknown version or corrupt header)");
+        return false;
+    }
+    if(h.sourceSize != key.size || h.sourceTime != key.time || h.settingsKey != key.settings) {
+        LOG_INFO("Mesh cache " << file->path() << " is out of date");
+        return false;
+    }
+    uint64_t tableBytes = (uint64_t)h.meshCount * sizeof(MeshRecord);
+    if(h.tableOffset % kAlign != 0 || h.tableOffset > file->size() || tableBytes > file->size() - h.tableOffset
+       || checksum(file->data() + h.tableOffset, tableBytes) != h.tableChecksum) {
+        LOG_WARN("Ignoring mesh cache " << file->path() << " (corrupt mesh table)");
+        return false;
+    }
+    records = (const MeshRecord*)(file->data() + h.tableOffset);
+    return true;
+}
+
+// Coarse level of a validated record; it is small, so it is packed again rather than stored twice
+static void attachCoarse(primitives::MeshGL& m, const MeshRecord& r, const uint8_t* base) {
+    if(r.coarseIndexCount == 0) return;
+    std::vector<float> verts((size_t)r.coarseVertexCount * 3);
+    if(!verts.empty()) memcpy(verts.data(), base + r.sections[CoarsePositions].offset, r.sections[CoarsePositions].size);
+    std::vector<unsigned int> idx(r.coarseIndexCount);
+    memcpy(idx.data(), base + r.sections[CoarseIndices].offset, r.sections[CoarseIndices].size);
+    m.buildCoarse(verts, idx);
+}
+
+// Mesh of a record. A full mesh copies the picking data and BVH out and points its pending GPU data
+// into the mapping; a shell only gets the bounds, draw parameters and payload sizes (paged out).
+// Both get the coarse level when 'coarse' is set.
+static std::unique_ptr<primitives::MeshGL> makeMesh(const MeshRecord& r, const std::shared_ptr<MappedFile>& file, bool boundsOnly, bool coarse) {
+    auto m = std::make_unique<primitives::MeshGL>();
+    m->aabbMin = glm::vec3(r.aabbMin[0], r.aabbMin[1], r.aabbMin[2]);
+    m->aabbMax = glm::vec3(r.aabbMax[0], r.aabbMax[1], r.aabbMax[2]);
+    m->quantizedPositions = (r.flags & Quantized) != 0;
+    m->indexType = (r.flags & Index16) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    m->indexCount = (int)r.indexCount;
+    const Section& vs = r.sections[m->quantizedPositions ? GpuVertices : Positions];
+    const uint8_t* base = file->data();
+    if(coarse) attachCoarse(*m, r, base);
+    if(boundsOnly) {
+        m->pagedOut = true;
+        m->pagedGpuBytes = vs.size + r.sections[DrawIndices].size;
+        m->pagedCpuBytes = r.sections[Positions].size + r.sections[BvhIndices].size + r.sections[Bvh].size;
+        return m;
+    }
+    m->cpuPositions.resize(r.vertexCount);
+    if(r.vertexCount) memcpy(m->cpuPositions.data(), base + r.sections[Positions].offset, r.sections[Positions].size);
+    m->cpuIndices.resize(r.indexCount);
+    if(r.indexCount) memcpy(m->cpuIndices.data(), base + r.sections[BvhIndices].offset, r.sections[BvhIndices].size);
+    m->bvhNodes.resize(r.sections[Bvh].size / sizeof(primitives::MeshGL::BVHNode));
+    if(!m->bvhNodes.empty()) memcpy(m->bvhNodes.data(), base + r.sections[Bvh].offset, r.sections[Bvh].size);
+    // GPU data is uploaded straight from the mapped pages
+    m->pending.vertices = base + vs.offset;
+    m->pending.vertexBytes = vs.size;
+    m->pending.indices = base + r.sections[DrawIndices].offset;
+    m->pending.indexBytes = r.sections[DrawIndices].size;
+    m->pending.owner = file;
+    return m;
+}
+
+} // anonymous
+
+namespace MeshCache {
+
+std::string cachePath(const std::string& assetPath) { return assetPath + ".nvmesh"; }
+
+bool sourceKey(const std::string& assetPath, uint64_t settingsKey, SourceKey& out) {
+    std::error_code ec;
+    uintmax_t size = std::filesystem::file_size(assetPath, ec);
+    if(ec) return false;
+    auto time = std::filesystem::last_write_time(assetPath, ec);
+    if(ec) return false;
+    out.size = (uint64_t)size;
+    out.time = (int64_t)time.time_since_epoch().count();
+    out.settings = settingsKey;
+    return true;
+}
+
+bool load(const std::string& assetPath, const SourceKey& key, std::vector<std::unique_ptr<primitives::MeshGL>>& out, std::vector<ImportNode>& nodes,
+          bool boundsOnly) {
+    out.clear();
+    nodes.clear();
+    std::shared_ptr<MappedFile> file;
+    FileHeader h;
+    const MeshRecord* records = nullptr;
+    if(!openContainer(assetPath, key, file, h, records)) return false;
+    uint64_t sourceCount = 0;
+    for(uint32_t i = 0; i < h.meshCount; ++i) sourceCount = std::max<uint64_t>(sourceCount, (uint64_t)records[i].sourceIndex + 1);
+    if(sourceCount > kMaxSourceIndex
+       || !sectionValid(h.nodes, *file, h.nodes.size) || !readNodeTable(h, file->data() + h.nodes.offset, nodes)) {
+        LOG_WARN("Ignoring mesh cache " << file->path() << " (corrupt mesh or node table)");
+        nodes.clear();
+        return false;
+    }
+
+    // Checksums and picking copies touch every page, so spread the meshes over the pool
+    out.resize(h.meshCount);
+    std::atomic<bool> corrupt{false};
+    ThreadPool::instance().parallelFor(h.meshCount, boundsOnly ? 1024 : 1, [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end && !corrupt; ++i) {
+            const MeshRecord& r = records[i];
+            // shells are validated when they are paged in, apart from the coarse level they show until then
+            if(!coarseValid(r, *file) || (!boundsOnly && !recordValid(r, *file))) { corrupt = true; return; }
+            out[i] = makeMesh(r, file, boundsOnly, true);
+        }
+    });
+    if(corrupt) {
+        LOG_WARN("Ignoring mesh cache " << file->path() << " (section checksum mismatch)");
+        out.clear();
+        nodes.clear();
+        return false;
+    }
+    // records are written in completion order; index by source mesh (skipped meshes stay null)
+    std::vector<std::unique_ptr<primitives::MeshGL>> bySource(sourceCount);
+    for(size_t i = 0; i < out.size(); ++i) bySource[records[i].sourceIndex] = std::move(out[i]);
+    out.swap(bySource);
+    return true;
+}
+
+bool loadMesh(const std::string& assetPath, const SourceKey& key, uint32_t sourceIndex, std::unique_ptr<primitives::MeshGL>& out) {
+    out.reset();
+    std::shared_ptr<MappedFile> file;
+    FileHeader h;
+    const MeshRecord* records = nullptr;
+    if(!openContainer(assetPath, key, file, h, records)) return false;
+    for(uint32_t i = 0; i < h.meshCount; ++i) {
+        if(records[i].sourceIndex != sourceIndex) continue;
+        if(!recordValid(records[i], *file)) {
+            LOG_WARN("Mesh " << sourceIndex << " of " << file->path() << " is corrupt (section checksum mismatch)");
+            return false;
+        }
+        // the resident shell already has its coarse level
+        out = makeMesh(records[i], file, false, false);
+        return true;
+    }
+    return false;
+}
+
+// ---- Writer ----
+
+// Temporary file next to the cache. Unique per process and writer: two imports of the same asset (or
+// the editor and a batch run) may write its cache at once, and the last rename wins whole.
+static std::string tempPath(const std::string& path) {
+    static std::atomic<uint64_t> s_next{0};
+#ifdef _WIN32
+    long long pid = _getpid();
+#else
+    long long pid = getpid();
+#endif
+    return path + "." + std::to_string(pid) + "-" + std::to_string(s_next.fetch_add(1)) + ".tmp";
+}
+
+Writer::~Writer() {
+    abort();
+}
+
+bool Writer::begin(const std::string& assetPath, const SourceKey& key) {
+    abort();
+    m_path = cachePath(assetPath);
+    m_key = key;
+    m_tmpPath = tempPath(m_path);
+    m_file.open(m_tmpPath, std::ios::binary | std::ios::trunc);
+    if(!m_file) { LOG_WARN("Could not write mesh cache " << m_path); return false; }
+    // header is written last; reserve its space
+    FileHeader h = {};
+    m_file.write((const char*)&h, sizeof(h));
+    m_offset = sizeof(h);
+    m_ok = (bool)m_file;
+    return m_ok;
+}
+
+bool Writer::writeSection(const void* data, uint64_t size, uint64_t* outOffset, uint64_t* outChecksum) {
+    static const char zeros[kAlign] = {};
+    uint64_t pad = (kAlign - m_offset % kAlign) % kAlign;
+    m_file.write(zeros, (std::streamsize)pad);
+    *outOffset = m_offset + pad;
+    *outChecksum = checksum((const uint8_t*)data, size);
+    if(size) m_file.write((const char*)data, (std::streamsize)size);
+    m_offset += pad + size;
+    return (bool)m_file;
+}
+
+void Writer::add(uint32_t sourceIndex, const primitives::MeshGL& mesh, bool optimized) {
+    MeshRecord r = {};
+    r.sourceIndex = sourceIndex;
+    r.vertexCount = (uint32_t)mesh.cpuPositions.size();
+    r.indexCount = (uint32_t)mesh.cpuIndices.size();
+    const primitives::MeshGL* coarse = mesh.coarse.get();
+    if(coarse) {
+        r.coarseVertexCount = (uint32_t)coarse->cpuPositions.size();
+        r.coarseIndexCount = (uint32_t)coarse->cpuIndices.size();
+    }
+    if(mesh.quantizedPositions) r.flags |= Quantized;
+    if(mesh.indexType == GL_UNSIGNED_SHORT) r.flags |= Index16;
+    if(optimized) r.flags |= Optimized;
+    for(int k = 0; k < 3; ++k) { r.aabbMin[k] = mesh.aabbMin[k]; r.aabbMax[k] = mesh.aabbMax[k]; }
+
+    struct Data { const void* ptr; uint64_t size; } data[SectionCount] = {
+        { mesh.cpuPositions.data(), (uint64_t)mesh.cpuPositions.size() * 12 },
+        { mesh.quantizedPositions ? mesh.pending.vertices : nullptr, mesh.quantizedPositions ? (uint64_t)mesh.pending.vertexBytes : 0 },
+        { mesh.cpuIndices.data(), (uint64_t)mesh.cpuIndices.size() * 4 },
+        { mesh.bvhNodes.data(), (uint64_t)mesh.bvhNodes.size() * sizeof(primitives::MeshGL::BVHNode) },
+        { mesh.pending.indices, (uint64_t)mesh.pending.indexBytes },
+        { coarse ? (const void*)coarse->cpuPositions.data() : nullptr, (uint64_t)r.coarseVertexCount * 12 },
+        { coarse ? (const void*)coarse->cpuIndices.data() : nullptr, (uint64_t)r.coarseIndexCount * 4 },
+    };
+
+    std::lock_guard<std::mutex> lk(m_mtx);
+    if(!m_ok) return;
+    for(int s = 0; s < SectionCount && m_ok; ++s) {
+        r.sections[s].size = data[s].size;
+        m_ok = writeSection(data[s].ptr, data[s].size, &r.sections[s].offset, &r.sections[s].checksum);
+    }
+    const uint8_t* rb = (const uint8_t*)&r;
+    m_table.insert(m_table.end(), rb, rb + sizeof(r));
+    m_meshCount++;
+}
+
+void Writer::setNodes(const std::vector<ImportNode>& nodes) {
+    std::vector<uint8_t> records, refs;
+    std::string names;
+    for(const ImportNode& n : nodes) {
+        NodeRecord r = {};
+        r.parent = n.parent;
+        r.meshFirst = (uint32_t)(refs.size() / 4);
+        r.meshCount = (uint32_t)n.meshes.size();
+        r.nameFirst = (uint32_t)names.size();
+        r.nameLength = (uint32_t)n.name.size();
+        memcpy(r.local, &n.local[0][0], sizeof(r.local));
+        const uint8_t* rb = (const uint8_t*)&r;
+        records.insert(records.end(), rb, rb + sizeof(r));
+        const uint8_t* mb = (const uint8_t*)n.meshes.data();
+        refs.insert(refs.end(), mb, mb + n.meshes.size() * 4);
+        names += n.name;
+    }
+    std::lock_guard<std::mutex> lk(m_mtx);
+    m_nodeCount = (uint32_t)nodes.size();
+    m_nodeMeshRefs = (uint32_t)(refs.size() / 4);
+    m_nodes = std::move(records);
+    m_nodes.insert(m_nodes.end(), refs.begin(), refs.end());
+    m_nodes.insert(m_nodes.end(), names.begin(), names.end());
+}
+
+bool Writer::finish() {
+    std::lock_guard<std::mutex> lk(m_mtx);
+    if(!m_file.is_open()) return false;
+    FileHeader h = {};
+    h.magic = kMagic;
+    h.version = kVersion;
+    h.meshCount = m_meshCount;
+    h.headerBytes = sizeof(h);
+    h.sourceSize = m_key.size;
+    h.sourceTime = m_key.time;
+    h.settingsKey = m_key.settings;
+    h.nodeCount = m_nodeCount;
+    h.nodeMeshRefs = m_nodeMeshRefs;
+    h.nodes.size = m_nodes.size();
+    if(m_ok) m_ok = writeSection(m_nodes.data(), m_nodes.size(), &h.nodes.offset, &h.nodes.checksum);
+    if(m_ok) m_ok = writeSection(m_table.data(), m_table.size(), &h.tableOffset, &h.tableChecksum);
+    h.headerChecksum = headerChecksum(h);
+    if(m_ok) {
+        m_file.seekp(0);
+        m_file.write((const char*)&h, sizeof(h));
+        m_ok = (bool)m_file;
+    }
+    m_file.close();
+    std::error_code ec;
+    if(m_ok) std::filesystem::rename(m_tmpPath, m_path, ec);
+    if(!m_ok || ec) {
+        LOG_WARN("Could not write mesh cache " << m_path);
+        std::filesystem::remove(m_tmpPath, ec);
+        return false;
+    }
+    LOG_INFO("Wrote mesh cache " << m_path << " (" << m_meshCount << " meshes, " << m_nodeCount << " nodes, " << m_offset / 1024 << " KB)");
+    m_table.clear();
+    m_meshCount = 0;
+    m_nodes.clear();
+    m_nodeCount = m_nodeMeshRefs = 0;
+    return true;
+}
+
+void Writer::abort() {
+    std::lock_guard<std::mutex> lk(m_mtx);
+    if(!m_file.is_open()) return;
+    m_file.close();
+    std::error_code ec;
+    std::filesystem::remove(m_tmpPath, ec);
+    m_table.clear();
+    m_meshCount = 0;
+    m_nodes.clear();
+    m_nodeCount = m_nodeMeshRefs = 0;
+    m_ok = false;
+}
+
+} // namespace MeshCache
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <cstdint>
+#include "import_node.h"
+
+namespace primitives { struct MeshGL; }
+
+// Native binary container for imported meshes ("<asset>.nvmesh"), written on the first import of an
+// asset and memory-mapped on later ones so the source file never has to be parsed again.
+//
+// Layout (version 3): a 128-byte header, the mesh sections, the node hierarchy, then a table with one
+// record per mesh.
+// Every section starts on a 64-byte boundary and carries its own checksum:
+//   positions       float xyz, source vertex order (picking, and the GPU vertex buffer when not quantized)
+//   gpuVertices     16-bit unorm xyz + pad, only for quantized meshes
+//   bvhIndices      uint32 triangle list in BVH leaf order (picking)
+//   bvh             MeshGL::BVHNode array
+//   drawIndices     GPU index buffer (uint16 or uint32), in the mesh optimizer's order when it ran
+//   coarsePositions float xyz of the coarse level (MeshGL::coarse), empty for small meshes
+//   coarseIndices   uint32 triangle list of the coarse level
+// The header records the source file's size and modification time and a key of the import settings;
+// a container that does not match all three is ignored and rewritten by the next import.
+namespace MeshCache {
+    struct SourceKey {
+        uint64_t size = 0;
+        int64_t time = 0;
+        uint64_t settings = 0;
+    };
+    // Identify the current state of the source file; false when it cannot be read
+    bool sourceKey(const std::string& assetPath, uint64_t settingsKey, SourceKey& out);
+
+    std::string cachePath(const std::string& assetPath);
+
+    // Map the container of the asset and create its meshes. The meshes' pending GPU data points into
+    // the mapping (kept alive until their upload is done); picking data and the BVH are copied out.
+    // 'out' is indexed by source mesh (null for meshes the import skipped); 'nodes' is the stored
+    // hierarchy, empty when the import had none.
+    // Returns false, leaving both empty, when there is no valid container for this key.
+    // With 'boundsOnly' the meshes are paged-out shells (MeshGL::pagedOut) holding only their bounds,
+    // draw parameters and coarse level; MeshStreamer reads the rest with loadMesh() when they come into view.
+    bool load(const std::string& assetPath, const SourceKey& key, std::vector<std::unique_ptr<primitives::MeshGL>>& out,
+              std::vector<ImportNode>& nodes, bool boundsOnly = false);
+
+    // One mesh of the container, as load() creates it but without the coarse level. False when the container no longer matches the
+    // key or has no valid record for the source mesh. Thread-safe.
+    bool loadMesh(const std::string& assetPath, const SourceKey& key, uint32_t sourceIndex, std::unique_ptr<primitives::MeshGL>& out);
+
+    // Streams meshes into a new container as an import builds them. Data goes to a temporary file that
+    // replaces the old container in finish(); a writer destroyed before finish() leaves nothing behind.
+    class Writer {
+    public:
+        ~Writer();
+        bool begin(const std::string& assetPath, const SourceKey& key);
+        // Append one built mesh (its pending GPU data must still be present). Thread-safe.
+        void add(uint32_t sourceIndex, const primitives::MeshGL& mesh, bool optimized);
+        // Node hierarchy referring to the source mesh indices passed to add()
+        void setNodes(const std::vector<ImportNode>& nodes);
+        bool finish();
+        void abort();
+
+    private:
+        bool writeSection(const void* data, uint64_t size, uint64_t* outOffset, uint64_t* outChecksum);
+
+        std::mutex m_mtx;
+        std::ofstream m_file;
+        std::string m_path;
+        std::string m_tmpPath;
+        SourceKey m_key;
+        std::vector<uint8_t> m_table;
+        uint32_t m_meshCount = 0;
+        std::vector<uint8_t> m_nodes;
+        uint32_t m_nodeCount = 0;
+        uint32_t m_nodeMeshRefs = 0;
+        uint64_t m_offset = 0;
+        bool m_ok = false;
+    };
+}
@@ -0,0 +1,588 @@
+#include "mesh_optimizer.h"
+#include "log.h"
+#include "thread_pool.h"
+#include "xxhash.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <fstream>
+#include <filesystem>
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+#include <unordered_set>
+
+namespace {
+
+// Forsyth scoring parameters (values from the original paper)
+static const int kCacheSize = 32;
+static const float kCacheDecayPower = 1.5f;
+static const float kLastTriScore = 0.75f;
+static const float kValenceBoostScale = 2.0f;
+static const float kValenceBoostPower = 0.5f;
+
+static float vertexScore(int cachePos, int activeTris) {
+    if(activeTris == 0) return -1.0f;
+    float score = 0.0f;
+    if(cachePos >= 0) {
+        if(cachePos < 3) score = kLastTriScore;
+        else score = powf(1.0f - (float)(cachePos - 3) / (float)(kCacheSize - 3), kCacheDecayPower);
+    }
+    return score + kValenceBoostScale * powf((float)activeTris, -kValenceBoostPower);
+}
+
+// Vertices per parallel chunk when welding
+static const size_t kWeldGrain = 1 << 16;
+// Number of hash partitions deduplicated independently (power of two)
+static const size_t kWeldBuckets = 64;
+
+struct PosKey {
+    uint32_t x, y, z;
+    bool operator==(const PosKey& o) const { return x == o.x && y == o.y && z == o.z; }
+};
+
+static uint64_t mix64(uint64_t h) {
+    h ^= h >> 33; h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+static PosKey posKey(const float* p) {
+    PosKey k;
+    // +0.0f folds -0.0f into 0.0f so both hash the same
+    float x = p[0] + 0.0f, y = p[1] + 0.0f, z = p[2] + 0.0f;
+    memcpy(&k.x, &x, 4); memcpy(&k.y, &y, 4); memcpy(&k.z, &z, 4);
+    return k;
+}
+
+static uint64_t hashKey(const PosKey& k) {
+    return mix64(((uint64_t)k.x << 32 | k.y) ^ mix64(k.z));
+}
+
+struct PosKeyHash { size_t operator()(const PosKey& k) const { return (size_t)hashKey(k); } };
+
+static uint64_t hashCell(int64_t x, int64_t y, int64_t z) {
+    return mix64((uint64_t)x * 0x9E3779B97F4A7C15ull ^ mix64((uint64_t)y) ^ mix64((uint64_t)z * 0xC2B2AE3D27D4EB4Full));
+}
+
+// Largest cluster grid per axis; three cell coordinates pack into 21 bits each
+static const int kClusterGridMax = 127;
+static const int kClusterAttempts = 4;
+
+static const uint32_t kCacheMagic = 0x504F564E; // "NVOP"
+static const uint32_t kCacheVersion = 3; // 3: keys hashed with XXH64
+
+} // anonymous
+
+namespace MeshOptimizer {
+
+WeldResult weldVertices(std::vector<float>& verts, std::vector<unsigned int>& idx, float epsilon) {
+    WeldResult r;
+    size_t n = verts.size() / 3;
+    r.verticesBefore = r.verticesAfter = n;
+    if(n == 0) return r;
+    for(unsigned int v : idx) if(v >= n) { LOG_WARN("MeshOptimizer: index out of range, mesh not welded"); return r; }
+    ThreadPool& pool = ThreadPool::instance();
+
+    // 1) exact matches: partition vertices by hash, dedup each partition independently
+    std::vector<uint64_t> hashes(n);
+    pool.parallelFor(n, kWeldGrain, [&](size_t b, size_t e){
+        for(size_t i = b; i < e; ++i) hashes[i] = hashKey(posKey(&verts[i * 3]));
+    });
+    std::vector<size_t> bucketStart(kWeldBuckets + 1, 0);
+    for(size_t i = 0; i < n; ++i) bucketStart[(hashes[i] >> 58) + 1]++;
+    for(size_t b = 0; b < kWeldBuckets; ++b) bucketStart[b + 1] += bucketStart[b];
+    std::vector<unsigned int> byBucket(n);
+    {
+        std::vector<size_t> fill(bucketStart.begin(), bucketStart.end() - 1);
+        for(size_t i = 0; i < n; ++i) byBucket[fill[hashes[i] >> 58]++] = (unsigned int)i;
+    }
+    std::vector<unsigned int> remap(n);
+    pool.parallelFor(kWeldBuckets, 1, [&](size_t b, size_t e){
+        for(size_t bucket = b; bucket < e; ++bucket) {
+            std::unordered_map<PosKey, unsigned int, PosKeyHash> first;
+            first.reserve(bucketStart[bucket + 1] - bucketStart[bucket]);
+            // ids are ascending within a bucket, so the first occurrence becomes canonical
+            for(size_t i = bucketStart[bucket]; i < bucketStart[bucket + 1]; ++i) {
+                unsigned int v = byBucket[i];
+                auto it = first.emplace(posKey(&verts[v * 3]), v).first;
+                remap[v] = it->second;
+            }
+        }
+    });
+
+    // 2) near matches: canonical vertices are bucketed in a grid of 2*epsilon cells, so every
+    //    neighbour within epsilon lies in one of the 2x2x2 cells around the vertex; each vertex
+    //    picks the lowest id within epsilon there
+    if(epsilon > 0.0f) {
+        struct CellEntry { uint64_t hash; unsigned int v; };
+        std::vector<CellEntry> cells;
+        cells.reserve(n);
+        float inv = 0.5f / epsilon;
+        auto cellCoord = [inv](float x) { return (int64_t)floorf(x * inv); };
+        for(size_t i = 0; i < n; ++i) {
+            if(remap[i] != i) continue;
+            const float* p = &verts[i * 3];
+            cells.push_back({ hashCell(cellCoord(p[0]), cellCoord(p[1]), cellCoord(p[2])), (unsigned int)i });
+        }
+        std::sort(cells.begin(), cells.end(), [](const CellEntry& a, const CellEntry& b){
+            return a.hash != b.hash ? a.hash < b.hash : a.v < b.v;
+        });
+        // cell hash -> [begin, end) range in the sorted array
+        std::unordered_map<uint64_t, std::pair<uint32_t, uint32_t>> ranges;
+        ranges.reserve(cells.size());
+        for(size_t i = 0; i < cells.size(); ) {
+            size_t j = i;
+            while(j < cells.size() && cells[j].hash == cells[i].hash) ++j;
+            ranges.emplace(cells[i].hash, std::make_pair((uint32_t)i, (uint32_t)j));
+            i = j;
+        }
+
+        std::vector<unsigned int> rep(n);
+        for(size_t i = 0; i < n; ++i) rep[i] = (unsigned int)i;
+        float eps2 = epsilon * epsilon;
+        pool.parallelFor(cells.size(), kWeldGrain / 4, [&](size_t b, size_t e){
+            for(size_t ci = b; ci < e; ++ci) {
+                unsigned int v = cells[ci].v;
+                glm::vec3 pv(verts[v * 3], verts[v * 3 + 1], verts[v * 3 + 2]);
+                int64_t lo[3] = { cellCoord(pv.x - epsilon), cellCoord(pv.y - epsilon), cellCoord(pv.z - epsilon) };
+                int64_t hi[3] = { cellCoord(pv.x + epsilon), cellCoord(pv.y + epsilon), cellCoord(pv.z + epsilon) };
+                unsigned int best = v;
+                for(int64_t z = lo[2]; z <= hi[2]; ++z) for(int64_t y = lo[1]; y <= hi[1]; ++y) for(int64_t x = lo[0]; x <= hi[0]; ++x) {
+                    auto it = ranges.find(hashCell(x, y, z));
+                    if(it == ranges.end()) continue;
+                    // ids are ascending within a cell, so stop at the first one >= best
+                    for(uint32_t k = it->second.first; k < it->second.second && cells[k].v < best; ++k) {
+                        unsigned int u = cells[k].v;
+                        // the distance test also rejects entries of colliding cells
+                        glm::vec3 d = glm::vec3(verts[u * 3], verts[u * 3 + 1], verts[u * 3 + 2]) - pv;
+                        if(glm::dot(d, d) <= eps2) best = u;
+                    }
+                }
+                rep[v] = best;
+            }
+        });
+        // representatives always have lower ids, so one ascending pass resolves chains
+        for(size_t i = 0; i < n; ++i) rep[i] = rep[rep[i]];
+        for(size_t i = 0; i < n; ++i) remap[i] = rep[remap[i]];
+    }
+
+    // 3) compact the vertex array in first-occurrence order
+    std::vector<unsigned int> newId(n, ~0u);
+    unsigned int next = 0;
+    for(size_t i = 0; i < n; ++i) if(remap[i] == i) newId[i] = next++;
+    if(next == n) return r;
+    std::vector<float> out(next * 3);
+    for(size_t i = 0; i < n; ++i) {
+        if(newId[i] == ~0u) continue;
+        memcpy(&out[newId[i] * 3], &verts[i * 3], 3 * sizeof(float));
+    }
+    verts.swap(out);
+
+    pool.parallelFor(idx.size(), kWeldGrain, [&](size_t b, size_t e){
+        for(size_t i = b; i < e; ++i) idx[i] = newId[remap[idx[i]]];
+    });
+    size_t w = 0;
+    for(size_t t = 0; t + 2 < idx.size(); t += 3) {
+        unsigned int a = idx[t], b = idx[t + 1], c = idx[t + 2];
+        if(a == b || b == c || a == c) { r.trianglesRemoved++; continue; }
+        idx[w++] = a; idx[w++] = b; idx[w++] = c;
+    }
+    idx.resize(w);
+    r.verticesAfter = next;
+    return r;
+}
+
+float computeACMR(const std::vector<unsigned int>& idx, size_t vertexCount, int cacheSize) {
+    size_t triCount = idx.size() / 3;
+    if(triCount == 0) return 0.0f;
+    std::vector<unsigned int> stamp(vertexCount, 0);
+    unsigned int time = (unsigned int)cacheSize + 1;
+    size_t misses = 0;
+    for(unsigned int v : idx) {
+        if(v >= vertexCount) continue;
+        if(time - stamp[v] > (unsigned int)cacheSize) { stamp[v] = time++; misses++; }
+    }
+    return (float)misses / (float)triCount;
+}
+
+void optimizeVertexCache(std::vector<unsigned int>& idx, size_t vertexCount) {
+    size_t triCount = idx.size() / 3;
+    if(triCount == 0 || vertexCount == 0) return;
+
+    // vertex -> triangle adjacency (active triangles are kept at the front of each range)
+    std::vector<int> activeCount(vertexCount, 0);
+    for(unsigned int v : idx) activeCount[v]++;
+    std::vector<size_t> offset(vertexCount + 1, 0);
+    for(size_t v = 0; v < vertexCount; ++v) offset[v + 1] = offset[v] + activeCount[v];
+    std::vector<unsigned int> adjacency(idx.size());
+    {
+        std::vector<size_t> fill(offset.begin(), offset.end() - 1);
+        for(size_t t = 0; t < triCount; ++t)
+            for(int k = 0; k < 3; ++k) adjacency[fill[idx[t * 3 + k]]++] = (unsigned int)t;
+    }
+
+    std::vector<int> cachePos(vertexCount, -1);
+    std::vector<float> vScore(vertexCount);
+    for(size_t v = 0; v < vertexCount; ++v) vScore[v] = vertexScore(-1, activeCount[v]);
+    std::vector<float> tScore(triCount);
+    std::vector<char> added(triCount, 0);
+    int best = 0;
+    for(size_t t = 0; t < triCount; ++t) {
+        tScore[t] = vScore[idx[t * 3]] + vScore[idx[t * 3 + 1]] + vScore[idx[t * 3 + 2]];
+        if(tScore[t] > tScore[best]) best = (int)t;
+    }
+
+    std::vector<unsigned int> out;
+    out.reserve(idx.size());
+    std::vector<unsigned int> cache, nextCache;
+    cache.reserve(kCacheSize + 3); nextCache.reserve(kCacheSize + 3);
+    size_t cursor = 0;
+
+    while(out.size() < idx.size()) {
+        if(best < 0) {
+            // dead end: continue with the next unused triangle in input order
+            while(cursor < triCount && added[cursor]) cursor++;
+            if(cursor == triCount) break;
+            best = (int)cursor;
+        }
+        unsigned int tri = (unsigned int)best;
+        added[tri] = 1;
+        const unsigned int* tv = &idx[tri * 3];
+        for(int k = 0; k < 3; ++k) {
+            unsigned int v = tv[k];
+            out.push_back(v);
+            // move the triangle out of the vertex's active range
+            size_t b = offset[v], e = b + activeCount[v];
+            for(size_t i = b; i < e; ++i) {
+                if(adjacency[i] == tri) { std::swap(adjacency[i], adjacency[e - 1]); break; }
+            }
+            activeCount[v]--;
+        }
+
+        // new LRU: the triangle's vertices first, then the previous entries
+        nextCache.clear();
+        for(int k = 0; k < 3; ++k) nextCache.push_back(tv[k]);
+        for(unsigned int v : cache) {
+            if(v != tv[0] && v != tv[1] && v != tv[2]) nextCache.push_back(v);
+        }
+        cache.swap(nextCache);
+
+        for(size_t i = 0; i < cache.size(); ++i) {
+            unsigned int v = cache[i];
+            cachePos[v] = i < (size_t)kCacheSize ? (int)i : -1;
+            vScore[v] = vertexScore(cachePos[v], activeCount[v]);
+        }
+        if(cache.size() > (size_t)kCacheSize) cache.resize(kCacheSize);
+
+        // rescore triangles touching the cache and pick the best one
+        best = -1;
+        float bestScore = -1.0f;
+        for(unsigned int v : cache) {
+            size_t b = offset[v], e = b + activeCount[v];
+            for(size_t i = b; i < e; ++i) {
+                unsigned int t = adjacency[i];
+                float s = vScore[idx[t * 3]] + vScore[idx[t * 3 + 1]] + vScore[idx[t * 3 + 2]];
+                tScore[t] = s;
+                if(s > bestScore) { bestScore = s; best = (int)t; }
+            }
+        }
+    }
+    idx.swap(out);
+}
+
+void optimizeOverdraw(std::vector<unsigned int>& idx, const std::vector<float>& verts, float threshold) {
+    size_t triCount = idx.size() / 3;
+    size_t vertexCount = verts.size() / 3;
+    if(triCount < 2 || vertexCount == 0) return;
+
+    // Split into clusters where the simulated cache restarts (all three vertices miss), as long
+    // as the current cluster already performs within 'threshold' of the whole mesh.
+    const int cacheSize = 16;
+    float meshACMR = computeACMR(idx, vertexCount, cacheSize);
+    std::vector<size_t> clusterStart;
+    clusterStart.push_back(0);
+    std::vector<unsigned int> stamp(vertexCount, 0);
+    unsigned int time = cacheSize + 1;
+    size_t clusterMisses = 0, clusterTris = 0;
+    for(size_t t = 0; t < triCount; ++t) {
+        int misses = 0;
+        for(int k = 0; k < 3; ++k) {
+            unsigned int v = idx[t * 3 + k];
+            if(time - stamp[v] > (unsigned int)cacheSize) { stamp[v] = time++; misses++; }
+        }
+        if(misses == 3 && clusterTris > 0 && (float)clusterMisses / (float)clusterTris <= meshACMR * threshold) {
+            clusterStart.push_back(t);
+            clusterMisses = 0; clusterTris = 0;
+        }
+        clusterMisses += misses;
+        clusterTris++;
+    }
+    size_t clusterCount = clusterStart.size();
+    if(clusterCount < 2) return;
+    clusterStart.push_back(triCount);
+
+    auto pos = [&](unsigned int v) { return glm::vec3(verts[v * 3], verts[v * 3 + 1], verts[v * 3 + 2]); };
+
+    // mesh centroid (area weighted)
+    glm::vec3 meshCenter(0.0f); float meshArea = 0.0f;
+    std::vector<glm::vec3> clusterCenter(clusterCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> clusterNormal(clusterCount, glm::vec3(0.0f));
+    std::vector<float> clusterArea(clusterCount, 0.0f);
+    for(size_t c = 0; c < clusterCount; ++c) {
+        for(size_t t = clusterStart[c]; t < clusterStart[c + 1]; ++t) {
+            glm::vec3 a = pos(idx[t * 3]), b = pos(idx[t * 3 + 1]), d = pos(idx[t * 3 + 2]);
+            glm::vec3 n = glm::cross(b - a, d - a);
+            float area = glm::length(n);
+            glm::vec3 centroid = (a + b + d) / 3.0f;
+            clusterCenter[c] += centroid * area;
+            clusterNormal[c] += n;
+            clusterArea[c] += area;
+        }
+        meshCenter += clusterCenter[c];
+        meshArea += clusterArea[c];
+    }
+    if(meshArea <= 0.0f) return;
+    meshCenter /= meshArea;
+
+    // clusters facing away from the mesh center (likely occluders) are drawn first
+    std::vector<float> sortKey(clusterCount, 0.0f);
+    for(size_t c = 0; c < clusterCount; ++c) {
+        if(clusterArea[c] <= 0.0f) continue;
+        glm::vec3 center = clusterCenter[c] / clusterArea[c];
+        float len = glm::length(clusterNormal[c]);
+        if(len > 0.0f) sortKey[c] = glm::dot(center - meshCenter, clusterNormal[c] / len);
+    }
+    std::vector<size_t> order(clusterCount);
+    for(size_t c = 0; c < clusterCount; ++c) order[c] = c;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b){ return sortKey[a] > sortKey[b]; });
+
+    std::vector<unsigned int> out;
+    out.reserve(idx.size());
+    for(size_t c : order) {
+        out.insert(out.end(), idx.begin() + clusterStart[c] * 3, idx.begin() + clusterStart[c + 1] * 3);
+    }
+    idx.swap(out);
+}
+
+void optimizeVertexFetch(std::vector<float>& verts, std::vector<unsigned int>& idx) {
+    size_t vertexCount = verts.size() / 3;
+    std::vector<unsigned int> remap(vertexCount, ~0u);
+    std::vector<float> out;
+    out.reserve(verts.size());
+    unsigned int next = 0;
+    for(unsigned int& v : idx) {
+        if(remap[v] == ~0u) {
+            remap[v] = next++;
+            out.push_back(verts[v * 3]); out.push_back(verts[v * 3 + 1]); out.push_back(verts[v * 3 + 2]);
+        }
+        v = remap[v];
+    }
+    verts.swap(out);
+}
+
+Result optimize(std::vector<float>& verts, std::vector<unsigned int>& idx) {
+    Result r;
+    size_t vertexCount = verts.size() / 3;
+    // reject out-of-range indices instead of reading past the vertex array
+    for(unsigned int v : idx) if(v >= vertexCount) { LOG_WARN("MeshOptimizer: index out of range, mesh left unoptimized"); return r; }
+    r.acmrBefore = computeACMR(idx, vertexCount);
+    optimizeVertexCache(idx, vertexCount);
+    optimizeOverdraw(idx, verts);
+    optimizeVertexFetch(verts, idx);
+    r.acmrAfter = computeACMR(idx, verts.size() / 3);
+    return r;
+}
+
+bool simplifyClusters(const std::vector<float>& verts, const std::vector<unsigned int>& idx, size_t targetTriangles,
+                      std::vector<float>& outVerts, std::vector<unsigned int>& outIdx) {
+    outVerts.clear(); outIdx.clear();
+    size_t vertexCount = verts.size() / 3;
+    size_t triCount = idx.size() / 3;
+    if(vertexCount == 0 || triCount <= targetTriangles || targetTriangles == 0) return false;
+    for(unsigned int v : idx) if(v >= vertexCount) return false;
+
+    glm::vec3 mn(FLT_MAX), mx(-FLT_MAX);
+    for(size_t i = 0; i < vertexCount; ++i) {
+        glm::vec3 p(verts[i * 3], verts[i * 3 + 1], verts[i * 3 + 2]);
+        mn = glm::min(mn, p); mx = glm::max(mx, p);
+    }
+    glm::vec3 ext = mx - mn;
+    float extent = std::max(ext.x, std::max(ext.y, ext.z));
+    if(!(extent > 0.0f)) return false;
+
+    // a closed surface occupies roughly 3g^2 cells of a g^3 grid, each giving about two triangles
+    int grid = (int)std::sqrt((float)targetTriangles / 6.0f);
+    std::vector<unsigned int> remap(vertexCount);
+    std::vector<uint64_t> tris;
+    size_t cellCount = 0;
+    for(int attempt = 0; attempt < kClusterAttempts; ++attempt) {
+        grid = std::min(std::max(grid, 2), kClusterGridMax);
+        float scale = (float)grid / extent;
+        std::unordered_map<uint64_t, unsigned int> cells;
+        cells.reserve(std::min(vertexCount, (size_t)grid * grid * 8));
+        for(size_t i = 0; i < vertexCount; ++i) {
+            glm::vec3 c = (glm::vec3(verts[i * 3], verts[i * 3 + 1], verts[i * 3 + 2]) - mn) * scale;
+            uint64_t x = (uint64_t)std::min((int)c.x, grid - 1), y = (uint64_t)std::min((int)c.y, grid - 1), z = (uint64_t)std::min((int)c.z, grid - 1);
+            auto it = cells.emplace(x | y << 21 | z << 42, (unsigned int)cells.size()).first;
+            remap[i] = it->second;
+        }
+        cellCount = cells.size();
+
+        std::unordered_set<uint64_t> seen;
+        tris.clear();
+        for(size_t t = 0; t < triCount; ++t) {
+            uint64_t a = remap[idx[t * 3]], b = remap[idx[t * 3 + 1]], c = remap[idx[t * 3 + 2]];
+            if(a == b || b == c || a == c) continue;
+            // rotate the smallest index first; keeps the winding, so only same-facing duplicates merge
+            if(b < a && b < c) { uint64_t tmp = a; a = b; b = c; c = tmp; }
+            else if(c < a && c < b) { uint64_t tmp = c; c = b; b = a; a = tmp; }
+            uint64_t key = a | b << 21 | c << 42;
+            if(seen.insert(key).second) tris.push_back(key);
+        }
+        if(tris.size() * 2 <= targetTriangles * 3 || grid == 2) break;
+        grid = (int)((float)grid * std::sqrt((float)targetTriangles / (float)tris.size()));
+    }
+    if(tris.empty() || tris.size() >= triCount) return false;
+
+    // cell representatives at the average position of their vertices
+    std::vector<double> sums(cellCount * 3, 0.0);
+    std::vector<unsigned int> counts(cellCount, 0);
+    for(size_t i = 0; i < vertexCount; ++i) {
+        for(int k = 0; k < 3; ++k) sums[remap[i] * 3 + k] += verts[i * 3 + k];
+        counts[remap[i]]++;
+    }
+    outVerts.resize(cellCount * 3);
+    for(size_t c = 0; c < cellCount; ++c) {
+        for(int k = 0; k < 3; ++k) outVerts[c * 3 + k] = (float)(sums[c * 3 + k] / (double)std::max(counts[c], 1u));
+    }
+    const uint64_t mask = (1ull << 21) - 1;
+    outIdx.reserve(tris.size() * 3);
+    for(uint64_t key : tris) {
+        outIdx.push_back((unsigned int)(key & mask));
+        outIdx.push_back((unsigned int)(key >> 21 & mask));
+        outIdx.push_back((unsigned int)(key >> 42 & mask));
+    }
+    // drops the cells whose triangles all collapsed
+    optimizeVertexFetch(outVerts, outIdx);
+    return true;
+}
+
+uint64_t hashMesh(const std::vector<float>& verts, const std::vector<unsigned int>& idx) {
+    uint64_t sizes[2] = { verts.size(), idx.size() };
+    uint64_t h = XXHash::hash64(sizes, sizeof(sizes));
+    h = XXHash::hash64(verts.data(), verts.size() * sizeof(float), h);
+    return XXHash::hash64(idx.data(), idx.size() * sizeof(unsigned int), h);
+}
+
+// Checksum of an entry: the vertices, then the indices seeded with the vertices' hash
+static uint64_t entryChecksum(const std::vector<float>& verts, const std::vector<unsigned int>& idx) {
+    uint64_t h = XXHash::hash64(verts.data(), verts.size() * sizeof(float));
+    return XXHash::hash64(idx.data(), idx.size() * sizeof(unsigned int), h);
+}
+
+bool Cache::load(const std::string& assetPath) {
+    m_path = assetPath + ".meshopt";
+    m_entries.clear();
+    m_dirty = false;
+    std::ifstream f(m_path, std::ios::binary);
+    if(!f) return false;
+    std::error_code ec;
+    uint64_t fileSize = std::filesystem::file_size(m_path, ec);
+    if(ec) return false;
+    uint32_t header[3] = {0, 0, 0};
+    if(!f.read((char*)header, sizeof(header)) || header[0] != kCacheMagic || header[1] != kCacheVersion) {
+        LOG_WARN("Ignoring stale mesh optimization cache " << m_path);
+        return false;
+    }
+    uint64_t pos = sizeof(header);
+    for(uint32_t i = 0; i < header[2]; ++i) {
+        uint64_t key = 0, checksum = 0; uint32_t counts[2] = {0, 0};
+        if(!f.read((char*)&key, sizeof(key)) || !f.read((char*)counts, sizeof(counts)) || !f.read((char*)&checksum, sizeof(checksum))) break;
+        pos += sizeof(key) + sizeof(counts) + sizeof(checksum);
+        // the streams must fit in what is left of the file before anything is allocated
+        uint64_t bytes = (uint64_t)counts[0] * sizeof(float) + (uint64_t)counts[1] * sizeof(unsigned int);
+        if(bytes > fileSize - std::min(pos, fileSize) || counts[0] % 3 != 0 || counts[1] % 3 != 0) {
+            LOG_WARN("Ignoring corrupt mesh optimization cache " << m_path);
+            break;
+        }
+        Entry e;
+        e.verts.resize(counts[0]);
+        e.idx.resize(counts[1]);
+        if(!f.read((char*)e.verts.data(), e.verts.size() * sizeof(float))) break;
+        if(!f.read((char*)e.idx.data(), e.idx.size() * sizeof(unsigned int))) break;
+        pos += bytes;
+        uint32_t vertexCount = counts[0] / 3;
+        bool valid = entryChecksum(e.verts, e.idx) == checksum;
+        for(size_t k = 0; valid && k < e.idx.size(); ++k) valid = e.idx[k] < vertexCount;
+        if(!valid) {
+            LOG_WARN("Skipping corrupt entry in mesh optimization cache " << m_path);
+            continue;
+        }
+        m_entries[key] = std::move(e);
+    }
+    return true;
+}
+
+bool Cache::save() const {
+    if(m_path.empty()) return false;
+    // written next to the cache and renamed over it, so an interrupted save leaves the old file
+    std::string tmp = m_path + ".tmp";
+    bool ok;
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        if(!f) { LOG_WARN("Could not write mesh optimization cache " << m_path); return false; }
+        uint32_t used = 0;
+        for(const auto& kv : m_entries) if(kv.second.used) used++;
+        uint32_t header[3] = { kCacheMagic, kCacheVersion, used };
+        f.write((const char*)header, sizeof(header));
+        for(const auto& kv : m_entries) {
+            if(!kv.second.used) continue;
+            uint32_t counts[2] = { (uint32_t)kv.second.verts.size(), (uint32_t)kv.second.idx.size() };
+            uint64_t checksum = entryChecksum(kv.second.verts, kv.second.idx);
+            f.write((const char*)&kv.first, sizeof(kv.first));
+            f.write((const char*)counts, sizeof(counts));
+            f.write((const char*)&checksum, sizeof(checksum));
+            f.write((const char*)kv.second.verts.data(), kv.second.verts.size() * sizeof(float));
+            f.write((const char*)kv.second.idx.data(), kv.second.idx.size() * sizeof(unsigned int));
+        }
+        ok = (bool)f;
+    }
+    std::error_code ec;
+    if(ok) std::filesystem::rename(tmp, m_path, ec);
+    if(!ok || ec) {
+        std::filesystem::remove(tmp, ec);
+        LOG_WARN("Could not write mesh optimization cache " << m_path);
+        return false;
+    }
+    return true;
+}
+
+bool Cache::dirty() const {
+    std::lock_guard<std::mutex> lk(m_mtx);
+    if(m_dirty) return true;
+    // loaded entries the import did not use belong to source meshes that changed or are gone
+    for(const auto& kv : m_entries) if(!kv.second.used) return true;
+    return false;
+}
+
+bool Cache::find(uint64_t key, std::vector<float>& verts, std::vector<unsigned int>& idx) {
+    std::lock_guard<std::mutex> lk(m_mtx);
+    auto it = m_entries.find(key);
+    if(it == m_entries.end()) return false;
+    it->second.used = true;
+    verts = it->second.verts;
+    idx = it->second.idx;
+    return true;
+}
+
+void Cache::store(uint64_t key, const std::vector<float>& verts, const std::vector<unsigned int>& idx) {
+    std::lock_guard<std::mutex> lk(m_mtx);
+    Entry& e = m_entries[key];
+    e.verts = verts;
+    e.idx = idx;
+    e.used = true;
+    m_dirty = true;
+}
+
+} // namespace MeshOptimizer
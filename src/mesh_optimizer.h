@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <unordered_map>
+#include <mutex>
+
+// CPU-side mesh optimizations applied at import time, before MeshGL::upload.
+// All functions work on tightly packed xyz float positions and triangle lists.
+namespace MeshOptimizer {
+    struct WeldResult {
+        size_t verticesBefore = 0;
+        size_t verticesAfter = 0;
+        size_t trianglesRemoved = 0; // collapsed to degenerate by the weld
+    };
+    // Merge duplicate vertices: bit-exact matches through a hash, then (epsilon > 0) vertices closer
+    // than epsilon through a quantized spatial hash. Runs on the thread pool for large meshes.
+    // Vertices keep first-occurrence order; triangles that collapse are removed.
+    WeldResult weldVertices(std::vector<float>& verts, std::vector<unsigned int>& idx, float epsilon);
+
+    // Average cache miss ratio (transformed vertices per triangle) for a FIFO post-transform cache
+    float computeACMR(const std::vector<unsigned int>& idx, size_t vertexCount, int cacheSize = 16);
+
+    // Reorder triangles for post-transform vertex cache locality (Forsyth's linear-speed algorithm)
+    void optimizeVertexCache(std::vector<unsigned int>& idx, size_t vertexCount);
+
+    // Reorder clusters of the cache-optimized triangle list so outward-facing parts are drawn first.
+    // Cluster boundaries are only placed where the cache state allows it (ACMR within 'threshold' x).
+    void optimizeOverdraw(std::vector<unsigned int>& idx, const std::vector<float>& verts, float threshold = 1.05f);
+
+    // Renumber vertices in first-use order (drops unreferenced vertices)
+    void optimizeVertexFetch(std::vector<float>& verts, std::vector<unsigned int>& idx);
+
+    struct Result {
+        float acmrBefore = 0.0f;
+        float acmrAfter = 0.0f;
+    };
+    // Run all passes in order: vertex cache, overdraw, vertex fetch
+    Result optimize(std::vector<float>& verts, std::vector<unsigned int>& idx);
+
+    // Coarse approximation by vertex clustering: vertices are merged per cell of a uniform grid (at the
+    // cell's average position) and collapsed or duplicate triangles dropped. The grid is shrunk until the
+    // result is within about 1.5x of 'targetTriangles'. Returns false when no smaller mesh was produced.
+    bool simplifyClusters(const std::vector<float>& verts, const std::vector<unsigned int>& idx, size_t targetTriangles,
+                          std::vector<float>& outVerts, std::vector<unsigned int>& outIdx);
+
+    // XXH64 hash of mesh input data (cache key)
+    uint64_t hashMesh(const std::vector<float>& verts, const std::vector<unsigned int>& idx);
+
+    // Optimized meshes of one asset, stored in a sidecar file next to it ("<asset>.meshopt").
+    // Entries are keyed by the hash of the unoptimized input, so a changed source mesh misses;
+    // entries not used by the last import are dropped on save. Entries are checksummed and their indices
+    // checked on load, so a damaged file only costs misses. find/store are thread-safe.
+    class Cache {
+    public:
+        bool load(const std::string& assetPath);
+        bool save() const;
+        bool find(uint64_t key, std::vector<float>& verts, std::vector<unsigned int>& idx);
+        void store(uint64_t key, const std::vector<float>& verts, const std::vector<unsigned int>& idx);
+        // True when save() would change the file: entries were stored, or loaded ones went unused and
+        // would be pruned
+        bool dirty() const;
+
+    private:
+        struct Entry { std::vector<float> verts; std::vector<unsigned int> idx; bool used = false; };
+        std::string m_path;
+        std::unordered_map<uint64_t, Entry> m_entries;
+        bool m_dirty = false;
+        mutable std::mutex m_mtx;
+    };
+}
@@ -0,0 +1,681 @@
+#include "mesh_parsers.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include <charconv>
+#include <filesystem>
+#include <sstream>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+namespace MeshParsers {
+
+// index of triangles whose face referred to a missing vertex; they are dropped before returning
+static const uint32_t kInvalid = 0xffffffffu;
+
+bool handles(const std::string& lowerExtension) {
+    return lowerExtension == ".obj" || lowerExtension == ".stl" || lowerExtension == ".ply";
+}
+
+// ---- Text helpers ----
+
+struct Chunk {
+    const char* begin;
+    const char* end;
+};
+
+// About one chunk per MB, at most a few per worker for balance; every chunk starts at a line start
+static std::vector<Chunk> splitLines(const char* data, size_t size) {
+    size_t workers = std::max<size_t>(ThreadPool::instance().workerCount(), 1);
+    size_t count = std::clamp<size_t>(size >> 20, 1, workers * 16);
+    std::vector<Chunk> out;
+    const char* end = data + size;
+    const char* p = data;
+    for(size_t i = 1; i <= count && p < end; ++i) {
+        const char* cut = i == count ? end : std::max(p, data + size / count * i);
+        if(cut < end) {
+            const void* nl = memchr(cut, '\n', (size_t)(end - cut));
+            cut = nl ? (const char*)nl + 1 : end;
+        }
+        out.push_back({ p, cut });
+        p = cut;
+    }
+    return out;
+}
+
+static inline bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+static inline const char* skipBlank(const char* p, const char* end) { while(p < end && isBlank(*p)) ++p; return p; }
+static inline const char* skipToken(const char* p, const char* end) { while(p < end && !isBlank(*p)) ++p; return p; }
+static inline const char* lineEnd(const char* p, const char* end) {
+    const void* nl = memchr(p, '\n', (size_t)(end - p));
+    return nl ? (const char*)nl : end;
+}
+static inline const char* nextLine(const char* le, const char* end) { return le < end ? le + 1 : end; }
+
+// Single-letter OBJ statement ("v ", "f ", ...)
+static inline bool isStatement(const char* p, const char* le, char c) { return le - p > 1 && p[0] == c && isBlank(p[1]); }
+
+static inline size_t countTokens(const char* p, const char* le) {
+    size_t n = 0;
+    for(;;) {
+        p = skipBlank(p, le);
+        if(p >= le) return n;
+        n++;
+        p = skipToken(p, le);
+    }
+}
+
+// Parse the next whitespace-separated number; null when there is none
+template<typename T>
+static inline const char* parseNumber(const char* p, const char* le, T& out) {
+    p = skipBlank(p, le);
+    if(p < le && *p == '+') ++p;
+    auto r = std::from_chars(p, le, out);
+    return r.ec == std::errc() ? r.ptr : nullptr;
+}
+
+static std::string trimmed(const char* p, const char* le) {
+    p = skipBlank(p, le);
+    while(le > p && isBlank(le[-1])) --le;
+    return std::string(p, le);
+}
+
+// Remove triangles marked kInvalid, keeping the order of the rest
+static void dropInvalid(std::vector<unsigned int>& idx) {
+    size_t w = 0;
+    for(size_t t = 0; t + 2 < idx.size(); t += 3) {
+        if(idx[t] == kInvalid || idx[t + 1] == kInvalid || idx[t + 2] == kInvalid) continue;
+        idx[w] = idx[t]; idx[w + 1] = idx[t + 1]; idx[w + 2] = idx[t + 2];
+        w += 3;
+    }
+    idx.resize(w);
+}
+
+// Copy triangles [t0, t1) and the vertices they use into 'out', renumbering the vertices
+static void extractPart(const std::vector<float>& positions, const std::vector<unsigned int>& indices, size_t t0, size_t t1, Mesh& out) {
+    uint32_t lo = kInvalid, hi = 0;
+    size_t used = 0;
+    for(size_t t = t0; t < t1; ++t) {
+        const unsigned int* tri = &indices[t * 3];
+        if(tri[0] == kInvalid || tri[1] == kInvalid || tri[2] == kInvalid) continue;
+        for(int k = 0; k < 3; ++k) { lo = std::min(lo, tri[k]); hi = std::max(hi, tri[k]); }
+        used += 3;
+    }
+    if(used == 0) return;
+    out.indices.reserve(used);
+    auto emit = [&](uint32_t v){
+        out.positions.insert(out.positions.end(), &positions[(size_t)v * 3], &positions[(size_t)v * 3] + 3);
+        return (unsigned int)(out.positions.size() / 3 - 1);
+    };
+    size_t span = (size_t)hi - lo + 1;
+    if(span <= used * 4 + 1024) {
+        // groups usually own a contiguous run of vertices: a dense remap table is small
+        std::vector<uint32_t> remap(span, kInvalid);
+        for(size_t t = t0; t < t1; ++t) {
+            const unsigned int* tri = &indices[t * 3];
+            if(tri[0] == kInvalid || tri[1] == kInvalid || tri[2] == kInvalid) continue;
+            for(int k = 0; k < 3; ++k) {
+                uint32_t& r = remap[tri[k] - lo];
+                if(r == kInvalid) r = emit(tri[k]);
+                out.indices.push_back(r);
+            }
+        }
+        return;
+    }
+    // scattered vertices: renumber through the sorted set of used indices
+    std::vector<uint32_t> verts;
+    verts.reserve(used);
+    for(size_t t = t0; t < t1; ++t) {
+        const unsigned int* tri = &indices[t * 3];
+        if(tri[0] == kInvalid || tri[1] == kInvalid || tri[2] == kInvalid) continue;
+        verts.insert(verts.end(), tri, tri + 3);
+    }
+    std::sort(verts.begin(), verts.end());
+    verts.erase(std::unique(verts.begin(), verts.end()), verts.end());
+    for(uint32_t v : verts) emit(v);
+    for(size_t t = t0; t < t1; ++t) {
+        const unsigned int* tri = &indices[t * 3];
+        if(tri[0] == kInvalid || tri[1] == kInvalid || tri[2] == kInvalid) continue;
+        for(int k = 0; k < 3; ++k) out.indices.push_back((unsigned int)(std::lower_bound(verts.begin(), verts.end(), tri[k]) - verts.begin()));
+    }
+}
+
+// ---- OBJ ----
+
+struct ObjChunk {
+    Chunk text;
+    size_t vertices = 0;
+    size_t triangles = 0;
+    size_t vertexBase = 0;
+    size_t triangleBase = 0;
+    std::vector<std::pair<size_t, std::string>> groups; // triangle offset in the chunk, name
+};
+
+// Pass 1: count what the chunk will write
+static void countObj(ObjChunk& c) {
+    for(const char* p = c.text.begin; p < c.text.end;) {
+        const char* le = lineEnd(p, c.text.end);
+        const char* s = skipBlank(p, le);
+        if(isStatement(s, le, 'v')) c.vertices++;
+        else if(isStatement(s, le, 'f')) {
+            size_t n = countTokens(s + 1, le);
+            if(n >= 3) c.triangles += n - 2;
+        } else if(isStatement(s, le, 'o') || isStatement(s, le, 'g')) {
+            c.groups.push_back({ c.triangles, trimmed(s + 1, le) });
+        }
+        p = nextLine(le, c.text.end);
+    }
+}
+
+// Pass 2: parse into the shared arrays at the chunk's offsets
+static void parseObj(const ObjChunk& c, float* positions, unsigned int* indices, size_t totalVertices, std::atomic<size_t>& invalid) {
+    float* pos = positions + c.vertexBase * 3;
+    unsigned int* tri = indices + c.triangleBase * 3;
+    size_t vi = 0;
+    std::vector<uint32_t> face;
+    for(const char* p = c.text.begin; p < c.text.end;) {
+        const char* le = lineEnd(p, c.text.end);
+        const char* s = skipBlank(p, le);
+        if(isStatement(s, le, 'v')) {
+            float xyz[3] = { 0.0f, 0.0f, 0.0f };
+            const char* q = s + 1;
+            for(int k = 0; k < 3 && q; ++k) q = parseNumber(q, le, xyz[k]);
+            pos[0] = xyz[0]; pos[1] = xyz[1]; pos[2] = xyz[2];
+            pos += 3;
+            vi++;
+        } else if(isStatement(s, le, 'f')) {
+            // v, v/vt, v/vt/vn or v//vn; negative indices count back from the last vertex read
+            face.clear();
+            bool valid = true;
+            for(const char* q = s + 1;;) {
+                q = skipBlank(q, le);
+                if(q >= le) break;
+                long long v = 0;
+                auto r = std::from_chars(q, le, v);
+                long long resolved = r.ec != std::errc() || v == 0 ? -1 : v > 0 ? v - 1 : (long long)(c.vertexBase + vi) + v;
+                if(resolved < 0 || resolved >= (long long)totalVertices) valid = false;
+                face.push_back((uint32_t)resolved);
+                q = skipToken(q, le);
+            }
+            if(face.size() >= 3) {
+                if(!valid) invalid += face.size() - 2;
+                for(size_t k = 2; k < face.size(); ++k) {
+                    tri[0] = valid ? face[0] : kInvalid;
+                    tri[1] = valid ? face[k - 1] : kInvalid;
+                    tri[2] = valid ? face[k] : kInvalid;
+                    tri += 3;
+                }
+            }
+        }
+        p = nextLine(le, c.text.end);
+    }
+}
+
+static bool loadObj(const MappedFile& file, std::vector<Mesh>& meshes, std::string& err) {
+    std::vector<Chunk> chunks = splitLines((const char*)file.data(), file.size());
+    std::vector<ObjChunk> work(chunks.size());
+    for(size_t i = 0; i < chunks.size(); ++i) work[i].text = chunks[i];
+    ThreadPool& pool = ThreadPool::instance();
+    pool.parallelFor(work.size(), 1, [&](size_t b, size_t e){ for(size_t i = b; i < e; ++i) countObj(work[i]); });
+
+    size_t vertices = 0, triangles = 0;
+    for(ObjChunk& c : work) {
+        c.vertexBase = vertices;
+        c.triangleBase = triangles;
+        vertices += c.vertices;
+        triangles += c.triangles;
+    }
+    if(triangles == 0) { err = "no faces"; return false; }
+    if(vertices >= kInvalid) { err = "too many vertices"; return false; }
+
+    std::vector<float> positions(vertices * 3);
+    std::vector<unsigned int> indices(triangles * 3);
+    std::atomic<size_t> invalid{0};
+    pool.parallelFor(work.size(), 1, [&](size_t b, size_t e){
+        for(size_t i = b; i < e; ++i) parseObj(work[i], positions.data(), indices.data(), vertices, invalid);
+    });
+
+    // objects/groups: triangle ranges in file order; a name given before any face renames the current part
+    struct Part { std::string name; size_t t0 = 0, t1 = 0; };
+    std::vector<Part> parts(1);
+    for(const ObjChunk& c : work) {
+        for(const auto& g : c.groups) {
+            size_t t = c.triangleBase + g.first;
+            if(t > parts.back().t0) {
+                parts.back().t1 = t;
+                parts.push_back({ g.second, t, 0 });
+            } else {
+                parts.back().name = g.second;
+            }
+        }
+    }
+    parts.back().t1 = triangles;
+    parts.erase(std::remove_if(parts.begin(), parts.end(), [](const Part& p){ return p.t1 == p.t0; }), parts.end());
+
+    if(parts.size() == 1) {
+        // the common scan case: hand the arrays over as they are
+        meshes.resize(1);
+        meshes[0].name = parts[0].name;
+        if(invalid > 0) dropInvalid(indices);
+        meshes[0].positions.swap(positions);
+        meshes[0].indices.swap(indices);
+    } else {
+        meshes.resize(parts.size());
+        pool.parallelFor(parts.size(), 1, [&](size_t b, size_t e){
+            for(size_t i = b; i < e; ++i) {
+                meshes[i].name = parts[i].name;
+                extractPart(positions, indices, parts[i].t0, parts[i].t1, meshes[i]);
+            }
+        });
+        meshes.erase(std::remove_if(meshes.begin(), meshes.end(), [](const Mesh& m){ return m.indices.empty(); }), meshes.end());
+    }
+    if(invalid > 0) err = std::to_string(invalid.load()) + " triangles refer to missing vertices and were dropped";
+    return !meshes.empty();
+}
+
+// ---- STL ----
+
+static bool loadStl(const MappedFile& file, Mesh& mesh, std::string& err) {
+    const uint8_t* d = file.data();
+    size_t size = file.size();
+    ThreadPool& pool = ThreadPool::instance();
+    uint32_t count = 0;
+    if(size >= 84) memcpy(&count, d + 80, 4);
+    // binary: 80-byte header, triangle count, 50-byte records (normal, 3 vertices, attribute word).
+    // ASCII files start with "solid" too, so the size is what tells them apart.
+    if(size >= 84 && 84 + (uint64_t)count * 50 == size) {
+        if(count == 0) { err = "no triangles"; return false; }
+        mesh.positions.resize((size_t)count * 9);
+        mesh.indices.resize((size_t)count * 3);
+        // little-endian floats, read straight from the mapping (records are not 4-byte aligned)
+        pool.parallelFor(count, 1 << 16, [&](size_t b, size_t e){
+            for(size_t t = b; t < e; ++t) {
+                memcpy(&mesh.positions[t * 9], d + 84 + t * 50 + 12, 36);
+                mesh.indices[t * 3] = (unsigned int)(t * 3);
+                mesh.indices[t * 3 + 1] = (unsigned int)(t * 3 + 1);
+                mesh.indices[t * 3 + 2] = (unsigned int)(t * 3 + 2);
+            }
+        });
+        return true;
+    }
+
+    // ASCII: every "vertex x y z" line is the next corner; facets are three consecutive corners
+    std::vector<Chunk> chunks = splitLines((const char*)d, size);
+    std::vector<size_t> base(chunks.size() + 1, 0);
+    auto isVertex = [](const char* s, const char* le){ return le - s > 6 && memcmp(s, "vertex", 6) == 0 && isBlank(s[6]); };
+    pool.parallelFor(chunks.size(), 1, [&](size_t b, size_t e){
+        for(size_t i = b; i < e; ++i) {
+            size_t n = 0;
+            for(const char* p = chunks[i].begin; p < chunks[i].end;) {
+                const char* le = lineEnd(p, chunks[i].end);
+                if(isVertex(skipBlank(p, le), le)) n++;
+                p = nextLine(le, chunks[i].end);
+            }
+            base[i + 1] = n;
+        }
+    });
+    for(size_t i = 0; i < chunks.size(); ++i) base[i + 1] += base[i];
+    size_t vertices = base.back() / 3 * 3;
+    if(vertices == 0) { err = "not an STL file"; return false; }
+    mesh.positions.resize(base.back() * 3);
+    pool.parallelFor(chunks.size(), 1, [&](size_t b, size_t e){
+        for(size_t i = b; i < e; ++i) {
+            float* pos = mesh.positions.data() + base[i] * 3;
+            for(const char* p = chunks[i].begin; p < chunks[i].end;) {
+                const char* le = lineEnd(p, chunks[i].end);
+                const char* s = skipBlank(p, le);
+                if(isVertex(s, le)) {
+                    const char* q = s + 6;
+                    for(int k = 0; k < 3; ++k) { float v = 0.0f; if(q) q = parseNumber(q, le, v); pos[k] = v; }
+                    pos += 3;
+                }
+                p = nextLine(le, chunks[i].end);
+            }
+        }
+    });
+    mesh.positions.resize(vertices * 3);
+    mesh.indices.resize(vertices);
+    for(size_t i = 0; i < vertices; ++i) mesh.indices[i] = (unsigned int)i;
+    return true;
+}
+
+// ---- PLY ----
+
+static bool isIndexList(const PlyProperty& p) { return p.list && (p.name == "vertex_indices" || p.name == "vertex_index"); }
+
+static PlyType plyType(const std::string& s) {
+    if(s == "char" || s == "int8") return Int8;
+    if(s == "uchar" || s == "uint8") return UInt8;
+    if(s == "short" || s == "int16") return Int16;
+    if(s == "ushort" || s == "uint16") return UInt16;
+    if(s == "int" || s == "int32") return Int32;
+    if(s == "uint" || s == "uint32") return UInt32;
+    if(s == "float" || s == "float32") return Float32;
+    if(s == "double" || s == "float64") return Float64;
+    return PlyInvalid;
+}
+
+bool readPlyHeader(const char* data, size_t size, PlyHeader& header, std::string& err) {
+    PlyFormat& format = header.format;
+    std::vector<PlyElement>& elements = header.elements;
+    size_t& bodyOffset = header.bodyOffset;
+    elements.clear();
+    if(size < 4 || memcmp(data, "ply", 3) != 0) { err = "not a PLY file"; return false; }
+    const char* end = data + size;
+    bool haveFormat = false;
+    for(const char* p = data; p < end;) {
+        const char* le = lineEnd(p, end);
+        std::istringstream ss(std::string(p, le));
+        std::string word;
+        ss >> word;
+        p = nextLine(le, end);
+        if(word == "format") {
+            std::string f;
+            ss >> f;
+            if(f == "ascii") format = PlyFormat::Ascii;
+            else if(f == "binary_little_endian") format = PlyFormat::BinaryLE;
+            else if(f == "binary_big_endian") format = PlyFormat::BinaryBE;
+            else { err = "unknown PLY format " + f; return false; }
+            haveFormat = true;
+        } else if(word == "element") {
+            PlyElement e;
+            ss >> e.name >> e.count;
+            if(!ss) { err = "bad PLY element line"; return false; }
+            elements.push_back(std::move(e));
+        } else if(word == "property") {
+            if(elements.empty()) { err = "PLY property outside an element"; return false; }
+            PlyProperty prop;
+            std::string type;
+            ss >> type;
+            if(type == "list") {
+                std::string countType, itemType;
+                ss >> countType >> itemType >> prop.name;
+                prop.list = true;
+                prop.countType = plyType(countType);
+                prop.type = plyType(itemType);
+                if(prop.countType == PlyInvalid || prop.countType == Float32 || prop.countType == Float64) { err = "bad PLY list count type"; return false; }
+            } else {
+                prop.type = plyType(type);
+                ss >> prop.name;
+            }
+            if(prop.type == PlyInvalid) { err = "unknown PLY property type " + type; return false; }
+            elements.back().props.push_back(std::move(prop));
+        } else if(word == "end_header") {
+            if(!haveFormat) { err = "PLY header has no format"; return false; }
+            bodyOffset = (size_t)(p - data);
+            return true;
+        }
+    }
+    err = "PLY header has no end_header";
+    return false;
+}
+
+// x, y, z property positions of the vertex element
+static bool vertexFields(const PlyElement& e, int fields[3]) {
+    fields[0] = fields[1] = fields[2] = -1;
+    for(size_t i = 0; i < e.props.size(); ++i) {
+        if(e.props[i].list) continue;
+        if(e.props[i].name == "x") fields[0] = (int)i;
+        else if(e.props[i].name == "y") fields[1] = (int)i;
+        else if(e.props[i].name == "z") fields[2] = (int)i;
+    }
+    return fields[0] >= 0 && fields[1] >= 0 && fields[2] >= 0;
+}
+
+static inline uint32_t toIndex(double v) { return v >= 0.0 && v < (double)kInvalid ? (uint32_t)v : kInvalid; }
+
+// A list count as read from the file: a whole number from 0 to the largest value of the count type.
+// Anything else fails the parse rather than being cast to a huge size_t.
+static bool listCount(double v, PlyType countType, size_t& n) {
+    static const double kMax[] = { 127.0, 255.0, 32767.0, 65535.0, 2147483647.0, 4294967295.0 };
+    if(countType > UInt32 || !(v >= 0.0) || v > kMax[countType] || v != std::floor(v)) return false;
+    n = (size_t)v;
+    return true;
+}
+
+// Faces where every record is "n i0 .. in-1" with the same n: fixed stride, verified and decoded in parallel
+static bool readFixedFaces(const PlyElement& e, const uint8_t* p, const uint8_t* end, bool swap, std::vector<unsigned int>& indices, size_t& consumed) {
+    if(e.props.size() != 1 || !e.props[0].list || e.count == 0) return false;
+    const PlyProperty& prop = e.props[0];
+    size_t cs = plySize(prop.countType), is = plySize(prop.type);
+    if(p + cs > end) return false;
+    double n = readPlyValue(p, prop.countType, swap);
+    if(n < 3 || n > 64) return false;
+    size_t corners = (size_t)n;
+    size_t stride = cs + corners * is;
+    if((size_t)(end - p) / stride < e.count) return false;
+    std::atomic<bool> uniform{true};
+    ThreadPool& pool = ThreadPool::instance();
+    pool.parallelFor(e.count, 1 << 16, [&](size_t b, size_t f){
+        for(size_t i = b; i < f && uniform; ++i) if(readPlyValue(p + i * stride, prop.countType, swap) != n) uniform = false;
+    });
+    if(!uniform) return false;
+    size_t perFace = (corners - 2) * 3;
+    size_t start = indices.size();
+    indices.resize(start + e.count * perFace);
+    pool.parallelFor(e.count, 1 << 15, [&](size_t b, size_t f){
+        for(size_t i = b; i < f; ++i) {
+            const uint8_t* rec = p + i * stride + cs;
+            unsigned int* out = &indices[start + i * perFace];
+            uint32_t first = toIndex(readPlyValue(rec, prop.type, swap));
+            uint32_t prev = toIndex(readPlyValue(rec + is, prop.type, swap));
+            for(size_t k = 2; k < corners; ++k) {
+                uint32_t cur = toIndex(readPlyValue(rec + k * is, prop.type, swap));
+                out[0] = first; out[1] = prev; out[2] = cur;
+                out += 3;
+                prev = cur;
+            }
+        }
+    });
+    consumed = stride * e.count;
+    return true;
+}
+
+static bool loadPlyBinary(const uint8_t* data, size_t size, size_t offset, bool swap, const std::vector<PlyElement>& elements, Mesh& mesh, std::string& err) {
+    const uint8_t* p = data + offset;
+    const uint8_t* end = data + size;
+    ThreadPool& pool = ThreadPool::instance();
+    for(const PlyElement& e : elements) {
+        bool hasList = std::any_of(e.props.begin(), e.props.end(), [](const PlyProperty& pr){ return pr.list; });
+        if(!hasList) {
+            size_t stride = 0;
+            std::vector<size_t> offsets;
+            for(const PlyProperty& pr : e.props) { offsets.push_back(stride); stride += plySize(pr.type); }
+            if(stride == 0 || (size_t)(end - p) / stride < e.count) { err = "PLY file is truncated"; return false; }
+            int f[3];
+            if(e.name == "vertex") {
+                if(!vertexFields(e, f)) { err = "PLY vertices have no x, y, z"; return false; }
+                mesh.positions.resize(e.count * 3);
+                pool.parallelFor(e.count, 1 << 15, [&](size_t b, size_t n){
+                    for(size_t i = b; i < n; ++i) {
+                        const uint8_t* rec = p + i * stride;
+                        for(int k = 0; k < 3; ++k) mesh.positions[i * 3 + k] = (float)readPlyValue(rec + offsets[f[k]], e.props[f[k]].type, swap);
+                    }
+                });
+            }
+            p += stride * e.count;
+            continue;
+        }
+        size_t consumed = 0;
+        if(e.name == "face" && readFixedFaces(e, p, end, swap, mesh.indices, consumed)) { p += consumed; continue; }
+        // variable-size records: walk them in order
+        bool face = e.name == "face";
+        std::vector<uint32_t> poly;
+        for(size_t r = 0; r < e.count; ++r) {
+            for(const PlyProperty& pr : e.props) {
+                if(!pr.list) {
+                    if(p + plySize(pr.type) > end) { err = "PLY file is truncated"; return false; }
+                    p += plySize(pr.type);
+                    continue;
+                }
+                if(p + plySize(pr.countType) > end) { err = "PLY file is truncated"; return false; }
+                size_t n = 0;
+                if(!listCount(readPlyValue(p, pr.countType, swap), pr.countType, n)) { err = "bad PLY list count"; return false; }
+                p += plySize(pr.countType);
+                if((size_t)(end - p) / plySize(pr.type) < n) { err = "PLY file is truncated"; return false; }
+                if(face && isIndexList(pr)) {
+                    poly.clear();
+                    for(size_t k = 0; k < n; ++k) poly.push_back(toIndex(readPlyValue(p + k * plySize(pr.type), pr.type, swap)));
+                    for(size_t k = 2; k < n; ++k) mesh.indices.insert(mesh.indices.end(), { poly[0], poly[k - 1], poly[k] });
+                }
+                p += n * plySize(pr.type);
+            }
+        }
+    }
+    return true;
+}
+
+// One ASCII face record: walks the properties and calls fn(corner indices) for the index list.
+// False when a list count is invalid.
+template<typename Fn>
+static bool parseFaceLine(const char* q, const char* le, const PlyElement& e, std::vector<uint32_t>& poly, Fn&& fn) {
+    for(const PlyProperty& pr : e.props) {
+        if(!q) return true;
+        if(!pr.list) { q = skipToken(skipBlank(q, le), le); continue; }
+        double v = 0;
+        q = parseNumber(q, le, v);
+        if(!q) return true;
+        size_t n = 0;
+        if(!listCount(v, pr.countType, n)) return false;
+        if(!isIndexList(pr)) { for(size_t k = 0; k < n && q; ++k) q = skipToken(skipBlank(q, le), le); continue; }
+        poly.clear();
+        // a line shorter than its count ends with one invalid corner, which drops the last triangle
+        for(size_t k = 0; k < n; ++k) {
+            double c = -1;
+            q = parseNumber(q, le, c);
+            poly.push_back(q ? toIndex(c) : kInvalid);
+            if(!q) break;
+        }
+        fn(poly);
+        return true;
+    }
+    return true;
+}
+
+static bool loadPlyAscii(const char* data, size_t size, size_t offset, const std::vector<PlyElement>& elements, Mesh& mesh, std::string& err) {
+    ThreadPool& pool = ThreadPool::instance();
+    std::vector<Chunk> chunks = splitLines(data + offset, size - offset);
+    // line number of every chunk's first line, then which element each line belongs to
+    std::vector<size_t> firstLine(chunks.size() + 1, 0);
+    pool.parallelFor(chunks.size(), 1, [&](size_t b, size_t e){
+        for(size_t i = b; i < e; ++i) {
+            size_t lines = 0;
+            for(const char* p = chunks[i].begin; p < chunks[i].end; p = nextLine(lineEnd(p, chunks[i].end), chunks[i].end)) lines++;
+            firstLine[i + 1] = lines;
+        }
+    });
+    for(size_t i = 0; i < chunks.size(); ++i) firstLine[i + 1] += firstLine[i];
+
+    const PlyElement* vertexElem = nullptr;
+    const PlyElement* faceElem = nullptr;
+    size_t vertexStart = 0, faceStart = 0, line = 0;
+    for(const PlyElement& e : elements) {
+        if(e.name == "vertex") { vertexElem = &e; vertexStart = line; }
+        if(e.name == "face") { faceElem = &e; faceStart = line; }
+        line += e.count;
+    }
+    if(!vertexElem) { err = "PLY file has no vertices"; return false; }
+    int f[3];
+    if(!vertexFields(*vertexElem, f)) { err = "PLY vertices have no x, y, z"; return false; }
+    if(firstLine.back() < line) { err = "PLY file is truncated"; return false; }
+    auto inFaces = [&](size_t l){ return faceElem && l >= faceStart && l < faceStart + faceElem->count; };
+
+    // pass 1: triangles per chunk
+    std::vector<size_t> triBase(chunks.size() + 1, 0);
+    std::atomic<bool> badCount{false};
+    if(faceElem) {
+        pool.parallelFor(chunks.size(), 1, [&](size_t b, size_t e){
+            std::vector<uint32_t> poly;
+            for(size_t i = b; i < e; ++i) {
+                size_t l = firstLine[i], tris = 0;
+                for(const char* p = chunks[i].begin; p < chunks[i].end; ++l) {
+                    const char* le = lineEnd(p, chunks[i].end);
+                    if(inFaces(l) && !parseFaceLine(p, le, *faceElem, poly, [&](const std::vector<uint32_t>& c){ if(c.size() >= 3) tris += c.size() - 2; })) badCount = true;
+                    p = nextLine(le, chunks[i].end);
+                }
+                triBase[i + 1] = tris;
+            }
+        });
+    }
+    if(badCount) { err = "bad PLY list count"; return false; }
+    for(size_t i = 0; i < chunks.size(); ++i) triBase[i + 1] += triBase[i];
+
+    // pass 2: parse in place
+    mesh.positions.assign(vertexElem->count * 3, 0.0f);
+    mesh.indices.resize(triBase.back() * 3);
+    pool.parallelFor(chunks.size(), 1, [&](size_t b, size_t e){
+        std::vector<uint32_t> poly;
+        std::vector<double> values(vertexElem->props.size());
+        for(size_t i = b; i < e; ++i) {
+            size_t l = firstLine[i];
+            unsigned int* tri = mesh.indices.data() + triBase[i] * 3;
+            for(const char* p = chunks[i].begin; p < chunks[i].end; ++l) {
+                const char* le = lineEnd(p, chunks[i].end);
+                if(l >= vertexStart && l < vertexStart + vertexElem->count) {
+                    const char* q = p;
+                    for(size_t k = 0; k < vertexElem->props.size() && q; ++k) {
+                        const PlyProperty& pr = vertexElem->props[k];
+                        if(!pr.list) { values[k] = 0.0; q = parseNumber(q, le, values[k]); continue; }
+                        double v = 0;
+                        size_t n = 0;
+                        q = parseNumber(q, le, v);
+                        if(q && !listCount(v, pr.countType, n)) { badCount = true; q = nullptr; }
+                        for(size_t s = 0; s < n && q; ++s) q = skipToken(skipBlank(q, le), le);
+                    }
+                    float* pos = &mesh.positions[(l - vertexStart) * 3];
+                    for(int k = 0; k < 3; ++k) pos[k] = (float)values[f[k]];
+                } else if(inFaces(l)) {
+                    parseFaceLine(p, le, *faceElem, poly, [&](const std::vector<uint32_t>& c){
+                        for(size_t k = 2; k < c.size(); ++k) { tri[0] = c[0]; tri[1] = c[k - 1]; tri[2] = c[k]; tri += 3; }
+                    });
+                }
+                p = nextLine(le, chunks[i].end);
+            }
+        }
+    });
+    if(badCount) { err = "bad PLY list count"; return false; }
+    return true;
+}
+
+static bool loadPly(const MappedFile& file, Mesh& mesh, std::string& err) {
+    PlyHeader h;
+    if(!readPlyHeader((const char*)file.data(), file.size(), h, err)) return false;
+    bool ok = h.format == PlyFormat::Ascii
+        ? loadPlyAscii((const char*)file.data(), file.size(), h.bodyOffset, h.elements, mesh, err)
+        // little-endian hosts: big-endian files are byte-swapped value by value
+        : loadPlyBinary(file.data(), file.size(), h.bodyOffset, h.format == PlyFormat::BinaryBE, h.elements, mesh, err);
+    if(!ok) return false;
+    if(mesh.indices.empty()) { err = "PLY file has no faces"; return false; }
+    // faces may come before the vertices, so indices are checked once everything is read
+    size_t vertices = mesh.positions.size() / 3;
+    std::atomic<bool> invalid{false};
+    ThreadPool::instance().parallelFor(mesh.indices.size(), 1 << 18, [&](size_t b, size_t e){
+        bool bad = false;
+        for(size_t i = b; i < e; ++i) if(mesh.indices[i] >= vertices) { mesh.indices[i] = kInvalid; bad = true; }
+        if(bad) invalid = true;
+    });
+    if(invalid) dropInvalid(mesh.indices);
+    return !mesh.indices.empty();
+}
+
+bool load(const std::string& path, std::vector<Mesh>& meshes, std::string& err) {
+    meshes.clear();
+    MappedFile file;
+    if(!file.open(path)) { err = "cannot open file"; return false; }
+    std::string ext = std::filesystem::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    if(ext == ".obj") return loadObj(file, meshes, err);
+    Mesh mesh;
+    mesh.name = std::filesystem::path(path).stem().string();
+    bool ok = ext == ".stl" ? loadStl(file, mesh, err) : ext == ".ply" ? loadPly(file, mesh, err) : false;
+    if(!ok) {
+        if(err.empty()) err = "unsupported format";
+        return false;
+    }
+    meshes.push_back(std::move(mesh));
+    return true;
+}
+
+} // namespace MeshParsers
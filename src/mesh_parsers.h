@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+// Native readers for large scan formats: Wavefront OBJ, STL (binary and ASCII) and PLY (ASCII,
+// binary little and big endian). They are much faster and leaner than Assimp on multi-GB files.
+//
+// The file is memory-mapped. Text is split into line-aligned chunks that are parsed in parallel
+// (std::from_chars) in two passes: the first counts vertices and triangles per chunk, the second
+// parses straight into the final position and index arrays at the chunk's offsets, so nothing is
+// parsed into temporary storage and concatenated afterwards. Binary records are decoded from the
+// mapping in parallel. Polygons are fan-triangulated; only positions are read (normals, texture
+// coordinates and colors are ignored, as in the rest of the import pipeline).
+namespace MeshParsers {
+    struct Mesh {
+        std::string name;
+        std::vector<float> positions;     // xyz
+        std::vector<unsigned int> indices; // triangle list
+    };
+
+    // True for the extensions read here (".obj", ".stl", ".ply"; lower case)
+    bool handles(const std::string& lowerExtension);
+
+    // OBJ files give one mesh per object/group ('o'/'g') with faces; STL and PLY give one mesh.
+    // Faces referring to missing vertices are dropped. Returns false and sets 'err' on unreadable files.
+    bool load(const std::string& path, std::vector<Mesh>& meshes, std::string& err);
+
+    // PLY header, also used by the point-cloud importer for vertex-only files
+    enum PlyType : uint8_t { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64, PlyInvalid };
+    enum class PlyFormat { Ascii, BinaryLE, BinaryBE };
+
+    struct PlyProperty {
+        std::string name;
+        PlyType type = PlyInvalid;
+        PlyType countType = PlyInvalid; // list properties
+        bool list = false;
+    };
+
+    struct PlyElement {
+        std::string name;
+        size_t count = 0;
+        std::vector<PlyProperty> props;
+    };
+
+    struct PlyHeader {
+        PlyFormat format = PlyFormat::Ascii;
+        std::vector<PlyElement> elements;
+        size_t bodyOffset = 0; // first byte after "end_header\n"
+    };
+
+    bool readPlyHeader(const char* data, size_t size, PlyHeader& header, std::string& err);
+
+    inline size_t plySize(PlyType t) {
+        static const size_t kSizes[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+        return kSizes[t];
+    }
+
+    // One binary value of any PLY type; 'swap' for big-endian files on little-endian hosts
+    inline double readPlyValue(const uint8_t* p, PlyType t, bool swap) {
+        uint8_t b[8];
+        size_t n = plySize(t);
+        if(swap) for(size_t i = 0; i < n; ++i) b[i] = p[n - 1 - i];
+        else memcpy(b, p, n);
+        switch(t) {
+            case Int8: return (double)(int8_t)b[0];
+            case UInt8: return (double)b[0];
+            case Int16: { int16_t v; memcpy(&v, b, 2); return v; }
+            case UInt16: { uint16_t v; memcpy(&v, b, 2); return v; }
+            case Int32: { int32_t v; memcpy(&v, b, 4); return v; }
+            case UInt32: { uint32_t v; memcpy(&v, b, 4); return v; }
+            case Float32: { float v; memcpy(&v, b, 4); return v; }
+            default: { double v; memcpy(&v, b, 8); return v; }
+        }
+    }
+}
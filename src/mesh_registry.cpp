@@ -0,0 +1,102 @@
+#include "mesh_registry.h"
+#include "primitive_factory.h"
+#include "xxhash.h"
+#include <unordered_map>
+#include <mutex>
+#include <algorithm>
+
+namespace MeshRegistry {
+
+// What a registered mesh looked like when it was interned. Collisions are checked against this rather
+// than the live mesh, whose streams the GL thread releases and replaces (MeshStreamer) without s_mtx.
+struct Entry {
+    std::weak_ptr<primitives::MeshGL> mesh;
+    uint64_t checkHash = 0; // second hash of the streams, independent of the key
+    size_t vertexBytes = 0;
+    size_t indexBytes = 0;
+    int indexCount = 0;
+    GLenum indexType = 0;
+    bool quantizedPositions = false;
+};
+
+static std::mutex s_mtx;
+static std::unordered_map<uint64_t, Entry> s_meshes;
+static size_t s_sweepAt = 256;
+static Stats s_stats;
+
+uint64_t contentKey(const primitives::MeshGL& m) {
+    // format fields first: the same bytes decode differently as quantized or float positions
+    uint64_t header[3] = { (uint64_t)m.quantizedPositions, (uint64_t)m.indexType, (uint64_t)m.pending.vertexBytes };
+    uint64_t h = XXHash::hash64(header, sizeof(header));
+    h = XXHash::hash64(m.pending.vertices, m.pending.vertexBytes, h);
+    return XXHash::hash64(m.pending.indices, m.pending.indexBytes, h);
+}
+
+// Seed of the check hash; any value other than the key's seed (0) makes the two hashes independent
+static const uint64_t kCheckSeed = 0x9E3779B97F4A7C15ull;
+
+static Entry describe(const primitives::MeshGL& m) {
+    Entry e;
+    e.checkHash = XXHash::hash64(m.pending.indices, m.pending.indexBytes, XXHash::hash64(m.pending.vertices, m.pending.vertexBytes, kCheckSeed));
+    e.vertexBytes = m.pending.vertexBytes;
+    e.indexBytes = m.pending.indexBytes;
+    e.indexCount = m.indexCount;
+    e.indexType = m.indexType;
+    e.quantizedPositions = m.quantizedPositions;
+    return e;
+}
+
+// A 64-bit key collision is unlikely but not impossible: the sizes, formats and a second 64-bit hash
+// must match as well
+static bool identical(const Entry& a, const Entry& b) {
+    return a.checkHash == b.checkHash && a.vertexBytes == b.vertexBytes && a.indexBytes == b.indexBytes &&
+           a.indexCount == b.indexCount && a.indexType == b.indexType && a.quantizedPositions == b.quantizedPositions;
+}
+
+static size_t meshBytes(const primitives::MeshGL& m) {
+    return m.pending.bytes() + m.cpuPositions.size() * sizeof(glm::vec3) + m.cpuIndices.size() * sizeof(unsigned int) +
+           m.bvhNodes.size() * sizeof(primitives::MeshGL::BVHNode);
+}
+
+// Drop entries whose meshes are gone; amortized by doubling the threshold
+static void sweep() {
+    for(auto it = s_meshes.begin(); it != s_meshes.end();) {
+        if(it->second.mesh.expired()) it = s_meshes.erase(it);
+        else ++it;
+    }
+    s_sweepAt = std::max<size_t>(256, s_meshes.size() * 2);
+}
+
+std::shared_ptr<primitives::MeshGL> intern(std::unique_ptr<primitives::MeshGL> mesh) {
+    if(!mesh) return nullptr;
+    // hashed outside the lock
+    uint64_t key = contentKey(*mesh);
+    Entry entry = describe(*mesh);
+    std::lock_guard<std::mutex> lk(s_mtx);
+    auto it = s_meshes.find(key);
+    if(it != s_meshes.end()) {
+        std::shared_ptr<primitives::MeshGL> existing = it->second.mesh.lock();
+        if(existing && identical(it->second, entry)) {
+            s_stats.duplicates++;
+            s_stats.bytesSaved += meshBytes(*mesh);
+            return existing;
+        }
+        // collision with a live mesh: keep the new one unshared
+        if(existing) return std::shared_ptr<primitives::MeshGL>(std::move(mesh));
+    }
+    std::shared_ptr<primitives::MeshGL> shared(std::move(mesh));
+    entry.mesh = shared;
+    s_meshes[key] = std::move(entry);
+    if(s_meshes.size() >= s_sweepAt) sweep();
+    return shared;
+}
+
+Stats stats() {
+    std::lock_guard<std::mutex> lk(s_mtx);
+    Stats s = s_stats;
+    s.liveMeshes = 0;
+    for(const auto& e : s_meshes) if(!e.second.mesh.expired()) s.liveMeshes++;
+    return s;
+}
+
+} // namespace MeshRegistry
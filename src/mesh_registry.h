@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace primitives { struct MeshGL; }
+
+// Process-wide registry of imported meshes keyed by a content hash (XXH64) of their GPU vertex and
+// index streams. Imports intern every built or cache-loaded mesh before it is uploaded, so meshes
+// that are bit-identical within a file or across files share one set of GPU buffers and one BVH.
+// Entries are weak: a mesh leaves the registry when the last entity using it is gone.
+// Thread-safe.
+namespace MeshRegistry {
+    // Content key of a mesh whose pending GPU data is still present (see MeshGL::PendingData)
+    uint64_t contentKey(const primitives::MeshGL& mesh);
+
+    // Return the registered mesh identical to 'mesh' (which is then dropped), or register and return
+    // 'mesh' itself. The result needs uploadStreamed() unless another import already uploaded it.
+    std::shared_ptr<primitives::MeshGL> intern(std::unique_ptr<primitives::MeshGL> mesh);
+
+    struct Stats {
+        size_t liveMeshes = 0;   // registered meshes still in use
+        size_t duplicates = 0;   // interned meshes resolved to an existing one
+        size_t bytesSaved = 0;   // GPU + picking/BVH memory of those duplicates
+    };
+    Stats stats();
+}
@@ -0,0 +1,282 @@
+#include "mesh_streamer.h"
+#include "frustum.h"
+#include "primitive_factory.h"
+#include "scene.h"
+#include "thread_pool.h"
+#include "log.h"
+#include <GLFW/glfw3.h>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+bool g_meshStreaming = true;
+int g_meshStreamGpuMB = 2048;
+int g_meshStreamRamMB = 2048;
+float g_meshStreamMinPixels = 2.0f;
+
+namespace {
+
+// Mesh reads queued on the thread pool at once
+static const size_t kMaxLoadsInFlight = 32;
+// Payload bytes handed to UploadQueue per pump(); the queue paces the copies itself, this bounds the
+// staging of one frame's worth of finished reads
+static const size_t kFrameApplyBytes = 32u << 20;
+
+struct Entry {
+    std::weak_ptr<primitives::MeshGL> mesh;
+    std::string asset;
+    MeshCache::SourceKey key;
+    uint32_t sourceIndex = 0;
+    // unique per track(): the key is the mesh's address, which a new mesh can reuse once the old one is freed
+    uint64_t generation = 0;
+    uint64_t lastWantedFrame = 0;
+    bool loading = false;
+    bool failed = false; // the cache no longer matches; never retried
+};
+
+struct LoadedMesh {
+    const primitives::MeshGL* id = nullptr;
+    uint64_t generation = 0; // of the entry the read was issued for
+    std::unique_ptr<primitives::MeshGL> mesh; // null when the read failed
+};
+
+struct Candidate {
+    float coverage;
+    primitives::MeshGL* mesh;
+    Entry* entry;
+};
+
+static std::mutex s_mtx; // guards s_entries and s_loaded
+static std::unordered_map<const primitives::MeshGL*, Entry> s_entries;
+static std::deque<LoadedMesh> s_loaded;
+static std::atomic<size_t> s_inFlight{0};
+// paged in and waiting for UploadQueue (GL thread)
+static std::vector<std::weak_ptr<primitives::MeshGL>> s_uploading;
+static uint64_t s_frame = 0;
+static uint64_t s_generation = 0;
+static unsigned int s_revision = 0;
+// residency changed since the last budget check
+static bool s_dirty = false;
+static MeshStreamer::Stats s_stats;
+
+static size_t gpuSize(const primitives::MeshGL& m) { return m.pagedOut ? m.pagedGpuBytes : m.gpuBytes; }
+static size_t cpuSize(const primitives::MeshGL& m) { return m.pagedOut ? m.pagedCpuBytes : m.cpuBytes(); }
+
+// Caller holds s_mtx
+static void requestLoad(Entry& e, const primitives::MeshGL* id) {
+    e.loading = true;
+    s_inFlight++;
+    ThreadPool::instance().submit([asset = e.asset, key = e.key, index = e.sourceIndex, generation = e.generation, id]{
+        LoadedMesh l;
+        l.id = id;
+        l.generation = generation;
+        MeshCache::loadMesh(asset, key, index, l.mesh);
+        {
+            std::lock_guard<std::mutex> lk(s_mtx);
+            s_loaded.push_back(std::move(l));
+        }
+        s_inFlight--;
+        glfwPostEmptyEvent();
+    });
+}
+
+// Release the least recently wanted meshes while a budget is exceeded; meshes wanted by the last
+// update() are kept. Drops the entries of meshes that are gone. Caller holds s_mtx.
+static void enforceBudgets() {
+    struct Victim { uint64_t frame; primitives::MeshGL* mesh; };
+    std::vector<Victim> victims;
+    // keeps the victims alive while they are released
+    std::vector<std::shared_ptr<primitives::MeshGL>> alive;
+    size_t gpu = 0, cpu = 0, resident = 0;
+    for(auto it = s_entries.begin(); it != s_entries.end();) {
+        std::shared_ptr<primitives::MeshGL> m = it->second.mesh.lock();
+        if(!m) { it = s_entries.erase(it); continue; }
+        if(!m->pagedOut) {
+            gpu += m->gpuBytes;
+            cpu += m->cpuBytes();
+            resident++;
+            if(!m->uploadPending && it->second.lastWantedFrame < s_frame) {
+                victims.push_back({ it->second.lastWantedFrame, m.get() });
+                alive.push_back(std::move(m));
+            }
+        }
+        ++it;
+    }
+    size_t gpuBudget = (size_t)std::max(g_meshStreamGpuMB, 0) << 20;
+    size_t cpuBudget = (size_t)std::max(g_meshStreamRamMB, 0) << 20;
+    if(g_meshStreaming && (gpu > gpuBudget || cpu > cpuBudget)) {
+        std::sort(victims.begin(), victims.end(), [](const Victim& a, const Victim& b){ return a.frame < b.frame; });
+        size_t released = 0;
+        for(const Victim& v : victims) {
+            if(gpu <= gpuBudget && cpu <= cpuBudget) break;
+            gpu -= v.mesh->gpuBytes;
+            cpu -= v.mesh->cpuBytes();
+            v.mesh->release();
+            resident--;
+            released++;
+        }
+        if(released) {
+            s_stats.pagedOut += released;
+            s_revision++;
+        }
+    }
+    s_stats.trackedMeshes = s_entries.size();
+    s_stats.residentMeshes = resident;
+    s_stats.gpuBytes = gpu;
+    s_stats.cpuBytes = cpu;
+}
+
+} // namespace
+
+namespace MeshStreamer {
+
+void track(const std::string& assetPath, const MeshCache::SourceKey& key, const std::vector<std::shared_ptr<primitives::MeshGL>>& meshes) {
+    std::lock_guard<std::mutex> lk(s_mtx);
+    for(size_t i = 0; i < meshes.size(); ++i) {
+        const auto& m = meshes[i];
+        if(!m) continue;
+        // a mesh shared through MeshRegistry stays with the asset that registered it first
+        auto it = s_entries.find(m.get());
+        if(it != s_entries.end() && it->second.mesh.lock() == m) continue;
+        Entry& e = s_entries[m.get()];
+        e = Entry();
+        e.mesh = m;
+        e.asset = assetPath;
+        e.key = key;
+        e.sourceIndex = (uint32_t)i;
+        e.generation = ++s_generation;
+    }
+    s_dirty = true;
+}
+
+void update(const Scene& scene, const glm::mat4& view, const glm::mat4& proj, int viewportHeight) {
+    std::lock_guard<std::mutex> lk(s_mtx);
+    if(s_entries.empty()) return;
+    s_frame++;
+
+    Frustum frustum(proj * view);
+    glm::vec3 camera = glm::vec3(glm::inverse(view)[3]);
+    float pixelsPerUnit = proj[1][1] * (float)viewportHeight * 0.5f;
+
+    // largest coverage over the entities instancing each mesh
+    std::vector<Candidate> candidates;
+    std::unordered_map<const primitives::MeshGL*, size_t> slot;
+    for(const SceneEntity& ent : scene.entities()) {
+        if(!ent.mesh) continue;
+        auto it = s_entries.find(ent.mesh.get());
+        if(it == s_entries.end() || it->second.failed || it->second.mesh.expired()) continue;
+        const primitives::MeshGL& m = *ent.mesh;
+        glm::vec3 center = glm::vec3(ent.world * glm::vec4((m.aabbMin + m.aabbMax) * 0.5f, 1.0f));
+        float scale = std::max(glm::length(glm::vec3(ent.world[0])), std::max(glm::length(glm::vec3(ent.world[1])), glm::length(glm::vec3(ent.world[2]))));
+        float radius = glm::length(m.aabbMax - m.aabbMin) * 0.5f * scale;
+        if(!frustum.intersects(center, radius)) continue;
+        float dist = glm::length(center - camera);
+        float coverage = dist > radius ? radius * pixelsPerUnit / dist : FLT_MAX;
+        if(g_meshStreaming && coverage < g_meshStreamMinPixels) continue;
+        auto s = slot.find(ent.mesh.get());
+        if(s == slot.end()) {
+            slot.emplace(ent.mesh.get(), candidates.size());
+            candidates.push_back({ coverage, ent.mesh.get(), &it->second });
+        } else {
+            candidates[s->second].coverage = std::max(candidates[s->second].coverage, coverage);
+        }
+    }
+    // without streaming every mesh is wanted, so imports opened with their coarse levels refine to full
+    // detail everywhere; the meshes out of view come after the visible ones
+    std::vector<std::shared_ptr<primitives::MeshGL>> alive;
+    if(!g_meshStreaming) {
+        for(auto& kv : s_entries) {
+            if(kv.second.failed || slot.count(kv.first)) continue;
+            std::shared_ptr<primitives::MeshGL> m = kv.second.mesh.lock();
+            if(!m) continue;
+            candidates.push_back({ -1.0f, m.get(), &kv.second });
+            alive.push_back(std::move(m));
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b){ return a.coverage > b.coverage; });
+
+    size_t gpuBudget = (size_t)std::max(g_meshStreamGpuMB, 0) << 20;
+    size_t cpuBudget = (size_t)std::max(g_meshStreamRamMB, 0) << 20;
+    size_t gpu = 0, cpu = 0, wanted = 0;
+    for(const Candidate& c : candidates) {
+        size_t g = gpuSize(*c.mesh), p = cpuSize(*c.mesh);
+        if(g_meshStreaming && wanted > 0 && (gpu + g > gpuBudget || cpu + p > cpuBudget)) break;
+        gpu += g;
+        cpu += p;
+        wanted++;
+        c.entry->lastWantedFrame = s_frame;
+        if(c.mesh->pagedOut && !c.entry->loading && s_inFlight < kMaxLoadsInFlight) requestLoad(*c.entry, c.mesh);
+    }
+    s_stats.wantedMeshes = wanted;
+    s_dirty = true;
+}
+
+bool pump() {
+    std::lock_guard<std::mutex> lk(s_mtx);
+    size_t bytes = 0;
+    while(!s_loaded.empty() && bytes < kFrameApplyBytes) {
+        LoadedMesh l = std::move(s_loaded.front());
+        s_loaded.pop_front();
+        auto it = s_entries.find(l.id);
+        // read for a mesh that was freed, its address now taken by another
+        if(it == s_entries.end() || it->second.generation != l.generation) continue;
+        Entry& e = it->second;
+        e.loading = false;
+        std::shared_ptr<primitives::MeshGL> m = e.mesh.lock();
+        if(!m || !m->pagedOut) continue;
+        if(!l.mesh) {
+            e.failed = true;
+            LOG_WARN("Mesh " << e.sourceIndex << " of " << e.asset << " could not be paged in (mesh cache out of date)");
+            continue;
+        }
+        // the view moved on while it was read
+        if(e.lastWantedFrame < s_frame) continue;
+        bytes += l.mesh->pending.bytes();
+        // the coarse level stays: it is drawn until the upload is done, and again if the mesh is released
+        std::unique_ptr<primitives::MeshGL> coarse = std::move(m->coarse);
+        *m = std::move(*l.mesh);
+        m->coarse = std::move(coarse);
+        m->uploadStreamed();
+        s_uploading.push_back(m);
+        s_stats.pagedIn++;
+        s_dirty = true;
+    }
+    // paged-in meshes become drawable when UploadQueue retires their copies
+    size_t before = s_uploading.size();
+    s_uploading.erase(std::remove_if(s_uploading.begin(), s_uploading.end(), [](const std::weak_ptr<primitives::MeshGL>& w){
+        auto m = w.lock();
+        return !m || !m->uploadPending;
+    }), s_uploading.end());
+    if(s_uploading.size() != before) s_revision++;
+
+    if(s_dirty) {
+        enforceBudgets();
+        s_dirty = false;
+    }
+    return s_inFlight > 0 || !s_loaded.empty() || !s_uploading.empty();
+}
+
+unsigned int revision() { return s_revision; }
+
+Stats stats() {
+    std::lock_guard<std::mutex> lk(s_mtx);
+    Stats st = s_stats;
+    st.loadsInFlight = s_inFlight;
+    return st;
+}
+
+void destroy() {
+    while(s_inFlight > 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    std::lock_guard<std::mutex> lk(s_mtx);
+    s_loaded.clear();
+    s_uploading.clear();
+    s_entries.clear();
+}
+
+} // namespace MeshStreamer
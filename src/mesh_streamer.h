@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <glm/glm.hpp>
+#include "mesh_cache.h"
+
+class Scene;
+namespace primitives { struct MeshGL; }
+
+// Page imported meshes in and out by view (only meshes stored in a mesh cache can be paged)
+extern bool g_meshStreaming;
+// Budgets for the payloads of streamed meshes (MB): GPU buffers, and picking copies + BVH in RAM
+extern int g_meshStreamGpuMB;
+extern int g_meshStreamRamMB;
+// Meshes whose bounds cover fewer pixels than this are not paged in
+extern float g_meshStreamMinPixels;
+
+// Out-of-core residency for imported meshes. Entities keep their shared MeshGL, which always holds its
+// bounds and draw parameters; the payload is read back from the asset's mesh cache (MeshCache::loadMesh)
+// when the mesh is in view and released (MeshGL::release) when it has not been in view recently and a
+// budget is exceeded. Imports from the mesh cache create paged-out shells that draw their coarse level
+// (MeshGL::coarse) until paged in, so even very large assets are on screen and interactive at once. With
+// streaming on, a scene larger than memory opens without ever loading the meshes out of view; with it
+// off every mesh is paged in, visible ones first, and none is released.
+//
+// update() ranks the meshes in the view frustum by screen coverage (bounding sphere radius in pixels, which
+// folds in the camera distance); the largest are wanted until the budgets are spent. Wanted meshes that are
+// paged out are read on the thread pool, largest first, and handed to UploadQueue by pump(). The least
+// recently wanted meshes are released while either budget is exceeded.
+//
+// track() is thread-safe; everything else must be called on the GL thread.
+namespace MeshStreamer {
+    // Make the meshes of an asset pageable; 'meshes' is indexed by source mesh as in the asset's mesh cache
+    void track(const std::string& assetPath, const MeshCache::SourceKey& key, const std::vector<std::shared_ptr<primitives::MeshGL>>& meshes);
+
+    // Rank the scene's meshes for this view and queue loads for the wanted ones that are paged out
+    void update(const Scene& scene, const glm::mat4& view, const glm::mat4& proj, int viewportHeight);
+
+    // Hand finished loads to UploadQueue and release meshes over budget. Call once per frame.
+    // Returns true while loads or their uploads are in flight.
+    bool pump();
+
+    // Bumped when paged-in meshes become drawable or meshes are released
+    unsigned int revision();
+
+    struct Stats {
+        size_t trackedMeshes = 0;
+        size_t residentMeshes = 0;
+        size_t wantedMeshes = 0;   // by the last update()
+        size_t gpuBytes = 0;       // payloads of resident tracked meshes
+        size_t cpuBytes = 0;
+        size_t loadsInFlight = 0;
+        size_t pagedIn = 0;        // totals since startup
+        size_t pagedOut = 0;
+    };
+    Stats stats();
+
+    // Wait for queued loads and forget every tracked mesh
+    void destroy();
+}
@@ -0,0 +1,394 @@
+#include "meshopt_decoder.h"
+#include <cstring>
+#include <cmath>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NOVA_MESHOPT_SSE2 1
+#endif
+
+namespace {
+
+// ---- Vertex codec ----
+
+static const uint8_t kVertexHeader = 0xa0;
+static const size_t kVertexBlockSizeBytes = 8192;
+static const size_t kVertexBlockMaxSize = 256;
+static const size_t kByteGroupSize = 16;
+static const size_t kByteGroupDecodeLimit = 24; // 8 header bytes + 16 escaped bytes
+static const size_t kTailMaxSize = 32;
+
+static size_t vertexBlockSize(size_t stride) {
+    size_t n = (kVertexBlockSizeBytes / stride) & ~(kByteGroupSize - 1);
+    return n < kVertexBlockMaxSize ? n : kVertexBlockMaxSize;
+}
+
+// One group of 16 bytes stored with 0, 2, 4 or 8 bits each. In the 2- and 4-bit forms the all-ones
+// value escapes to a full byte that follows the packed bits.
+static const uint8_t* decodeBytesGroup(const uint8_t* data, uint8_t* out, int bitslog2) {
+    switch(bitslog2) {
+    case 0:
+        memset(out, 0, kByteGroupSize);
+        return data;
+    case 1: {
+        const uint8_t* escaped = data + 4;
+        for(int b = 0; b < 4; ++b) {
+            uint8_t packed = data[b];
+            for(int k = 0; k < 4; ++k) {
+                uint8_t v = packed >> 6;
+                packed <<= 2;
+                *out++ = v == 3 ? *escaped : v;
+                escaped += v == 3;
+            }
+        }
+        return escaped;
+    }
+    case 2: {
+        const uint8_t* escaped = data + 8;
+        for(int b = 0; b < 8; ++b) {
+            uint8_t packed = data[b];
+            for(int k = 0; k < 2; ++k) {
+                uint8_t v = packed >> 4;
+                packed <<= 4;
+                *out++ = v == 15 ? *escaped : v;
+                escaped += v == 15;
+            }
+        }
+        return escaped;
+    }
+    default:
+        memcpy(out, data, kByteGroupSize);
+        return data + kByteGroupSize;
+    }
+}
+
+// 'count' (multiple of 16) bytes: a 2-bit width per group, then the groups
+static const uint8_t* decodeBytes(const uint8_t* data, const uint8_t* end, uint8_t* out, size_t count) {
+    const uint8_t* header = data;
+    size_t headerSize = (count / kByteGroupSize + 3) / 4;
+    if((size_t)(end - data) < headerSize) return nullptr;
+    data += headerSize;
+    for(size_t i = 0; i < count; i += kByteGroupSize) {
+        // the stream always ends with the tail, so a full group can be read without further checks
+        if((size_t)(end - data) < kByteGroupDecodeLimit) return nullptr;
+        size_t group = i / kByteGroupSize;
+        int bitslog2 = (header[group / 4] >> ((group % 4) * 2)) & 3;
+        data = decodeBytesGroup(data, out + i, bitslog2);
+    }
+    return data;
+}
+
+// Bytes are zigzag deltas from the previous vertex; write the running values to dst[i * stride]
+static void deltaDecode(const uint8_t* deltas, size_t count, uint8_t* dst, size_t stride, uint8_t& last) {
+    size_t i = 0;
+    uint8_t p = last;
+#ifdef NOVA_MESHOPT_SSE2
+    // 16 vertices at a time: unzigzag, then an in-register prefix sum
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i low7 = _mm_set1_epi8(0x7f);
+    alignas(16) uint8_t values[16];
+    for(; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(deltas + i));
+        __m128i sign = _mm_cmpeq_epi8(_mm_and_si128(v, one), one);
+        v = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(v, 1), low7), sign);
+        v = _mm_add_epi8(v, _mm_slli_si128(v, 1));
+        v = _mm_add_epi8(v, _mm_slli_si128(v, 2));
+        v = _mm_add_epi8(v, _mm_slli_si128(v, 4));
+        v = _mm_add_epi8(v, _mm_slli_si128(v, 8));
+        v = _mm_add_epi8(v, _mm_set1_epi8((char)p));
+        _mm_store_si128((__m128i*)values, v);
+        for(int k = 0; k < 16; ++k) dst[(i + k) * stride] = values[k];
+        p = values[15];
+    }
+#endif
+    for(; i < count; ++i) {
+        uint8_t d = deltas[i];
+        p = (uint8_t)(p + ((d >> 1) ^ (uint8_t)-(d & 1)));
+        dst[i * stride] = p;
+    }
+    last = p;
+}
+
+// Vertices are split into blocks; each byte position of the vertex is stored as its own stream
+static const uint8_t* decodeVertexBlock(const uint8_t* data, const uint8_t* end, uint8_t* dst, size_t count, size_t stride, uint8_t* last) {
+    uint8_t deltas[kVertexBlockMaxSize];
+    size_t aligned = (count + kByteGroupSize - 1) & ~(kByteGroupSize - 1);
+    for(size_t k = 0; k < stride; ++k) {
+        data = decodeBytes(data, end, deltas, aligned);
+        if(!data) return nullptr;
+        deltaDecode(deltas, count, dst + k, stride, last[k]);
+    }
+    return data;
+}
+
+// ---- Index codecs ----
+
+static const uint8_t kIndexHeader = 0xe0;
+static const uint8_t kSequenceHeader = 0xd0;
+
+static uint32_t decodeVByte(const uint8_t*& data) {
+    uint8_t lead = *data++;
+    if(lead < 128) return lead;
+    uint32_t result = lead & 127;
+    uint32_t shift = 7;
+    for(int i = 0; i < 4; ++i) {
+        uint8_t group = *data++;
+        result |= (uint32_t)(group & 127) << shift;
+        shift += 7;
+        if(group < 128) break;
+    }
+    return result;
+}
+
+static uint32_t decodeIndex(const uint8_t*& data, uint32_t last) {
+    uint32_t v = decodeVByte(data);
+    return last + ((v >> 1) ^ (uint32_t)-(int32_t)(v & 1));
+}
+
+static void writeIndex(void* dst, size_t i, size_t indexSize, uint32_t v) {
+    if(indexSize == 2) ((uint16_t*)dst)[i] = (uint16_t)v;
+    else ((uint32_t*)dst)[i] = v;
+}
+
+// Recently seen vertices and edges; the encoder references them by age
+struct Fifos {
+    uint32_t vertices[16];
+    uint32_t edges[16][2];
+    size_t vertexOffset = 0;
+    size_t edgeOffset = 0;
+
+    Fifos() {
+        memset(vertices, 0xff, sizeof(vertices));
+        memset(edges, 0xff, sizeof(edges));
+    }
+    uint32_t vertex(int age) const { return vertices[(vertexOffset - age) & 15]; }
+    void pushVertex(uint32_t v, bool cond = true) {
+        vertices[vertexOffset] = v;
+        vertexOffset = (vertexOffset + (cond ? 1 : 0)) & 15;
+    }
+    void pushEdge(uint32_t a, uint32_t b) {
+        edges[edgeOffset][0] = a;
+        edges[edgeOffset][1] = b;
+        edgeOffset = (edgeOffset + 1) & 15;
+    }
+};
+
+} // anonymous
+
+namespace MeshoptDecoder {
+
+bool decodeVertexBuffer(void* dst, size_t count, size_t stride, const uint8_t* src, size_t size) {
+    if(stride == 0 || stride > 256 || stride % 4 != 0) return false;
+    if(size < 1 + stride) return false;
+    const uint8_t* data = src;
+    const uint8_t* end = src + size;
+    if((*data & 0xf0) != kVertexHeader || (*data & 0x0f) > 0) return false;
+    data++;
+
+    // the tail ends with the first vertex, which the first block's deltas start from
+    uint8_t last[256];
+    memcpy(last, end - stride, stride);
+
+    uint8_t* out = (uint8_t*)dst;
+    size_t blockSize = vertexBlockSize(stride);
+    for(size_t offset = 0; offset < count; offset += blockSize) {
+        size_t n = count - offset < blockSize ? count - offset : blockSize;
+        data = decodeVertexBlock(data, end, out + offset * stride, n, stride, last);
+        if(!data) return false;
+    }
+    size_t tailSize = stride < kTailMaxSize ? kTailMaxSize : stride;
+    return (size_t)(end - data) == tailSize;
+}
+
+bool decodeIndexBuffer(void* dst, size_t count, size_t indexSize, const uint8_t* src, size_t size) {
+    if(count % 3 != 0 || (indexSize != 2 && indexSize != 4)) return false;
+    // header, one code byte per triangle and the 16-byte codeaux table
+    if(size < 1 + count / 3 + 16) return false;
+    if((src[0] & 0xf0) != kIndexHeader) return false;
+    int version = src[0] & 0x0f;
+    if(version > 1) return false;
+
+    Fifos fifo;
+    uint32_t next = 0;
+    uint32_t last = 0;
+    // version 1 spends codes 13 and 14 on +-1 deltas from the last free index
+    int fecmax = version >= 1 ? 13 : 15;
+
+    const uint8_t* code = src + 1;
+    const uint8_t* data = code + count / 3;
+    const uint8_t* dataSafeEnd = src + size - 16;
+    const uint8_t* codeauxTable = dataSafeEnd;
+
+    for(size_t i = 0; i < count; i += 3) {
+        // a triangle reads at most 16 data bytes, which the codeaux table after dataSafeEnd covers
+        if(data > dataSafeEnd) return false;
+        uint8_t codetri = *code++;
+        uint32_t a, b, c;
+        if(codetri < 0xf0) {
+            // edge from the fifo plus one vertex
+            int fe = codetri >> 4;
+            a = fifo.edges[(fifo.edgeOffset - 1 - fe) & 15][0];
+            b = fifo.edges[(fifo.edgeOffset - 1 - fe) & 15][1];
+            int fec = codetri & 15;
+            if(fec < fecmax) {
+                c = fec == 0 ? next : fifo.vertex(1 + fec);
+                if(fec == 0) next++;
+                fifo.pushVertex(c, fec == 0);
+            } else {
+                last = c = fec != 15 ? last + (fec - (fec ^ 3)) : decodeIndex(data, last);
+                fifo.pushVertex(c);
+            }
+            fifo.pushEdge(c, b);
+            fifo.pushEdge(a, c);
+        } else {
+            int fea, feb, fec;
+            if(codetri < 0xfe) {
+                // common vertex combinations come from the table; the first vertex is always 'next'
+                uint8_t codeaux = codeauxTable[codetri & 15];
+                fea = 0;
+                feb = codeaux >> 4;
+                fec = codeaux & 15;
+            } else {
+                uint8_t codeaux = *data++;
+                fea = codetri == 0xfe ? 0 : 15;
+                feb = codeaux >> 4;
+                fec = codeaux & 15;
+                // codeaux 0 outside the table restarts the vertex numbering
+                if(codeaux == 0) next = 0;
+            }
+            a = fea == 0 ? next++ : 0;
+            b = feb == 0 ? next++ : fifo.vertex(feb);
+            c = fec == 0 ? next++ : fifo.vertex(fec);
+            if(fea == 15) last = a = decodeIndex(data, last);
+            if(feb == 15) last = b = decodeIndex(data, last);
+            if(fec == 15) last = c = decodeIndex(data, last);
+            fifo.pushVertex(a);
+            fifo.pushVertex(b, feb == 0 || feb == 15);
+            fifo.pushVertex(c, fec == 0 || fec == 15);
+            fifo.pushEdge(b, a);
+            fifo.pushEdge(c, b);
+            fifo.pushEdge(a, c);
+        }
+        writeIndex(dst, i + 0, indexSize, a);
+        writeIndex(dst, i + 1, indexSize, b);
+        writeIndex(dst, i + 2, indexSize, c);
+    }
+    // every data byte must have been used, up to the codeaux table
+    return data == dataSafeEnd;
+}
+
+bool decodeIndexSequence(void* dst, size_t count, size_t indexSize, const uint8_t* src, size_t size) {
+    if(indexSize != 2 && indexSize != 4) return false;
+    // header, at least one byte per index and a 4-byte tail
+    if(size < 1 + count + 4) return false;
+    if((src[0] & 0xf0) != kSequenceHeader || (src[0] & 0x0f) > 1) return false;
+
+    const uint8_t* data = src + 1;
+    const uint8_t* dataSafeEnd = src + size - 4;
+    // two baselines; the low bit of each value selects the one its delta applies to
+    uint32_t last[2] = { 0, 0 };
+    for(size_t i = 0; i < count; ++i) {
+        // an index reads at most 5 bytes, covered by the tail
+        if(data >= dataSafeEnd) return false;
+        uint32_t v = decodeVByte(data);
+        uint32_t baseline = v & 1;
+        v >>= 1;
+        uint32_t index = last[baseline] + ((v >> 1) ^ (uint32_t)-(int32_t)(v & 1));
+        last[baseline] = index;
+        writeIndex(dst, i, indexSize, index);
+    }
+    return data == dataSafeEnd;
+}
+
+// ---- Filters ----
+
+template<typename T>
+static void decodeOctahedral(T* data, size_t count) {
+    const float maxValue = (float)((1 << (sizeof(T) * 8 - 1)) - 1);
+    for(size_t i = 0; i < count; ++i) {
+        T* v = data + i * 4;
+        // z is stored as the octahedral "1.0" in the same bit count
+        float x = (float)v[0];
+        float y = (float)v[1];
+        float z = (float)v[2] - std::fabs(x) - std::fabs(y);
+        // unfold the lower hemisphere
+        float t = z >= 0.0f ? 0.0f : z;
+        x += x >= 0.0f ? t : -t;
+        y += y >= 0.0f ? t : -t;
+        float s = maxValue / std::sqrt(x * x + y * y + z * z);
+        v[0] = (T)(int)(x * s + (x >= 0.0f ? 0.5f : -0.5f));
+        v[1] = (T)(int)(y * s + (y >= 0.0f ? 0.5f : -0.5f));
+        v[2] = (T)(int)(z * s + (z >= 0.0f ? 0.5f : -0.5f));
+    }
+}
+
+static void decodeQuaternion(int16_t* data, size_t count) {
+    const float scale = 1.0f / std::sqrt(2.0f);
+    for(size_t i = 0; i < count; ++i) {
+        int16_t* v = data + i * 4;
+        // the fourth component holds the largest component's index (low 2 bits) and the encoding scale
+        float ss = scale / (float)(v[3] | 3);
+        float x = (float)v[0] * ss;
+        float y = (float)v[1] * ss;
+        float z = (float)v[2] * ss;
+        float ww = 1.0f - x * x - y * y - z * z;
+        float w = std::sqrt(ww >= 0.0f ? ww : 0.0f);
+        int qc = v[3] & 3;
+        int16_t xf = (int16_t)(int)(x * 32767.0f + (x >= 0.0f ? 0.5f : -0.5f));
+        int16_t yf = (int16_t)(int)(y * 32767.0f + (y >= 0.0f ? 0.5f : -0.5f));
+        int16_t zf = (int16_t)(int)(z * 32767.0f + (z >= 0.0f ? 0.5f : -0.5f));
+        int16_t wf = (int16_t)(int)(w * 32767.0f + 0.5f);
+        v[(qc + 1) & 3] = xf;
+        v[(qc + 2) & 3] = yf;
+        v[(qc + 3) & 3] = zf;
+        v[(qc + 0) & 3] = wf;
+    }
+}
+
+// Each 32-bit value is an 8-bit exponent over a 24-bit signed mantissa
+static void decodeExponential(uint32_t* data, size_t count) {
+    size_t i = 0;
+#ifdef NOVA_MESHOPT_SSE2
+    const __m128i bias = _mm_set1_epi32(127);
+    for(; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i m = _mm_srai_epi32(_mm_slli_epi32(v, 8), 8);
+        __m128i e = _mm_srai_epi32(v, 24);
+        __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(e, bias), 23));
+        __m128 f = _mm_mul_ps(scale, _mm_cvtepi32_ps(m));
+        _mm_storeu_si128((__m128i*)(data + i), _mm_castps_si128(f));
+    }
+#endif
+    for(; i < count; ++i) {
+        int32_t m = (int32_t)(data[i] << 8) >> 8;
+        int32_t e = (int32_t)data[i] >> 24;
+        // 2^e built directly in the exponent bits
+        uint32_t bits = (uint32_t)(e + 127) << 23;
+        float scale;
+        memcpy(&scale, &bits, 4);
+        float f = scale * (float)m;
+        memcpy(&data[i], &f, 4);
+    }
+}
+
+bool applyFilter(void* data, size_t count, size_t stride, Filter filter) {
+    switch(filter) {
+    case Filter::None:
+        return true;
+    case Filter::Octahedral:
+        if(stride == 4) decodeOctahedral((int8_t*)data, count);
+        else if(stride == 8) decodeOctahedral((int16_t*)data, count);
+        else return false;
+        return true;
+    case Filter::Quaternion:
+        if(stride != 8) return false;
+        decodeQuaternion((int16_t*)data, count);
+        return true;
+    case Filter::Exponential:
+        if(stride % 4 != 0) return false;
+        decodeExponential((uint32_t*)data, count * stride / 4);
+        return true;
+    }
+    return false;
+}
+
+} // namespace MeshoptDecoder
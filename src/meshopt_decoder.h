@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Decoder for the meshoptimizer bitstreams used by the glTF EXT_meshopt_compression extension
+// (vertex codec version 0, index codec versions 0-1, index sequence codec, and the three filters).
+// All functions validate the stream against the output size and return false on malformed input
+// instead of reading past 'size'.
+namespace MeshoptDecoder {
+    // ATTRIBUTES mode: 'count' elements of 'stride' bytes (stride multiple of 4, at most 256)
+    bool decodeVertexBuffer(void* dst, size_t count, size_t stride, const uint8_t* src, size_t size);
+
+    // TRIANGLES mode: 'count' indices (multiple of 3) of 'indexSize' bytes (2 or 4)
+    bool decodeIndexBuffer(void* dst, size_t count, size_t indexSize, const uint8_t* src, size_t size);
+
+    // INDICES mode: 'count' indices of 'indexSize' bytes (2 or 4)
+    bool decodeIndexSequence(void* dst, size_t count, size_t indexSize, const uint8_t* src, size_t size);
+
+    enum class Filter { None, Octahedral, Quaternion, Exponential };
+    // Undo a filter in place on decoded ATTRIBUTES data; false when the stride is invalid for the filter
+    bool applyFilter(void* data, size_t count, size_t stride, Filter filter);
+}
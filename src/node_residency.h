@@ -0,0 +1,188 @@
+#pragma once
+
+#include "frustum.h"
+#include "scene.h"
+#include "thread_pool.h"
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// GPU residency of the nodes of out-of-core assets, shared by PointCloudStreamer and ClusterMeshStreamer.
+// Node reads run on the thread pool; pump() uploads the finished ones within a per-frame byte budget,
+// releases every node of assets removed from the scene and then the least recently drawn nodes until the
+// memory budget is met. Nodes drawn in the current frame, and the first 'pinnedNodes' of each asset, are
+// kept even over budget.
+//
+// Asset (PointCloud, ClusterMesh) has nodes(), gpuNodes() (vao, loading, lastUsedFrame), releaseNode(),
+// residentBytes() and residentNodes(). Payload is a node's data copied out of the mapped container:
+// read(const Asset&, node) runs on a worker (so the copy pages the data in there rather than on the GL
+// thread), bytes() and upload(Asset&, node) on the GL thread.
+// Everything but the reads must be called on the GL thread.
+template<class Asset, class Payload>
+class NodeResidency {
+public:
+    NodeResidency(size_t pinnedNodes, size_t maxLoadsInFlight, size_t frameUploadBytes)
+        : m_pinned(pinnedNodes), m_maxLoads(maxLoadsInFlight), m_frameBytes(frameUploadBytes) {}
+
+    // Assets of the scene entities listed in 'ids', held by 'member'
+    static std::vector<const Asset*> inScene(const Scene& scene, const std::vector<int>& ids, std::shared_ptr<Asset> SceneEntity::*member) {
+        std::vector<const Asset*> assets;
+        for(int id : ids) {
+            const SceneEntity* e = scene.findById(id);
+            if(e && e->*member) assets.push_back((e->*member).get());
+        }
+        return assets;
+    }
+
+    uint64_t frame() const { return m_frame; }
+    void beginFrame() { m_frame++; }
+    unsigned int revision() const { return m_revision; }
+    size_t loadsInFlight() const { return m_inFlight; }
+    bool canLoad() const { return m_inFlight < m_maxLoads; }
+
+    // Remember an asset drawn this frame, for eviction and statistics
+    void track(const std::shared_ptr<Asset>& asset) {
+        for(const auto& w : m_assets) if(w.lock() == asset) return;
+        m_assets.push_back(asset);
+    }
+
+    // Read and upload a node on this thread (offline rendering, and roots that must always be drawable)
+    void uploadNow(Asset& asset, size_t node) {
+        Payload p;
+        p.read(asset, node);
+        p.upload(asset, node);
+        asset.gpuNodes()[node].lastUsedFrame = m_frame;
+        m_revision++;
+    }
+
+    void requestLoad(std::shared_ptr<Asset> asset, size_t node) {
+        asset->gpuNodes()[node].loading = true;
+        m_inFlight++;
+        ThreadPool::instance().submit([this, asset, node]() mutable {
+            Loaded l;
+            l.payload.read(*asset, node);
+            l.node = node;
+            // the queue takes this reference: the last one must be dropped on the GL thread, which frees the GPU nodes
+            l.asset = std::move(asset);
+            {
+                std::lock_guard<std::mutex> lk(m_mtx);
+                m_loaded.push_back(std::move(l));
+            }
+            m_inFlight--;
+            glfwPostEmptyEvent();
+        });
+    }
+
+    // Upload finished reads of the assets in 'live' and evict. Returns true while loads are in flight.
+    bool pump(const std::vector<const Asset*>& live, size_t memoryBudget) {
+        std::vector<Loaded> batch;
+        {
+            std::lock_guard<std::mutex> lk(m_mtx);
+            size_t bytes = 0;
+            while(!m_loaded.empty() && bytes < m_frameBytes) {
+                bytes += m_loaded.front().payload.bytes();
+                batch.push_back(std::move(m_loaded.front()));
+                m_loaded.pop_front();
+            }
+        }
+        for(Loaded& l : batch) {
+            auto& g = l.asset->gpuNodes()[l.node];
+            g.loading = false;
+            // skip assets removed from the scene while the node was read
+            if(!contains(live, l.asset.get()) || g.vao != 0) continue;
+            l.payload.upload(*l.asset, l.node);
+            // not evicted before it is drawn once
+            g.lastUsedFrame = m_frame;
+            m_revision++;
+        }
+        // last references to removed assets are dropped here, on the GL thread
+        batch.clear();
+        evict(live, memoryBudget);
+
+        std::lock_guard<std::mutex> lk(m_mtx);
+        return m_inFlight > 0 || !m_loaded.empty();
+    }
+
+    void evict(const std::vector<const Asset*>& live, size_t memoryBudget) {
+        std::vector<std::shared_ptr<Asset>> assets;
+        size_t resident = 0;
+        bool released = false;
+        for(const auto& w : m_assets) {
+            auto a = w.lock();
+            if(!a) continue;
+            if(!contains(live, a.get())) {
+                // removed assets are tracked again if they come back (undo)
+                for(size_t i = 0; i < a->gpuNodes().size(); ++i) if(a->gpuNodes()[i].vao != 0) a->releaseNode(i);
+                released = true;
+                continue;
+            }
+            resident += a->residentBytes();
+            assets.push_back(std::move(a));
+        }
+        m_assets.assign(assets.begin(), assets.end());
+        if(resident > memoryBudget) {
+            struct Victim { uint64_t frame; Asset* asset; size_t node; };
+            std::vector<Victim> victims;
+            for(const auto& a : assets) {
+                const auto& gpu = a->gpuNodes();
+                for(size_t i = m_pinned; i < gpu.size(); ++i)
+                    if(gpu[i].vao != 0 && gpu[i].lastUsedFrame < m_frame) victims.push_back({ gpu[i].lastUsedFrame, a.get(), i });
+            }
+            std::sort(victims.begin(), victims.end(), [](const Victim& a, const Victim& b){ return a.frame < b.frame; });
+            for(const Victim& v : victims) {
+                if(resident <= memoryBudget) break;
+                size_t before = v.asset->residentBytes();
+                v.asset->releaseNode(v.node);
+                resident -= before - v.asset->residentBytes();
+                released = true;
+            }
+        }
+        if(released) m_revision++;
+    }
+
+    void residentTotals(size_t& nodes, size_t& bytes) const {
+        nodes = bytes = 0;
+        for(const auto& w : m_assets) {
+            if(auto a = w.lock()) { nodes += a->residentNodes(); bytes += a->residentBytes(); }
+        }
+    }
+
+    // Drop queued loads and forget the tracked assets
+    void destroy() {
+        // queued reads hold their asset; wait for them so every asset is freed on this thread
+        while(m_inFlight > 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        {
+            std::lock_guard<std::mutex> lk(m_mtx);
+            m_loaded.clear();
+        }
+        m_assets.clear();
+    }
+
+private:
+    struct Loaded {
+        std::shared_ptr<Asset> asset;
+        size_t node = 0;
+        Payload payload;
+    };
+
+    static bool contains(const std::vector<const Asset*>& assets, const Asset* asset) {
+        return std::find(assets.begin(), assets.end(), asset) != assets.end();
+    }
+
+    const size_t m_pinned;
+    const size_t m_maxLoads;
+    const size_t m_frameBytes;
+    std::mutex m_mtx;
+    std::deque<Loaded> m_loaded;          // guarded by m_mtx
+    std::atomic<size_t> m_inFlight{0};
+    std::vector<std::weak_ptr<Asset>> m_assets; // assets seen by select(), for eviction
+    uint64_t m_frame = 0;
+    unsigned int m_revision = 0;
+};
@@ -0,0 +1,54 @@
+#include "octree_chunks.h"
+
+namespace OctreeChunks {
+
+namespace {
+
+static int32_t splitNode(Layout& L, const std::vector<std::vector<uint64_t>>& pyramid, uint64_t maxChunkItems, int level, int x, int y, int z) {
+    int n = 1 << level;
+    uint64_t count = pyramid[level][((size_t)z * n + y) * n + x];
+    if(count == 0) return -1;
+    if(count <= maxChunkItems || level == kCountLevels) {
+        int32_t id = (int32_t)L.chunks.size();
+        L.chunks.push_back({ level, x, y, z, count });
+        // every counting cell under the chunk maps to it
+        int span = 1 << (kCountLevels - level);
+        for(int cz = z * span; cz < (z + 1) * span; ++cz)
+            for(int cy = y * span; cy < (y + 1) * span; ++cy)
+                for(int cx = x * span; cx < (x + 1) * span; ++cx)
+                    L.cellChunk[((size_t)cz * kCountGrid + cy) * kCountGrid + cx] = (uint32_t)id;
+        return -2 - id;
+    }
+    int32_t self = (int32_t)L.uppers.size();
+    L.uppers.push_back({ level, x, y, z, { -1, -1, -1, -1, -1, -1, -1, -1 } });
+    for(int o = 0; o < 8; ++o) {
+        int32_t child = splitNode(L, pyramid, maxChunkItems, level + 1, 2 * x + (o & 1), 2 * y + ((o >> 1) & 1), 2 * z + ((o >> 2) & 1));
+        L.uppers[self].children[o] = child;
+    }
+    return self;
+}
+
+} // anonymous
+
+Layout build(const Counts& counts, uint64_t maxChunkItems) {
+    // counts per level, (z * n + y) * n + x
+    std::vector<std::vector<uint64_t>> pyramid(kCountLevels + 1);
+    pyramid[kCountLevels].resize(kCountCells);
+    for(size_t i = 0; i < kCountCells; ++i) pyramid[kCountLevels][i] = counts[i];
+    for(int level = kCountLevels - 1; level >= 0; --level) {
+        int n = 1 << level;
+        pyramid[level].assign((size_t)n * n * n, 0);
+        const std::vector<uint64_t>& child = pyramid[level + 1];
+        for(int z = 0; z < 2 * n; ++z)
+            for(int y = 0; y < 2 * n; ++y)
+                for(int x = 0; x < 2 * n; ++x)
+                    pyramid[level][((size_t)(z / 2) * n + y / 2) * n + x / 2] += child[((size_t)z * 2 * n + y) * 2 * n + x];
+    }
+    Layout layout;
+    layout.cellChunk.assign(kCountCells, 0);
+    splitNode(layout, pyramid, maxChunkItems, 0, 0, 0, 0);
+    for(Chunk& c : layout.chunks) { c.first = layout.total; layout.total += c.count; }
+    return layout;
+}
+
+} // namespace OctreeChunks
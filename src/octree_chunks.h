@@ -0,0 +1,109 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+// Chunk layout shared by the out-of-core builders (PointCloudBuilder, ClusterMeshBuilder). Items (points,
+// or triangles by centroid) are counted per cell of a kCountGrid^3 grid, which is level kCountLevels of the
+// octree over the root cube. The octree is then cut into chunks of at most a given number of items, each
+// built in memory on one worker, and a pass over the source scatters every item into its chunk's
+// contiguous range of a file.
+namespace OctreeChunks {
+    static const int kCountLevels = 7;
+    static const int kCountGrid = 1 << kCountLevels;
+    static const size_t kCountCells = (size_t)kCountGrid * kCountGrid * kCountGrid;
+
+    // Counting grid over the root cube
+    struct Grid {
+        double min[3];
+        double invCell;
+
+        Grid(const double rootMin[3], double rootSize) : min{ rootMin[0], rootMin[1], rootMin[2] }, invCell(kCountGrid / rootSize) {}
+
+        // Cell of a position; positions outside the cube go to the nearest cell
+        size_t cell(double x, double y, double z) const {
+            return ((size_t)clamp((z - min[2]) * invCell) * kCountGrid + clamp((y - min[1]) * invCell)) * kCountGrid + clamp((x - min[0]) * invCell);
+        }
+        static int clamp(double v) { return v <= 0.0 ? 0 : v >= (double)kCountGrid ? kCountGrid - 1 : (int)v; }
+    };
+
+    // Items per counting cell; add() is thread-safe
+    class Counts {
+    public:
+        Counts() : m_cells(new std::atomic<uint64_t>[kCountCells]) {
+            for(size_t i = 0; i < kCountCells; ++i) m_cells[i].store(0, std::memory_order_relaxed);
+        }
+        void add(size_t cell) { m_cells[cell].fetch_add(1, std::memory_order_relaxed); }
+        uint64_t operator[](size_t cell) const { return m_cells[cell].load(std::memory_order_relaxed); }
+
+    private:
+        std::unique_ptr<std::atomic<uint64_t>[]> m_cells;
+    };
+
+    struct Chunk {
+        int level, x, y, z;
+        uint64_t count;
+        uint64_t first = 0; // item offset of the chunk's range
+    };
+
+    struct Layout {
+        std::vector<Chunk> chunks;
+        // nodes above the chunks, parents before children; the root is uppers[0], or chunk 0 when everything
+        // fits in one chunk. children: >= 0 upper node, -1 empty, <= -2 chunk (-2 - index)
+        struct Upper { int level, x, y, z; int32_t children[8]; };
+        std::vector<Upper> uppers;
+        std::vector<uint32_t> cellChunk; // counting cell -> chunk
+        uint64_t total = 0;              // items over all chunks; their ranges are [0, total) in chunk order
+    };
+
+    // Cut the octree into chunks of at most 'maxChunkItems' (a single counting cell may exceed it)
+    Layout build(const Counts& counts, uint64_t maxChunkItems);
+
+    // Writes the items of a pass over the source into their chunk's range, one write per chunk and block.
+    // write(first, items, count) stores items at item offset 'first'.
+    template<class Item>
+    class Scatter {
+    public:
+        explicit Scatter(const Layout& layout) : m_layout(layout), m_cursor(layout.chunks.size(), 0), m_runStart(layout.chunks.size() + 1) {}
+
+        // 'chunkOf[i]' is the chunk of items[i]. False when a write fails, or a chunk receives more items
+        // than were counted (overflowed(): the source changed since the counting pass).
+        template<class Write>
+        bool add(const std::vector<uint32_t>& chunkOf, const std::vector<Item>& items, Write&& write) {
+            const size_t chunks = m_layout.chunks.size();
+            std::fill(m_runStart.begin(), m_runStart.end(), 0);
+            for(uint32_t c : chunkOf) m_runStart[c + 1]++;
+            for(size_t c = 0; c < chunks; ++c) m_runStart[c + 1] += m_runStart[c];
+            m_sorted.resize(items.size());
+            std::vector<size_t> fill(m_runStart.begin(), m_runStart.end() - 1);
+            for(size_t i = 0; i < items.size(); ++i) m_sorted[fill[chunkOf[i]]++] = items[i];
+            for(size_t c = 0; c < chunks; ++c) {
+                size_t run = m_runStart[c + 1] - m_runStart[c];
+                if(run == 0) continue;
+                if(m_cursor[c] + run > m_layout.chunks[c].count) { m_overflowed = true; return false; }
+                if(!write(m_layout.chunks[c].first + m_cursor[c], &m_sorted[m_runStart[c]], run)) return false;
+                m_cursor[c] += run;
+            }
+            return true;
+        }
+
+        bool overflowed() const { return m_overflowed; }
+
+        // True when every chunk received exactly the items counted for it
+        bool complete() const {
+            for(size_t c = 0; c < m_cursor.size(); ++c) if(m_cursor[c] != m_layout.chunks[c].count) return false;
+            return true;
+        }
+
+    private:
+        const Layout& m_layout;
+        std::vector<uint64_t> m_cursor;
+        std::vector<size_t> m_runStart;
+        std::vector<Item> m_sorted;
+        bool m_overflowed = false;
+    };
+}
@@ -0,0 +1,452 @@
+#include "png_codec.h"
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+namespace PngCodec {
+
+static const uint8_t kSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+// decoded images larger than this are rejected (guards against hostile headers)
+static const uint32_t kMaxDimension = 16384;
+
+// deflate length codes 257..285 and distance codes 0..29: base value and extra bits
+static const uint16_t kLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t kLengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t kDistBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t kDistExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+static uint32_t crcTable[256];
+[[maybe_unused]] static bool s_crcInit = [] {
+    for(uint32_t n = 0; n < 256; ++n) {
+        uint32_t c = n;
+        for(int k = 0; k < 8; ++k) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        crcTable[n] = c;
+    }
+    return true;
+}();
+
+static uint32_t crc32(const uint8_t* p, size_t n, uint32_t crc = 0) {
+    crc = ~crc;
+    for(size_t i = 0; i < n; ++i) crc = crcTable[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static uint32_t adler32(const uint8_t* p, size_t n) {
+    uint32_t a = 1, b = 0;
+    while(n > 0) {
+        // 5552 bytes is the longest run before b can overflow
+        size_t chunk = std::min(n, (size_t)5552);
+        for(size_t i = 0; i < chunk; ++i) { a += p[i]; b += a; }
+        a %= 65521; b %= 65521;
+        p += chunk; n -= chunk;
+    }
+    return (b << 16) | a;
+}
+
+static uint32_t readBE32(const uint8_t* p) { return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3]; }
+
+static void writeBE32(std::vector<uint8_t>& out, uint32_t v) {
+    out.push_back((uint8_t)(v >> 24)); out.push_back((uint8_t)(v >> 16)); out.push_back((uint8_t)(v >> 8)); out.push_back((uint8_t)v);
+}
+
+// ---- Deflate (fixed Huffman) ----
+
+struct BitWriter {
+    std::vector<uint8_t>& out;
+    uint32_t bits = 0;
+    int count = 0;
+
+    // value's low 'n' bits, least significant first
+    void put(uint32_t value, int n) {
+        bits |= value << count;
+        count += n;
+        while(count >= 8) { out.push_back((uint8_t)bits); bits >>= 8; count -= 8; }
+    }
+    // Huffman codes are sent most significant bit first
+    void putCode(uint32_t code, int n) {
+        uint32_t rev = 0;
+        for(int i = 0; i < n; ++i) rev |= ((code >> i) & 1) << (n - 1 - i);
+        put(rev, n);
+    }
+    void flush() { if(count > 0) out.push_back((uint8_t)bits); bits = 0; count = 0; }
+};
+
+static void putLiteral(BitWriter& w, int sym) {
+    if(sym < 144) w.putCode(0x30 + sym, 8);
+    else if(sym < 256) w.putCode(0x190 + sym - 144, 9);
+    else if(sym < 280) w.putCode(sym - 256, 7);
+    else w.putCode(0xc0 + sym - 280, 8);
+}
+
+static void putMatch(BitWriter& w, int length, int distance) {
+    int lc = 28;
+    while(kLengthBase[lc] > length) lc--;
+    putLiteral(w, 257 + lc);
+    if(kLengthExtra[lc]) w.put(length - kLengthBase[lc], kLengthExtra[lc]);
+    int dc = 29;
+    while(kDistBase[dc] > distance) dc--;
+    w.putCode(dc, 5);
+    if(kDistExtra[dc]) w.put(distance - kDistBase[dc], kDistExtra[dc]);
+}
+
+// zlib stream of 'data': one final fixed-Huffman block, greedy matches from 3-byte hash chains
+static void deflate(const uint8_t* data, size_t n, std::vector<uint8_t>& out) {
+    static const int kWindow = 32768;
+    static const int kHashBits = 15;
+    static const int kMaxChain = 48;
+    static const int kMaxMatch = 258;
+    out.push_back(0x78); out.push_back(0x01); // zlib header: deflate, 32 KB window, fastest level
+    BitWriter w{ out };
+    w.put(1, 1); // final block
+    w.put(1, 2); // fixed Huffman codes
+
+    std::vector<int32_t> head((size_t)1 << kHashBits, -1);
+    std::vector<int32_t> prev(kWindow, -1);
+    auto hash = [&](size_t i){ return (uint32_t)((data[i] << 16) | (data[i + 1] << 8) | data[i + 2]) * 2654435761u >> (32 - kHashBits); };
+    auto insert = [&](size_t i){
+        if(i + 2 >= n) return;
+        uint32_t h = hash(i);
+        prev[i & (kWindow - 1)] = head[h];
+        head[h] = (int32_t)i;
+    };
+
+    size_t i = 0;
+    while(i < n) {
+        int bestLen = 0, bestDist = 0;
+        if(i + 2 < n) {
+            int32_t cand = head[hash(i)];
+            int maxLen = (int)std::min((size_t)kMaxMatch, n - i);
+            for(int chain = 0; cand >= 0 && chain < kMaxChain; ++chain) {
+                size_t dist = i - (size_t)cand;
+                if(dist > (size_t)kWindow - 1) break;
+                if(data[cand + bestLen] == data[i + bestLen]) {
+                    int len = 0;
+                    while(len < maxLen && data[cand + len] == data[i + len]) len++;
+                    if(len > bestLen) { bestLen = len; bestDist = (int)dist; if(len == maxLen) break; }
+                }
+                int32_t next = prev[cand & (kWindow - 1)];
+                if(next >= cand) break; // slot reused by a newer position
+                cand = next;
+            }
+        }
+        if(bestLen >= 3) {
+            putMatch(w, bestLen, bestDist);
+            for(int k = 0; k < bestLen; ++k) insert(i + k);
+            i += bestLen;
+        } else {
+            putLiteral(w, data[i]);
+            insert(i);
+            i++;
+        }
+    }
+    putLiteral(w, 256);
+    w.flush();
+    writeBE32(out, adler32(data, n));
+}
+
+// ---- Inflate ----
+
+struct Huffman {
+    uint16_t count[16];   // codes of each length
+    uint16_t symbol[288]; // symbols ordered by code
+};
+
+// Canonical code from code lengths. Incomplete codes are allowed (single distance code), over-subscribed are not.
+static bool buildHuffman(Huffman& h, const uint8_t* lengths, int n) {
+    memset(h.count, 0, sizeof(h.count));
+    for(int i = 0; i < n; ++i) h.count[lengths[i]]++;
+    h.count[0] = 0;
+    int left = 1;
+    for(int len = 1; len < 16; ++len) {
+        left <<= 1;
+        left -= h.count[len];
+        if(left < 0) return false;
+    }
+    uint16_t offs[16];
+    offs[1] = 0;
+    for(int len = 1; len < 15; ++len) offs[len + 1] = offs[len] + h.count[len];
+    for(int i = 0; i < n; ++i) if(lengths[i]) h.symbol[offs[lengths[i]]++] = (uint16_t)i;
+    return true;
+}
+
+struct BitReader {
+    const uint8_t* p;
+    size_t size;
+    size_t pos = 0;
+    uint32_t bits = 0;
+    int count = 0;
+    bool overrun = false;
+
+    uint32_t get(int n) {
+        while(count < n) {
+            if(pos >= size) { overrun = true; return 0; }
+            bits |= (uint32_t)p[pos++] << count;
+            count += 8;
+        }
+        uint32_t v = bits & ((1u << n) - 1);
+        bits >>= n;
+        count -= n;
+        return v;
+    }
+    int decode(const Huffman& h) {
+        int code = 0, first = 0, index = 0;
+        for(int len = 1; len < 16; ++len) {
+            code |= (int)get(1);
+            if(overrun) return -1;
+            int c = h.count[len];
+            if(code - c < first) return h.symbol[index + (code - first)];
+            index += c;
+            first += c;
+            first <<= 1;
+            code <<= 1;
+        }
+        return -1;
+    }
+};
+
+static bool inflateBlock(BitReader& br, std::vector<uint8_t>& out, const Huffman& lit, const Huffman& dist, size_t limit) {
+    for(;;) {
+        int sym = br.decode(lit);
+        if(sym < 0) return false;
+        if(sym < 256) {
+            if(out.size() >= limit) return false;
+            out.push_back((uint8_t)sym);
+            continue;
+        }
+        if(sym == 256) return true;
+        sym -= 257;
+        if(sym >= 29) return false;
+        size_t len = kLengthBase[sym] + br.get(kLengthExtra[sym]);
+        int dsym = br.decode(dist);
+        if(dsym < 0 || dsym >= 30) return false;
+        size_t d = kDistBase[dsym] + br.get(kDistExtra[dsym]);
+        if(br.overrun || d > out.size() || out.size() + len > limit) return false;
+        size_t from = out.size() - d;
+        for(size_t k = 0; k < len; ++k) out.push_back(out[from + k]);
+    }
+}
+
+// zlib stream -> bytes, at most 'limit' of them
+static bool inflate(const uint8_t* data, size_t n, std::vector<uint8_t>& out, size_t limit) {
+    if(n < 6) return false;
+    if((data[0] & 0x0f) != 8 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20)) return false; // deflate, no preset dictionary
+    BitReader br{ data + 2, n - 2 };
+    bool last = false;
+    while(!last) {
+        last = br.get(1) != 0;
+        uint32_t type = br.get(2);
+        if(br.overrun) return false;
+        if(type == 0) {
+            // stored: byte aligned LEN, NLEN, then raw bytes
+            br.bits = 0; br.count = 0;
+            if(br.pos + 4 > br.size) return false;
+            uint32_t len = br.p[br.pos] | (br.p[br.pos + 1] << 8);
+            uint32_t nlen = br.p[br.pos + 2] | (br.p[br.pos + 3] << 8);
+            br.pos += 4;
+            if(len != (~nlen & 0xffff) || br.pos + len > br.size || out.size() + len > limit) return false;
+            out.insert(out.end(), br.p + br.pos, br.p + br.pos + len);
+            br.pos += len;
+        } else if(type == 1) {
+            static Huffman fixedLit, fixedDist;
+            static bool fixedInit = [] {
+                uint8_t l[288];
+                for(int i = 0; i < 144; ++i) l[i] = 8;
+                for(int i = 144; i < 256; ++i) l[i] = 9;
+                for(int i = 256; i < 280; ++i) l[i] = 7;
+                for(int i = 280; i < 288; ++i) l[i] = 8;
+                buildHuffman(fixedLit, l, 288);
+                for(int i = 0; i < 30; ++i) l[i] = 5;
+                buildHuffman(fixedDist, l, 30);
+                return true;
+            }();
+            (void)fixedInit;
+            if(!inflateBlock(br, out, fixedLit, fixedDist, limit)) return false;
+        } else if(type == 2) {
+            static const uint8_t kOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+            int nlit = (int)br.get(5) + 257, ndist = (int)br.get(5) + 1, ncode = (int)br.get(4) + 4;
+            if(nlit > 286 || ndist > 30) return false;
+            uint8_t lengths[320] = {};
+            for(int i = 0; i < ncode; ++i) lengths[kOrder[i]] = (uint8_t)br.get(3);
+            Huffman codeLen;
+            if(!buildHuffman(codeLen, lengths, 19)) return false;
+            memset(lengths, 0, sizeof(lengths));
+            for(int i = 0; i < nlit + ndist;) {
+                int sym = br.decode(codeLen);
+                if(sym < 0) return false;
+                if(sym < 16) { lengths[i++] = (uint8_t)sym; continue; }
+                int rep = 0;
+                uint8_t value = 0;
+                if(sym == 16) { if(i == 0) return false; value = lengths[i - 1]; rep = 3 + (int)br.get(2); }
+                else if(sym == 17) rep = 3 + (int)br.get(3);
+                else rep = 11 + (int)br.get(7);
+                if(i + rep > nlit + ndist) return false;
+                while(rep--) lengths[i++] = value;
+            }
+            if(lengths[256] == 0) return false; // no end-of-block code
+            Huffman lit, dist;
+            if(!buildHuffman(lit, lengths, nlit) || !buildHuffman(dist, lengths + nlit, ndist)) return false;
+            if(!inflateBlock(br, out, lit, dist, limit)) return false;
+        } else {
+            return false;
+        }
+        if(br.overrun) return false;
+    }
+    return true;
+}
+
+// ---- PNG ----
+
+static void writeChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t n) {
+    writeBE32(out, (uint32_t)n);
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    if(n) out.insert(out.end(), data, data + n);
+    writeBE32(out, crc32(out.data() + start, n + 4));
+}
+
+static uint8_t paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if(pa <= pb && pa <= pc) return (uint8_t)a;
+    return (uint8_t)(pb <= pc ? b : c);
+}
+
+// Filter one row; 'prev' is the previous unfiltered row (zeros for the first)
+static void filterRow(int type, const uint8_t* row, const uint8_t* prev, size_t n, int bpp, uint8_t* out) {
+    for(size_t i = 0; i < n; ++i) {
+        int a = i >= (size_t)bpp ? row[i - bpp] : 0;
+        int b = prev[i];
+        int c = i >= (size_t)bpp ? prev[i - bpp] : 0;
+        uint8_t pred = 0;
+        switch(type) {
+            case 1: pred = (uint8_t)a; break;
+            case 2: pred = (uint8_t)b; break;
+            case 3: pred = (uint8_t)((a + b) >> 1); break;
+            case 4: pred = paeth(a, b, c); break;
+        }
+        out[i] = (uint8_t)(row[i] - pred);
+    }
+}
+
+bool encodeRGBA(const uint8_t* rgba, int width, int height, std::vector<uint8_t>& out) {
+    if(!rgba || width <= 0 || height <= 0 || (uint32_t)width > kMaxDimension || (uint32_t)height > kMaxDimension) return false;
+    const size_t stride = (size_t)width * 4;
+    // filtered scanlines: each row gets the filter with the smallest sum of absolute residuals
+    std::vector<uint8_t> raw((stride + 1) * height);
+    std::vector<uint8_t> zero(stride, 0), trial(stride);
+    for(int y = 0; y < height; ++y) {
+        const uint8_t* row = rgba + stride * y;
+        const uint8_t* prev = y > 0 ? row - stride : zero.data();
+        uint8_t* dst = raw.data() + (stride + 1) * y;
+        uint64_t bestScore = UINT64_MAX;
+        for(int type = 0; type < 5; ++type) {
+            filterRow(type, row, prev, stride, 4, trial.data());
+            uint64_t score = 0;
+            for(size_t i = 0; i < stride; ++i) score += (uint64_t)std::abs((int)(int8_t)trial[i]);
+            if(score < bestScore) {
+                bestScore = score;
+                dst[0] = (uint8_t)type;
+                memcpy(dst + 1, trial.data(), stride);
+            }
+        }
+    }
+
+    out.clear();
+    out.insert(out.end(), kSignature, kSignature + 8);
+    uint8_t ihdr[13];
+    ihdr[0] = (uint8_t)(width >> 24); ihdr[1] = (uint8_t)(width >> 16); ihdr[2] = (uint8_t)(width >> 8); ihdr[3] = (uint8_t)width;
+    ihdr[4] = (uint8_t)(height >> 24); ihdr[5] = (uint8_t)(height >> 16); ihdr[6] = (uint8_t)(height >> 8); ihdr[7] = (uint8_t)height;
+    ihdr[8] = 8;  // bit depth
+    ihdr[9] = 6;  // RGBA
+    ihdr[10] = 0; ihdr[11] = 0; ihdr[12] = 0; // deflate, adaptive filtering, no interlace
+    writeChunk(out, "IHDR", ihdr, sizeof(ihdr));
+    std::vector<uint8_t> z;
+    deflate(raw.data(), raw.size(), z);
+    writeChunk(out, "IDAT", z.data(), z.size());
+    writeChunk(out, "IEND", nullptr, 0);
+    return true;
+}
+
+bool decodeRGBA(const uint8_t* data, size_t size, int& width, int& height, std::vector<uint8_t>& rgba) {
+    if(size < 8 || memcmp(data, kSignature, 8) != 0) return false;
+    uint32_t w = 0, h = 0;
+    int channels = 0;
+    bool header = false, end = false;
+    std::vector<uint8_t> z;
+    for(size_t pos = 8; pos + 12 <= size && !end;) {
+        uint32_t len = readBE32(data + pos);
+        if(len > size - pos - 12) return false;
+        const uint8_t* type = data + pos + 4;
+        const uint8_t* body = data + pos + 8;
+        if(crc32(type, len + 4) != readBE32(body + len)) return false;
+        if(!memcmp(type, "IHDR", 4)) {
+            if(len < 13) return false;
+            w = readBE32(body);
+            h = readBE32(body + 4);
+            uint8_t depth = body[8], color = body[9];
+            if(depth != 8 || body[10] != 0 || body[11] != 0 || body[12] != 0) return false;
+            switch(color) {
+                case 0: channels = 1; break;
+                case 2: channels = 3; break;
+                case 4: channels = 2; break;
+                case 6: channels = 4; break;
+                default: return false; // palette
+            }
+            if(w == 0 || h == 0 || w > kMaxDimension || h > kMaxDimension) return false;
+            header = true;
+        } else if(!memcmp(type, "IDAT", 4)) {
+            z.insert(z.end(), body, body + len);
+        } else if(!memcmp(type, "IEND", 4)) {
+            end = true;
+        } else if(!(type[0] & 0x20)) {
+            return false; // unknown critical chunk
+        }
+        pos += 12 + (size_t)len;
+    }
+    if(!header || z.empty()) return false;
+
+    const size_t stride = (size_t)w * channels;
+    std::vector<uint8_t> raw;
+    raw.reserve((stride + 1) * h);
+    if(!inflate(z.data(), z.size(), raw, (stride + 1) * h) || raw.size() != (stride + 1) * h) return false;
+
+    // unfilter in place, rows are stride + 1 bytes with the filter type first
+    std::vector<uint8_t> zero(stride, 0);
+    for(uint32_t y = 0; y < h; ++y) {
+        uint8_t* row = raw.data() + (stride + 1) * y + 1;
+        const uint8_t* prev = y > 0 ? row - (stride + 1) : zero.data();
+        uint8_t type = row[-1];
+        for(size_t i = 0; i < stride; ++i) {
+            int a = i >= (size_t)channels ? row[i - channels] : 0;
+            int b = prev[i];
+            int c = i >= (size_t)channels ? prev[i - channels] : 0;
+            switch(type) {
+                case 0: break;
+                case 1: row[i] = (uint8_t)(row[i] + a); break;
+                case 2: row[i] = (uint8_t)(row[i] + b); break;
+                case 3: row[i] = (uint8_t)(row[i] + ((a + b) >> 1)); break;
+                case 4: row[i] = (uint8_t)(row[i] + paeth(a, b, c)); break;
+                default: return false;
+            }
+        }
+    }
+
+    rgba.resize((size_t)w * h * 4);
+    for(uint32_t y = 0; y < h; ++y) {
+        const uint8_t* src = raw.data() + (stride + 1) * y + 1;
+        uint8_t* dst = rgba.data() + (size_t)w * 4 * y;
+        for(uint32_t x = 0; x < w; ++x, src += channels, dst += 4) {
+            switch(channels) {
+                case 1: dst[0] = dst[1] = dst[2] = src[0]; dst[3] = 255; break;
+                case 2: dst[0] = dst[1] = dst[2] = src[0]; dst[3] = src[1]; break;
+                case 3: dst[0] = src[0]; dst[1] = src[1]; dst[2] = src[2]; dst[3] = 255; break;
+                default: memcpy(dst, src, 4); break;
+            }
+        }
+    }
+    width = (int)w;
+    height = (int)h;
+    return true;
+}
+
+} // namespace PngCodec
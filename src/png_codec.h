@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Minimal PNG reader/writer for thumbnails and rendered images, without zlib or an image library.
+// The encoder writes 8-bit RGBA with per-row adaptive filters and a single fixed-Huffman deflate
+// block (LZ77 over a 32 KB window); the decoder reads any zlib stream (stored, fixed and dynamic
+// blocks) of non-interlaced 8-bit greyscale, RGB, grey+alpha or RGBA images. Palette, 16-bit and
+// interlaced files are rejected. Both functions are thread-safe.
+namespace PngCodec {
+    // Encode 'width' x 'height' RGBA8 pixels, rows top to bottom, into 'out'
+    bool encodeRGBA(const uint8_t* rgba, int width, int height, std::vector<uint8_t>& out);
+
+    // Decode into RGBA8 rows top to bottom. Returns false for unsupported or corrupt files.
+    bool decodeRGBA(const uint8_t* data, size_t size, int& width, int& height, std::vector<uint8_t>& rgba);
+}
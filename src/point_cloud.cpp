@@ -0,0 +1,84 @@
+#include "point_cloud.h"
+#include "mesh_cache.h"
+#include "gl_state.h"
+#include "xxhash.h"
+#include "log.h"
+#include <cstring>
+#include <cstddef>
+#include <type_traits>
+
+static_assert(sizeof(PointCloud::FileHeader) == 128, "header must stay 128 bytes");
+static_assert(sizeof(PointCloud::Point) == 16 && std::is_trivially_copyable<PointCloud::Point>::value, "points are stored verbatim");
+static_assert(sizeof(PointCloud::Node) == 64 && std::is_trivially_copyable<PointCloud::Node>::value, "nodes are stored verbatim");
+
+PointCloud::~PointCloud() {
+    for(size_t i = 0; i < m_gpu.size(); ++i) releaseNode(i);
+}
+
+std::string PointCloud::containerPath(const std::string& assetPath) { return assetPath + ".nvpc"; }
+
+std::shared_ptr<PointCloud> PointCloud::open(const std::string& assetPath, std::string& err) {
+    MeshCache::SourceKey key;
+    if(!MeshCache::sourceKey(assetPath, 0, key)) { err = "cannot read " + assetPath; return nullptr; }
+    std::shared_ptr<PointCloud> pc(new PointCloud());
+    pc->m_source = assetPath;
+    MappedFile& file = pc->m_file;
+    if(!file.open(containerPath(assetPath))) { err = "no point cloud container"; return nullptr; }
+
+    FileHeader h;
+    if(file.size() < sizeof(h)) { err = "truncated point cloud container"; return nullptr; }
+    memcpy(&h, file.data(), sizeof(h));
+    if(h.magic != kMagic || h.version != kVersion || h.headerBytes != sizeof(h)
+       || h.headerChecksum != XXHash::hash64(&h, offsetof(FileHeader, headerChecksum))) {
+        err = "unknown version or corrupt header";
+        return nullptr;
+    }
+    if(h.sourceSize != key.size || h.sourceTime != key.time) { err = "point cloud container is out of date"; return nullptr; }
+    uint64_t dataEnd = sizeof(h) + h.recordCount * sizeof(Point);
+    uint64_t tableBytes = (uint64_t)h.nodeCount * sizeof(Node);
+    if(h.nodeCount == 0 || h.nodeTableOffset < dataEnd || h.nodeTableOffset > file.size() || tableBytes > file.size() - h.nodeTableOffset
+       || XXHash::hash64(file.data() + h.nodeTableOffset, tableBytes) != h.nodeTableChecksum) {
+        err = "corrupt node table";
+        return nullptr;
+    }
+    pc->m_nodes.resize(h.nodeCount);
+    memcpy(pc->m_nodes.data(), file.data() + h.nodeTableOffset, tableBytes);
+    for(const Node& n : pc->m_nodes) {
+        bool ok = n.first <= h.recordCount && n.count <= h.recordCount - n.first;
+        for(int32_t c : n.children) ok = ok && c >= -1 && c < (int32_t)h.nodeCount;
+        if(!ok) { err = "corrupt node table"; return nullptr; }
+    }
+    pc->m_gpu.resize(h.nodeCount);
+    pc->m_pointCount = h.pointCount;
+    memcpy(pc->m_origin, h.origin, sizeof(h.origin));
+    pc->m_boundsMin = glm::vec3(h.boundsMin[0], h.boundsMin[1], h.boundsMin[2]);
+    pc->m_boundsMax = glm::vec3(h.boundsMax[0], h.boundsMax[1], h.boundsMax[2]);
+    return pc;
+}
+
+void PointCloud::uploadNode(size_t index, const Point* points) {
+    GpuNode& g = m_gpu[index];
+    size_t bytes = (size_t)m_nodes[index].count * sizeof(Point);
+    if(g.vao == 0) {
+        glGenVertexArrays(1, &g.vao);
+        glGenBuffers(1, &g.vbo);
+        m_residentNodes++;
+        m_residentBytes += bytes;
+    }
+    GLState::bindVertexArray(g.vao);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, g.vbo);
+    glBufferData(GL_ARRAY_BUFFER, bytes, points, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Point), (void*)offsetof(Point, x));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Point), (void*)offsetof(Point, rgba));
+}
+
+void PointCloud::releaseNode(size_t index) {
+    GpuNode& g = m_gpu[index];
+    if(g.vao == 0) return;
+    GLState::deleteBuffer(g.vbo);
+    GLState::deleteVertexArray(g.vao);
+    m_residentBytes -= (size_t)m_nodes[index].count * sizeof(Point);
+    m_residentNodes--;
+}
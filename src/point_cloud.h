@@ -0,0 +1,111 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "mapped_file.h"
+
+// Point cloud stored as a disk-backed octree ("<asset>.nvpc", written by PointCloudBuilder).
+// Every inner node holds a subsample of the points below it, about size / kSampleGrid apart, and the
+// leaves hold the rest; nodes are additive, so drawing a node and its children shows every point once.
+// The container is memory-mapped and nodes are streamed to the GPU by PointCloudStreamer, so only the
+// nodes in view are ever read from disk.
+//
+// Layout: a 128-byte header, the point records node after node, then the node table. Positions are
+// stored relative to the center of the source bounds (origin()), which keeps float precision for
+// georeferenced scans far from zero.
+class PointCloud {
+public:
+    struct Point {
+        float x, y, z;
+        uint8_t rgba[4];
+    };
+
+    struct Node {
+        glm::vec3 min;         // cube corner, relative to origin()
+        float size;            // cube edge
+        float spacing;         // distance between the node's points (0 for leaves, which keep everything)
+        uint32_t count;
+        uint64_t first;        // first point record
+        int32_t children[8];   // -1 when empty; octant bit 0 = +x, bit 1 = +y, bit 2 = +z
+    };
+
+    // GPU copy of a node, managed by PointCloudStreamer on the GL thread
+    struct GpuNode {
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        uint64_t lastUsedFrame = 0;
+        bool loading = false;
+    };
+
+    // sampling cells per node edge
+    static const int kSampleGrid = 128;
+
+    // Container layout, shared with PointCloudBuilder
+    static const uint32_t kMagic = 0x4350564E; // "NVPC"
+    static const uint32_t kVersion = 1;
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t headerBytes;
+        uint32_t nodeCount;
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        uint64_t pointCount;    // points in the octree
+        uint64_t recordCount;   // point records in the file, including slots left by sampling
+        double origin[3];
+        float boundsMin[3];
+        float boundsMax[3];
+        uint64_t nodeTableOffset;
+        uint64_t nodeTableChecksum;
+        uint64_t reserved;      // zero
+        uint64_t headerChecksum; // XXH64 of all fields above
+    };
+
+    ~PointCloud();
+    PointCloud(const PointCloud&) = delete;
+    PointCloud& operator=(const PointCloud&) = delete;
+
+    static std::string containerPath(const std::string& assetPath);
+    // Map the container of an asset. Returns null (with 'err') when it is missing, corrupt, or was built
+    // from a different version of the source file.
+    static std::shared_ptr<PointCloud> open(const std::string& assetPath, std::string& err);
+
+    const std::string& sourcePath() const { return m_source; }
+    uint64_t pointCount() const { return m_pointCount; }
+    const std::vector<Node>& nodes() const { return m_nodes; }
+    // tight bounds of the points, relative to origin()
+    const glm::vec3& boundsMin() const { return m_boundsMin; }
+    const glm::vec3& boundsMax() const { return m_boundsMax; }
+    // source coordinates of the cloud's local origin
+    const double* origin() const { return m_origin; }
+
+    // Records of a node, straight from the mapping (first access pages them in)
+    const Point* points(const Node& node) const { return (const Point*)(m_file.data() + sizeof(FileHeader)) + node.first; }
+
+    // GPU residency (GL thread)
+    std::vector<GpuNode>& gpuNodes() { return m_gpu; }
+    // 'points' holds the node's count records
+    void uploadNode(size_t index, const Point* points);
+    void releaseNode(size_t index);
+    size_t residentBytes() const { return m_residentBytes; }
+    size_t residentNodes() const { return m_residentNodes; }
+
+private:
+    PointCloud() = default;
+
+    std::string m_source;
+    MappedFile m_file;
+    std::vector<Node> m_nodes;
+    std::vector<GpuNode> m_gpu;
+    uint64_t m_pointCount = 0;
+    double m_origin[3] = { 0.0, 0.0, 0.0 };
+    glm::vec3 m_boundsMin = glm::vec3(0.0f);
+    glm::vec3 m_boundsMax = glm::vec3(0.0f);
+    size_t m_residentBytes = 0;
+    size_t m_residentNodes = 0;
+};
@@ -0,0 +1,650 @@
+#include "point_cloud_builder.h"
+#include "point_cloud.h"
+#include "octree_chunks.h"
+#include "mesh_parsers.h"
+#include "mesh_cache.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include "xxhash.h"
+#include "log.h"
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <cstddef>
+#include <cmath>
+#include <cfloat>
+
+namespace {
+
+using Point = PointCloud::Point;
+using Node = PointCloud::Node;
+
+// points decoded per source block
+static const size_t kBlockPoints = 1 << 20;
+// chunks are octree nodes of at most this many points (see OctreeChunks)
+static const uint64_t kMaxChunkPoints = 1 << 20;
+// nodes with fewer points are leaves
+static const size_t kMaxNodePoints = 20000;
+// identical points cannot be separated; stop subdividing at this depth
+static const int kMaxDepth = 24;
+
+struct SourcePoint {
+    double x, y, z;
+    uint8_t rgba[4];
+};
+
+template<typename T> static T readLE(const uint8_t* p) { T v; memcpy(&v, p, sizeof(T)); return v; }
+
+// Sequential block reader over a mapped source file
+class PointReader {
+public:
+    virtual ~PointReader() = default;
+    // Decode the next block into 'out'; false when the file is exhausted
+    virtual bool next(std::vector<SourcePoint>& out) = 0;
+    virtual void rewind() = 0;
+    // fraction of the file read so far
+    virtual float position() const = 0;
+    // bounds recorded in the file header, when the format has them
+    virtual bool headerBounds(double mn[3], double mx[3]) const { (void)mn; (void)mx; return false; }
+};
+
+// LAS 1.0-1.4, point formats 0-10. Coordinates are scaled integers; colors are 16-bit (often holding
+// 8-bit values); formats without color are shaded by intensity.
+class LasReader : public PointReader {
+public:
+    bool open(const std::string& path, std::string& err) {
+        if(!m_file.open(path)) { err = "cannot open file"; return false; }
+        const uint8_t* d = m_file.data();
+        size_t size = m_file.size();
+        if(size < 227 || memcmp(d, "LASF", 4) != 0) { err = "not a LAS file"; return false; }
+        uint16_t headerSize = readLE<uint16_t>(d + 94);
+        m_dataOffset = readLE<uint32_t>(d + 96);
+        uint8_t format = d[104];
+        m_recordLength = readLE<uint16_t>(d + 105);
+        m_count = readLE<uint32_t>(d + 107);
+        if(d[25] >= 4 && headerSize >= 375 && size >= 255) {
+            uint64_t count14 = readLE<uint64_t>(d + 247);
+            if(count14) m_count = count14;
+        }
+        // LAZ marks compressed records in the top bits of the format
+        if(format & 0xC0) { err = "compressed LAZ files are not supported"; return false; }
+        static const uint16_t kMinLength[] = { 20, 28, 26, 34, 57, 63, 30, 36, 38, 59, 67 };
+        static const int kRgbOffset[] = { -1, -1, 20, 28, -1, 28, -1, 30, 30, -1, 30 };
+        if(format > 10 || m_recordLength < kMinLength[format]) { err = "unsupported LAS point format"; return false; }
+        m_rgbOffset = kRgbOffset[format];
+        for(int k = 0; k < 3; ++k) {
+            m_scale[k] = readLE<double>(d + 131 + k * 8);
+            m_offset[k] = readLE<double>(d + 155 + k * 8);
+            m_max[k] = readLE<double>(d + 179 + k * 16);
+            m_min[k] = readLE<double>(d + 187 + k * 16);
+        }
+        if(m_dataOffset > size) { err = "truncated LAS file"; return false; }
+        uint64_t available = (size - m_dataOffset) / m_recordLength;
+        if(available < m_count) {
+            LOG_WARN("LAS file " << path << " is truncated: " << available << " of " << m_count << " points");
+            m_count = available;
+        }
+        // 8-bit colors stored in 16-bit fields are common; look at the first points to tell
+        uint64_t sample = std::min<uint64_t>(m_count, 65536);
+        uint16_t maxValue = 0;
+        for(uint64_t i = 0; i < sample; ++i) {
+            const uint8_t* rec = record(i);
+            if(m_rgbOffset >= 0) for(int k = 0; k < 3; ++k) maxValue = std::max(maxValue, readLE<uint16_t>(rec + m_rgbOffset + k * 2));
+            else maxValue = std::max(maxValue, readLE<uint16_t>(rec + 12));
+        }
+        m_colorShift = maxValue > 255 ? 8 : 0;
+        m_intensityScale = maxValue > 0 ? 255.0f / (float)maxValue : 1.0f;
+        return true;
+    }
+
+    bool next(std::vector<SourcePoint>& out) override {
+        if(m_next >= m_count) return false;
+        size_t n = (size_t)std::min<uint64_t>(kBlockPoints, m_count - m_next);
+        out.resize(n);
+        uint64_t base = m_next;
+        ThreadPool::instance().parallelFor(n, 1 << 14, [&](size_t b, size_t e){
+            for(size_t i = b; i < e; ++i) {
+                const uint8_t* rec = record(base + i);
+                SourcePoint& p = out[i];
+                p.x = readLE<int32_t>(rec) * m_scale[0] + m_offset[0];
+                p.y = readLE<int32_t>(rec + 4) * m_scale[1] + m_offset[1];
+                p.z = readLE<int32_t>(rec + 8) * m_scale[2] + m_offset[2];
+                if(m_rgbOffset >= 0) {
+                    for(int k = 0; k < 3; ++k) p.rgba[k] = (uint8_t)std::min<int>(readLE<uint16_t>(rec + m_rgbOffset + k * 2) >> m_colorShift, 255);
+                } else {
+                    uint8_t grey = (uint8_t)std::min(readLE<uint16_t>(rec + 12) * m_intensityScale, 255.0f);
+                    p.rgba[0] = p.rgba[1] = p.rgba[2] = grey;
+                }
+                p.rgba[3] = 255;
+            }
+        });
+        m_next += n;
+        return true;
+    }
+
+    void rewind() override { m_next = 0; }
+    float position() const override { return m_count ? (float)m_next / (float)m_count : 1.0f; }
+
+    bool headerBounds(double mn[3], double mx[3]) const override {
+        for(int k = 0; k < 3; ++k) {
+            if(!(m_min[k] <= m_max[k])) return false;
+            mn[k] = m_min[k];
+            mx[k] = m_max[k];
+        }
+        return true;
+    }
+
+private:
+    const uint8_t* record(uint64_t i) const { return m_file.data() + m_dataOffset + i * m_recordLength; }
+
+    MappedFile m_file;
+    uint64_t m_dataOffset = 0;
+    uint16_t m_recordLength = 0;
+    uint64_t m_count = 0;
+    uint64_t m_next = 0;
+    int m_rgbOffset = -1;
+    int m_colorShift = 0;
+    float m_intensityScale = 1.0f;
+    double m_scale[3] = { 1.0, 1.0, 1.0 };
+    double m_offset[3] = { 0.0, 0.0, 0.0 };
+    double m_min[3] = { 0.0, 0.0, 0.0 };
+    double m_max[3] = { 0.0, 0.0, 0.0 };
+};
+
+// PLY vertex element (binary or ASCII) with x/y/z and optional red/green/blue/alpha
+class PlyReader : public PointReader {
+public:
+    bool open(const std::string& path, std::string& err) {
+        using namespace MeshParsers;
+        if(!m_file.open(path)) { err = "cannot open file"; return false; }
+        PlyHeader h;
+        if(!readPlyHeader((const char*)m_file.data(), m_file.size(), h, err)) return false;
+        m_ascii = h.format == PlyFormat::Ascii;
+        m_swap = h.format == PlyFormat::BinaryBE;
+        m_begin = h.bodyOffset;
+        // elements before the vertices are skipped (lines in ASCII files, fixed-size records in binary ones)
+        size_t linesBefore = 0;
+        const PlyElement* vertex = nullptr;
+        for(const PlyElement& e : h.elements) {
+            if(e.name == "vertex") { vertex = &e; break; }
+            if(m_ascii) { linesBefore += e.count; continue; }
+            size_t stride = 0;
+            for(const PlyProperty& p : e.props) {
+                if(p.list) { err = "PLY element before the vertices has a list property"; return false; }
+                stride += plySize(p.type);
+            }
+            m_begin += stride * e.count;
+        }
+        if(!vertex) { err = "PLY file has no vertices"; return false; }
+        m_count = vertex->count;
+        m_props = vertex->props;
+        for(int k = 0; k < 7; ++k) m_field[k] = -1;
+        for(size_t i = 0; i < m_props.size(); ++i) {
+            const std::string& n = m_props[i].name;
+            int f = n == "x" ? 0 : n == "y" ? 1 : n == "z" ? 2
+                  : (n == "red" || n == "diffuse_red" || n == "r") ? 3
+                  : (n == "green" || n == "diffuse_green" || n == "g") ? 4
+                  : (n == "blue" || n == "diffuse_blue" || n == "b") ? 5
+                  : (n == "alpha" || n == "a") ? 6 : -1;
+            if(f >= 0 && !m_props[i].list) m_field[f] = (int)i;
+            if(m_props[i].list && !m_ascii) { err = "PLY vertices with list properties are not supported"; return false; }
+        }
+        if(m_field[0] < 0 || m_field[1] < 0 || m_field[2] < 0) { err = "PLY vertices have no x, y, z"; return false; }
+        if(!m_ascii) {
+            for(const PlyProperty& p : m_props) { m_offsets.push_back(m_stride); m_stride += plySize(p.type); }
+            if(m_begin > m_file.size() || (m_file.size() - m_begin) / m_stride < m_count) { err = "PLY file is truncated"; return false; }
+        } else {
+            const char* end = (const char*)m_file.data() + m_file.size();
+            const char* p = (const char*)m_file.data() + m_begin;
+            for(size_t i = 0; i < linesBefore && p < end; ++i) {
+                const void* nl = memchr(p, '\n', (size_t)(end - p));
+                p = nl ? (const char*)nl + 1 : end;
+            }
+            m_begin = (size_t)(p - (const char*)m_file.data());
+        }
+        rewind();
+        return true;
+    }
+
+    bool next(std::vector<SourcePoint>& out) override {
+        if(m_next >= m_count) return false;
+        size_t n = (size_t)std::min<uint64_t>(kBlockPoints, m_count - m_next);
+        if(m_ascii) {
+            // line starts of the block (one sequential newline scan), then lines parsed in parallel
+            const char* end = (const char*)m_file.data() + m_file.size();
+            m_lines.clear();
+            const char* p = m_cursor;
+            while(m_lines.size() < n && p < end) {
+                m_lines.push_back(p);
+                const void* nl = memchr(p, '\n', (size_t)(end - p));
+                p = nl ? (const char*)nl + 1 : end;
+            }
+            m_lines.push_back(p);
+            m_cursor = p;
+            n = m_lines.size() - 1;
+            if(n == 0) { m_next = m_count; return false; }
+        }
+        out.resize(n);
+        uint64_t base = m_next;
+        ThreadPool::instance().parallelFor(n, 1 << 13, [&](size_t b, size_t e){
+            std::vector<double> values(m_props.size());
+            for(size_t i = b; i < e; ++i) {
+                if(m_ascii) parseLine(m_lines[i], m_lines[i + 1], values);
+                else {
+                    const uint8_t* rec = m_file.data() + m_begin + (base + i) * m_stride;
+                    for(int f = 0; f < 7; ++f) if(m_field[f] >= 0) values[m_field[f]] = MeshParsers::readPlyValue(rec + m_offsets[m_field[f]], m_props[m_field[f]].type, m_swap);
+                }
+                SourcePoint& sp = out[i];
+                sp.x = values[m_field[0]];
+                sp.y = values[m_field[1]];
+                sp.z = values[m_field[2]];
+                for(int k = 0; k < 4; ++k) sp.rgba[k] = m_field[3 + k] >= 0 ? toColor(values[m_field[3 + k]], m_props[m_field[3 + k]].type) : (k < 3 ? 200 : 255);
+            }
+        });
+        m_next += n;
+        return true;
+    }
+
+    void rewind() override {
+        m_next = 0;
+        m_cursor = (const char*)m_file.data() + m_begin;
+    }
+    float position() const override { return m_count ? (float)m_next / (float)m_count : 1.0f; }
+
+private:
+    void parseLine(const char* p, const char* le, std::vector<double>& values) const {
+        for(size_t k = 0; k < m_props.size(); ++k) {
+            while(p < le && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+            if(p < le && *p == '+') ++p;
+            double v = 0.0;
+            auto r = std::from_chars(p, le, v);
+            values[k] = r.ec == std::errc() ? v : 0.0;
+            while(p < le && *p != ' ' && *p != '\t') ++p;
+        }
+    }
+
+    static uint8_t toColor(double v, MeshParsers::PlyType t) {
+        if(t == MeshParsers::Float32 || t == MeshParsers::Float64) v *= 255.0;
+        else if(t == MeshParsers::UInt16 || t == MeshParsers::Int16) v /= 257.0;
+        return (uint8_t)std::clamp(v, 0.0, 255.0);
+    }
+
+    MappedFile m_file;
+    std::vector<MeshParsers::PlyProperty> m_props;
+    std::vector<size_t> m_offsets;
+    size_t m_stride = 0;
+    int m_field[7]; // x y z r g b a -> property index
+    bool m_ascii = false;
+    bool m_swap = false;
+    size_t m_begin = 0;
+    uint64_t m_count = 0;
+    uint64_t m_next = 0;
+    const char* m_cursor = nullptr;
+    std::vector<const char*> m_lines;
+};
+
+static inline bool validPoint(const SourcePoint& p) { return std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z); }
+
+static inline int clampCell(double v, int n) { return v <= 0.0 ? 0 : v >= (double)n ? n - 1 : (int)v; }
+
+// ---- Octree of one chunk ----
+
+// One bit per sampling cell of a node, reused by every node a worker builds
+struct SampleGrid {
+    std::vector<uint64_t> bits = std::vector<uint64_t>((size_t)PointCloud::kSampleGrid * PointCloud::kSampleGrid * PointCloud::kSampleGrid / 64, 0);
+
+    static size_t cell(const Point& p, const glm::vec3& min, float invCell) {
+        const int n = PointCloud::kSampleGrid;
+        int cx = clampCell((p.x - min.x) * invCell, n), cy = clampCell((p.y - min.y) * invCell, n), cz = clampCell((p.z - min.z) * invCell, n);
+        return ((size_t)cz * n + cy) * n + cx;
+    }
+    // true when the cell was empty
+    bool claim(size_t c) {
+        uint64_t bit = 1ull << (c & 63);
+        if(bits[c >> 6] & bit) return false;
+        bits[c >> 6] |= bit;
+        return true;
+    }
+    void release(size_t c) { bits[c >> 6] &= ~(1ull << (c & 63)); }
+};
+
+static inline int octant(const Point& p, const glm::vec3& center) {
+    return (p.x >= center.x ? 1 : 0) | (p.y >= center.y ? 2 : 0) | (p.z >= center.z ? 4 : 0);
+}
+
+// Build the subtree of points [b, e) (shuffled) in the cube (min, size). Each node's points are appended
+// to 'out' in node order; returns the node index in 'nodes' (relative to the chunk).
+static int32_t buildSubtree(std::vector<Point>& pts, size_t b, size_t e, const glm::vec3& min, float size, int depth,
+                            std::vector<Node>& nodes, std::vector<Point>& out, SampleGrid& grid) {
+    int32_t self = (int32_t)nodes.size();
+    Node node;
+    node.min = min;
+    node.size = size;
+    node.spacing = 0.0f;
+    node.first = out.size();
+    node.count = 0;
+    for(int32_t& c : node.children) c = -1;
+    nodes.push_back(node);
+    if(e - b <= kMaxNodePoints || depth >= kMaxDepth) {
+        out.insert(out.end(), pts.begin() + b, pts.begin() + e);
+        nodes[self].count = (uint32_t)(e - b);
+        return self;
+    }
+    // keep the first point of every sampling cell (the points are shuffled), pass the rest down by octant
+    float invCell = PointCloud::kSampleGrid / size;
+    glm::vec3 center = min + glm::vec3(size * 0.5f);
+    size_t kept = out.size();
+    size_t counts[8] = { 0 };
+    std::vector<uint8_t> oct(e - b, 0xff);
+    for(size_t i = b; i < e; ++i) {
+        if(grid.claim(SampleGrid::cell(pts[i], min, invCell))) out.push_back(pts[i]);
+        else { oct[i - b] = (uint8_t)octant(pts[i], center); counts[oct[i - b]]++; }
+    }
+    for(size_t i = kept; i < out.size(); ++i) grid.release(SampleGrid::cell(out[i], min, invCell));
+    nodes[self].count = (uint32_t)(out.size() - kept);
+    nodes[self].spacing = size / PointCloud::kSampleGrid;
+
+    // regroup the remaining points by octant inside [b, e)
+    size_t starts[9] = { b };
+    for(int o = 0; o < 8; ++o) starts[o + 1] = starts[o] + counts[o];
+    {
+        std::vector<Point> tmp(starts[8] - b);
+        size_t cursor[8];
+        for(int o = 0; o < 8; ++o) cursor[o] = starts[o] - b;
+        for(size_t i = b; i < e; ++i) if(oct[i - b] != 0xff) tmp[cursor[oct[i - b]]++] = pts[i];
+        std::copy(tmp.begin(), tmp.end(), pts.begin() + b);
+    }
+    oct.clear();
+    oct.shrink_to_fit();
+    float half = size * 0.5f;
+    for(int o = 0; o < 8; ++o) {
+        if(counts[o] == 0) continue;
+        glm::vec3 cmin = min + glm::vec3((o & 1) ? half : 0.0f, (o & 2) ? half : 0.0f, (o & 4) ? half : 0.0f);
+        int32_t child = buildSubtree(pts, starts[o], starts[o + 1], cmin, half, depth + 1, nodes, out, grid);
+        nodes[self].children[o] = child;
+    }
+    return self;
+}
+
+static bool readRecords(std::fstream& f, uint64_t first, Point* dst, size_t count) {
+    f.seekg((std::streamoff)(sizeof(PointCloud::FileHeader) + first * sizeof(Point)));
+    f.read((char*)dst, (std::streamsize)(count * sizeof(Point)));
+    return (bool)f;
+}
+
+static bool writeRecords(std::fstream& f, uint64_t first, const Point* src, size_t count) {
+    f.seekp((std::streamoff)(sizeof(PointCloud::FileHeader) + first * sizeof(Point)));
+    f.write((const char*)src, (std::streamsize)(count * sizeof(Point)));
+    return (bool)f;
+}
+
+static std::unique_ptr<PointReader> openReader(const std::string& path, std::string& err) {
+    std::string ext = std::filesystem::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    if(ext == ".las") {
+        auto r = std::make_unique<LasReader>();
+        if(r->open(path, err)) return r;
+    } else {
+        auto r = std::make_unique<PlyReader>();
+        if(r->open(path, err)) return r;
+    }
+    return nullptr;
+}
+
+} // anonymous
+
+namespace PointCloudBuilder {
+
+bool isPointCloud(const std::string& path) {
+    std::string ext = std::filesystem::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    if(ext == ".las") return true;
+    if(ext != ".ply") return false;
+    MappedFile file;
+    if(!file.open(path)) return false;
+    MeshParsers::PlyHeader h;
+    std::string err;
+    if(!MeshParsers::readPlyHeader((const char*)file.data(), file.size(), h, err)) return false;
+    bool vertices = false, faces = false;
+    for(const MeshParsers::PlyElement& e : h.elements) {
+        if(e.name == "vertex" && e.count > 0) vertices = true;
+        if(e.name == "face" && e.count > 0) faces = true;
+    }
+    return vertices && !faces;
+}
+
+bool build(const std::string& path, std::string& err, std::atomic<float>* progress, const std::atomic<bool>* cancel) {
+    MeshCache::SourceKey key;
+    if(!MeshCache::sourceKey(path, 0, key)) { err = "cannot read file"; return false; }
+    {
+        std::string stale;
+        if(PointCloud::open(path, stale)) return true;
+    }
+    std::unique_ptr<PointReader> reader = openReader(path, err);
+    if(!reader) return false;
+    ThreadPool& pool = ThreadPool::instance();
+    auto report = [&](float begin, float end, float f){ if(progress) *progress = begin + (end - begin) * f; };
+    auto cancelled = [&]{ return cancel && cancel->load(); };
+    std::vector<SourcePoint> block;
+    auto dropInvalid = [&]{ block.erase(std::remove_if(block.begin(), block.end(), [](const SourcePoint& p){ return !validPoint(p); }), block.end()); };
+
+    // 1. bounds
+    double mn[3], mx[3];
+    bool fromHeader = reader->headerBounds(mn, mx);
+    if(!fromHeader) {
+        for(int k = 0; k < 3; ++k) { mn[k] = DBL_MAX; mx[k] = -DBL_MAX; }
+        while(reader->next(block)) {
+            if(cancelled()) { err = "cancelled"; return false; }
+            for(const SourcePoint& p : block) {
+                if(!validPoint(p)) continue;
+                double v[3] = { p.x, p.y, p.z };
+                for(int k = 0; k < 3; ++k) { mn[k] = std::min(mn[k], v[k]); mx[k] = std::max(mx[k], v[k]); }
+            }
+            report(0.0f, 0.1f, reader->position());
+        }
+        reader->rewind();
+        if(mn[0] > mx[0]) { err = "no points"; return false; }
+    }
+    double origin[3], rootSize = 0.0;
+    for(int k = 0; k < 3; ++k) { origin[k] = 0.5 * (mn[k] + mx[k]); rootSize = std::max(rootSize, mx[k] - mn[k]); }
+    // a little slack: header bounds are rounded, and points on the far faces must fall inside
+    rootSize = rootSize > 0.0 ? rootSize * 1.001 : 1.0;
+    double rootMin[3] = { origin[0] - rootSize * 0.5, origin[1] - rootSize * 0.5, origin[2] - rootSize * 0.5 };
+    const OctreeChunks::Grid grid(rootMin, rootSize);
+    auto countCell = [&](const SourcePoint& p){ return grid.cell(p.x, p.y, p.z); };
+
+    // 2. points per counting cell, and the tight bounds
+    auto counts = std::make_unique<OctreeChunks::Counts>();
+    glm::vec3 tightMin(FLT_MAX), tightMax(-FLT_MAX);
+    std::mutex boundsMtx;
+    uint64_t total = 0;
+    while(reader->next(block)) {
+        if(cancelled()) { err = "cancelled"; return false; }
+        dropInvalid();
+        pool.parallelFor(block.size(), 1 << 14, [&](size_t b, size_t e){
+            glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+            for(size_t i = b; i < e; ++i) {
+                counts->add(countCell(block[i]));
+                glm::vec3 p((float)(block[i].x - origin[0]), (float)(block[i].y - origin[1]), (float)(block[i].z - origin[2]));
+                lo = glm::min(lo, p);
+                hi = glm::max(hi, p);
+            }
+            std::lock_guard<std::mutex> lk(boundsMtx);
+            tightMin = glm::min(tightMin, lo);
+            tightMax = glm::max(tightMax, hi);
+        });
+        total += block.size();
+        report(0.1f, 0.3f, reader->position());
+    }
+    if(total == 0) { err = "no points"; return false; }
+
+    const OctreeChunks::Layout layout = OctreeChunks::build(*counts, kMaxChunkPoints);
+    counts.reset();
+
+    // 3. copy the points into their chunk's range of the container (header and node table come last)
+    std::string outPath = PointCloud::containerPath(path);
+    std::string tmpPath = outPath + ".tmp";
+    auto fail = [&](const std::string& message){
+        err = message;
+        std::error_code ec;
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    };
+    {
+        std::fstream f(tmpPath, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+        if(!f) return fail("cannot write " + tmpPath);
+        OctreeChunks::Scatter<Point> scatter(layout);
+        std::vector<uint32_t> chunkOf;
+        std::vector<Point> packed;
+        reader->rewind();
+        while(reader->next(block)) {
+            if(cancelled()) return fail("cancelled");
+            dropInvalid();
+            size_t n = block.size();
+            chunkOf.resize(n);
+            packed.resize(n);
+            pool.parallelFor(n, 1 << 14, [&](size_t b, size_t e){
+                for(size_t i = b; i < e; ++i) {
+                    const SourcePoint& s = block[i];
+                    chunkOf[i] = layout.cellChunk[countCell(s)];
+                    Point& p = packed[i];
+                    p.x = (float)(s.x - origin[0]);
+                    p.y = (float)(s.y - origin[1]);
+                    p.z = (float)(s.z - origin[2]);
+                    memcpy(p.rgba, s.rgba, 4);
+                }
+            });
+            if(!scatter.add(chunkOf, packed, [&](uint64_t first, const Point* src, size_t count){ return writeRecords(f, first, src, count); }))
+                return fail(scatter.overflowed() ? "the file changed during the import" : "cannot write " + tmpPath);
+            report(0.3f, 0.6f, reader->position());
+        }
+        if(!scatter.complete()) return fail("the file changed during the import");
+    }
+    reader.reset();
+
+    // 4. octree of every chunk, in parallel; each worker rewrites its chunk's range in node order
+    std::vector<std::vector<Node>> chunkNodes(layout.chunks.size());
+    std::atomic<uint64_t> pointsDone{0};
+    std::atomic<bool> ioError{false};
+    pool.parallelFor(layout.chunks.size(), 1, [&](size_t b, size_t e){
+        SampleGrid grid;
+        for(size_t c = b; c < e; ++c) {
+            if(cancelled() || ioError) return;
+            const OctreeChunks::Chunk& ch = layout.chunks[c];
+            std::fstream f(tmpPath, std::ios::in | std::ios::out | std::ios::binary);
+            std::vector<Point> pts(ch.count), out;
+            if(!f || !readRecords(f, ch.first, pts.data(), pts.size())) { ioError = true; return; }
+            // sampling keeps the first point per cell, so shuffle away the scan order
+            std::mt19937 rng((uint32_t)c);
+            std::shuffle(pts.begin(), pts.end(), rng);
+            out.reserve(pts.size());
+            float size = (float)(rootSize / (1 << ch.level));
+            glm::vec3 min((float)(rootMin[0] - origin[0] + ch.x * (double)size), (float)(rootMin[1] - origin[1] + ch.y * (double)size),
+                          (float)(rootMin[2] - origin[2] + ch.z * (double)size));
+            buildSubtree(pts, 0, pts.size(), min, size, ch.level, chunkNodes[c], out, grid);
+            for(Node& n : chunkNodes[c]) n.first += ch.first;
+            if(!writeRecords(f, ch.first, out.data(), out.size())) { ioError = true; return; }
+            pointsDone += ch.count;
+            report(0.6f, 0.95f, (float)pointsDone.load() / (float)total);
+        }
+    });
+    if(cancelled()) return fail("cancelled");
+    if(ioError) return fail("cannot write " + tmpPath);
+
+    // node table: the nodes above the chunks first (root = 0), then every chunk's subtree
+    std::vector<Node> nodes(layout.uppers.size());
+    std::vector<int32_t> chunkBase(layout.chunks.size());
+    for(size_t c = 0; c < layout.chunks.size(); ++c) {
+        chunkBase[c] = (int32_t)nodes.size();
+        for(Node n : chunkNodes[c]) {
+            for(int32_t& child : n.children) if(child >= 0) child += chunkBase[c];
+            nodes.push_back(n);
+        }
+        std::vector<Node>().swap(chunkNodes[c]);
+    }
+    auto resolve = [&](int32_t ref){ return ref <= -2 ? chunkBase[-2 - ref] : ref; };
+
+    // 5. nodes above the chunks, children before parents: each takes one point per sampling cell from
+    // its children's points, which keep the rest. Its points go after all the chunk ranges.
+    uint64_t recordEnd = layout.total;
+    {
+        std::fstream f(tmpPath, std::ios::in | std::ios::out | std::ios::binary);
+        if(!f) return fail("cannot write " + tmpPath);
+        SampleGrid grid;
+        std::mt19937 rng(12345);
+        for(size_t u = layout.uppers.size(); u-- > 0;) {
+            const OctreeChunks::Layout::Upper& up = layout.uppers[u];
+            Node& node = nodes[u];
+            node.size = (float)(rootSize / (1 << up.level));
+            node.min = glm::vec3((float)(rootMin[0] - origin[0] + up.x * (double)node.size), (float)(rootMin[1] - origin[1] + up.y * (double)node.size),
+                                 (float)(rootMin[2] - origin[2] + up.z * (double)node.size));
+            node.spacing = node.size / PointCloud::kSampleGrid;
+            for(int o = 0; o < 8; ++o) node.children[o] = up.children[o] == -1 ? -1 : resolve(up.children[o]);
+
+            // candidates tagged with their child slot
+            std::vector<std::pair<Point, uint8_t>> candidates;
+            for(int o = 0; o < 8; ++o) {
+                if(node.children[o] < 0) continue;
+                const Node& child = nodes[node.children[o]];
+                std::vector<Point> pts(child.count);
+                if(!readRecords(f, child.first, pts.data(), pts.size())) return fail("cannot read " + tmpPath);
+                for(const Point& p : pts) candidates.push_back({ p, (uint8_t)o });
+            }
+            std::shuffle(candidates.begin(), candidates.end(), rng);
+            std::vector<Point> kept;
+            std::vector<Point> remaining[8];
+            float invCell = PointCloud::kSampleGrid / node.size;
+            for(const auto& c : candidates) {
+                if(grid.claim(SampleGrid::cell(c.first, node.min, invCell))) kept.push_back(c.first);
+                else remaining[c.second].push_back(c.first);
+            }
+            for(const Point& p : kept) grid.release(SampleGrid::cell(p, node.min, invCell));
+            for(int o = 0; o < 8; ++o) {
+                if(node.children[o] < 0) continue;
+                Node& child = nodes[node.children[o]];
+                child.count = (uint32_t)remaining[o].size();
+                if(!writeRecords(f, child.first, remaining[o].data(), remaining[o].size())) return fail("cannot write " + tmpPath);
+            }
+            node.first = recordEnd;
+            node.count = (uint32_t)kept.size();
+            if(!writeRecords(f, recordEnd, kept.data(), kept.size())) return fail("cannot write " + tmpPath);
+            recordEnd += kept.size();
+            if(cancelled()) return fail("cancelled");
+        }
+
+        PointCloud::FileHeader h = {};
+        h.magic = PointCloud::kMagic;
+        h.version = PointCloud::kVersion;
+        h.headerBytes = sizeof(h);
+        h.nodeCount = (uint32_t)nodes.size();
+        h.sourceSize = key.size;
+        h.sourceTime = key.time;
+        h.pointCount = total;
+        h.recordCount = recordEnd;
+        memcpy(h.origin, origin, sizeof(origin));
+        for(int k = 0; k < 3; ++k) { h.boundsMin[k] = tightMin[k]; h.boundsMax[k] = tightMax[k]; }
+        h.nodeTableOffset = sizeof(h) + recordEnd * sizeof(Point);
+        h.nodeTableChecksum = XXHash::hash64(nodes.data(), nodes.size() * sizeof(Node));
+        h.headerChecksum = XXHash::hash64(&h, offsetof(PointCloud::FileHeader, headerChecksum));
+        f.seekp((std::streamoff)h.nodeTableOffset);
+        f.write((const char*)nodes.data(), (std::streamsize)(nodes.size() * sizeof(Node)));
+        f.seekp(0);
+        f.write((const char*)&h, sizeof(h));
+        if(!f) return fail("cannot write " + tmpPath);
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, outPath, ec);
+    if(ec) return fail("cannot write " + outPath);
+    report(0.0f, 1.0f, 1.0f);
+    LOG_INFO("Built point cloud octree " << outPath << ": " << total << " points, " << nodes.size() << " nodes, "
+             << layout.chunks.size() << " chunks");
+    return true;
+}
+
+} // namespace PointCloudBuilder
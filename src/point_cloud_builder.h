@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <atomic>
+
+// Converts a scanned point cloud (LAS 1.0-1.4 uncompressed, or PLY with vertices and no faces) into the
+// octree container read by PointCloud, without ever holding the whole cloud in memory:
+//   1. bounds (from the LAS header, or a pass over the file)
+//   2. a pass counting points per cell of a 128^3 grid; cells are merged up into chunks of at most a
+//      few million points
+//   3. a pass copying the points into their chunk's range of the container
+//   4. per chunk, in parallel: an octree built top-down, each node keeping one point per sampling cell
+//      and passing the rest to its children; the chunk's range is rewritten in node order
+//   5. the nodes above the chunks, sampled bottom-up from their children's points
+// The source is memory-mapped and read in blocks decoded on the thread pool.
+namespace PointCloudBuilder {
+    // True for files imported as point clouds: LAS, and PLY files whose header has no faces
+    bool isPointCloud(const std::string& path);
+
+    // Write "<asset>.nvpc" unless an up-to-date one exists. 'progress' (0..1) and 'cancel' are optional.
+    bool build(const std::string& path, std::string& err, std::atomic<float>* progress = nullptr, const std::atomic<bool>* cancel = nullptr);
+}
@@ -0,0 +1,146 @@
+#include "point_cloud_streamer.h"
+#include "point_cloud.h"
+#include "node_residency.h"
+#include "scene.h"
+#include <algorithm>
+#include <memory>
+#include <queue>
+
+int g_pointCloudPointBudget = 10000000;
+int g_pointCloudMemoryMB = 1024;
+float g_pointCloudScreenError = 1.5f;
+float g_pointCloudMaxPointSize = 4.0f;
+
+namespace {
+
+// Points of a node, copied out of the mapped container
+struct NodePoints {
+    std::vector<PointCloud::Point> points;
+
+    void read(const PointCloud& cloud, size_t node) {
+        const PointCloud::Node& n = cloud.nodes()[node];
+        const PointCloud::Point* p = cloud.points(n);
+        points.assign(p, p + n.count);
+    }
+    size_t bytes() const { return points.size() * sizeof(PointCloud::Point); }
+    void upload(PointCloud& cloud, size_t node) const { cloud.uploadNode(node, points.data()); }
+};
+
+// Bytes uploaded per pump(); a node is at most a few MB, so a frame uploads a handful of them
+static const size_t kFrameUploadBytes = 48u << 20;
+// Node reads queued on the thread pool at once; more would only delay the nodes selected next frame
+static const size_t kMaxLoadsInFlight = 64;
+
+static NodeResidency<PointCloud, NodePoints> s_residency(0, kMaxLoadsInFlight, kFrameUploadBytes);
+static bool s_synchronous = false;
+static PointCloudStreamer::Stats s_stats;
+
+struct CloudView {
+    std::shared_ptr<PointCloud> cloud;
+    glm::mat4 mvp;
+    glm::vec3 camera; // in the cloud's local space
+    Frustum frustum;
+};
+
+struct Candidate {
+    float priority; // projected size, largest first
+    uint32_t cloud;
+    int32_t node;
+    bool operator<(const Candidate& o) const { return priority < o.priority; }
+};
+
+static std::vector<const PointCloud*> sceneClouds(const Scene& scene) {
+    return NodeResidency<PointCloud, NodePoints>::inScene(scene, scene.pointCloudIds(), &SceneEntity::pointCloud);
+}
+
+static size_t memoryBudget() { return (size_t)std::max(g_pointCloudMemoryMB, 0) << 20; }
+
+} // namespace
+
+namespace PointCloudStreamer {
+
+void select(const Scene& scene, const glm::mat4& view, const glm::mat4& proj, int viewportHeight, std::vector<DrawNode>& out) {
+    out.clear();
+    // nothing calls pump() between offline frames; keep to the memory budget here
+    if(s_synchronous) s_residency.evict(sceneClouds(scene), memoryBudget());
+    s_residency.beginFrame();
+    s_stats.selectedNodes = 0;
+    s_stats.drawnPoints = 0;
+
+    std::vector<CloudView> clouds;
+    for(int id : scene.pointCloudIds()) {
+        const SceneEntity* e = scene.findById(id);
+        if(!e || !e->pointCloud || e->pointCloud->nodes().empty()) continue;
+        glm::mat4 mv = view * e->world;
+        glm::mat4 mvp = proj * mv;
+        clouds.push_back({ e->pointCloud, mvp, glm::vec3(glm::inverse(mv)[3]), Frustum(mvp) });
+        s_residency.track(e->pointCloud);
+    }
+    if(clouds.empty()) return;
+
+    // pixels covered by one unit at distance one
+    float pixelsPerUnit = proj[1][1] * (float)viewportHeight * 0.5f;
+    std::priority_queue<Candidate> queue;
+    auto push = [&](uint32_t c, int32_t n) {
+        const CloudView& cv = clouds[c];
+        const PointCloud::Node& node = cv.cloud->nodes()[n];
+        if(!cv.frustum.intersects(node.min, node.min + glm::vec3(node.size))) return;
+        float radius = node.size * 0.8660254f;
+        float dist = glm::length(node.min + glm::vec3(node.size * 0.5f) - cv.camera);
+        // nearest distance to the node's bounding sphere; a node around the camera is the largest on screen
+        float nearest = std::max(dist - radius, node.size * 1e-4f);
+        queue.push({ node.size / nearest, c, n });
+    };
+    for(uint32_t c = 0; c < clouds.size(); ++c) push(c, 0);
+
+    size_t budget = (size_t)std::max(g_pointCloudPointBudget, 0);
+    size_t points = 0;
+    while(!queue.empty()) {
+        Candidate cand = queue.top();
+        queue.pop();
+        const CloudView& cv = clouds[cand.cloud];
+        PointCloud& cloud = *cv.cloud;
+        const PointCloud::Node& node = cloud.nodes()[cand.node];
+        if(points > 0 && points + node.count > budget) break;
+        points += node.count;
+        s_stats.selectedNodes++;
+
+        float radius = node.size * 0.8660254f;
+        float dist = glm::length(node.min + glm::vec3(node.size * 0.5f) - cv.camera);
+        float nearest = std::max(dist - radius, node.size * 1e-4f);
+        if(node.spacing > 0.0f && node.spacing * pixelsPerUnit / nearest > g_pointCloudScreenError) {
+            for(int32_t child : node.children) if(child >= 0) push(cand.cloud, child);
+        }
+        if(node.count == 0) continue;
+
+        PointCloud::GpuNode& g = cloud.gpuNodes()[cand.node];
+        if(g.vao == 0 && s_synchronous) s_residency.uploadNow(cloud, cand.node);
+        if(g.vao != 0) {
+            // points of one sampling cell, sized at the node's center; leaves are drawn as finely as their parent's children
+            float cell = (node.spacing > 0.0f ? node.spacing : node.size / PointCloud::kSampleGrid) * pixelsPerUnit / std::max(dist, 1e-6f);
+            float pointSize = std::min(std::max(cell, 1.0f), std::max(g_pointCloudMaxPointSize, 1.0f));
+            g.lastUsedFrame = s_residency.frame();
+            out.push_back({ g.vao, (GLsizei)node.count, cv.mvp, pointSize });
+            s_stats.drawnPoints += node.count;
+        } else if(!g.loading && s_residency.canLoad()) {
+            s_residency.requestLoad(cv.cloud, cand.node);
+        }
+    }
+}
+
+bool pump(const Scene& scene) { return s_residency.pump(sceneClouds(scene), memoryBudget()); }
+
+unsigned int revision() { return s_residency.revision(); }
+
+void setSynchronous(bool synchronous) { s_synchronous = synchronous; }
+
+Stats stats() {
+    Stats st = s_stats;
+    s_residency.residentTotals(st.residentNodes, st.residentBytes);
+    st.loadsInFlight = s_residency.loadsInFlight();
+    return st;
+}
+
+void destroy() { s_residency.destroy(); }
+
+} // namespace PointCloudStreamer
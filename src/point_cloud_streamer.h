@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+class Scene;
+
+// Points drawn per frame over all point clouds
+extern int g_pointCloudPointBudget;
+// GPU memory kept for loaded nodes (MB); the least recently drawn nodes beyond it are released
+extern int g_pointCloudMemoryMB;
+// Screen-space error: a node is refined while its point spacing covers more pixels than this
+extern float g_pointCloudScreenError;
+// Largest point size, used to close the gaps between the points of coarse nodes
+extern float g_pointCloudMaxPointSize;
+
+// Level-of-detail selection and GPU streaming for the point-cloud entities of a scene.
+// Each frame the octree nodes in the view frustum are refined largest-on-screen first until the point
+// budget is spent or their point spacing is under the screen-space error. Selected nodes that are not
+// on the GPU are read from the mapped container on the thread pool and uploaded by pump() within a
+// per-frame byte budget; meanwhile their parent, which covers the same space more coarsely, is drawn.
+//
+// All functions must be called on the GL thread.
+namespace PointCloudStreamer {
+    struct DrawNode {
+        GLuint vao = 0;
+        GLsizei count = 0;
+        glm::mat4 mvp = glm::mat4(1.0f);
+        float pointSize = 1.0f;
+    };
+
+    // Nodes to draw for the given view, and queue loads for the missing ones
+    void select(const Scene& scene, const glm::mat4& view, const glm::mat4& proj, int viewportHeight, std::vector<DrawNode>& out);
+
+    // Upload loaded nodes of the scene's clouds and release nodes over the memory budget, and those of
+    // clouds removed from the scene. Call once per frame. Returns true while loads are in flight.
+    bool pump(const Scene& scene);
+
+    // Bumped whenever nodes become resident or are released; a view showing point clouds is stale
+    // when it changes
+    unsigned int revision();
+
+    // Load selected nodes inside select() instead of streaming them (offline rendering wants complete frames)
+    void setSynchronous(bool synchronous);
+
+    struct Stats {
+        size_t selectedNodes = 0;
+        size_t drawnPoints = 0;
+        size_t residentNodes = 0;
+        size_t residentBytes = 0;
+        size_t loadsInFlight = 0;
+    };
+    Stats stats();
+
+    // Drop queued loads and forget the tracked clouds (their GPU nodes are freed with the clouds)
+    void destroy();
+}
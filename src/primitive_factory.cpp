@@ -1,41 +1,81 @@
 #include "primitive_factory.h"
+#include "gl_state.h"
+#include "upload_queue.h"
 #include <glad/glad.h>
 #include <vector>
 #include <cmath>
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <glm/gtc/matrix_transform.hpp>
 
 namespace primitives {
 
 MeshGL::~MeshGL() {
-    if (ebo) { glDeleteBuffers(1, &ebo); ebo = 0; }
-    if (vbo) { glDeleteBuffers(1, &vbo); vbo = 0; }
-    if (vao) { glDeleteVertexArrays(1, &vao); vao = 0; }
+    if(uploadPending) UploadQueue::cancel(this);
+    GLState::deleteBuffer(ebo);
+    GLState::deleteBuffer(vbo);
+    GLState::deleteVertexArray(vao);
 }
 
 MeshGL::MeshGL(MeshGL&& other) noexcept {
+    if(other.uploadPending) UploadQueue::retarget(&other, this);
+    uploadPending = other.uploadPending;
     vao = other.vao; vbo = other.vbo; ebo = other.ebo; indexCount = other.indexCount;
+    indexType = other.indexType; quantizedPositions = other.quantizedPositions; gpuBytes = other.gpuBytes;
     aabbMin = other.aabbMin; aabbMax = other.aabbMax;
+    pagedOut = other.pagedOut; pagedGpuBytes = other.pagedGpuBytes; pagedCpuBytes = other.pagedCpuBytes;
     cpuPositions = std::move(other.cpuPositions);
     cpuIndices = std::move(other.cpuIndices);
     bvhNodes = std::move(other.bvhNodes);
-    other.vao = other.vbo = other.ebo = 0; other.indexCount = 0;
+    pending = std::move(other.pending);
+    coarse = std::move(other.coarse);
+    other.vao = other.vbo = other.ebo = 0; other.indexCount = 0; other.gpuBytes = 0; other.uploadPending = false; other.pending.reset();
 }
 
 MeshGL& MeshGL::operator=(MeshGL&& other) noexcept {
     if(this != &other){
-        if (ebo) { glDeleteBuffers(1, &ebo); }
-        if (vbo) { glDeleteBuffers(1, &vbo); }
-        if (vao) { glDeleteVertexArrays(1, &vao); }
+        if(uploadPending) UploadQueue::cancel(this);
+        if(other.uploadPending) UploadQueue::retarget(&other, this);
+        uploadPending = other.uploadPending;
+        GLState::deleteBuffer(ebo);
+        GLState::deleteBuffer(vbo);
+        GLState::deleteVertexArray(vao);
         vao = other.vao; vbo = other.vbo; ebo = other.ebo; indexCount = other.indexCount;
+        indexType = other.indexType; quantizedPositions = other.quantizedPositions; gpuBytes = other.gpuBytes;
         aabbMin = other.aabbMin; aabbMax = other.aabbMax;
+        pagedOut = other.pagedOut; pagedGpuBytes = other.pagedGpuBytes; pagedCpuBytes = other.pagedCpuBytes;
         cpuPositions = std::move(other.cpuPositions);
         cpuIndices = std::move(other.cpuIndices);
         bvhNodes = std::move(other.bvhNodes);
-        other.vao = other.vbo = other.ebo = 0; other.indexCount = 0;
+        pending = std::move(other.pending);
+        coarse = std::move(other.coarse);
+        other.vao = other.vbo = other.ebo = 0; other.indexCount = 0; other.gpuBytes = 0; other.uploadPending = false; other.pending.reset();
     }
     return *this;
 }
 
+size_t MeshGL::cpuBytes() const {
+    return cpuPositions.size() * sizeof(glm::vec3) + cpuIndices.size() * sizeof(unsigned int) + bvhNodes.size() * sizeof(BVHNode);
+}
+
+void MeshGL::release() {
+    if(pagedOut) return;
+    if(uploadPending) UploadQueue::cancel(this);
+    uploadPending = false;
+    pagedGpuBytes = gpuBytes;
+    pagedCpuBytes = cpuBytes();
+    GLState::deleteBuffer(ebo);
+    GLState::deleteBuffer(vbo);
+    GLState::deleteVertexArray(vao);
+    gpuBytes = 0;
+    std::vector<glm::vec3>().swap(cpuPositions);
+    std::vector<unsigned int>().swap(cpuIndices);
+    std::vector<BVHNode>().swap(bvhNodes);
+    pending.reset();
+    pagedOut = true;
+}
+
 // Simple helper to compute triangle centroid bounding box split
 static void computeTriangleAABB(const std::vector<glm::vec3>& pos, const std::vector<unsigned int>& idx, int triStart, int triCount, glm::vec3& outMin, glm::vec3& outMax, glm::vec3& outCentroidMin, glm::vec3& outCentroidMax) {
     outMin = glm::vec3(FLT_MAX); outMax = glm::vec3(-FLT_MAX);
@@ -103,7 +143,48 @@ static int buildBVHRecursive(MeshGL& mesh, int triStart, int triCount) {
     return myIndex;
 }
 
-void MeshGL::upload(const std::vector<float>& verts, const std::vector<unsigned int>& idx) {
+// Pack positions (quantized against the mesh's AABB when asked) and indices into the pending GPU buffers
+static void packBuffers(MeshGL& m, const std::vector<float>& verts, const std::vector<unsigned int>& idx, bool quantizePositions) {
+    struct PackedBuffers { std::vector<uint8_t> vertices, indices; };
+    auto packedBuffers = std::make_shared<PackedBuffers>();
+    std::vector<uint8_t>& vdata = packedBuffers->vertices;
+    std::vector<uint8_t>& idata = packedBuffers->indices;
+    size_t vcount = m.cpuPositions.size();
+    m.quantizedPositions = quantizePositions && vcount > 0;
+    if(m.quantizedPositions) {
+        // 16-bit unorm per axis relative to the AABB, padded to 8 bytes per vertex
+        glm::vec3 ext = m.aabbMax - m.aabbMin;
+        glm::vec3 inv(ext.x > 0.0f ? 1.0f / ext.x : 0.0f, ext.y > 0.0f ? 1.0f / ext.y : 0.0f, ext.z > 0.0f ? 1.0f / ext.z : 0.0f);
+        vdata.assign(vcount * 4 * sizeof(uint16_t), 0);
+        uint16_t* packed = (uint16_t*)vdata.data();
+        for(size_t i=0;i<vcount;++i){
+            glm::vec3 n = glm::clamp((m.cpuPositions[i] - m.aabbMin) * inv, 0.0f, 1.0f);
+            packed[i*4+0] = (uint16_t)(n.x * 65535.0f + 0.5f);
+            packed[i*4+1] = (uint16_t)(n.y * 65535.0f + 0.5f);
+            packed[i*4+2] = (uint16_t)(n.z * 65535.0f + 0.5f);
+        }
+    } else {
+        vdata.resize(verts.size() * sizeof(float));
+        if(!verts.empty()) memcpy(vdata.data(), verts.data(), vdata.size());
+    }
+
+    if(vcount < 65536) {
+        m.indexType = GL_UNSIGNED_SHORT;
+        idata.resize(idx.size() * sizeof(uint16_t));
+        uint16_t* out = (uint16_t*)idata.data();
+        for(size_t i=0;i<idx.size();++i) out[i] = (uint16_t)idx[i];
+    } else {
+        m.indexType = GL_UNSIGNED_INT;
+        idata.resize(idx.size() * sizeof(unsigned int));
+        if(!idx.empty()) memcpy(idata.data(), idx.data(), idata.size());
+    }
+    m.indexCount = (int)idx.size();
+    m.pending.vertices = vdata.data(); m.pending.vertexBytes = vdata.size();
+    m.pending.indices = idata.data(); m.pending.indexBytes = idata.size();
+    m.pending.owner = packedBuffers;
+}
+
+void MeshGL::build(const std::vector<float>& verts, const std::vector<unsigned int>& idx, bool quantizePositions) {
     // compute AABB from vertex positions (assume verts.size() % 3 == 0)
     cpuPositions.clear(); cpuIndices.clear(); bvhNodes.clear();
     if(!verts.empty()){
@@ -132,25 +213,93 @@ void MeshGL::upload(const std::vector<float>& verts, const std::vector<unsigned
         buildBVHRecursive(*this, 0, triCount);
     }
 
-    if (vao == 0) glGenVertexArrays(1, &vao);
-    if (vbo == 0) glGenBuffers(1, &vbo);
-    if (ebo == 0) glGenBuffers(1, &ebo);
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(float), verts.data(), GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size() * sizeof(unsigned int), idx.data(), GL_STATIC_DRAW);
+    // Pack the GPU buffers now so the main-thread upload is a plain copy
+    packBuffers(*this, verts, idx, quantizePositions);
+}
+
+void MeshGL::buildCoarse(const std::vector<float>& verts, const std::vector<unsigned int>& idx) {
+    coarse.reset(new MeshGL());
+    coarse->aabbMin = aabbMin; coarse->aabbMax = aabbMax;
+    size_t vcount = verts.size() / 3;
+    coarse->cpuPositions.resize(vcount);
+    for(size_t i=0;i<vcount;++i) coarse->cpuPositions[i] = glm::vec3(verts[i*3+0], verts[i*3+1], verts[i*3+2]);
+    coarse->cpuIndices = idx;
+    // same decode as this mesh; the coarse vertices are averages, so they stay inside the AABB
+    packBuffers(*coarse, verts, idx, quantizedPositions);
+}
+
+// Create the VAO and buffers; with null data the buffers are only allocated
+static void createBuffers(MeshGL& m, const void* vertexData, const void* indexData) {
+    if (m.vao == 0) glGenVertexArrays(1, &m.vao);
+    if (m.vbo == 0) glGenBuffers(1, &m.vbo);
+    if (m.ebo == 0) glGenBuffers(1, &m.ebo);
+    GLState::bindVertexArray(m.vao);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, m.vbo);
+    glBufferData(GL_ARRAY_BUFFER, m.pending.vertexBytes, vertexData, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glBindVertexArray(0);
-    indexCount = (int)idx.size();
+    if(m.quantizedPositions) glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, 4 * sizeof(uint16_t), (void*)0);
+    else glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m.ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m.pending.indexBytes, indexData, GL_STATIC_DRAW);
+    m.gpuBytes = m.pending.bytes();
+}
+
+void MeshGL::uploadGPU() {
+    if(uploadPending) UploadQueue::cancel(this);
+    createBuffers(*this, pending.vertices, pending.indices);
+    // the GL owns the data now
+    pending.reset();
 }
 
+void MeshGL::uploadStreamed() {
+    // the coarse level is drawn until the streamed copies are done
+    uploadCoarse();
+    if(uploadPending) UploadQueue::cancel(this);
+    createBuffers(*this, nullptr, nullptr);
+    UploadQueue::enqueue(this);
+}
+
+void MeshGL::uploadCoarse() {
+    if(coarse && coarse->vao == 0 && coarse->pending.bytes() > 0) coarse->uploadGPU();
+}
+
+void MeshGL::upload(const std::vector<float>& verts, const std::vector<unsigned int>& idx, bool quantizePositions) {
+    build(verts, idx, quantizePositions);
+    uploadGPU();
+}
+
+glm::mat4 MeshGL::positionDecode() const {
+    if(!quantizedPositions) return glm::mat4(1.0f);
+    glm::mat4 m = glm::translate(glm::mat4(1.0f), aabbMin);
+    return glm::scale(m, aabbMax - aabbMin);
+}
+
+const MeshGL& MeshGL::drawLevel() const {
+    if(coarse && (vao == 0 || uploadPending || pagedOut)) return *coarse;
+    return *this;
+}
+
+const MeshGL& MeshGL::pickLevel() const {
+    if(coarse && cpuIndices.empty()) return *coarse;
+    return *this;
+}
+
+// The VAO is left bound; the state cache filters the rebind when the same mesh is drawn again
 void MeshGL::draw() const {
-    if (vao == 0 || indexCount == 0) return;
-    glBindVertexArray(vao);
-    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr);
-    glBindVertexArray(0);
+    const MeshGL& m = drawLevel();
+    if (m.vao == 0 || m.indexCount == 0 || m.uploadPending) return;
+    GLState::bindVertexArray(m.vao);
+    glDrawElements(GL_TRIANGLES, m.indexCount, m.indexType, nullptr);
+}
+
+void MeshGL::bind() const {
+    GLState::bindVertexArray(drawLevel().vao);
+}
+
+void MeshGL::drawBound() const {
+    const MeshGL& m = drawLevel();
+    if (m.vao == 0 || m.indexCount == 0 || m.uploadPending) return;
+    glDrawElements(GL_TRIANGLES, m.indexCount, m.indexType, nullptr);
 }
 
 // Moller-Trumbore helper
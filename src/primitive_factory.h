@@ -1,12 +1,17 @@
 #pragma once
 
 #include <vector>
+#include <memory>
+#include <cstdint>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
 namespace primitives {
 
-enum class PrimitiveType { Cube, Sphere, Cylinder, Plane };
+// Mesh: imported geometry, or an empty group node of an imported hierarchy
+// PointCloud and ClusterMesh entities carry no mesh; they are drawn from SceneEntity::pointCloud and
+// SceneEntity::clusterMesh
+enum class PrimitiveType { Cube, Sphere, Cylinder, Plane, Mesh, PointCloud, ClusterMesh };
 
 // Small GL mesh helper (owns VAO/VBO/EBO)
 struct MeshGL {
@@ -14,6 +19,20 @@ struct MeshGL {
     GLuint vbo = 0;
     GLuint ebo = 0;
     int indexCount = 0;
+    // GL_UNSIGNED_SHORT when the mesh has fewer than 65536 vertices, else GL_UNSIGNED_INT
+    GLenum indexType = GL_UNSIGNED_INT;
+    // Positions stored as 16-bit unorm relative to the AABB (see positionDecode())
+    bool quantizedPositions = false;
+    // Size of the vertex + index buffers on the GPU
+    size_t gpuBytes = 0;
+    // Set while uploadStreamed() data is still being copied; draw calls skip the mesh until then
+    bool uploadPending = false;
+    // Payload (GL buffers, picking copies, BVH) released or never loaded; only the bounds and draw
+    // parameters are valid and draw calls skip the mesh. MeshStreamer pages it back in.
+    bool pagedOut = false;
+    // gpuBytes and cpuBytes() of the payload while it is paged out
+    size_t pagedGpuBytes = 0;
+    size_t pagedCpuBytes = 0;
 
     // Axis-aligned bounding box in mesh/model local space
     glm::vec3 aabbMin = glm::vec3(-1.0f);
@@ -27,6 +46,26 @@ struct MeshGL {
     struct BVHNode { glm::vec3 min; glm::vec3 max; int start; int count; int left; int right; };
     std::vector<BVHNode> bvhNodes;
 
+    // GPU-ready vertex/index bytes waiting for uploadGPU()/uploadStreamed(). build() points them at
+    // buffers it allocates; a mesh loaded from the binary cache points them straight into the mapped
+    // file. 'owner' keeps that storage alive until the upload is done, then everything is reset.
+    struct PendingData {
+        const uint8_t* vertices = nullptr;
+        size_t vertexBytes = 0;
+        const uint8_t* indices = nullptr;
+        size_t indexBytes = 0;
+        std::shared_ptr<const void> owner;
+
+        size_t bytes() const { return vertexBytes + indexBytes; }
+        void reset() { *this = PendingData(); }
+    };
+    PendingData pending;
+
+    // Simplified stand-in drawn and picked while the full payload is not resident (progressive loading).
+    // Shares the AABB and position format of this mesh, so positionDecode() applies to both; has no BVH.
+    // Kept by release().
+    std::unique_ptr<MeshGL> coarse;
+
     MeshGL() = default;
     ~MeshGL();
 
@@ -38,9 +77,37 @@ struct MeshGL {
     MeshGL(MeshGL&& other) noexcept;
     MeshGL& operator=(MeshGL&& other) noexcept;
 
-    // upload vertex (vec3) and index buffers
-    void upload(const std::vector<float>& verts, const std::vector<unsigned int>& idx);
+    // upload vertex (vec3) and index buffers; optionally store positions quantized to 16 bits per axis
+    void upload(const std::vector<float>& verts, const std::vector<unsigned int>& idx, bool quantizePositions = false);
+    // upload() in two steps: build() does the CPU work (bounds, BVH, GPU buffer packing) and may run
+    // on a worker thread; uploadGPU() creates the GL objects and must run on the GL thread.
+    void build(const std::vector<float>& verts, const std::vector<unsigned int>& idx, bool quantizePositions = false);
+    // Build the coarse level from simplified geometry (after build(), worker thread safe)
+    void buildCoarse(const std::vector<float>& verts, const std::vector<unsigned int>& idx);
+    void uploadGPU();
+    // Like uploadGPU(), but the buffer contents are streamed over the next frames by UploadQueue
+    void uploadStreamed();
+    // Upload the coarse level, if any and not uploaded yet (small; done in one go)
+    void uploadCoarse();
     void draw() const;
+
+    // Bytes of the picking copies and BVH
+    size_t cpuBytes() const;
+    // Free the payload and mark the mesh paged out (GL thread)
+    void release();
+
+    // Matrix mapping stored positions to mesh local space. Identity for float positions; for
+    // quantized meshes it scales [0,1] to the AABB. Multiply it into the model matrix when drawing.
+    glm::mat4 positionDecode() const;
+
+    // Split draw for batched callers: bind() once, then drawBound() for every instance
+    void bind() const;
+    void drawBound() const;
+
+    // Level the draw calls use: this mesh once its buffers are drawable, else the coarse level
+    const MeshGL& drawLevel() const;
+    // Best level with picking data: this mesh while its CPU copies are resident, else the coarse level
+    const MeshGL& pickLevel() const;
 };
 
 // Return CPU-side data for primitives (positions only, 3 floats per vertex)
@@ -0,0 +1,160 @@
+#include <glad/glad.h>
+#include "render_queue.h"
+#include "scene.h"
+#include "gl_state.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include <cstring>
+
+namespace {
+
+// LSD radix sort of 64-bit keys with a 32-bit payload, 8 bits per pass.
+// Passes where every key shares the same byte are skipped, so typical scenes
+// (a single pass) only pay for the mesh and depth bytes.
+static void radixSort(std::vector<uint64_t>& keys, std::vector<uint32_t>& vals, std::vector<uint64_t>& tmpKeys, std::vector<uint32_t>& tmpVals) {
+    size_t n = keys.size();
+    if(n < 2) return;
+    tmpKeys.resize(n); tmpVals.resize(n);
+    for(int pass = 0; pass < 8; ++pass) {
+        int shift = pass * 8;
+        size_t count[256] = {0};
+        for(size_t i = 0; i < n; ++i) count[(keys[i] >> shift) & 0xFF]++;
+        if(count[(keys[0] >> shift) & 0xFF] == n) continue;
+        size_t sum = 0;
+        for(int b = 0; b < 256; ++b) { size_t c = count[b]; count[b] = sum; sum += c; }
+        for(size_t i = 0; i < n; ++i) {
+            size_t dst = count[(keys[i] >> shift) & 0xFF]++;
+            tmpKeys[dst] = keys[i]; tmpVals[dst] = vals[i];
+        }
+        keys.swap(tmpKeys); vals.swap(tmpVals);
+    }
+}
+
+// Positive floats keep their order when compared as unsigned integers
+static uint32_t depthBits(float d) {
+    if(!(d > 0.0f)) return 0;
+    uint32_t bits; memcpy(&bits, &d, sizeof(bits));
+    return bits;
+}
+
+} // anonymous
+
+void RenderQueue::assignMeshId(DrawItem& item, const primitives::MeshGL* mesh) {
+    MeshRef& ref = m_meshIds[mesh];
+    if(ref.refs == 0) {
+        if(!m_freeMeshIds.empty()) { ref.id = m_freeMeshIds.back(); m_freeMeshIds.pop_back(); }
+        else ref.id = m_nextMeshId++;
+    }
+    ref.refs++;
+    item.mesh = mesh;
+    item.meshId = ref.id;
+}
+
+void RenderQueue::releaseMeshId(const primitives::MeshGL* mesh) {
+    auto it = m_meshIds.find(mesh);
+    if(it == m_meshIds.end()) return;
+    if(--it->second.refs > 0) return;
+    m_freeMeshIds.push_back(it->second.id);
+    m_meshIds.erase(it);
+}
+
+void RenderQueue::update(const SceneEntity& ent, bool selected) {
+    if(!ent.mesh) { remove(ent.id); return; }
+
+    auto it = m_slotById.find(ent.id);
+    if(it == m_slotById.end()) {
+        it = m_slotById.emplace(ent.id, m_items.size()).first;
+        m_items.emplace_back();
+    }
+    DrawItem& item = m_items[it->second];
+    item.entityId = ent.id;
+    item.pass = Pass::Opaque;
+    if(item.mesh != ent.mesh.get()) {
+        if(item.mesh) releaseMeshId(item.mesh);
+        assignMeshId(item, ent.mesh.get());
+    }
+
+    const glm::mat4& model = ent.world;
+    // brighter highlight for the selected entity
+    item.color = selected ? ent.color + glm::vec3(0.2f) : ent.color;
+    item.center = glm::vec3(model * glm::vec4((ent.mesh->aabbMin + ent.mesh->aabbMax) * 0.5f, 1.0f));
+    item.model = model * ent.mesh->positionDecode();
+    m_keysDirty = true;
+}
+
+void RenderQueue::remove(int entityId) {
+    auto it = m_slotById.find(entityId);
+    if(it == m_slotById.end()) return;
+    size_t slot = it->second;
+    releaseMeshId(m_items[slot].mesh);
+    m_slotById.erase(it);
+    // swap-remove keeps the item array dense
+    if(slot != m_items.size() - 1) {
+        m_items[slot] = m_items.back();
+        m_slotById[m_items[slot].entityId] = slot;
+    }
+    m_items.pop_back();
+    m_keysDirty = true;
+}
+
+void RenderQueue::clear() {
+    m_items.clear();
+    m_slotById.clear();
+    m_meshIds.clear();
+    m_freeMeshIds.clear();
+    m_nextMeshId = 1;
+    m_order.clear();
+    m_sortKeys.clear();
+    m_keysDirty = true;
+}
+
+void RenderQueue::refreshKeys(unsigned int prog, const glm::mat4& vp) {
+    size_t n = m_items.size();
+    m_sortKeys.resize(n);
+    m_order.resize(n);
+    // clip-space w of a point is its view depth for a perspective projection
+    glm::vec4 wRow(vp[0][3], vp[1][3], vp[2][3], vp[3][3]);
+    for(size_t i = 0; i < n; ++i) {
+        DrawItem& item = m_items[i];
+        float depth = glm::dot(wRow, glm::vec4(item.center, 1.0f));
+        uint64_t key = 0;
+        key |= (uint64_t)((uint8_t)item.pass & 0xF) << 60;
+        key |= (uint64_t)(item.meshId & 0xFFFFFFF) << 32;
+        key |= (uint64_t)depthBits(depth);
+        item.key = key;
+        m_sortKeys[i] = key;
+        m_order[i] = (uint32_t)i;
+    }
+    radixSort(m_sortKeys, m_order, m_tmpKeys, m_tmpOrder);
+    m_lastProg = prog;
+    m_lastVP = vp;
+    m_keysDirty = false;
+}
+
+void RenderQueue::draw(unsigned int prog, const glm::mat4& vp) {
+    if(m_keysDirty || prog != m_lastProg || vp != m_lastVP) refreshKeys(prog, vp);
+
+    m_stats = Stats();
+    m_stats.items = (int)m_items.size();
+    if(m_items.empty()) return;
+
+    GLState::useProgram(prog);
+    m_stats.programBinds++;
+    GLint locMVP = glGetUniformLocation(prog, "uMVP");
+    GLint locColor = glGetUniformLocation(prog, "uColor");
+
+    const primitives::MeshGL* bound = nullptr;
+    for(uint32_t idx : m_order) {
+        const DrawItem& item = m_items[idx];
+        if(item.mesh != bound) {
+            item.mesh->bind();
+            bound = item.mesh;
+            m_stats.meshBinds++;
+        }
+        glm::mat4 mvp = vp * item.model;
+        glUniformMatrix4fv(locMVP, 1, GL_FALSE, &mvp[0][0]);
+        glUniform3f(locColor, item.color.r, item.color.g, item.color.b);
+        item.mesh->drawBound();
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+namespace primitives { struct MeshGL; }
+struct SceneEntity;
+
+// Retained list of packed draw items, one per visible entity.
+// Items are updated incrementally when entities are added, removed or edited; each frame only
+// the depth bits of the sort keys are refreshed (and only when the view changed) before a
+// radix sort. Drawing walks the sorted list and issues program/mesh binds only on change.
+//
+// Sort key layout (most significant first):
+//   [63..60] pass   [59..32] mesh   [31..0] view depth (float bits)
+// Every item is drawn with the same program, so it takes no bits. Mesh ids are recycled, so they stay
+// below the number of distinct meshes in the queue and never collide.
+class RenderQueue {
+public:
+    enum class Pass : uint8_t { Opaque = 0, Overlay = 1 };
+
+    struct DrawItem {
+        uint64_t key = 0;
+        int entityId = 0;
+        Pass pass = Pass::Opaque;
+        const primitives::MeshGL* mesh = nullptr;
+        uint32_t meshId = 0;
+        glm::mat4 model = glm::mat4(1.0f); // includes the mesh's position decode
+        glm::vec3 color = glm::vec3(1.0f);
+        glm::vec3 center = glm::vec3(0.0f); // world-space bounds center (depth sorting)
+    };
+
+    // State changes issued by the last draw() call
+    struct Stats {
+        int items = 0;
+        int programBinds = 0;
+        int meshBinds = 0;
+    };
+
+    // Insert or refresh the item of an entity (entities without a mesh are removed)
+    void update(const SceneEntity& ent, bool selected);
+    void remove(int entityId);
+    void clear();
+
+    // Sort (if needed) and draw all items with the given program and view-projection
+    void draw(unsigned int prog, const glm::mat4& vp);
+
+    size_t size() const { return m_items.size(); }
+    const Stats& lastStats() const { return m_stats; }
+
+private:
+    void assignMeshId(DrawItem& item, const primitives::MeshGL* mesh);
+    void releaseMeshId(const primitives::MeshGL* mesh);
+    void refreshKeys(unsigned int prog, const glm::mat4& vp);
+
+    std::vector<DrawItem> m_items;
+    std::unordered_map<int, size_t> m_slotById; // entity id -> index into m_items
+
+    // small per-mesh ids for the sort key (ref-counted by the items using the mesh); ids of meshes no
+    // longer drawn are reused first
+    struct MeshRef { uint32_t id = 0; int refs = 0; };
+    std::unordered_map<const primitives::MeshGL*, MeshRef> m_meshIds;
+    std::vector<uint32_t> m_freeMeshIds;
+    uint32_t m_nextMeshId = 1;
+
+    // sorted draw order (indices into m_items) and radix sort scratch
+    std::vector<uint64_t> m_sortKeys;
+    std::vector<uint32_t> m_order;
+    std::vector<uint64_t> m_tmpKeys;
+    std::vector<uint32_t> m_tmpOrder;
+
+    bool m_keysDirty = true;
+    unsigned int m_lastProg = 0;
+    glm::mat4 m_lastVP = glm::mat4(0.0f);
+    Stats m_stats;
+};
@@ -0,0 +1,147 @@
+#include "render_target_pool.h"
+#include "gl_state.h"
+#include "log.h"
+#include <vector>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+
+namespace {
+
+// Allocation granularity in pixels. Sizes are rounded up to a multiple of this.
+static const int kBucket = 128;
+// Free targets unused for this many frames are deleted.
+static const int kMaxIdleFrames = 120;
+// Bytes per pixel: color (RGBA8 or RGBA16F) + DEPTH24_STENCIL8
+static size_t bytesPerPixel(GLenum colorFormat) { return (colorFormat == GL_RGBA16F ? 8 : 4) + 4; }
+
+struct PoolEntry {
+    std::unique_ptr<RenderTargetPool::Target> target;
+    std::string owner; // empty when free
+    int idleFrames = 0;
+};
+
+static std::vector<PoolEntry> s_entries;
+
+static int bucketSize(int v) { return ((v + kBucket - 1) / kBucket) * kBucket; }
+
+// A target can serve a request if it has the requested format, is large enough and is at most four
+// times the area the request would allocate (hysteresis: shrinking a little never reallocates). The
+// limit is on bucketed sizes, so a target of the request's own bucket always fits, however small or
+// thin the request is.
+static bool fits(const RenderTargetPool::Target& t, int w, int h, GLenum colorFormat) {
+    if(t.colorFormat != colorFormat || w > t.allocWidth || h > t.allocHeight) return false;
+    return (size_t)bucketSize(w) * (size_t)bucketSize(h) * 4 >= (size_t)t.allocWidth * (size_t)t.allocHeight;
+}
+
+static void deleteTarget(RenderTargetPool::Target& t) {
+    if(t.depth) { glDeleteRenderbuffers(1, &t.depth); t.depth = 0; }
+    if(t.color) { glDeleteTextures(1, &t.color); t.color = 0; }
+    GLState::deleteFramebuffer(t.fbo);
+    t.allocWidth = t.allocHeight = t.width = t.height = 0;
+}
+
+static bool createTarget(RenderTargetPool::Target& t, int w, int h, GLenum colorFormat) {
+    t.allocWidth = w; t.allocHeight = h;
+    t.colorFormat = colorFormat;
+    glGenFramebuffers(1, &t.fbo);
+    GLState::bindFramebuffer(t.fbo);
+    glGenTextures(1, &t.color);
+    glBindTexture(GL_TEXTURE_2D, t.color);
+    glTexImage2D(GL_TEXTURE_2D, 0, (GLint)colorFormat, w, h, 0, GL_RGBA, colorFormat == GL_RGBA16F ? GL_HALF_FLOAT : GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, t.color, 0);
+    glGenRenderbuffers(1, &t.depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, t.depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, w, h);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, t.depth);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    GLState::bindFramebuffer(0);
+    if(status != GL_FRAMEBUFFER_COMPLETE) {
+        LOG_ERROR("Failed to create framebuffer, status: " << status);
+        deleteTarget(t);
+        return false;
+    }
+    LOG_DEBUG("RenderTargetPool: allocated " << w << "x" << h << (colorFormat == GL_RGBA16F ? " RGBA16F" : "") << " target");
+    return true;
+}
+
+static PoolEntry* findOwned(const char* owner) {
+    for(auto& e : s_entries) if(e.owner == owner) return &e;
+    return nullptr;
+}
+
+} // anonymous
+
+namespace RenderTargetPool {
+
+Target* acquire(const char* owner, int w, int h, GLenum colorFormat) {
+    if(w <= 0 || h <= 0) return nullptr;
+
+    PoolEntry* cur = findOwned(owner);
+    if(cur && fits(*cur->target, w, h, colorFormat)) {
+        cur->target->width = w; cur->target->height = h;
+        return cur->target.get();
+    }
+    if(cur) { cur->owner.clear(); cur->idleFrames = 0; }
+
+    // Recycle the smallest free target that fits
+    PoolEntry* best = nullptr;
+    for(auto& e : s_entries) {
+        if(!e.owner.empty() || !fits(*e.target, w, h, colorFormat)) continue;
+        if(!best || (size_t)e.target->allocWidth * e.target->allocHeight < (size_t)best->target->allocWidth * best->target->allocHeight) best = &e;
+    }
+    if(!best) {
+        PoolEntry e;
+        e.target = std::make_unique<Target>();
+        if(!createTarget(*e.target, bucketSize(w), bucketSize(h), colorFormat)) return nullptr;
+        s_entries.push_back(std::move(e));
+        best = &s_entries.back();
+    }
+    best->owner = owner;
+    best->idleFrames = 0;
+    best->target->width = w; best->target->height = h;
+    return best->target.get();
+}
+
+void release(const char* owner) {
+    PoolEntry* e = findOwned(owner);
+    if(e) { e->owner.clear(); e->idleFrames = 0; }
+}
+
+void endFrame() {
+    for(auto& e : s_entries) {
+        if(e.owner.empty()) e.idleFrames++;
+    }
+    auto it = std::remove_if(s_entries.begin(), s_entries.end(), [](PoolEntry& e){
+        if(!e.owner.empty() || e.idleFrames < kMaxIdleFrames) return false;
+        deleteTarget(*e.target);
+        return true;
+    });
+    s_entries.erase(it, s_entries.end());
+}
+
+void destroy() {
+    for(auto& e : s_entries) deleteTarget(*e.target);
+    s_entries.clear();
+}
+
+size_t bytesAllocated() {
+    size_t total = 0;
+    for(const auto& e : s_entries) total += (size_t)e.target->allocWidth * (size_t)e.target->allocHeight * bytesPerPixel(e.target->colorFormat);
+    return total;
+}
+
+int targetCount() { return (int)s_entries.size(); }
+
+int freeCount() {
+    int n = 0;
+    for(const auto& e : s_entries) if(e.owner.empty()) n++;
+    return n;
+}
+
+} // namespace RenderTargetPool
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+
+// Shared pool of offscreen color+depth render targets used by every viewport render path.
+// Allocations are rounded up to size buckets; a target that is larger than requested is rendered
+// into a sub-rectangle anchored at the origin, so dragging a panel edge does not touch GPU memory
+// until the size crosses a bucket boundary (or shrinks far enough to waste most of the allocation).
+namespace RenderTargetPool {
+    struct Target {
+        GLuint fbo = 0;
+        GLuint color = 0;
+        GLuint depth = 0;
+        GLenum colorFormat = GL_RGBA8; // internal format of 'color'
+        // size of the GPU allocation
+        int allocWidth = 0;
+        int allocHeight = 0;
+        // size of the sub-rectangle currently rendered into
+        int width = 0;
+        int height = 0;
+
+        // UV of the far corner of the used sub-rectangle (use with ImGui::Image, V flipped)
+        float uMax() const { return allocWidth > 0 ? (float)width / (float)allocWidth : 1.0f; }
+        float vMax() const { return allocHeight > 0 ? (float)height / (float)allocHeight : 1.0f; }
+    };
+
+    // Return the target owned by 'owner' (e.g. "viewport"), sized to at least w x h, with the given
+    // color format (GL_RGBA8, or GL_RGBA16F for float output). The target's width/height are set to w/h.
+    // Returns nullptr on invalid size or FBO failure. The pointer stays valid until release(owner) or destroy().
+    Target* acquire(const char* owner, int w, int h, GLenum colorFormat = GL_RGBA8);
+
+    // Hand the owner's target back to the free list so other passes can recycle it.
+    void release(const char* owner);
+
+    // Age free targets; those unused for a while are deleted. Call once per frame.
+    void endFrame();
+
+    // Delete every target (requires a current GL context).
+    void destroy();
+
+    // Statistics
+    size_t bytesAllocated();
+    int targetCount();
+    int freeCount();
+}
@@ -1,5 +1,11 @@
 #include "renderer.h"
 #include "log.h"
+#include "render_target_pool.h"
+#include "gl_state.h"
+#include "point_cloud.h"
+#include "point_cloud_streamer.h"
+#include "cluster_mesh.h"
+#include "cluster_mesh_streamer.h"
 #include <vector>
 #include <iostream>
 #include <glm/gtc/matrix_transform.hpp>
@@ -8,43 +14,21 @@
 
 namespace {
 static GLuint g_prog = 0;
-// FBO resources
-static GLuint s_fbo = 0;
-static GLuint s_fboColor = 0;
-static GLuint s_fboDepth = 0;
-static int s_fbo_w = 0;
-static int s_fbo_h = 0;
-
-static void ensureFBO(int w, int h) {
-    if(w <= 0 || h <= 0) return;
-    if(s_fbo && s_fbo_w == w && s_fbo_h == h) return;
-    if(s_fboDepth) { glDeleteRenderbuffers(1, &s_fboDepth); s_fboDepth = 0; }
-    if(s_fboColor) { glDeleteTextures(1, &s_fboColor); s_fboColor = 0; }
-    if(s_fbo) { glDeleteFramebuffers(1, &s_fbo); s_fbo = 0; }
-    s_fbo_w = w; s_fbo_h = h;
-    glGenFramebuffers(1, &s_fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, s_fbo);
-    glGenTextures(1, &s_fboColor);
-    glBindTexture(GL_TEXTURE_2D, s_fboColor);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, s_fboColor, 0);
-    glGenRenderbuffers(1, &s_fboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, s_fboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, w, h);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, s_fboDepth);
-    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-    if(status != GL_FRAMEBUFFER_COMPLETE) {
-        LOG_ERROR("Failed to create framebuffer, status: " << status);
-        if(s_fboDepth) { glDeleteRenderbuffers(1, &s_fboDepth); s_fboDepth = 0; }
-        if(s_fboColor) { glDeleteTextures(1, &s_fboColor); s_fboColor = 0; }
-        if(s_fbo) { glDeleteFramebuffers(1, &s_fbo); s_fbo = 0; }
-        s_fbo_w = s_fbo_h = 0;
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-}
+// Offscreen target used by renderScene (owned through the shared pool)
+static RenderTargetPool::Target* s_target = nullptr;
+static GLenum s_colorFormat = GL_RGBA8;
+// Uniform locations of g_prog (looked up once after linking)
+static GLint s_locMVP = -1;
+static GLint s_locColor = -1;
+// Point program for point-cloud nodes (per-vertex color, size set per node)
+static GLuint s_pointProg = 0;
+static GLint s_locPointMVP = -1;
+static GLint s_locPointSize = -1;
+static std::vector<PointCloudStreamer::DrawNode> s_pointDraws;
+static std::vector<ClusterMeshStreamer::DrawNode> s_clusterDraws;
+// Persistent stream buffer for the line helpers (grid, axes, selection box)
+static GLuint s_lineVAO = 0;
+static GLuint s_lineVBO = 0;
 
 static GLuint compileShader(GLenum type, const char* src) {
     GLuint s = glCreateShader(type);
@@ -80,6 +64,40 @@ uniform vec3 uColor;
 void main(){ FragColor = vec4(uColor,1.0); }
 )glsl";
 
+const char* VS_POINTS = R"glsl(
+#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec4 aColor;
+uniform mat4 uMVP;
+uniform float uPointSize;
+out vec3 vColor;
+void main(){ gl_Position = uMVP * vec4(aPos,1.0); gl_PointSize = uPointSize; vColor = aColor.rgb; }
+)glsl";
+const char* FS_POINTS = R"glsl(
+#version 330 core
+in vec3 vColor;
+out vec4 FragColor;
+void main(){ FragColor = vec4(vColor,1.0); }
+)glsl";
+
+// Upload line vertices (xyz) into the shared line buffer and bind the program with the given MVP
+static void beginLines(const std::vector<float>& verts, const glm::mat4& mvp) {
+    if(!s_lineVAO) {
+        glGenVertexArrays(1, &s_lineVAO);
+        glGenBuffers(1, &s_lineVBO);
+        GLState::bindVertexArray(s_lineVAO);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, s_lineVBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    }
+    GLState::bindVertexArray(s_lineVAO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, s_lineVBO);
+    // re-specifying the store lets the driver orphan the previous contents instead of stalling
+    glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(float), verts.data(), GL_STREAM_DRAW);
+    GLState::useProgram(g_prog);
+    glUniformMatrix4fv(s_locMVP, 1, GL_FALSE, &mvp[0][0]);
+}
+
 } // anonymous
 
 namespace Renderer {
@@ -87,13 +105,21 @@ namespace Renderer {
 void init() {
     if(g_prog) return;
     g_prog = createProgram(VS_SIMPLE, FS_SIMPLE);
+    s_locMVP = glGetUniformLocation(g_prog, "uMVP");
+    s_locColor = glGetUniformLocation(g_prog, "uColor");
+    s_pointProg = createProgram(VS_POINTS, FS_POINTS);
+    s_locPointMVP = glGetUniformLocation(s_pointProg, "uMVP");
+    s_locPointSize = glGetUniformLocation(s_pointProg, "uPointSize");
+    glEnable(GL_PROGRAM_POINT_SIZE);
 }
 
 void destroy() {
-    if(g_prog) { glDeleteProgram(g_prog); g_prog = 0; }
-    if(s_fboDepth) { glDeleteRenderbuffers(1, &s_fboDepth); s_fboDepth = 0; }
-    if(s_fboColor) { glDeleteTextures(1, &s_fboColor); s_fboColor = 0; }
-    if(s_fbo) { glDeleteFramebuffers(1, &s_fbo); s_fbo = 0; }
+    GLState::deleteProgram(g_prog);
+    GLState::deleteProgram(s_pointProg);
+    GLState::deleteBuffer(s_lineVBO);
+    GLState::deleteVertexArray(s_lineVAO);
+    s_target = nullptr;
+    RenderTargetPool::destroy();
 }
 
 GLuint getProgram() { return g_prog; }
@@ -109,57 +135,37 @@ void renderGrid(const glm::mat4& vp) {
         lines.push_back(-half*step); lines.push_back(0.0f); lines.push_back(z);
         lines.push_back(half*step);  lines.push_back(0.0f); lines.push_back(z);
     }
-    GLuint tmpVBO=0, tmpVAO=0; glGenBuffers(1,&tmpVBO); glGenVertexArrays(1,&tmpVAO);
-    glBindVertexArray(tmpVAO); glBindBuffer(GL_ARRAY_BUFFER, tmpVBO);
-    glBufferData(GL_ARRAY_BUFFER, lines.size()*sizeof(float), lines.data(), GL_DYNAMIC_DRAW);
-    glEnableVertexAttribArray(0); glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(float),(void*)0);
-    glUseProgram(g_prog);
-    GLint loc = glGetUniformLocation(g_prog, "uMVP"); glm::mat4 model = glm::mat4(1.0f); glm::mat4 mvp = vp * model;
-    glUniformMatrix4fv(loc, 1, GL_FALSE, &mvp[0][0]); GLint col = glGetUniformLocation(g_prog, "uColor"); glUniform3f(col, 0.6f, 0.6f, 0.6f);
+    beginLines(lines, vp);
+    glUniform3f(s_locColor, 0.6f, 0.6f, 0.6f);
     glDrawArrays(GL_LINES, 0, (GLsizei)(lines.size()/3));
-    glBindVertexArray(0); glDeleteBuffers(1,&tmpVBO); glDeleteVertexArrays(1,&tmpVAO);
 }
 
 void drawOriginMarker(const glm::mat4& vp) {
     std::vector<float> verts = {0.0f,0.0f,0.0f, 0.6f,0.0f,0.0f, 0.0f,0.0f,0.0f, 0.0f,0.6f,0.0f, 0.0f,0.0f,0.0f, 0.0f,0.0f,0.6f};
-    GLuint tmpVBO=0, tmpVAO=0; glGenBuffers(1,&tmpVBO); glGenVertexArrays(1,&tmpVAO);
-    glBindVertexArray(tmpVAO); glBindBuffer(GL_ARRAY_BUFFER, tmpVBO);
-    glBufferData(GL_ARRAY_BUFFER, verts.size()*sizeof(float), verts.data(), GL_DYNAMIC_DRAW);
-    glEnableVertexAttribArray(0); glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(float),(void*)0);
-    glUseProgram(g_prog); GLint loc = glGetUniformLocation(g_prog, "uMVP"); glm::mat4 model = glm::mat4(1.0f); glm::mat4 mvp = vp * model; glUniformMatrix4fv(loc, 1, GL_FALSE, &mvp[0][0]); GLint col = glGetUniformLocation(g_prog, "uColor");
-    glUniform3f(col, 1.0f, 0.0f, 0.0f); glDrawArrays(GL_LINES, 0, 2);
-    glUniform3f(col, 1.0f, 0.9f, 0.2f); glDrawArrays(GL_LINES, 2, 2);
-    glUniform3f(col, 0.0f, 0.0f, 1.0f); glDrawArrays(GL_LINES, 4, 2);
-    glBindVertexArray(0); glDeleteBuffers(1,&tmpVBO); glDeleteVertexArrays(1,&tmpVAO);
+    beginLines(verts, vp);
+    glUniform3f(s_locColor, 1.0f, 0.0f, 0.0f); glDrawArrays(GL_LINES, 0, 2);
+    glUniform3f(s_locColor, 1.0f, 0.9f, 0.2f); glDrawArrays(GL_LINES, 2, 2);
+    glUniform3f(s_locColor, 0.0f, 0.0f, 1.0f); glDrawArrays(GL_LINES, 4, 2);
 }
 
 void drawAxisLines(const glm::mat4& vp) {
     std::vector<float> verts; verts.push_back(-100.0f); verts.push_back(0.0f); verts.push_back(0.0f); verts.push_back(100.0f); verts.push_back(0.0f); verts.push_back(0.0f);
     verts.push_back(0.0f); verts.push_back(-100.0f); verts.push_back(0.0f); verts.push_back(0.0f); verts.push_back(100.0f); verts.push_back(0.0f);
     verts.push_back(0.0f); verts.push_back(0.0f); verts.push_back(-100.0f); verts.push_back(0.0f); verts.push_back(0.0f); verts.push_back(100.0f);
-    GLuint tmpVBO=0, tmpVAO=0; glGenBuffers(1,&tmpVBO); glGenVertexArrays(1,&tmpVAO);
-    glBindVertexArray(tmpVAO); glBindBuffer(GL_ARRAY_BUFFER, tmpVBO);
-    glBufferData(GL_ARRAY_BUFFER, verts.size()*sizeof(float), verts.data(), GL_DYNAMIC_DRAW);
-    glEnableVertexAttribArray(0); glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(float),(void*)0);
-    glUseProgram(g_prog); GLint loc = glGetUniformLocation(g_prog, "uMVP"); glm::mat4 model = glm::mat4(1.0f); glm::mat4 mvp = vp * model; glUniformMatrix4fv(loc, 1, GL_FALSE, &mvp[0][0]); GLint col = glGetUniformLocation(g_prog, "uColor");
-    glUniform3f(col, 1.0f, 0.2f, 0.2f); glDrawArrays(GL_LINES, 0, 2);
-    glUniform3f(col, 1.0f, 0.9f, 0.2f); glDrawArrays(GL_LINES, 2, 2);
-    glUniform3f(col, 0.2f, 0.4f, 1.0f); glDrawArrays(GL_LINES, 4, 2);
-    glBindVertexArray(0); glDeleteBuffers(1,&tmpVBO); glDeleteVertexArrays(1,&tmpVAO);
+    beginLines(verts, vp);
+    glUniform3f(s_locColor, 1.0f, 0.2f, 0.2f); glDrawArrays(GL_LINES, 0, 2);
+    glUniform3f(s_locColor, 1.0f, 0.9f, 0.2f); glDrawArrays(GL_LINES, 2, 2);
+    glUniform3f(s_locColor, 0.2f, 0.4f, 1.0f); glDrawArrays(GL_LINES, 4, 2);
 }
 
 void drawSelectionBox(const glm::mat4& vp, const SceneEntity* ent) {
-    if(!ent || !ent->mesh) return;
+    if(!ent || (!ent->mesh && !ent->pointCloud && !ent->clusterMesh)) return;
     // model transforms entity local-space AABB into world
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, ent->position);
-    model *= glm::toMat4(glm::quat(glm::radians(ent->rotation)));
-    model = glm::scale(model, ent->scale);
-    glm::mat4 mvp = vp * model;
+    glm::mat4 mvp = vp * ent->world;
 
-    // get local AABB from mesh
-    glm::vec3 mn = ent->mesh->aabbMin;
-    glm::vec3 mx = ent->mesh->aabbMax;
+    // get local AABB from mesh, point cloud or cluster mesh
+    glm::vec3 mn = ent->mesh ? ent->mesh->aabbMin : ent->pointCloud ? ent->pointCloud->boundsMin() : ent->clusterMesh->boundsMin();
+    glm::vec3 mx = ent->mesh ? ent->mesh->aabbMax : ent->pointCloud ? ent->pointCloud->boundsMax() : ent->clusterMesh->boundsMax();
 
     // compute 8 corners in local space
     glm::vec3 c[8];
@@ -185,44 +191,94 @@ void drawSelectionBox(const glm::mat4& vp, const SceneEntity* ent) {
     pushLine(c[4], c[5]); pushLine(c[5], c[6]); pushLine(c[6], c[7]); pushLine(c[7], c[4]);
     pushLine(c[0], c[4]); pushLine(c[1], c[5]); pushLine(c[2], c[6]); pushLine(c[3], c[7]);
 
-    GLuint tmpVBO=0, tmpVAO=0; glGenBuffers(1,&tmpVBO); glGenVertexArrays(1,&tmpVAO);
-    glBindVertexArray(tmpVAO); glBindBuffer(GL_ARRAY_BUFFER, tmpVBO);
-    glBufferData(GL_ARRAY_BUFFER, lines.size()*sizeof(float), lines.data(), GL_DYNAMIC_DRAW);
-    glEnableVertexAttribArray(0); glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(float),(void*)0);
-    glUseProgram(g_prog); GLint loc = glGetUniformLocation(g_prog, "uMVP"); glUniformMatrix4fv(loc, 1, GL_FALSE, &mvp[0][0]); GLint col = glGetUniformLocation(g_prog, "uColor"); glLineWidth(3.0f); glUniform3f(col, 1.0f, 0.2f, 1.0f); glDrawArrays(GL_LINES, 0, (GLsizei)(lines.size()/3)); glLineWidth(1.0f);
-    glBindVertexArray(0); glDeleteBuffers(1,&tmpVBO); glDeleteVertexArrays(1,&tmpVAO);
+    beginLines(lines, mvp);
+    GLState::lineWidth(3.0f);
+    glUniform3f(s_locColor, 1.0f, 0.2f, 1.0f);
+    glDrawArrays(GL_LINES, 0, (GLsizei)(lines.size()/3));
+    GLState::lineWidth(1.0f);
+}
+
+void drawMesh(const primitives::MeshGL& mesh, const glm::mat4& mvp, const glm::vec3& color) {
+    GLState::useProgram(g_prog);
+    glUniformMatrix4fv(s_locMVP, 1, GL_FALSE, &mvp[0][0]);
+    glUniform3f(s_locColor, color.r, color.g, color.b);
+    mesh.draw();
+}
+
+void drawPointClouds(const Scene& scene, const glm::mat4& view, const glm::mat4& proj, int viewportHeight) {
+    if(scene.pointCloudIds().empty()) return;
+    PointCloudStreamer::select(scene, view, proj, viewportHeight, s_pointDraws);
+    if(s_pointDraws.empty()) return;
+    GLState::useProgram(s_pointProg);
+    for(const auto& d : s_pointDraws) {
+        glUniformMatrix4fv(s_locPointMVP, 1, GL_FALSE, &d.mvp[0][0]);
+        glUniform1f(s_locPointSize, d.pointSize);
+        GLState::bindVertexArray(d.vao);
+        glDrawArrays(GL_POINTS, 0, d.count);
+    }
+}
+
+void drawClusterMeshes(const Scene& scene, const glm::mat4& view, const glm::mat4& proj, int viewportHeight) {
+    if(scene.clusterMeshIds().empty()) return;
+    ClusterMeshStreamer::select(scene, view, proj, viewportHeight, s_clusterDraws);
+    if(s_clusterDraws.empty()) return;
+    GLState::useProgram(g_prog);
+    for(const auto& d : s_clusterDraws) {
+        glUniformMatrix4fv(s_locMVP, 1, GL_FALSE, &d.mvp[0][0]);
+        glUniform3f(s_locColor, d.color.r, d.color.g, d.color.b);
+        GLState::bindVertexArray(d.vao);
+        glDrawElements(GL_TRIANGLES, d.count, GL_UNSIGNED_INT, (void*)0);
+    }
 }
 
 // Render scene into offscreen texture sized to viewport (ImGui logical pixels). Returns view/proj & color texture
 void renderScene(Scene& scene, const Camera& camera, const ImVec2& viewport_pos, const ImVec2& viewport_size, bool wireframe, glm::mat4& out_view, glm::mat4& out_proj) {
     int w = (int)viewport_size.x;
     int h = (int)viewport_size.y;
-    ensureFBO(w, h);
-    if(!s_fbo) return; // failed to create
+    s_target = RenderTargetPool::acquire("renderer", w, h, s_colorFormat);
+    if(!s_target) return; // failed to create
 
-    glBindFramebuffer(GL_FRAMEBUFFER, s_fbo);
-    glViewport(0, 0, s_fbo_w, s_fbo_h);
+    // render into the used sub-rectangle of the (possibly larger) pooled target
+    GLState::bindFramebuffer(s_target->fbo);
+    GLState::viewport(0, 0, s_target->width, s_target->height);
+    GLState::setScissorTest(true);
+    glScissor(0, 0, s_target->width, s_target->height);
     glClearColor(0.09f, 0.09f, 0.11f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    GLState::setScissorTest(false);
+    GLState::setDepthTest(true);
+    GLState::setBlend(false);
 
     glm::mat4 view = camera.getView();
-    float aspect = (float)s_fbo_w / (s_fbo_h > 0 ? (float)s_fbo_h : 1.0f);
+    float aspect = (float)s_target->width / (s_target->height > 0 ? (float)s_target->height : 1.0f);
     glm::mat4 proj = camera.getProjection(aspect);
     glm::mat4 vp = proj * view;
 
     out_view = view; out_proj = proj;
 
-    glUseProgram(g_prog);
-    if(wireframe) glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    else glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    GLState::useProgram(g_prog);
+    GLState::polygonMode(wireframe ? GL_LINE : GL_FILL);
     renderGrid(vp);
     scene.drawAll(g_prog, vp);
+    drawPointClouds(scene, view, proj, s_target->height);
+    drawClusterMeshes(scene, view, proj, s_target->height);
     drawAxisLines(vp);
     drawOriginMarker(vp);
+    GLState::polygonMode(GL_FILL);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLState::bindFramebuffer(0);
 }
 
-GLuint getColorTexture() { return s_fboColor; }
+void setColorFormat(GLenum colorFormat) { s_colorFormat = colorFormat; }
+
+GLuint getColorTexture() { return s_target ? s_target->color : 0; }
+
+GLuint getFramebuffer() { return s_target ? s_target->fbo : 0; }
+
+void getColorTextureUV(ImVec2& uv0, ImVec2& uv1) {
+    float u = s_target ? s_target->uMax() : 1.0f;
+    float v = s_target ? s_target->vMax() : 1.0f;
+    uv0 = ImVec2(0.0f, v); uv1 = ImVec2(u, 0.0f);
+}
 
 } // namespace Renderer
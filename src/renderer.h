@@ -19,12 +19,25 @@ namespace Renderer {
     void drawOriginMarker(const glm::mat4& vp);
     void drawAxisLines(const glm::mat4& vp);
     void drawSelectionBox(const glm::mat4& vp, const SceneEntity* ent);
+    // One mesh with the scene program and a flat color (offscreen passes such as thumbnails).
+    // 'mvp' must include the mesh's positionDecode().
+    void drawMesh(const primitives::MeshGL& mesh, const glm::mat4& mvp, const glm::vec3& color);
+    // The scene's point clouds, at the level of detail streamed in for this view (PointCloudStreamer)
+    void drawPointClouds(const Scene& scene, const glm::mat4& view, const glm::mat4& proj, int viewportHeight);
+    // The scene's cluster meshes, as the cut through their BVH streamed in for this view (ClusterMeshStreamer)
+    void drawClusterMeshes(const Scene& scene, const glm::mat4& view, const glm::mat4& proj, int viewportHeight);
 
     // Offscreen FBO management and scene rendering
     // Renders the given scene into an offscreen texture sized to the provided viewport (logical pixels)
     // Outputs view and projection matrices used for the render into out_view/out_proj.
     void renderScene(Scene& scene, const Camera& camera, const ImVec2& viewport_pos, const ImVec2& viewport_size, bool wireframe, glm::mat4& out_view, glm::mat4& out_proj);
+    // Color format of that texture: GL_RGBA8 (default) or GL_RGBA16F (sequences written as EXR)
+    void setColorFormat(GLenum colorFormat);
 
     // Get the color texture produced by the last render (suitable for ImGui::Image)
     GLuint getColorTexture();
+    // Framebuffer of that render, for readback; the image is in its lower-left corner
+    GLuint getFramebuffer();
+    // UVs of the rendered sub-rectangle of that texture (flipped for ImGui::Image)
+    void getColorTextureUV(ImVec2& uv0, ImVec2& uv1);
 }
@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <unordered_set>
 
 struct AddCommand : Scene::Command {
     int id;
@@ -16,14 +17,40 @@ struct AddCommand : Scene::Command {
     void redo(Scene& s) override { s.addPrimitive(type, pos); }
 };
 
+glm::mat4 SceneEntity::localMatrix() const {
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+    model *= glm::toMat4(glm::quat(glm::radians(rotation)));
+    return glm::scale(model, scale);
+}
+
+void SceneEntity::setLocalMatrix(const glm::mat4& m) {
+    position = glm::vec3(m[3]);
+    glm::vec3 cols[3] = { glm::vec3(m[0]), glm::vec3(m[1]), glm::vec3(m[2]) };
+    scale = glm::vec3(glm::length(cols[0]), glm::length(cols[1]), glm::length(cols[2]));
+    // a mirrored basis is kept as a negative x scale
+    if(glm::dot(glm::cross(cols[0], cols[1]), cols[2]) < 0.0f) scale.x = -scale.x;
+    glm::mat3 rot;
+    for(int k = 0; k < 3; ++k) rot[k] = scale[k] != 0.0f ? cols[k] / scale[k] : glm::vec3(k == 0, k == 1, k == 2);
+    rotation = glm::degrees(glm::eulerAngles(glm::quat_cast(rot)));
+}
+
 Scene::Scene() {}
 Scene::~Scene() {}
 
 int Scene::addEntity(SceneEntity&& ent) {
     ent.id = m_nextId++;
+    if(ent.parentId != 0) {
+        if(m_indexById.count(ent.parentId)) m_childrenById[ent.parentId].push_back(ent.id);
+        else ent.parentId = 0;
+    }
+    if(m_selectedId != 0) markEntityDirty(m_selectedId); // loses highlight
     m_selectedId = ent.id;
+    m_indexById[ent.id] = m_entities.size();
+    if(ent.pointCloud) m_pointCloudIds.push_back(ent.id);
+    if(ent.clusterMesh) m_clusterMeshIds.push_back(ent.id);
     m_entities.push_back(std::move(ent));
     m_spawnCount++;
+    markEntityDirty(m_selectedId);
     return m_selectedId;
 }
 
@@ -39,6 +66,24 @@ int Scene::addPrimitive(primitives::PrimitiveType type, const glm::vec3& pos) {
     return addEntity(std::move(e));
 }
 
+int Scene::addPointCloud(std::shared_ptr<PointCloud> cloud, const std::string& name) {
+    SceneEntity e;
+    e.type = primitives::PrimitiveType::PointCloud;
+    e.name = name;
+    e.pointCloud = std::move(cloud);
+    e.color = glm::vec3(1.0f);
+    return addEntity(std::move(e));
+}
+
+int Scene::addClusterMesh(std::shared_ptr<ClusterMesh> mesh, const std::string& name) {
+    SceneEntity e;
+    e.type = primitives::PrimitiveType::ClusterMesh;
+    e.name = name;
+    e.clusterMesh = std::move(mesh);
+    e.color = glm::vec3(0.8f);
+    return addEntity(std::move(e));
+}
+
 int Scene::addCube(const glm::vec3& pos) { return addPrimitive(primitives::PrimitiveType::Cube, pos); }
 
 void Scene::recordSpawnOnly() {
@@ -46,62 +91,126 @@ void Scene::recordSpawnOnly() {
     m_spawnCount++;
 }
 
-void Scene::drawAll(unsigned int prog, const glm::mat4& vp) const {
-    for (const auto& ent : m_entities) {
-        if (!ent.mesh) continue;
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, ent.position);
-        // apply rotation (degrees -> radians)
-        glm::quat q = glm::quat(glm::radians(ent.rotation));
-        model *= glm::toMat4(q);
-        model = glm::scale(model, ent.scale);
-        glm::mat4 mvp = vp * model;
-        GLint loc = glGetUniformLocation(prog, "uMVP");
-        glUniformMatrix4fv(loc, 1, GL_FALSE, &mvp[0][0]);
-        GLint col = glGetUniformLocation(prog, "uColor");
-        if(ent.id == m_selectedId) {
-            // brighter highlight for selected entity
-            glUniform3f(col, 0.2f + ent.color.r, 0.2f + ent.color.g, 0.2f + ent.color.b);
-        } else {
-            glUniform3f(col, ent.color.r, ent.color.g, ent.color.b);
-        }
-        ent.mesh->draw();
+void Scene::markEntityDirty(int id) {
+    markDirty();
+    if(SceneEntity* e = findById(id)) {
+        updateWorld(*e);
+        // descendants inherit the new world matrix
+        auto it = m_childrenById.find(id);
+        if(it != m_childrenById.end()) for(int child : it->second) markEntityDirty(child);
     }
+    if(m_queueNeedsRebuild) return;
+    m_dirtyIds.push_back(id);
+    // many edits between draws (e.g. hidden viewport): a full rebuild is cheaper than replaying them
+    if(m_dirtyIds.size() > m_entities.size() + 16) { m_dirtyIds.clear(); m_queueNeedsRebuild = true; }
+}
+
+void Scene::updateWorld(SceneEntity& ent) {
+    ent.world = parentWorld(ent) * ent.localMatrix();
+}
+
+glm::mat4 Scene::parentWorld(const SceneEntity& ent) const {
+    const SceneEntity* parent = ent.parentId ? findById(ent.parentId) : nullptr;
+    return parent ? parent->world : glm::mat4(1.0f);
+}
+
+const std::vector<int>& Scene::childrenOf(int id) const {
+    static const std::vector<int> s_none;
+    auto it = m_childrenById.find(id);
+    return it == m_childrenById.end() ? s_none : it->second;
+}
+
+void Scene::rebuildIndex() {
+    m_indexById.clear();
+    for(size_t i = 0; i < m_entities.size(); ++i) m_indexById[m_entities[i].id] = i;
+}
+
+void Scene::syncRenderQueue() {
+    if(m_queueNeedsRebuild) {
+        m_renderQueue.clear();
+        for(const auto& ent : m_entities) m_renderQueue.update(ent, ent.id == m_selectedId);
+        m_queueNeedsRebuild = false;
+        m_dirtyIds.clear();
+        return;
+    }
+    if(m_dirtyIds.empty()) return;
+    std::sort(m_dirtyIds.begin(), m_dirtyIds.end());
+    m_dirtyIds.erase(std::unique(m_dirtyIds.begin(), m_dirtyIds.end()), m_dirtyIds.end());
+    for(int id : m_dirtyIds) {
+        const SceneEntity* ent = findById(id);
+        if(ent) m_renderQueue.update(*ent, id == m_selectedId);
+        else m_renderQueue.remove(id);
+    }
+    m_dirtyIds.clear();
+}
+
+void Scene::drawAll(unsigned int prog, const glm::mat4& vp) {
+    syncRenderQueue();
+    m_renderQueue.draw(prog, vp);
 }
 
 int Scene::getSelectedId() const { return m_selectedId; }
 
 void Scene::selectEntity(int id) {
     // ensure id exists
-    if(id == 0) { m_selectedId = 0; return; }
-    auto it = std::find_if(m_entities.begin(), m_entities.end(), [id](const SceneEntity& e){ return e.id == id; });
-    if(it != m_entities.end()) m_selectedId = id;
+    int prev = m_selectedId;
+    if(id == 0) { m_selectedId = 0; if(prev) markEntityDirty(prev); return; }
+    if(m_indexById.count(id)) {
+        m_selectedId = id;
+        if(prev) markEntityDirty(prev);
+        markEntityDirty(id);
+    }
 }
 
 SceneEntity* Scene::findById(int id) {
-    auto it = std::find_if(m_entities.begin(), m_entities.end(), [id](const SceneEntity& e){ return e.id == id; });
-    if(it == m_entities.end()) return nullptr;
-    return &(*it);
+    auto it = m_indexById.find(id);
+    if(it == m_indexById.end()) return nullptr;
+    return &m_entities[it->second];
+}
+
+const SceneEntity* Scene::findById(int id) const {
+    auto it = m_indexById.find(id);
+    if(it == m_indexById.end()) return nullptr;
+    return &m_entities[it->second];
 }
 
 void Scene::deleteSelected() {
-    if(m_selectedId == 0) return;
-    auto it = std::find_if(m_entities.begin(), m_entities.end(), [this](const SceneEntity& e){ return e.id == m_selectedId; });
-    if(it == m_entities.end()) return;
-    m_entities.erase(it);
+    const SceneEntity* sel = findById(m_selectedId);
+    if(!sel) return;
+    // the selection and all of its descendants
+    std::vector<int> removed{ sel->id };
+    for(size_t i = 0; i < removed.size(); ++i) {
+        auto it = m_childrenById.find(removed[i]);
+        if(it != m_childrenById.end()) removed.insert(removed.end(), it->second.begin(), it->second.end());
+    }
+    auto pit = m_childrenById.find(sel->parentId);
+    if(pit != m_childrenById.end()) {
+        auto& siblings = pit->second;
+        siblings.erase(std::remove(siblings.begin(), siblings.end(), sel->id), siblings.end());
+        if(siblings.empty()) m_childrenById.erase(pit);
+    }
+    std::unordered_set<int> gone(removed.begin(), removed.end());
+    m_entities.erase(std::remove_if(m_entities.begin(), m_entities.end(), [&](const SceneEntity& e){ return gone.count(e.id) != 0; }), m_entities.end());
+    for(int id : removed) m_childrenById.erase(id);
+    m_pointCloudIds.erase(std::remove_if(m_pointCloudIds.begin(), m_pointCloudIds.end(), [&](int id){ return gone.count(id) != 0; }), m_pointCloudIds.end());
+    m_clusterMeshIds.erase(std::remove_if(m_clusterMeshIds.begin(), m_clusterMeshIds.end(), [&](int id){ return gone.count(id) != 0; }), m_clusterMeshIds.end());
+    rebuildIndex();
     m_selectedId = 0;
+    for(int id : removed) markEntityDirty(id);
 }
 
 void Scene::translateSelected(const glm::vec3& delta) {
     SceneEntity* e = findById(m_selectedId);
     if(!e) return;
     e->position += delta;
+    markEntityDirty(e->id);
 }
 
 void Scene::setSelectedPosition(const glm::vec3& pos) {
     SceneEntity* e = findById(m_selectedId);
     if(!e) return;
     e->position = pos;
+    markEntityDirty(e->id);
 }
 
 // rotation/scale
@@ -109,24 +218,28 @@ void Scene::rotateSelected(const glm::vec3& deltaDegrees) {
     SceneEntity* e = findById(m_selectedId);
     if(!e) return;
     e->rotation += deltaDegrees;
+    markEntityDirty(e->id);
 }
 
 void Scene::setSelectedRotation(const glm::vec3& eulerDeg) {
     SceneEntity* e = findById(m_selectedId);
     if(!e) return;
     e->rotation = eulerDeg;
+    markEntityDirty(e->id);
 }
 
 void Scene::scaleSelected(const glm::vec3& scaleFactor) {
     SceneEntity* e = findById(m_selectedId);
     if(!e) return;
     e->scale *= scaleFactor;
+    markEntityDirty(e->id);
 }
 
 void Scene::setSelectedScale(const glm::vec3& scale) {
     SceneEntity* e = findById(m_selectedId);
     if(!e) return;
     e->scale = scale;
+    markEntityDirty(e->id);
 }
 
 void Scene::pushCommand(std::unique_ptr<Command> cmd) {
@@ -168,11 +281,18 @@ bool Scene::loadFromFile(const std::string& path) {
     std::ifstream f(path);
     if(!f) return false;
     m_entities.clear();
+    m_indexById.clear();
+    m_childrenById.clear();
+    m_pointCloudIds.clear();
+    m_clusterMeshIds.clear();
+    m_selectedId = 0;
+    m_queueNeedsRebuild = true;
+    markDirty();
     int t; float px,py,pz; float rx,ry,rz; float sx,sy,sz;
     while(f >> t >> px >> py >> pz >> rx >> ry >> rz >> sx >> sy >> sz){
         int id = addPrimitive((primitives::PrimitiveType)t, glm::vec3(px,py,pz));
         SceneEntity* e = findById(id);
-        if(e) { e->rotation = glm::vec3(rx,ry,rz); e->scale = glm::vec3(sx,sy,sz); }
+        if(e) { e->rotation = glm::vec3(rx,ry,rz); e->scale = glm::vec3(sx,sy,sz); markEntityDirty(id); }
     }
     return true;
 }
@@ -191,7 +311,7 @@ Scene::Transform Scene::getEntityTransform(int id) const {
 
 void Scene::setEntityTransform(int id, const Scene::Transform& t) {
     for(auto& e : m_entities){
-        if(e.id == id) { e.position = t.position; e.rotation = t.rotation; e.scale = t.scale; break; }
+        if(e.id == id) { e.position = t.position; e.rotation = t.rotation; e.scale = t.scale; markEntityDirty(id); break; }
     }
 }
 
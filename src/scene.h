@@ -1,19 +1,37 @@
 #pragma once
 
 #include "primitive_factory.h"
+#include "render_queue.h"
 #include <glm/glm.hpp>
 #include <vector>
 #include <memory>
 #include <string>
+#include <unordered_map>
+
+class PointCloud;
+class ClusterMesh;
 
 struct SceneEntity {
     int id = 0;
+    int parentId = 0; // 0 = root; position/rotation/scale are relative to the parent
     primitives::PrimitiveType type = primitives::PrimitiveType::Cube;
-    std::unique_ptr<primitives::MeshGL> mesh;
+    std::string name;
+    // shared by every entity instancing the same imported mesh (uploaded once)
+    std::shared_ptr<primitives::MeshGL> mesh;
+    // out-of-core point cloud (type PointCloud), drawn by Renderer::drawPointClouds instead of the render queue
+    std::shared_ptr<PointCloud> pointCloud;
+    // out-of-core mesh (type ClusterMesh), drawn by Renderer::drawClusterMeshes instead of the render queue
+    std::shared_ptr<ClusterMesh> clusterMesh;
     glm::vec3 position = glm::vec3(0.0f);
     glm::vec3 rotation = glm::vec3(0.0f); // Euler angles in degrees (x=pitch,y=yaw,z=roll)
     glm::vec3 scale = glm::vec3(1.0f);
     glm::vec3 color = glm::vec3(0.8f, 0.2f, 0.2f);
+    // parent world * localMatrix(), kept current by Scene::markEntityDirty()
+    glm::mat4 world = glm::mat4(1.0f);
+
+    glm::mat4 localMatrix() const;
+    // Set position/rotation/scale from a local matrix (shear is dropped)
+    void setLocalMatrix(const glm::mat4& m);
 };
 
 class Scene {
@@ -23,10 +41,14 @@ public:
 
     int addCube(const glm::vec3& pos = glm::vec3(0.0f));
     int addPrimitive(primitives::PrimitiveType type, const glm::vec3& pos = glm::vec3(0.0f));
+    int addPointCloud(std::shared_ptr<PointCloud> cloud, const std::string& name);
+    int addClusterMesh(std::shared_ptr<ClusterMesh> mesh, const std::string& name);
     // Record a spawn without allocating meshes (useful for testing/counting)
     void recordSpawnOnly();
 
-    void drawAll(unsigned int prog, const glm::mat4& vp) const;
+    // Draw every entity through the retained render queue (synced incrementally from edits)
+    void drawAll(unsigned int prog, const glm::mat4& vp);
+    const RenderQueue& renderQueue() const { return m_renderQueue; }
 
     // Selection / editing
     int getSelectedId() const;
@@ -42,15 +64,32 @@ public:
     void setSelectedScale(const glm::vec3& scale);
 
     SceneEntity* findById(int id);
+    const SceneEntity* findById(int id) const;
+
+    // Hierarchy. Children are deleted with their parent.
+    const std::vector<int>& childrenOf(int id) const;
+    // World matrix of the entity's parent (identity for roots)
+    glm::mat4 parentWorld(const SceneEntity& ent) const;
 
     // Expose entities for UI
     const std::vector<SceneEntity>& entities() const { return m_entities; }
     int getEntityCount() const { return (int)m_entities.size(); }
     int getSpawnCount() const { return m_spawnCount; }
+    // ids of the entities holding a point cloud
+    const std::vector<int>& pointCloudIds() const { return m_pointCloudIds; }
+    // ids of the entities holding a cluster mesh
+    const std::vector<int>& clusterMeshIds() const { return m_clusterMeshIds; }
 
-    // Allow external code to add a fully formed entity
+    // Allow external code to add a fully formed entity (its parentId must already exist or be 0)
     int addEntity(SceneEntity&& ent);
 
+    // Change tracking: the revision is bumped whenever entities, transforms or selection change.
+    // Code that mutates a SceneEntity directly (via findById) must call markEntityDirty() afterwards
+    // so its render queue item and world matrix (and those of its descendants) are refreshed.
+    void markDirty() { ++m_revision; }
+    void markEntityDirty(int id);
+    unsigned int getRevision() const { return m_revision; }
+
     // Undo/Redo (simple command stack)
     void undo();
     void redo();
@@ -102,6 +141,26 @@ private:
     // spawn counter (total primitives created or recorded)
     int m_spawnCount = 0;
 
+    // bumped on every visible change (see markDirty)
+    unsigned int m_revision = 0;
+
+    // entity id -> index into m_entities
+    std::unordered_map<int, size_t> m_indexById;
+    void rebuildIndex();
+
+    std::vector<int> m_pointCloudIds;
+    std::vector<int> m_clusterMeshIds;
+
+    // parent id -> child ids (roots are not listed)
+    std::unordered_map<int, std::vector<int>> m_childrenById;
+    void updateWorld(SceneEntity& ent);
+
+    // retained draw list and the entities whose items must be refreshed before the next draw
+    RenderQueue m_renderQueue;
+    std::vector<int> m_dirtyIds;
+    bool m_queueNeedsRebuild = false;
+    void syncRenderQueue();
+
     // command stack
     std::vector<std::unique_ptr<Command>> m_undoStack;
     std::vector<std::unique_ptr<Command>> m_redoStack;
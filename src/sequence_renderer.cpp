@@ -0,0 +1,212 @@
+#include "sequence_renderer.h"
+#include "renderer.h"
+#include "animator.h"
+#include "scene.h"
+#include "camera.h"
+#include "gl_state.h"
+#include "png_codec.h"
+#include "exr_writer.h"
+#include "thread_pool.h"
+#include "log.h"
+#include <filesystem>
+#include <fstream>
+#include <deque>
+#include <future>
+#include <memory>
+#include <chrono>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+
+namespace SequenceRenderer {
+
+// PBOs in flight: a frame is mapped kRing - 1 frames after its readback was issued
+static const int kRing = 3;
+
+struct Slot {
+    GLuint pbo = 0;
+    GLsync fence = nullptr;
+    int frame = -1;
+};
+
+// Output pattern split around its frame number conversion. The pattern comes from the command line,
+// so it is never handed to printf: only "%d" and "%0Nd" are conversions, "%%" is a '%' and any other
+// '%' is copied as is.
+struct FramePattern {
+    std::string head, tail;
+    int width = 0;
+};
+
+// Returns the number of frame number conversions in the pattern; the first one splits it
+static int parsePattern(const std::string& pattern, FramePattern& out) {
+    int conversions = 0;
+    std::string literal;
+    for(size_t i = 0; i < pattern.size();) {
+        if(pattern[i] == '%' && i + 1 < pattern.size()) {
+            if(pattern[i + 1] == '%') { literal += '%'; i += 2; continue; }
+            size_t j = i + 1;
+            int width = 0;
+            if(pattern[j] == '0') {
+                while(++j < pattern.size() && isdigit((unsigned char)pattern[j])) width = std::min(width * 10 + (pattern[j] - '0'), 16);
+                if(width == 0) j = pattern.size(); // "%0" without a width is not a conversion
+            }
+            if(j < pattern.size() && pattern[j] == 'd') {
+                if(conversions++ == 0) { out.head = literal; out.width = width; literal.clear(); }
+                i = j + 1;
+                continue;
+            }
+        }
+        literal += pattern[i++];
+    }
+    (conversions ? out.tail : out.head) = literal;
+    return conversions;
+}
+
+static std::string framePath(const FramePattern& pattern, int frame) {
+    std::string number = std::to_string(frame);
+    if((int)number.size() < pattern.width) number.insert(0, pattern.width - number.size(), '0');
+    return pattern.head + number + pattern.tail;
+}
+
+static bool isExr(const std::string& pattern) {
+    std::string ext = std::filesystem::path(pattern).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == ".exr";
+}
+
+static bool writeFile(const std::string& path, const std::vector<uint8_t>& bytes) {
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+    if(!f) return false;
+    f.write((const char*)bytes.data(), (std::streamsize)bytes.size());
+    return (bool)f;
+}
+
+// Worker: flip the bottom-up readback and encode it
+static bool encodeFrame(const std::vector<uint8_t>& pixels, int w, int h, bool exr, const std::string& path) {
+    std::vector<uint8_t> bytes;
+    size_t stride = (size_t)w * (exr ? 8 : 4);
+    std::vector<uint8_t> flipped(pixels.size());
+    for(int y = 0; y < h; ++y) memcpy(flipped.data() + stride * y, pixels.data() + stride * (h - 1 - y), stride);
+    bool ok = exr ? ExrWriter::encodeRGBAHalf((const uint16_t*)flipped.data(), w, h, bytes)
+                  : PngCodec::encodeRGBA(flipped.data(), w, h, bytes);
+    if(ok) ok = writeFile(path, bytes);
+    if(!ok) LOG_ERROR("Sequence: cannot write " << path);
+    return ok;
+}
+
+Stats render(Scene& scene, Camera& camera, const Settings& settings) {
+    Stats stats;
+    auto t0 = std::chrono::steady_clock::now();
+    const int w = std::max(settings.width, 1), h = std::max(settings.height, 1);
+    const bool exr = isExr(settings.outputPattern);
+    const size_t frameBytes = (size_t)w * h * (exr ? 8 : 4);
+    const float frameTime = 1.0f / std::max(settings.fps, 1e-3f);
+    const float step = std::max(g_fixedTimestep, 1e-4f);
+    // frames copied out of their PBO but not yet picked up by a worker
+    const size_t maxEncoding = ThreadPool::instance().workerCount() * 2 + 2;
+
+    FramePattern pattern;
+    int conversions = parsePattern(settings.outputPattern, pattern);
+    if(conversions > 1) {
+        LOG_ERROR("Sequence: output pattern " << settings.outputPattern << " has more than one frame number");
+        stats.failed = (size_t)std::max(settings.frameCount, 0);
+        return stats;
+    }
+    if(conversions == 0) {
+        // no frame number in the pattern: number the files before the extension
+        std::filesystem::path p(pattern.head);
+        pattern.head = (p.parent_path() / (p.stem().string() + "_")).string();
+        pattern.tail = p.extension().string();
+        pattern.width = 4;
+    }
+    std::error_code ec;
+    std::filesystem::path dir = std::filesystem::path(framePath(pattern, 0)).parent_path();
+    if(!dir.empty()) std::filesystem::create_directories(dir, ec);
+
+    // EXR frames are rendered and read back in half float, so they keep more than 8 bits per channel
+    if(exr) Renderer::setColorFormat(GL_RGBA16F);
+
+    Slot ring[kRing];
+    for(Slot& s : ring) {
+        glGenBuffers(1, &s.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)frameBytes, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    std::deque<std::future<bool>> encoding;
+    auto retireEncoding = [&](size_t keep){
+        while(encoding.size() > keep) {
+            if(encoding.front().get()) stats.written++; else stats.failed++;
+            encoding.pop_front();
+        }
+    };
+
+    // Map a finished readback and hand a copy to the pool
+    auto collect = [&](Slot& s){
+        if(s.frame < 0) return;
+        auto tw = std::chrono::steady_clock::now();
+        while(glClientWaitSync(s.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull) == GL_TIMEOUT_EXPIRED) {}
+        stats.readbackWaitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tw).count();
+        glDeleteSync(s.fence);
+        s.fence = nullptr;
+        auto pixels = std::make_shared<std::vector<uint8_t>>(frameBytes);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo);
+        const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)frameBytes, GL_MAP_READ_BIT);
+        bool ok = mapped != nullptr;
+        if(ok) memcpy(pixels->data(), mapped, frameBytes);
+        if(ok) glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        if(!ok) { LOG_ERROR("Sequence: cannot map readback of frame " << s.frame); stats.failed++; s.frame = -1; return; }
+        retireEncoding(maxEncoding);
+        std::string path = framePath(pattern, s.frame);
+        auto done = std::make_shared<std::promise<bool>>();
+        encoding.push_back(done->get_future());
+        ThreadPool::instance().submit([pixels, w, h, exr, path, done]{ done->set_value(encodeFrame(*pixels, w, h, exr, path)); });
+        s.frame = -1;
+    };
+
+    LOG_INFO("Sequence: " << settings.frameCount << " frames at " << w << "x" << h << ", " << settings.fps << " fps -> " << settings.outputPattern);
+    float accumulator = 0.0f;
+    const float orbitStep = settings.turntable && settings.frameCount > 0 ? glm::radians(360.0f) / (float)settings.frameCount : 0.0f;
+    glm::mat4 view, proj;
+    for(int frame = 0; frame < settings.frameCount; ++frame) {
+        if(frame > 0) {
+            accumulator += frameTime;
+            while(accumulator >= step) {
+                g_animator.update(scene, step);
+                accumulator -= step;
+            }
+            if(orbitStep != 0.0f) camera.orbit(orbitStep);
+        }
+        Renderer::renderScene(scene, camera, ImVec2(0.0f, 0.0f), ImVec2((float)w, (float)h), settings.wireframe, view, proj);
+        GLuint fbo = Renderer::getFramebuffer();
+        if(!fbo) { LOG_ERROR("Sequence: no render target for frame " << frame); stats.failed++; continue; }
+
+        // the slot is reused every kRing frames; its previous frame is long finished by now
+        Slot& slot = ring[frame % kRing];
+        collect(slot);
+        GLState::bindFramebuffer(fbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, 0, w, h, GL_RGBA, exr ? GL_HALF_FLOAT : GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        GLState::bindFramebuffer(0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.frame = frame;
+        // make sure the GPU starts on this frame while the CPU sets up the next one
+        glFlush();
+    }
+    // drain the ring in frame order
+    for(int i = 0; i < kRing; ++i) collect(ring[(settings.frameCount + i) % kRing]);
+    retireEncoding(0);
+    for(Slot& s : ring) glDeleteBuffers(1, &s.pbo);
+    if(exr) Renderer::setColorFormat(GL_RGBA8);
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    LOG_INFO("Sequence: " << stats.written << " frames written, " << stats.failed << " failed in " << stats.seconds << " s ("
+             << (stats.seconds > 0.0 ? (double)stats.written / stats.seconds : 0.0) << " fps, " << stats.readbackWaitMs << " ms waiting on readback)");
+    return stats;
+}
+
+} // namespace SequenceRenderer
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+class Scene;
+class Camera;
+
+// Offline rendering of an animated scene to numbered image files (turntables and playblasts for review).
+// Frames are rendered with Renderer::renderScene, so they look like the viewport. Between frames the
+// animator advances by the frame duration in g_fixedTimestep steps (like the main loop with
+// g_useFixedTimestep), so the result does not depend on how fast frames render.
+//
+// Readback goes through a ring of pixel buffer objects: glReadPixels into a PBO returns at once and the
+// PBO is mapped only once its fence has signalled, frames later, so the GPU is never drained between
+// frames. Mapped frames are encoded (PNG, or half-float EXR) and written on the thread pool; the number
+// of frames waiting for a worker is capped, so memory stays bounded when encoding is the bottleneck.
+//
+// Needs a current GL context with Renderer::init() done (see HeadlessGL for batch runs).
+namespace SequenceRenderer {
+    struct Settings {
+        // printf pattern taking the frame number; ".exr" writes EXR, anything else PNG
+        std::string outputPattern = "frames/frame_%04d.png";
+        int width = 1280;
+        int height = 720;
+        int frameCount = 120;
+        float fps = 30.0f;
+        bool turntable = false; // orbit the camera once around its target over the sequence
+        bool wireframe = false;
+    };
+    struct Stats {
+        size_t written = 0;
+        size_t failed = 0;
+        double seconds = 0.0;
+        double readbackWaitMs = 0.0; // time spent waiting for PBO fences
+    };
+
+    // Render and write every frame; the scene and camera are left at the last frame's state
+    Stats render(Scene& scene, Camera& camera, const Settings& settings);
+}
@@ -0,0 +1,99 @@
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+ThreadPool& ThreadPool::instance() {
+    static ThreadPool pool;
+    return pool;
+}
+
+ThreadPool::ThreadPool() {
+    // leave one core for the main (UI/GL) thread
+    unsigned int hw = std::thread::hardware_concurrency();
+    size_t n = hw > 1 ? hw - 1 : 1;
+    for(size_t i = 0; i < n; ++i) workers_.emplace_back([this]{ workerLoop(); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for(auto& t : workers_) if(t.joinable()) t.join();
+}
+
+void ThreadPool::workerLoop() {
+    for(;;) {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lk(mtx_);
+            cv_.wait(lk, [this]{ return stopping_ || !queue_.empty(); });
+            if(queue_.empty()) return; // stopping and drained
+            task = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        task();
+    }
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task) {
+    std::packaged_task<void()> pt(std::move(task));
+    std::future<void> fut = pt.get_future();
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        queue_.push_back(std::move(pt));
+    }
+    cv_.notify_one();
+    return fut;
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn) {
+    if(count == 0) return;
+    grain = std::max<size_t>(grain, 1);
+    size_t chunks = (count + grain - 1) / grain;
+    if(chunks == 1 || workers_.empty()) { fn(0, count); return; }
+
+    // Chunks are claimed through a shared counter. Helpers that start after all chunks are
+    // claimed return immediately, so the caller only waits for chunks, never for queued tasks
+    // (which could otherwise deadlock when every worker is itself inside parallelFor).
+    struct Shared {
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::atomic<bool> failed{false};
+        std::exception_ptr error; // first exception thrown by fn, under mtx
+    };
+    auto shared = std::make_shared<Shared>();
+    auto run = [shared, chunks, count, grain, &fn]() {
+        for(;;) {
+            size_t c = shared->next.fetch_add(1);
+            if(c >= chunks) return;
+            size_t begin = c * grain;
+            // after a failure the remaining chunks are only counted, so the caller stops waiting
+            if(!shared->failed.load()) {
+                try {
+                    fn(begin, std::min(begin + grain, count));
+                } catch(...) {
+                    std::lock_guard<std::mutex> lk(shared->mtx);
+                    if(!shared->error) shared->error = std::current_exception();
+                    shared->failed = true;
+                }
+            }
+            if(shared->done.fetch_add(1) + 1 == chunks) {
+                std::lock_guard<std::mutex> lk(shared->mtx);
+                shared->cv.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = std::min(chunks - 1, workers_.size());
+    for(size_t i = 0; i < helpers; ++i) submit(run);
+    run();
+    std::unique_lock<std::mutex> lk(shared->mtx);
+    shared->cv.wait(lk, [&]{ return shared->done.load() == chunks; });
+    if(shared->error) std::rethrow_exception(shared->error);
+}
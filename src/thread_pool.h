@@ -0,0 +1,39 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Process-wide worker pool for CPU-heavy asset work (import conversion, welding, BVH builds...).
+// Never touch GL from a task; hand results back to the main thread instead.
+class ThreadPool {
+public:
+    static ThreadPool& instance();
+
+    // Queue a task; the future becomes ready when it has run
+    std::future<void> submit(std::function<void()> task);
+
+    // Run fn(begin, end) over [0, count) in chunks of about 'grain' items and wait for completion.
+    // The calling thread works on chunks too, so this is safe to call from inside a pool task.
+    // If fn throws, chunks not yet started are skipped and the first exception is rethrown here.
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn);
+
+    size_t workerCount() const { return workers_.size(); }
+
+private:
+    ThreadPool();
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void workerLoop();
+
+    std::vector<std::thread> workers_;
+    std::deque<std::packaged_task<void()>> queue_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+};
@@ -0,0 +1,333 @@
+#include "thumbnail_cache.h"
+#include "thread_pool.h"
+#include "mapped_file.h"
+#include "png_codec.h"
+#include "mesh_cache.h"
+#include "asset_database.h"
+#include "log.h"
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <cstdio>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+
+namespace ThumbnailCache {
+
+static const int kMaxSize = 1024;
+
+// loads running on the pool at once; keeps a fast scroll from queueing every item it passed
+static const int kMaxLoadsInFlight = 4;
+// texture uploads per frame (a 128x128 thumbnail is 64 KB)
+static const int kUploadsPerFrame = 8;
+static const size_t kMaxTextures = 512;
+// a missing thumbnail is looked for again after this long, or as soon as the cache directory changes
+static const double kMissingRetrySeconds = 30.0;
+static const double kDirectoryPollSeconds = 2.0;
+
+struct Thumb {
+    enum State { Unloaded, Loading, Loaded, Missing };
+    State state = Unloaded;
+    GLuint texture = 0;
+    uint64_t lastUse = 0;
+    double missingSince = 0.0;
+};
+
+struct Decoded {
+    std::string asset;
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> rgba; // empty: no usable thumbnail
+};
+
+static std::unordered_map<std::string, Thumb> s_thumbs;
+static std::vector<std::string> s_requested; // this frame, in request order
+static uint64_t s_frame = 0;
+static int s_inFlight = 0;
+static size_t s_textureCount = 0;
+// modification time of the cache directory at the last poll; thumbnails are added by renaming into it
+static std::filesystem::file_time_type s_dirTime;
+static double s_lastDirPoll = -1.0;
+
+static std::mutex s_doneMtx;
+static std::vector<Decoded> s_done;
+
+// The browser, the asset database and the batch renderer may spell the same file differently
+// ("./dir/x.glb", "dir/x.glb", absolute): the index and invalidate() compare this form
+static std::string normalized(const std::string& path) {
+    std::error_code ec;
+    std::filesystem::path p = std::filesystem::absolute(path, ec);
+    return (ec ? std::filesystem::path(path) : p).lexically_normal().string();
+}
+
+// content hash index: normalized asset path -> state of the file when it was hashed
+struct IndexEntry {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    uint64_t hash = 0;
+};
+static std::mutex s_indexMtx;
+static std::string s_dir = "thumbnails";
+static std::unordered_map<std::string, IndexEntry> s_index;
+static bool s_indexLoaded = false;
+static bool s_indexDirty = false;
+
+static std::string indexPath() { return (std::filesystem::path(s_dir) / "index").string(); }
+
+// one tab-separated line per asset: path, size, mtime, hash (hex). Merged into the entries already
+// known, the newer state of a file winning, so it can be reread when another process saved it.
+// Caller holds s_indexMtx.
+static void loadIndex() {
+    s_indexLoaded = true;
+    std::ifstream f(indexPath());
+    std::string line;
+    while(std::getline(f, line)) {
+        if(line.empty() || line[0] == '#') continue;
+        std::vector<std::string> fields;
+        std::stringstream ss(line);
+        std::string field;
+        while(std::getline(ss, field, '\t')) fields.push_back(field);
+        if(fields.size() != 4) continue;
+        try {
+            IndexEntry e;
+            e.size = std::stoull(fields[1], nullptr, 16);
+            e.mtime = (int64_t)std::stoull(fields[2], nullptr, 16);
+            e.hash = std::stoull(fields[3], nullptr, 16);
+            // older indexes stored paths as given
+            std::string path = normalized(fields[0]);
+            auto it = s_index.find(path);
+            if(it == s_index.end() || it->second.mtime < e.mtime) s_index[path] = e;
+        } catch(const std::exception&) {}
+    }
+}
+
+void setDirectory(const std::string& dir) {
+    std::lock_guard<std::mutex> lk(s_indexMtx);
+    if(dir == s_dir) return;
+    s_dir = dir;
+    s_index.clear();
+    s_indexLoaded = false;
+    s_indexDirty = false;
+}
+
+std::string thumbnailPath(uint64_t contentHash) {
+    char name[24];
+    snprintf(name, sizeof(name), "%016llx.png", (unsigned long long)contentHash);
+    std::lock_guard<std::mutex> lk(s_indexMtx);
+    return (std::filesystem::path(s_dir) / name).string();
+}
+
+// Memoized hash of the file in its current state ('hash' = 0 when it was not hashed since it last
+// changed); false when the file cannot be read
+static bool lookupHash(const std::string& assetPath, MeshCache::SourceKey& key, uint64_t& hash) {
+    hash = 0;
+    if(!MeshCache::sourceKey(assetPath, 0, key)) return false;
+    std::string path = normalized(assetPath);
+    std::lock_guard<std::mutex> lk(s_indexMtx);
+    if(!s_indexLoaded) loadIndex();
+    auto it = s_index.find(path);
+    if(it != s_index.end() && it->second.size == key.size && it->second.mtime == key.time) hash = it->second.hash;
+    return true;
+}
+
+uint64_t knownHash(const std::string& assetPath) {
+    MeshCache::SourceKey key;
+    uint64_t hash;
+    lookupHash(assetPath, key, hash);
+    return hash;
+}
+
+uint64_t assetHash(const std::string& assetPath) {
+    MeshCache::SourceKey key;
+    uint64_t known;
+    if(!lookupHash(assetPath, key, known)) return 0;
+    if(known != 0) return known;
+    uint64_t hash = AssetDatabase::contentHash(assetPath);
+    if(hash == 0) return 0;
+    std::string path = normalized(assetPath);
+    std::lock_guard<std::mutex> lk(s_indexMtx);
+    s_index[path] = { key.size, key.time, hash };
+    s_indexDirty = true;
+    return hash;
+}
+
+void recordHash(const std::string& assetPath, uint64_t size, int64_t mtime, uint64_t contentHash) {
+    if(contentHash == 0) return;
+    std::string path = normalized(assetPath);
+    std::lock_guard<std::mutex> lk(s_indexMtx);
+    if(!s_indexLoaded) loadIndex();
+    s_index[path] = { size, mtime, contentHash };
+    s_indexDirty = true;
+}
+
+bool exists(uint64_t contentHash) {
+    std::error_code ec;
+    return std::filesystem::exists(thumbnailPath(contentHash), ec);
+}
+
+void saveIndex() {
+    std::lock_guard<std::mutex> lk(s_indexMtx);
+    if(!s_indexDirty) return;
+    std::error_code ec;
+    std::filesystem::create_directories(s_dir, ec);
+    std::string path = indexPath(), tmp = path + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::trunc);
+        if(!f) { LOG_WARN("Thumbnail cache: cannot write " << tmp); return; }
+        f << "# thumbnail index v1\n" << std::hex;
+        for(const auto& e : s_index) f << e.first << '\t' << e.second.size << '\t' << e.second.mtime << '\t' << e.second.hash << '\n';
+        if(!f) return;
+    }
+    std::filesystem::rename(tmp, path, ec);
+    if(!ec) s_indexDirty = false;
+}
+
+static double now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+GLuint get(const std::string& assetPath) {
+    Thumb& t = s_thumbs[assetPath];
+    t.lastUse = s_frame;
+    if(t.state == Thumb::Missing && now() - t.missingSince > kMissingRetrySeconds) t.state = Thumb::Unloaded;
+    if(t.state == Thumb::Unloaded) s_requested.push_back(assetPath);
+    return t.texture;
+}
+
+// Worker: find the asset's thumbnail by content hash and decode it. Only memoized hashes are used:
+// hashing here would read every multi-GB file scrolled past just to find it has no thumbnail.
+static void load(Decoded& d) {
+    uint64_t hash = knownHash(d.asset);
+    if(hash == 0) return;
+    MappedFile file;
+    if(!file.open(thumbnailPath(hash))) return;
+    int w = 0, h = 0;
+    std::vector<uint8_t> rgba;
+    if(!PngCodec::decodeRGBA(file.data(), file.size(), w, h, rgba) || w > kMaxSize || h > kMaxSize) return;
+    d.width = w;
+    d.height = h;
+    d.rgba.swap(rgba);
+}
+
+static void evict() {
+    if(s_textureCount <= kMaxTextures) return;
+    std::vector<std::pair<uint64_t, Thumb*>> loaded;
+    for(auto& e : s_thumbs) if(e.second.texture && e.second.lastUse != s_frame) loaded.push_back({ e.second.lastUse, &e.second });
+    std::sort(loaded.begin(), loaded.end(), [](const auto& a, const auto& b){ return a.first < b.first; });
+    for(size_t i = 0; i < loaded.size() && s_textureCount > kMaxTextures; ++i) {
+        Thumb& t = *loaded[i].second;
+        glDeleteTextures(1, &t.texture);
+        t.texture = 0;
+        t.state = Thumb::Unloaded;
+        s_textureCount--;
+    }
+}
+
+// Thumbnails written since the last poll (by a batch run, or another process) may be the missing ones
+static void pollDirectory() {
+    double t = now();
+    if(t - s_lastDirPoll < kDirectoryPollSeconds) return;
+    s_lastDirPoll = t;
+    std::lock_guard<std::mutex> lk(s_indexMtx);
+    std::error_code ec;
+    std::filesystem::file_time_type time = std::filesystem::last_write_time(s_dir, ec);
+    if(ec || time == s_dirTime) return;
+    s_dirTime = time;
+    // a batch run saves the hashes of the files it rendered along with the thumbnails
+    if(s_indexLoaded) loadIndex();
+    for(auto& e : s_thumbs) if(e.second.state == Thumb::Missing) e.second.state = Thumb::Unloaded;
+}
+
+bool pump() {
+    s_frame++;
+    pollDirectory();
+    // newest requests first: what is on screen now
+    for(auto it = s_requested.rbegin(); it != s_requested.rend() && s_inFlight < kMaxLoadsInFlight; ++it) {
+        Thumb& t = s_thumbs[*it];
+        if(t.state != Thumb::Unloaded) continue;
+        t.state = Thumb::Loading;
+        s_inFlight++;
+        std::string asset = *it;
+        ThreadPool::instance().submit([asset]{
+            Decoded d;
+            d.asset = asset;
+            load(d);
+            std::lock_guard<std::mutex> lk(s_doneMtx);
+            s_done.push_back(std::move(d));
+        });
+    }
+    s_requested.clear();
+
+    std::vector<Decoded> done;
+    {
+        std::lock_guard<std::mutex> lk(s_doneMtx);
+        size_t n = std::min(s_done.size(), (size_t)kUploadsPerFrame);
+        done.assign(std::make_move_iterator(s_done.begin()), std::make_move_iterator(s_done.begin() + n));
+        s_done.erase(s_done.begin(), s_done.begin() + n);
+    }
+    for(Decoded& d : done) {
+        s_inFlight--;
+        auto it = s_thumbs.find(d.asset);
+        // invalidated while loading: the next get() starts over
+        if(it == s_thumbs.end() || it->second.state != Thumb::Loading) continue;
+        Thumb& t = it->second;
+        if(d.rgba.empty()) { t.state = Thumb::Missing; t.missingSince = now(); continue; }
+        glGenTextures(1, &t.texture);
+        glBindTexture(GL_TEXTURE_2D, t.texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, d.width, d.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, d.rgba.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+        t.state = Thumb::Loaded;
+        s_textureCount++;
+    }
+    evict();
+    std::lock_guard<std::mutex> lk(s_doneMtx);
+    return s_inFlight > 0 || !s_done.empty();
+}
+
+bool write(uint64_t contentHash, int width, int height, const uint8_t* rgba) {
+    if(width <= 0 || height <= 0 || width > kMaxSize || height > kMaxSize || !rgba) return false;
+    std::vector<uint8_t> png;
+    if(!PngCodec::encodeRGBA(rgba, width, height, png)) return false;
+    std::string path = thumbnailPath(contentHash);
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+    // unique temporary name: several workers may store the same content at once
+    std::ostringstream tmp;
+    tmp << path << '.' << std::this_thread::get_id() << ".tmp";
+    {
+        std::ofstream f(tmp.str(), std::ios::binary | std::ios::trunc);
+        if(!f) return false;
+        f.write((const char*)png.data(), (std::streamsize)png.size());
+        if(!f) return false;
+    }
+    std::filesystem::rename(tmp.str(), path, ec);
+    return !ec;
+}
+
+void invalidate(const std::string& assetPath) {
+    std::string target = normalized(assetPath);
+    for(auto it = s_thumbs.begin(); it != s_thumbs.end();) {
+        if(it->first != assetPath && normalized(it->first) != target) { ++it; continue; }
+        if(it->second.texture) { glDeleteTextures(1, &it->second.texture); s_textureCount--; }
+        // a load still in flight is discarded when it arrives
+        it = s_thumbs.erase(it);
+    }
+}
+
+void destroy() {
+    for(auto& e : s_thumbs) if(e.second.texture) glDeleteTextures(1, &e.second.texture);
+    s_thumbs.clear();
+    s_textureCount = 0;
+    saveIndex();
+}
+
+} // namespace ThumbnailCache
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <glad/glad.h>
+
+// Asset thumbnails for the browser, stored as PNG files in a cache directory and keyed by the asset's
+// content hash ("<dir>/<xxh64 hex>.png"), so copies and renames of an asset share one thumbnail and an
+// edited asset simply misses until it is rendered again (see ThumbnailRenderer). Content hashes are
+// remembered by path, size and modification time in "<dir>/index", so a file is hashed once.
+//
+// get() is cheap and only records the request; pump() reads the most recently requested files on
+// the thread pool (a few at a time, so items scrolled past are never loaded) and uploads finished
+// ones within a per-frame budget. Least recently used textures are evicted beyond a fixed count.
+// Assets without a thumbnail are looked up again when the cache directory changes, and after a timeout.
+// get(), pump(), invalidate() and destroy() must be called on the GL thread; the rest are thread-safe.
+namespace ThumbnailCache {
+    // Cache directory (default "thumbnails"); set before the first use
+    void setDirectory(const std::string& dir);
+    std::string thumbnailPath(uint64_t contentHash);
+
+    // Content hash of the asset (AssetDatabase::contentHash), memoized by size and mtime. 0 when unreadable.
+    uint64_t assetHash(const std::string& assetPath);
+    // The memoized hash only, without reading the file; 0 when it was not hashed since it last changed.
+    // The browser uses this: only the batch pass (ThumbnailRenderer) hashes.
+    uint64_t knownHash(const std::string& assetPath);
+    // Memoize a hash computed elsewhere (AssetDatabase after a reimport) for the file's size and mtime
+    void recordHash(const std::string& assetPath, uint64_t size, int64_t mtime, uint64_t contentHash);
+    bool exists(uint64_t contentHash);
+
+    // Texture for the asset, or 0 while it is loading or when there is no thumbnail
+    GLuint get(const std::string& assetPath);
+
+    // Start loads and upload finished ones. Call once per frame. Returns true while work is pending.
+    bool pump();
+
+    // Store a thumbnail (RGBA8 rows top to bottom) for the content hash. Call invalidate() afterwards
+    // to show it in a running browser.
+    bool write(uint64_t contentHash, int width, int height, const uint8_t* rgba);
+    // Forget the asset's thumbnail state so the next get() loads it again (AssetDatabase calls it after
+    // a reimport)
+    void invalidate(const std::string& assetPath);
+
+    // Save the hash index (call before exit; the headless renderer calls it when done)
+    void saveIndex();
+    // Delete every texture (before the GL context goes away) and save the hash index
+    void destroy();
+}
@@ -0,0 +1,308 @@
+#include "thumbnail_renderer.h"
+#include "thumbnail_cache.h"
+#include "asset_loader.h"
+#include "render_target_pool.h"
+#include "renderer.h"
+#include "gl_state.h"
+#include "thread_pool.h"
+#include "log.h"
+#include <GLFW/glfw3.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <filesystem>
+#include <unordered_set>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+namespace ThumbnailRenderer {
+
+// assets parsed and built at once before their tiles are drawn
+static const size_t kLoadGroup = 8;
+static const float kFovDegrees = 30.0f;
+static const glm::vec3 kFillColor(0.72f, 0.74f, 0.78f);
+static const glm::vec3 kWireColor(0.28f, 0.30f, 0.34f);
+
+struct Item {
+    std::string path;
+    uint64_t hash = 0;
+};
+
+static void collectFiles(const std::vector<std::string>& paths, std::vector<std::string>& out) {
+    namespace fs = std::filesystem;
+    for(const std::string& p : paths) {
+        std::error_code ec;
+        if(!fs::is_directory(p, ec)) {
+            if(AssetLoader::canImport(p)) out.push_back(p);
+            else LOG_WARN("Thumbnails: not an importable file: " << p);
+            continue;
+        }
+        fs::recursive_directory_iterator it(p, fs::directory_options::skip_permission_denied, ec), end;
+        for(; !ec && it != end; it.increment(ec)) {
+            std::error_code fec;
+            std::string name = it->path().filename().string();
+            if(it->is_directory(fec)) {
+                if(!name.empty() && name[0] == '.') it.disable_recursion_pending();
+                continue;
+            }
+            if(it->is_regular_file(fec) && AssetLoader::canImport(name)) out.push_back(it->path().string());
+        }
+    }
+}
+
+// Frame the parts' world bounds from above-front-right and draw them into the current viewport
+static void drawAsset(const std::vector<AssetLoader::PreviewPart>& parts, int tileSize) {
+    glm::vec3 mn(1e30f), mx(-1e30f);
+    size_t triangles = 0;
+    for(const auto& p : parts) {
+        for(int c = 0; c < 8; ++c) {
+            glm::vec3 corner((c & 1) ? p.mesh->aabbMax.x : p.mesh->aabbMin.x,
+                             (c & 2) ? p.mesh->aabbMax.y : p.mesh->aabbMin.y,
+                             (c & 4) ? p.mesh->aabbMax.z : p.mesh->aabbMin.z);
+            glm::vec3 w = glm::vec3(p.world * glm::vec4(corner, 1.0f));
+            mn = glm::min(mn, w);
+            mx = glm::max(mx, w);
+        }
+        triangles += (size_t)p.mesh->indexCount / 3;
+    }
+    glm::vec3 center = (mn + mx) * 0.5f;
+    float radius = std::max(glm::length(mx - mn) * 0.5f, 1e-6f);
+    float dist = radius / std::sin(glm::radians(kFovDegrees) * 0.5f);
+    glm::vec3 dir = glm::normalize(glm::vec3(1.0f, 0.8f, 1.3f));
+    glm::mat4 view = glm::lookAt(center + dir * dist, center, glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 proj = glm::perspective(glm::radians(kFovDegrees), 1.0f, std::max(dist - radius * 1.01f, dist * 1e-3f), dist + radius * 1.01f);
+    glm::mat4 vp = proj * view;
+
+    // wires only help while there are a few pixels per triangle; denser meshes would turn solid dark
+    bool wires = triangles * 8 < (size_t)tileSize * tileSize;
+    if(wires) {
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(1.0f, 1.0f);
+    }
+    for(const auto& p : parts) Renderer::drawMesh(*p.mesh, vp * p.world * p.mesh->positionDecode(), kFillColor);
+    if(wires) {
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        GLState::polygonMode(GL_LINE);
+        for(const auto& p : parts) Renderer::drawMesh(*p.mesh, vp * p.world * p.mesh->positionDecode(), kWireColor);
+        GLState::polygonMode(GL_FILL);
+    }
+}
+
+// Copy tile 'slot' out of the atlas readback (bottom-up rows) and store it (worker thread)
+static bool encodeTile(const std::vector<uint8_t>& atlas, int atlasSize, int tileSize, size_t slot, uint64_t hash) {
+    int perRow = atlasSize / tileSize;
+    int x0 = (int)(slot % perRow) * tileSize;
+    int y0 = (int)(slot / perRow) * tileSize;
+    std::vector<uint8_t> tile((size_t)tileSize * tileSize * 4);
+    for(int r = 0; r < tileSize; ++r) {
+        const uint8_t* src = atlas.data() + ((size_t)(y0 + tileSize - 1 - r) * atlasSize + x0) * 4;
+        memcpy(tile.data() + (size_t)r * tileSize * 4, src, (size_t)tileSize * 4);
+    }
+    return ThumbnailCache::write(hash, tileSize, tileSize, tile.data());
+}
+
+Stats render(const std::vector<std::string>& paths, const Options& options) {
+    Stats stats;
+    auto t0 = std::chrono::steady_clock::now();
+    int tileSize = std::clamp(options.tileSize, 16, 1024);
+    int atlasSize = std::max(options.atlasSize, tileSize) / tileSize * tileSize;
+    int perRow = atlasSize / tileSize;
+    size_t perBatch = (size_t)perRow * perRow;
+
+    std::vector<std::string> files;
+    collectFiles(paths, files);
+    std::vector<Item> all(files.size());
+    ThreadPool::instance().parallelFor(files.size(), 16, [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; ++i) {
+            all[i].path = files[i];
+            all[i].hash = ThumbnailCache::assetHash(files[i]);
+        }
+    });
+    // one thumbnail per distinct content
+    std::vector<Item> todo;
+    std::unordered_set<uint64_t> seen;
+    for(Item& it : all) {
+        if(it.hash == 0) { LOG_WARN("Thumbnails: cannot read " << it.path); stats.failed++; continue; }
+        if(!seen.insert(it.hash).second || (!options.force && ThumbnailCache::exists(it.hash))) { stats.cached++; continue; }
+        todo.push_back(std::move(it));
+    }
+    LOG_INFO("Thumbnails: " << files.size() << " files, " << todo.size() << " to render (" << tileSize << " px, " << perBatch << " per batch)");
+
+    RenderTargetPool::Target* target = todo.empty() ? nullptr : RenderTargetPool::acquire("thumbnails", atlasSize, atlasSize);
+    if(!todo.empty() && !target) { LOG_ERROR("Thumbnails: cannot create a " << atlasSize << "x" << atlasSize << " target"); stats.failed += todo.size(); return stats; }
+
+    // tiles of the previous batch still being encoded; they own their readback
+    std::vector<std::future<bool>> encoding;
+    auto finishEncoding = [&]{
+        for(auto& f : encoding) { if(f.get()) stats.rendered++; else stats.failed++; }
+        encoding.clear();
+    };
+
+    for(size_t batch = 0; batch < todo.size(); batch += perBatch) {
+        size_t count = std::min(perBatch, todo.size() - batch);
+        GLState::bindFramebuffer(target->fbo);
+        GLState::setScissorTest(false);
+        GLState::viewport(0, 0, atlasSize, atlasSize);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        GLState::setDepthTest(true);
+        GLState::setBlend(false);
+        GLState::setScissorTest(true);
+
+        std::vector<bool> drawn(count, false);
+        for(size_t group = 0; group < count; group += kLoadGroup) {
+            size_t n = std::min(kLoadGroup, count - group);
+            std::vector<std::vector<AssetLoader::PreviewPart>> loaded(n);
+            ThreadPool::instance().parallelFor(n, 1, [&](size_t begin, size_t end){
+                for(size_t i = begin; i < end; ++i) AssetLoader::loadPreview(todo[batch + group + i].path, loaded[i]);
+            });
+            for(size_t i = 0; i < n; ++i) {
+                size_t slot = group + i;
+                if(loaded[i].empty()) { LOG_WARN("Thumbnails: nothing to draw in " << todo[batch + slot].path); continue; }
+                for(auto& p : loaded[i]) if(p.mesh->vao == 0) p.mesh->uploadGPU();
+                int x = (int)(slot % perRow) * tileSize, y = (int)(slot / perRow) * tileSize;
+                GLState::viewport(x, y, tileSize, tileSize);
+                glScissor(x, y, tileSize, tileSize);
+                drawAsset(loaded[i], tileSize);
+                drawn[slot] = true;
+            }
+            // the meshes are released here; GL frees their buffers once the draws are done
+        }
+        GLState::setScissorTest(false);
+
+        finishEncoding();
+        auto pixels = std::make_shared<std::vector<uint8_t>>((size_t)atlasSize * atlasSize * 4);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, 0, atlasSize, atlasSize, GL_RGBA, GL_UNSIGNED_BYTE, pixels->data());
+        GLState::bindFramebuffer(0);
+        for(size_t slot = 0; slot < count; ++slot) {
+            if(!drawn[slot]) { stats.failed++; continue; }
+            uint64_t hash = todo[batch + slot].hash;
+            auto promise = std::make_shared<std::promise<bool>>();
+            encoding.push_back(promise->get_future());
+            ThreadPool::instance().submit([pixels, atlasSize, tileSize, slot, hash, promise]{
+                promise->set_value(encodeTile(*pixels, atlasSize, tileSize, slot, hash));
+            });
+        }
+        LOG_INFO("Thumbnails: " << std::min(batch + count, todo.size()) << " / " << todo.size());
+    }
+    finishEncoding();
+    if(target) RenderTargetPool::release("thumbnails");
+    ThumbnailCache::saveIndex();
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    LOG_INFO("Thumbnails: " << stats.rendered << " rendered, " << stats.cached << " cached, " << stats.failed << " failed in " << s << " s");
+    return stats;
+}
+
+// ---- Single assets in the editor ----
+
+struct Preview {
+    std::string path;
+    uint64_t hash = 0;
+    std::vector<AssetLoader::PreviewPart> parts;
+};
+
+struct Written {
+    std::string path;
+    std::future<bool> ok;
+};
+
+static std::deque<Item> s_queue;
+static std::mutex s_previewMtx;
+static std::unique_ptr<Preview> s_preview; // built by the worker, taken by pump(); under s_previewMtx
+static bool s_loading = false;             // a preview is being built or waits in s_preview
+static std::vector<Written> s_written;
+
+void request(const std::string& path, uint64_t contentHash) {
+    for(Item& it : s_queue) if(it.path == path) { it.hash = contentHash; return; }
+    s_queue.push_back({ path, contentHash });
+}
+
+// Draw the preview into a tile-sized target, read it back and encode it on a worker
+static void renderPreview(const Preview& p, int tileSize) {
+    RenderTargetPool::Target* target = RenderTargetPool::acquire("thumbnail-tile", tileSize, tileSize);
+    if(!target) { LOG_WARN("Thumbnails: cannot create a " << tileSize << "x" << tileSize << " target"); return; }
+    for(auto& part : p.parts) if(part.mesh->vao == 0) part.mesh->uploadGPU();
+    GLState::bindFramebuffer(target->fbo);
+    GLState::setScissorTest(false);
+    GLState::viewport(0, 0, tileSize, tileSize);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    GLState::setDepthTest(true);
+    GLState::setBlend(false);
+    drawAsset(p.parts, tileSize);
+    auto pixels = std::make_shared<std::vector<uint8_t>>((size_t)tileSize * tileSize * 4);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, tileSize, tileSize, GL_RGBA, GL_UNSIGNED_BYTE, pixels->data());
+    GLState::bindFramebuffer(0);
+    RenderTargetPool::release("thumbnail-tile");
+
+    uint64_t hash = p.hash;
+    auto promise = std::make_shared<std::promise<bool>>();
+    s_written.push_back({ p.path, promise->get_future() });
+    ThreadPool::instance().submit([pixels, tileSize, hash, promise]{
+        promise->set_value(encodeTile(*pixels, tileSize, tileSize, 0, hash));
+        glfwPostEmptyEvent();
+    });
+}
+
+bool pump() {
+    // stored thumbnails: the browser looks them up again
+    for(auto it = s_written.begin(); it != s_written.end();) {
+        if(it->ok.wait_for(std::chrono::seconds(0)) != std::future_status::ready) { ++it; continue; }
+        if(it->ok.get()) ThumbnailCache::invalidate(it->path);
+        else LOG_WARN("Thumbnails: cannot store the thumbnail of " << it->path);
+        it = s_written.erase(it);
+    }
+    std::unique_ptr<Preview> preview;
+    {
+        std::lock_guard<std::mutex> lk(s_previewMtx);
+        preview = std::move(s_preview);
+    }
+    if(preview) {
+        if(preview->parts.empty()) LOG_WARN("Thumbnails: nothing to draw in " << preview->path);
+        else renderPreview(*preview, Options().tileSize);
+        // the preview meshes are released here, on the GL thread
+        preview.reset();
+        s_loading = false;
+    }
+    if(!s_loading && !s_queue.empty()) {
+        Item item = std::move(s_queue.front());
+        s_queue.pop_front();
+        s_loading = true;
+        ThreadPool::instance().submit([item]{
+            auto p = std::make_unique<Preview>();
+            p->path = item.path;
+            p->hash = item.hash;
+            try {
+                AssetLoader::loadPreview(item.path, p->parts);
+            } catch(const std::exception& e) {
+                LOG_WARN("Thumbnails: cannot load " << item.path << ": " << e.what());
+                p->parts.clear();
+            }
+            std::lock_guard<std::mutex> lk(s_previewMtx);
+            s_preview = std::move(p);
+            glfwPostEmptyEvent();
+        });
+    }
+    return s_loading || !s_queue.empty() || !s_written.empty();
+}
+
+void destroy() {
+    s_queue.clear();
+    // the preview being built holds meshes; wait for it so they are freed on this thread
+    while(s_loading) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::lock_guard<std::mutex> lk(s_previewMtx);
+        if(s_preview) { s_preview.reset(); s_loading = false; }
+    }
+    for(Written& w : s_written) w.ok.wait();
+    s_written.clear();
+}
+
+} // namespace ThumbnailRenderer
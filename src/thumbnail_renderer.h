@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Batch rendering of asset thumbnails into ThumbnailCache. Each asset is framed from its bounds in one
+// tile of an atlas-sized offscreen target (RenderTargetPool) and drawn with the Renderer's program; the
+// scene shader is unlit, so meshes get a flat fill with a darker wireframe on top when the wires are
+// sparse enough to read. The atlas is read back once per batch and its tiles are PNG-encoded and
+// written on the thread pool while the next batch renders.
+//
+// Needs a current GL context with Renderer::init() done (see HeadlessGL for batch runs).
+namespace ThumbnailRenderer {
+    struct Options {
+        int tileSize = 128;
+        int atlasSize = 2048;   // a batch holds (atlasSize / tileSize)^2 assets
+        bool force = false;     // render content already in the cache too
+    };
+    struct Stats {
+        size_t rendered = 0;
+        size_t cached = 0;      // content that already had a thumbnail (or appeared twice)
+        size_t failed = 0;
+    };
+
+    // Thumbnails for the given files; directories are searched recursively for importable files
+    Stats render(const std::vector<std::string>& paths, const Options& options);
+
+    // In the editor: queue one asset whose content (hash) has no thumbnail yet (AssetDatabase after a
+    // reimport). Its preview is built on the thread pool; pump() draws one finished preview per frame into
+    // a tile-sized target and writes it from a worker, then invalidates the browser's entry for it.
+    // GL thread only.
+    void request(const std::string& path, uint64_t contentHash);
+    // Call once per frame. Returns true while work is pending.
+    bool pump();
+    // Wait for the preview in flight and drop the queue (before the GL context goes away)
+    void destroy();
+}
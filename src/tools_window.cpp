@@ -2,6 +2,9 @@
 #include "gizmo_controller.h"
 #include "animator.h"
 #include "viewport_window.h"
+#include "point_cloud_streamer.h"
+#include "cluster_mesh_streamer.h"
+#include "mesh_streamer.h"
 #include <cstring>
 #include <functional>
 
@@ -57,6 +60,29 @@ void DrawToolsWindow(Scene& scene,
         ImGui::SliderFloat("Plane offset", &g_offsetPlane, 0.0f, 0.1f);
     }
 
+    if(ImGui::CollapsingHeader("Viewport performance")) {
+        ImGui::Checkbox("Dynamic resolution", &g_dynResEnabled);
+        ImGui::SliderFloat("Scene GPU time target (ms)", &g_dynResTargetMs, 4.0f, 50.0f, "%.1f");
+        ImGui::SliderFloat("Minimum scale", &g_dynResMinScale, 0.1f, 1.0f, "%.2f");
+        ImGui::Text("Current render scale: %.2f", g_dynResScale);
+        ImGui::Separator();
+        ImGui::Text("Point clouds");
+        ImGui::DragInt("Point budget", &g_pointCloudPointBudget, 100000.0f, 100000, 100000000);
+        ImGui::DragInt("GPU memory (MB)", &g_pointCloudMemoryMB, 16.0f, 64, 16384);
+        ImGui::SliderFloat("Screen error (px)", &g_pointCloudScreenError, 0.5f, 16.0f, "%.1f");
+        ImGui::SliderFloat("Max point size (px)", &g_pointCloudMaxPointSize, 1.0f, 16.0f, "%.1f");
+        ImGui::Separator();
+        ImGui::Checkbox("Mesh streaming", &g_meshStreaming);
+        ImGui::DragInt("Mesh GPU budget (MB)", &g_meshStreamGpuMB, 16.0f, 64, 65536);
+        ImGui::DragInt("Mesh RAM budget (MB)", &g_meshStreamRamMB, 16.0f, 64, 65536);
+        ImGui::SliderFloat("Min mesh coverage (px)", &g_meshStreamMinPixels, 0.0f, 32.0f, "%.1f");
+        ImGui::Separator();
+        ImGui::Text("Out-of-core meshes");
+        ImGui::DragInt("Triangle budget", &g_clusterMeshTriangleBudget, 100000.0f, 100000, 200000000);
+        ImGui::DragInt("Cluster GPU memory (MB)", &g_clusterMeshMemoryMB, 16.0f, 64, 16384);
+        ImGui::SliderFloat("Cluster screen error (px)", &g_clusterMeshScreenError, 0.5f, 16.0f, "%.1f");
+    }
+
     if(ImGui::Button("Cube")) {
         spawnType = primitives::PrimitiveType::Cube;
         if(recordOnly) scene.recordSpawnOnly();
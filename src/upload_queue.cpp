@@ -0,0 +1,203 @@
+#include "upload_queue.h"
+#include "primitive_factory.h"
+#include "gl_state.h"
+#include "log.h"
+#include <glad/glad.h>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+namespace {
+
+// Staging ring: kSegmentCount buffers of kSegmentBytes. A frame fills at most kFrameBudgetBytes,
+// so up to three frames of copies can be in flight before the ring stalls.
+static const size_t kSegmentBytes = 4u << 20;
+static const int kSegmentCount = 6;
+static const size_t kFrameBudgetBytes = 8u << 20;
+
+struct Segment {
+    GLuint buffer = 0;
+    uint64_t busyUntil = 0; // serial of the last batch that read from it
+};
+
+struct Upload {
+    primitives::MeshGL* mesh = nullptr;
+    size_t offset = 0; // bytes of vertex + index data already copied
+};
+
+// Copies issued in one pump(), retired together by one fence
+struct Batch {
+    uint64_t serial = 0;
+    GLsync fence = nullptr;
+    std::vector<primitives::MeshGL*> meshes; // meshes whose last copy is in this batch (null when cancelled)
+};
+
+static Segment s_segments[kSegmentCount];
+static int s_nextSegment = 0;
+static std::deque<Upload> s_queue;
+static std::deque<Batch> s_inFlight;
+static uint64_t s_nextSerial = 1;
+static uint64_t s_retiredSerial = 0;
+static size_t s_bytesLastFrame = 0;
+
+static size_t totalBytes(const primitives::MeshGL& m) { return m.pending.bytes(); }
+
+static void markReady(primitives::MeshGL* m) {
+    m->uploadPending = false;
+    m->pending.reset();
+}
+
+static void finishBatch(Batch& b) {
+    glDeleteSync(b.fence);
+    for(auto* m : b.meshes) if(m) markReady(m);
+    s_retiredSerial = b.serial;
+}
+
+// Retire batches whose fence has signaled; with wait set, block on the oldest one first
+static void retire(bool wait) {
+    while(!s_inFlight.empty()) {
+        Batch& b = s_inFlight.front();
+        GLenum r = glClientWaitSync(b.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000ull : 0);
+        if(r == GL_TIMEOUT_EXPIRED) break;
+        if(r == GL_WAIT_FAILED) LOG_WARN("UploadQueue: fence wait failed, assuming the copies finished");
+        finishBatch(b);
+        s_inFlight.pop_front();
+        wait = false;
+    }
+}
+
+static Segment& segmentAt(int i) {
+    Segment& seg = s_segments[i];
+    if(!seg.buffer) {
+        glGenBuffers(1, &seg.buffer);
+        GLState::bindBuffer(GL_COPY_READ_BUFFER, seg.buffer);
+        glBufferData(GL_COPY_READ_BUFFER, kSegmentBytes, nullptr, GL_STREAM_COPY);
+    }
+    return seg;
+}
+
+// Fill staging segments and issue their copies until the budget is spent or the ring is full.
+// Returns the number of bytes issued.
+static size_t issue(size_t budget) {
+    s_bytesLastFrame = 0;
+    Batch batch;
+    batch.serial = s_nextSerial;
+    struct Copy { GLuint dst; size_t dstOffset; size_t srcOffset; size_t size; };
+    std::vector<Copy> copies;
+
+    while(!s_queue.empty() && budget > 0) {
+        Segment& seg = segmentAt(s_nextSegment);
+        if(seg.busyUntil > s_retiredSerial) break; // ring full: the GPU is still reading the oldest segment
+
+        size_t segLimit = std::min(kSegmentBytes, budget);
+        GLState::bindBuffer(GL_COPY_READ_BUFFER, seg.buffer);
+        // the fence guarantees the GPU is done with this segment, so no implicit sync is needed
+        uint8_t* dst = (uint8_t*)glMapBufferRange(GL_COPY_READ_BUFFER, 0, segLimit, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if(!dst) { LOG_ERROR("UploadQueue: failed to map staging buffer"); break; }
+
+        size_t used = 0;
+        copies.clear();
+        while(!s_queue.empty() && used < segLimit) {
+            Upload& up = s_queue.front();
+            primitives::MeshGL* m = up.mesh;
+            size_t vbytes = m->pending.vertexBytes;
+            size_t total = totalBytes(*m);
+            // vertex data first, then indices
+            const uint8_t* src; size_t n; Copy c;
+            if(up.offset < vbytes) {
+                src = m->pending.vertices + up.offset; n = vbytes - up.offset;
+                c.dst = m->vbo; c.dstOffset = up.offset;
+            } else {
+                src = m->pending.indices + (up.offset - vbytes); n = total - up.offset;
+                c.dst = m->ebo; c.dstOffset = up.offset - vbytes;
+            }
+            n = std::min(n, segLimit - used);
+            memcpy(dst + used, src, n);
+            c.srcOffset = used; c.size = n;
+            copies.push_back(c);
+            used += n;
+            up.offset += n;
+            if(up.offset == total) { batch.meshes.push_back(m); s_queue.pop_front(); }
+        }
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+
+        // COPY_WRITE leaves the VAO and element buffer bindings alone
+        for(const Copy& c : copies) {
+            GLState::bindBuffer(GL_COPY_WRITE_BUFFER, c.dst);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, c.srcOffset, c.dstOffset, c.size);
+        }
+        seg.busyUntil = batch.serial;
+        s_nextSegment = (s_nextSegment + 1) % kSegmentCount;
+        budget -= used;
+        s_bytesLastFrame += used;
+    }
+
+    if(s_bytesLastFrame == 0) return 0;
+    batch.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    s_nextSerial++;
+    s_inFlight.push_back(std::move(batch));
+    return s_bytesLastFrame;
+}
+
+} // anonymous
+
+namespace UploadQueue {
+
+void enqueue(primitives::MeshGL* mesh) {
+    if(totalBytes(*mesh) == 0) { markReady(mesh); return; }
+    mesh->uploadPending = true;
+    Upload up; up.mesh = mesh;
+    s_queue.push_back(up);
+}
+
+void cancel(primitives::MeshGL* mesh) {
+    s_queue.erase(std::remove_if(s_queue.begin(), s_queue.end(), [mesh](const Upload& u){ return u.mesh == mesh; }), s_queue.end());
+    for(auto& b : s_inFlight) for(auto*& m : b.meshes) if(m == mesh) m = nullptr;
+    mesh->uploadPending = false;
+}
+
+void retarget(primitives::MeshGL* from, primitives::MeshGL* to) {
+    for(auto& u : s_queue) if(u.mesh == from) u.mesh = to;
+    for(auto& b : s_inFlight) for(auto*& m : b.meshes) if(m == from) m = to;
+}
+
+bool pump() {
+    retire(false);
+    issue(kFrameBudgetBytes);
+    return !s_queue.empty() || !s_inFlight.empty();
+}
+
+void flush() {
+    while(!s_queue.empty() || !s_inFlight.empty()) {
+        // nothing issued with an empty pipeline means mapping failed; leave the rest queued
+        if(issue(SIZE_MAX) == 0 && s_inFlight.empty()) break;
+        retire(true);
+    }
+}
+
+void destroy() {
+    // in-flight copies still complete on the GPU; only the bookkeeping goes away
+    for(auto& b : s_inFlight) {
+        glDeleteSync(b.fence);
+        for(auto* m : b.meshes) if(m) markReady(m);
+    }
+    s_inFlight.clear();
+    for(auto& u : s_queue) u.mesh->uploadPending = false;
+    s_queue.clear();
+    for(auto& seg : s_segments) { GLState::deleteBuffer(seg.buffer); seg.busyUntil = 0; }
+    s_nextSegment = 0;
+}
+
+Stats stats() {
+    Stats st;
+    st.queuedMeshes = s_queue.size();
+    for(const auto& u : s_queue) st.queuedBytes += totalBytes(*u.mesh) - u.offset;
+    for(const auto& b : s_inFlight) for(auto* m : b.meshes) if(m) st.inFlightMeshes++;
+    st.bytesLastFrame = s_bytesLastFrame;
+    for(const auto& seg : s_segments) if(seg.buffer) st.stagingBytes += kSegmentBytes;
+    return st;
+}
+
+} // namespace UploadQueue
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+
+namespace primitives { struct MeshGL; }
+
+// Streams mesh vertex/index data to the GPU over several frames instead of one glBufferData per mesh.
+// Data is written into a ring of staging buffers and copied into the mesh's buffers with
+// glCopyBufferSubData, at most a fixed number of bytes per frame. Each frame's copies are followed
+// by a fence; when it signals, the staging space is reused and the meshes whose last copy was in
+// that frame become drawable (MeshGL::uploadPending is cleared, draw calls skip the mesh until then).
+//
+// All functions must be called on the GL thread.
+namespace UploadQueue {
+    // Queue the mesh's pending vertex/index data (its GL buffers must already be allocated,
+    // see MeshGL::uploadStreamed). The pending data is released when the upload retires.
+    void enqueue(primitives::MeshGL* mesh);
+
+    // Drop a queued or in-flight upload (called by MeshGL when it is destroyed)
+    void cancel(primitives::MeshGL* mesh);
+    // A queued mesh was moved to another address
+    void retarget(primitives::MeshGL* from, primitives::MeshGL* to);
+
+    // Retire finished copies and issue new ones within the frame budget. Call once per frame.
+    // Returns true while uploads are queued or in flight.
+    bool pump();
+
+    // Finish every queued upload immediately (blocks on the GPU)
+    void flush();
+
+    // Delete the staging buffers and fences; queued meshes are left without data
+    void destroy();
+
+    struct Stats {
+        size_t queuedMeshes = 0;   // waiting for or in the middle of their copies
+        size_t inFlightMeshes = 0; // all copies issued, waiting for the fence
+        size_t queuedBytes = 0;
+        size_t bytesLastFrame = 0;
+        size_t stagingBytes = 0;
+    };
+    Stats stats();
+}
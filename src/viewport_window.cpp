@@ -1,8 +1,14 @@
 #include "viewport_window.h"
 #include "renderer.h"
+#include "render_target_pool.h"
+#include "gl_state.h"
 #include "gizmo_controller.h"
 #include "gizmo_lib.h"
 #include "primitive_factory.h"
+#include "point_cloud_streamer.h"
+#include "cluster_mesh.h"
+#include "cluster_mesh_streamer.h"
+#include "mesh_streamer.h"
 #include <glad/glad.h>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/matrix_inverse.hpp>
@@ -11,14 +17,40 @@
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtx/euler_angles.hpp>
 #include <cfloat>
+#include <cmath>
+#include <algorithm>
 #include <iostream>
 
-// Local FBO state (kept internal to this module)
-static GLuint s_fbo = 0;
-static GLuint s_fboColor = 0;
-static GLuint s_fboDepth = 0;
-static int s_fbo_w = 0;
-static int s_fbo_h = 0;
+// Inputs of the last offscreen render; when unchanged the previous texture is reused
+struct ViewportRenderKey {
+    unsigned int sceneRevision = 0;
+    unsigned int cameraRevision = 0;
+    GLuint target = 0;
+    int width = 0;
+    int height = 0;
+    bool wireframe = false;
+    int gizmoOperation = 0;
+    // point-cloud nodes streamed in or out, and the level-of-detail settings
+    unsigned int pointCloudRevision = 0;
+    int pointBudget = 0;
+    float screenError = 0.0f;
+    float maxPointSize = 0.0f;
+    // streamed meshes paged in or out, and the streaming settings
+    unsigned int meshStreamRevision = 0;
+    bool meshStreaming = false;
+    int meshStreamGpuMB = 0;
+    int meshStreamRamMB = 0;
+    float meshStreamMinPixels = 0.0f;
+    // cluster-mesh nodes streamed in or out, and their level-of-detail settings
+    unsigned int clusterMeshRevision = 0;
+    int clusterTriangleBudget = 0;
+    int clusterMemoryMB = 0;
+    float clusterScreenError = 0.0f;
+    bool operator==(const ViewportRenderKey&) const = default;
+};
+static ViewportRenderKey s_lastKey;
+static bool s_haveRendered = false;
+static bool s_lastHadPreview = false;
 
 // Extern spawn placement mode
 SpawnPlacementMode g_spawnPlacementMode = SpawnPlacementMode::Origin;
@@ -38,35 +70,83 @@ float g_offsetSphere = 1.0f;
 float g_offsetCylinder = 1.0f;
 float g_offsetPlane = 0.001f;
 
-static void ensureFBO(int w, int h) {
-    if(w <= 0 || h <= 0) return;
-    if(s_fbo && s_fbo_w == w && s_fbo_h == h) return;
-    if(s_fboDepth) { glDeleteRenderbuffers(1, &s_fboDepth); s_fboDepth = 0; }
-    if(s_fboColor) { glDeleteTextures(1, &s_fboColor); s_fboColor = 0; }
-    if(s_fbo) { glDeleteFramebuffers(1, &s_fbo); s_fbo = 0; }
-    s_fbo_w = w; s_fbo_h = h;
-    glGenFramebuffers(1, &s_fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, s_fbo);
-    glGenTextures(1, &s_fboColor);
-    glBindTexture(GL_TEXTURE_2D, s_fboColor);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, s_fboColor, 0);
-    glGenRenderbuffers(1, &s_fboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, s_fboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, w, h);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, s_fboDepth);
-    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-    if(status != GL_FRAMEBUFFER_COMPLETE) {
-        std::cerr << "Failed to create framebuffer, status: " << status << '\n';
-        if(s_fboDepth) { glDeleteRenderbuffers(1, &s_fboDepth); s_fboDepth = 0; }
-        if(s_fboColor) { glDeleteTextures(1, &s_fboColor); s_fboColor = 0; }
-        if(s_fbo) { glDeleteFramebuffers(1, &s_fbo); s_fbo = 0; }
-        s_fbo_w = s_fbo_h = 0;
+// Dynamic resolution settings (defined here to back externs)
+bool g_dynResEnabled = false;
+float g_dynResTargetMs = 16.6f;
+float g_dynResMinScale = 0.35f;
+float g_dynResScale = 1.0f;
+
+// GPU time of the scene pass, measured with GL_TIME_ELAPSED queries. Frame deltas are useless here:
+// under vsync they never drop below the refresh interval, whatever the scale. Results are read a few
+// frames late so the CPU never waits on the GPU.
+static const int kSceneTimers = 4;
+static GLuint s_sceneTimers[kSceneTimers] = {};
+static int s_sceneTimerNext = 0;    // query the next pass begins
+static int s_sceneTimersPending = 0; // ended and not read yet, the oldest kSceneTimersPending before next
+
+// False when every query is still in flight; this pass is then not measured
+static bool beginSceneTimer() {
+    if(s_sceneTimersPending == kSceneTimers) return false;
+    if(!s_sceneTimers[0]) glGenQueries(kSceneTimers, s_sceneTimers);
+    glBeginQuery(GL_TIME_ELAPSED, s_sceneTimers[s_sceneTimerNext]);
+    return true;
+}
+
+static void endSceneTimer() {
+    glEndQuery(GL_TIME_ELAPSED);
+    s_sceneTimerNext = (s_sceneTimerNext + 1) % kSceneTimers;
+    s_sceneTimersPending++;
+}
+
+// Read every finished measurement; 'ms' is the newest. False when none finished.
+static bool readSceneTimers(float& ms) {
+    bool read = false;
+    while(s_sceneTimersPending > 0) {
+        GLuint q = s_sceneTimers[(s_sceneTimerNext - s_sceneTimersPending + kSceneTimers) % kSceneTimers];
+        GLint available = 0;
+        glGetQueryObjectiv(q, GL_QUERY_RESULT_AVAILABLE, &available);
+        if(!available) break;
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(q, GL_QUERY_RESULT, &ns);
+        ms = (float)((double)ns * 1e-6);
+        s_sceneTimersPending--;
+        read = true;
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return read;
+}
+
+// Smoothed scene-pass GPU time used by the dynamic resolution controller (< 0: no sample yet)
+static float s_sceneMsAvg = -1.0f;
+static bool s_wasInteracting = false;
+// the scale is held while the smoothed time is within [kDeadband * target, target]
+static const float kDeadband = 0.85f;
+
+// Steer the render scale toward the scene-pass time target. Rendering cost is roughly proportional
+// to pixel count (scale^2), so the correction uses the square root of the time ratio and is
+// rate-limited to avoid visible pumping; inside the deadband nothing changes, so the scale settles.
+static float updateDynamicResolution(bool interacting) {
+    float sample = 0.0f;
+    bool measured = readSceneTimers(sample);
+    if(!g_dynResEnabled || !interacting) {
+        s_wasInteracting = false;
+        g_dynResScale = 1.0f;
+        return g_dynResScale;
+    }
+    if(!s_wasInteracting) {
+        // measurements from before this interaction belong to another view and scale
+        s_wasInteracting = true;
+        s_sceneMsAvg = -1.0f;
+        return g_dynResScale;
+    }
+    if(!measured) return g_dynResScale;
+    s_sceneMsAvg = s_sceneMsAvg < 0.0f ? sample : s_sceneMsAvg + (sample - s_sceneMsAvg) * 0.15f;
+    if(s_sceneMsAvg <= g_dynResTargetMs && s_sceneMsAvg >= g_dynResTargetMs * kDeadband) return g_dynResScale;
+    // aim at the middle of the band
+    float ratio = g_dynResTargetMs * (1.0f + kDeadband) * 0.5f / std::max(s_sceneMsAvg, 0.01f);
+    float desired = g_dynResScale * sqrtf(ratio);
+    float step = glm::clamp(desired / g_dynResScale, 0.9f, 1.05f);
+    g_dynResScale = glm::clamp(g_dynResScale * step, g_dynResMinScale, 1.0f);
+    return g_dynResScale;
 }
 
 // Helper: unproject screen point to world ray (origin, dir)
@@ -119,16 +199,26 @@ static bool rayIntersectSceneMeshes(Scene& scene, const glm::vec3& origin, const
     float bestT = FLT_MAX;
     bool hitAny = false;
     for(const auto& ent : scene.entities()) {
+        if(ent.clusterMesh) {
+            // in the mesh's local space, through its BVH; an unnormalized direction keeps t comparable
+            glm::mat4 inv = glm::inverse(ent.world);
+            glm::vec3 o = glm::vec3(inv * glm::vec4(origin, 1.0f));
+            glm::vec3 d = glm::mat3(inv) * dir;
+            float t; glm::vec3 n;
+            if(ent.clusterMesh->rayIntersect(o, d, t, n) && t < bestT) {
+                bestT = t; outPoint = origin + dir * t; hitEntityId = ent.id; hitAny = true;
+                outNormal = glm::normalize(glm::inverseTranspose(glm::mat3(ent.world)) * n);
+            }
+            continue;
+        }
         if(!ent.mesh) continue;
-        if(ent.mesh->cpuPositions.empty() || ent.mesh->cpuIndices.empty()) continue;
-        // transform mesh vertex positions to world space using entity transform
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, ent.position);
-        glm::quat q = glm::quat(glm::radians(ent.rotation));
-        model *= glm::toMat4(q);
-        model = glm::scale(model, ent.scale);
-        const auto& pos = ent.mesh->cpuPositions;
-        const auto& idx = ent.mesh->cpuIndices;
+        // the full mesh when resident, else its coarse level
+        const primitives::MeshGL& level = ent.mesh->pickLevel();
+        if(level.cpuPositions.empty() || level.cpuIndices.empty()) continue;
+        // transform mesh vertex positions to world space using the entity's world matrix
+        const glm::mat4& model = ent.world;
+        const auto& pos = level.cpuPositions;
+        const auto& idx = level.cpuIndices;
         for(size_t i=0;i+2<idx.size(); i+=3) {
             glm::vec3 v0 = glm::vec3(model * glm::vec4(pos[idx[i+0]], 1.0f));
             glm::vec3 v1 = glm::vec3(model * glm::vec4(pos[idx[i+1]], 1.0f));
@@ -155,13 +245,21 @@ void DrawViewportWindow(ViewportContext& ctx) {
     bool mouseOnViewport = (mpos.x >= viewport_pos.x && mpos.x <= (viewport_pos.x + viewport_size.x) && mpos.y >= viewport_pos.y && mpos.y <= (viewport_pos.y + viewport_size.y));
 
     int fb_w = (int)viewport_size.x; int fb_h = (int)viewport_size.y;
-    ensureFBO(fb_w, fb_h);
+    RenderTargetPool::Target* target = RenderTargetPool::acquire("viewport", fb_w, fb_h);
 
     // Delegate viewport input handling to Camera
     ctx.camera->handleViewportInput(glfwGetCurrentContext(), mouseOnViewport);
 
-    GLuint fboToUse = s_fbo;
-    GLuint fboColor = s_fboColor;
+    GLuint fboToUse = target ? target->fbo : 0;
+    GLuint fboColor = target ? target->color : 0;
+
+    // Dynamic resolution: pick the size of the sub-rectangle actually rendered this frame
+    static unsigned int s_lastCameraRevision = 0;
+    bool interacting = ctx.camera->isDragging() || ctx.camera->getRevision() != s_lastCameraRevision || *ctx.imguizmoActive || ctx.gizmo->isDragging();
+    s_lastCameraRevision = ctx.camera->getRevision();
+    float renderScale = updateDynamicResolution(interacting);
+    int render_w = target ? std::max(1, (int)(target->width * renderScale)) : 0;
+    int render_h = target ? std::max(1, (int)(target->height * renderScale)) : 0;
 
     // Static preview meshes for ghost placement
     static bool s_previewInit = false;
@@ -178,22 +276,12 @@ void DrawViewportWindow(ViewportContext& ctx) {
     }
 
     if(fboToUse) {
-        glBindFramebuffer(GL_FRAMEBUFFER, fboToUse);
-        glViewport(0,0,s_fbo_w,s_fbo_h);
-        glClearColor(0.09f,0.09f,0.11f,1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
         glm::mat4 view = ctx.camera->getView();
-        float aspect = (float)s_fbo_w / (s_fbo_h>0? (float)s_fbo_h : 1.0f);
+        float aspect = (float)target->width / (target->height>0? (float)target->height : 1.0f);
         glm::mat4 proj = ctx.camera->getProjection(aspect);
         glm::mat4 vp = proj * view;
         *ctx.lastView = view; *ctx.lastProj = proj;
 
-        glUseProgram(*ctx.prog);
-        if(*ctx.showWireframe) glPolygonMode(GL_FRONT_AND_BACK, GL_LINE); else glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        Renderer::renderGrid(vp);
-        ctx.scene->drawAll(*ctx.prog, vp);
-
         // compute live preview position if armed and in click modes
         bool havePreview = false;
         glm::vec3 previewPos(0.0f);
@@ -212,85 +300,144 @@ void DrawViewportWindow(ViewportContext& ctx) {
             }
         }
 
-        // Draw preview ghost if available
-        if(havePreview) {
-            // use program and set uniforms
-            GLint loc = glGetUniformLocation(*ctx.prog, "uMVP");
-            GLint col = glGetUniformLocation(*ctx.prog, "uColor");
-            // choose mesh and scale
-            primitives::MeshGL* pm = nullptr;
-            float previewScale = 0.5f; // default uniform preview scale
-            bool orientToNormal = g_spawnAlignToNormal;
-            switch(*ctx.spawnType) {
-                case primitives::PrimitiveType::Cube: pm = &s_cubePreview; previewScale = g_previewScaleCube; break;
-                case primitives::PrimitiveType::Sphere: pm = &s_spherePreview; previewScale = g_previewScaleSphere; break;
-                case primitives::PrimitiveType::Cylinder: pm = &s_cylinderPreview; previewScale = g_previewScaleCylinder; break;
-                case primitives::PrimitiveType::Plane: pm = &s_planePreview; previewScale = g_previewScalePlane; break;
-            }
-            if(pm) {
-                // compute model transform per-primitive so preview sits correctly on the surface
-                glm::mat4 model = glm::mat4(1.0f);
-                // default rotation: align up to normal if requested
-                glm::quat rotQ = glm::quat(glm::vec3(0.0f));
-                if(orientToNormal) {
-                    glm::vec3 up = glm::vec3(0,1,0);
-                    // if normal nearly aligned, skip
-                    if(glm::length(glm::cross(up, previewNormal)) > 1e-6f) {
-                        glm::vec3 axis = glm::normalize(glm::cross(up, previewNormal));
-                        float dot = glm::dot(up, previewNormal);
-                        float angle = acosf(glm::clamp(dot, -1.0f, 1.0f));
-                        rotQ = glm::angleAxis(angle, axis);
-                    } else {
-                        // normals nearly equal or opposite
-                        if(glm::dot(up, previewNormal) < 0.0f) rotQ = glm::angleAxis(glm::pi<float>(), glm::vec3(1,0,0));
-                    }
+        // Re-render the offscreen viewport only when something that feeds it changed;
+        // otherwise the texture from the last render is shown again.
+        ViewportRenderKey key;
+        key.sceneRevision = ctx.scene->getRevision();
+        key.cameraRevision = ctx.camera->getRevision();
+        key.target = target->fbo;
+        key.width = render_w; key.height = render_h;
+        key.wireframe = *ctx.showWireframe;
+        key.gizmoOperation = (int)*ctx.gizmoOperation;
+        key.pointCloudRevision = PointCloudStreamer::revision();
+        key.pointBudget = g_pointCloudPointBudget;
+        key.screenError = g_pointCloudScreenError;
+        key.maxPointSize = g_pointCloudMaxPointSize;
+        key.meshStreamRevision = MeshStreamer::revision();
+        key.meshStreaming = g_meshStreaming;
+        key.meshStreamGpuMB = g_meshStreamGpuMB;
+        key.meshStreamRamMB = g_meshStreamRamMB;
+        key.meshStreamMinPixels = g_meshStreamMinPixels;
+        key.clusterMeshRevision = ClusterMeshStreamer::revision();
+        key.clusterTriangleBudget = g_clusterMeshTriangleBudget;
+        key.clusterMemoryMB = g_clusterMeshMemoryMB;
+        key.clusterScreenError = g_clusterMeshScreenError;
+        bool needRender = !s_haveRendered || !(key == s_lastKey) || havePreview || s_lastHadPreview;
+
+        if(needRender) {
+            bool timed = g_dynResEnabled && interacting && beginSceneTimer();
+            // render into the used sub-rectangle of the pooled target (smaller under dynamic resolution)
+            GLState::bindFramebuffer(fboToUse);
+            GLState::viewport(0,0,render_w,render_h);
+            GLState::setScissorTest(true);
+            glScissor(0,0,render_w,render_h);
+            glClearColor(0.09f,0.09f,0.11f,1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            GLState::setScissorTest(false);
+            GLState::setDepthTest(true);
+            GLState::setBlend(false);
+
+            // page in what this view shows (drawn once uploaded; the revision change re-renders then)
+            MeshStreamer::update(*ctx.scene, view, proj, render_h);
+
+            GLState::useProgram(*ctx.prog);
+            GLState::polygonMode(*ctx.showWireframe ? GL_LINE : GL_FILL);
+            Renderer::renderGrid(vp);
+            ctx.scene->drawAll(*ctx.prog, vp);
+            Renderer::drawPointClouds(*ctx.scene, view, proj, render_h);
+            Renderer::drawClusterMeshes(*ctx.scene, view, proj, render_h);
+
+            // Draw preview ghost if available
+            if(havePreview) {
+                // use program and set uniforms
+                GLState::useProgram(*ctx.prog);
+                GLint loc = glGetUniformLocation(*ctx.prog, "uMVP");
+                GLint col = glGetUniformLocation(*ctx.prog, "uColor");
+                // choose mesh and scale
+                primitives::MeshGL* pm = nullptr;
+                float previewScale = 0.5f; // default uniform preview scale
+                bool orientToNormal = g_spawnAlignToNormal;
+                switch(*ctx.spawnType) {
+                    case primitives::PrimitiveType::Cube: pm = &s_cubePreview; previewScale = g_previewScaleCube; break;
+                    case primitives::PrimitiveType::Sphere: pm = &s_spherePreview; previewScale = g_previewScaleSphere; break;
+                    case primitives::PrimitiveType::Cylinder: pm = &s_cylinderPreview; previewScale = g_previewScaleCylinder; break;
+                    case primitives::PrimitiveType::Plane: pm = &s_planePreview; previewScale = g_previewScalePlane; break;
+                    default: break;
                 }
+                if(pm) {
+                    // compute model transform per-primitive so preview sits correctly on the surface
+                    glm::mat4 model = glm::mat4(1.0f);
+                    // default rotation: align up to normal if requested
+                    glm::quat rotQ = glm::quat(glm::vec3(0.0f));
+                    if(orientToNormal) {
+                        glm::vec3 up = glm::vec3(0,1,0);
+                        // if normal nearly aligned, skip
+                        if(glm::length(glm::cross(up, previewNormal)) > 1e-6f) {
+                            glm::vec3 axis = glm::normalize(glm::cross(up, previewNormal));
+                            float dot = glm::dot(up, previewNormal);
+                            float angle = acosf(glm::clamp(dot, -1.0f, 1.0f));
+                            rotQ = glm::angleAxis(angle, axis);
+                        } else {
+                            // normals nearly equal or opposite
+                            if(glm::dot(up, previewNormal) < 0.0f) rotQ = glm::angleAxis(glm::pi<float>(), glm::vec3(1,0,0));
+                        }
+                    }
 
-                // compute offset so primitive sits on the surface (half-height/radius)
-                glm::vec3 offset = glm::vec3(0.0f);
-                if(g_spawnApplyOffset) {
-                    if(*ctx.spawnType == primitives::PrimitiveType::Cube) {
-                        // cube in generator spans [-1,1] => half-height 1.0
-                        float authHalf = 1.0f;
-                        offset = previewNormal * (authHalf * previewScale * g_offsetCube);
-                    } else if(*ctx.spawnType == primitives::PrimitiveType::Sphere) {
-                        // sphere radius 1.0
-                        float authRadius = 1.0f;
-                        offset = previewNormal * (authRadius * previewScale * g_offsetSphere);
-                    } else if(*ctx.spawnType == primitives::PrimitiveType::Cylinder) {
-                        // cylinder generator used height=2.0 -> half-height = 1.0
-                        float authHalf = 1.0f;
-                        offset = previewNormal * (authHalf * previewScale * g_offsetCylinder);
-                    } else if(*ctx.spawnType == primitives::PrimitiveType::Plane) {
-                        // plane lies on surface: small offset to avoid z-fight
-                        offset = previewNormal * g_offsetPlane;
+                    // compute offset so primitive sits on the surface (half-height/radius)
+                    glm::vec3 offset = glm::vec3(0.0f);
+                    if(g_spawnApplyOffset) {
+                        if(*ctx.spawnType == primitives::PrimitiveType::Cube) {
+                            // cube in generator spans [-1,1] => half-height 1.0
+                            float authHalf = 1.0f;
+                            offset = previewNormal * (authHalf * previewScale * g_offsetCube);
+                        } else if(*ctx.spawnType == primitives::PrimitiveType::Sphere) {
+                            // sphere radius 1.0
+                            float authRadius = 1.0f;
+                            offset = previewNormal * (authRadius * previewScale * g_offsetSphere);
+                        } else if(*ctx.spawnType == primitives::PrimitiveType::Cylinder) {
+                            // cylinder generator used height=2.0 -> half-height = 1.0
+                            float authHalf = 1.0f;
+                            offset = previewNormal * (authHalf * previewScale * g_offsetCylinder);
+                        } else if(*ctx.spawnType == primitives::PrimitiveType::Plane) {
+                            // plane lies on surface: small offset to avoid z-fight
+                            offset = previewNormal * g_offsetPlane;
+                        }
+                    } else {
+                        // no offset
+                        offset = glm::vec3(0.0f);
                     }
-                } else {
-                    // no offset
-                    offset = glm::vec3(0.0f);
+
+                    // apply rotation then translation (rotate around origin then place)
+                    model *= glm::toMat4(rotQ);
+                    model = glm::translate(model, previewPos + offset);
+                    model = glm::scale(model, glm::vec3(previewScale));
+
+                    glm::mat4 mvp = vp * model * pm->positionDecode();
+                    glUniformMatrix4fv(loc, 1, GL_FALSE, &mvp[0][0]);
+                    // draw wireframe with blending (depth test is already on for the scene pass)
+                    GLState::setBlend(true);
+                    GLState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                    GLState::polygonMode(GL_LINE);
+                    glUniform3f(col, 0.9f, 0.9f, 0.2f);
+                    pm->draw();
+                    GLState::setBlend(false);
+                    GLState::polygonMode(*ctx.showWireframe ? GL_LINE : GL_FILL);
                 }
+            }
 
-                // apply rotation then translation (rotate around origin then place)
-                model *= glm::toMat4(rotQ);
-                model = glm::translate(model, previewPos + offset);
-                model = glm::scale(model, glm::vec3(previewScale));
-
-                glm::mat4 mvp = vp * model;
-                glUniformMatrix4fv(loc, 1, GL_FALSE, &mvp[0][0]);
-                // draw wireframe with blending
-                GLboolean prevBlend = glIsEnabled(GL_BLEND);
-                GLboolean prevDepth = glIsEnabled(GL_DEPTH_TEST);
-                glEnable(GL_BLEND); glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-                if(!prevDepth) glEnable(GL_DEPTH_TEST);
-                glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-                glUniform3f(col, 0.9f, 0.9f, 0.2f);
-                pm->draw();
-                // restore
-                glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-                if(!prevBlend) glDisable(GL_BLEND);
-                if(!prevDepth) glDisable(GL_DEPTH_TEST);
+            // Selection box is part of the offscreen image; overlays below are drawn through ImGui every frame
+            SceneEntity* selBox = ctx.scene->findById(ctx.scene->getSelectedId());
+            if(selBox && (*ctx.gizmoOperation == ImGuizmo::ROTATE || *ctx.gizmoOperation == ImGuizmo::SCALE)) {
+                Renderer::drawSelectionBox(vp, selBox);
             }
+
+            GLState::polygonMode(GL_FILL);
+            if(timed) endSceneTimer();
+            GLState::bindFramebuffer(0);
+            s_lastKey = key;
+            s_haveRendered = true;
         }
+        s_lastHadPreview = havePreview;
 
         // Spawn when requested
         if(ctx.spawnPending && *ctx.spawnPending) {
@@ -374,16 +521,16 @@ void DrawViewportWindow(ViewportContext& ctx) {
         // Selection visuals
         SceneEntity* sel = ctx.scene->findById(ctx.scene->getSelectedId());
         if(sel && (*ctx.gizmoOperation == ImGuizmo::ROTATE || *ctx.gizmoOperation == ImGuizmo::SCALE)) {
-            Renderer::drawSelectionBox(vp, sel);
             GizmoLib::DrawAxisOverlay(sel, view, proj, viewport_pos, viewport_size);
             if(*ctx.gizmoOperation == ImGuizmo::ROTATE) GizmoLib::DrawRotationArcs(*ctx.scene, sel->id, view, proj, viewport_pos, viewport_size, *ctx.gizmoMode);
         }
-
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
     }
 
-    // Show rendered texture
+    // Show rendered texture; the last rendered sub-rectangle is stretched over the panel (bilinear upscale)
     ImVec2 show_size = viewport_size;
-    if(fboColor && show_size.x > 0 && show_size.y > 0) ImGui::Image((ImTextureID)(intptr_t)fboColor, show_size, ImVec2(0,1), ImVec2(1,0));
-    else ImGui::Dummy(show_size);
+    if(fboColor && show_size.x > 0 && show_size.y > 0) {
+        float u1 = (float)s_lastKey.width / (float)target->allocWidth;
+        float v1 = (float)s_lastKey.height / (float)target->allocHeight;
+        ImGui::Image((ImTextureID)(intptr_t)fboColor, show_size, ImVec2(0,v1), ImVec2(u1,0));
+    } else ImGui::Dummy(show_size);
 }
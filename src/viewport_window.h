@@ -61,6 +61,15 @@ extern float g_offsetSphere;
 extern float g_offsetCylinder;
 extern float g_offsetPlane;
 
+// Dynamic resolution: while the camera or a gizmo is moving, render the viewport at a reduced
+// scale steered toward a GPU-time target for the scene pass, then upscale into the panel. Full
+// resolution is restored as soon as interaction stops.
+extern bool g_dynResEnabled;
+extern float g_dynResTargetMs;
+extern float g_dynResMinScale;
+// Current render scale (read-only for UI)
+extern float g_dynResScale;
+
 // Draw the viewport UI, render scene into an offscreen FBO and handle gizmo/spawn logic.
 // The function preserves behavior of original code and uses values supplied via ViewportContext.
 void DrawViewportWindow(ViewportContext& ctx);
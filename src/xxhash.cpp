@@ -0,0 +1,70 @@
+#include "xxhash.h"
+#include <cstring>
+
+namespace XXHash {
+
+static const uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+static const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+static const uint64_t kPrime3 = 0x165667B19E3779F9ull;
+static const uint64_t kPrime4 = 0x85EBCA77C2B2AE63ull;
+static const uint64_t kPrime5 = 0x27D4EB2F165667C5ull;
+
+static inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+// unaligned little-endian reads (every supported target is little-endian)
+static inline uint64_t read64(const uint8_t* p) { uint64_t v; memcpy(&v, p, 8); return v; }
+static inline uint32_t read32(const uint8_t* p) { uint32_t v; memcpy(&v, p, 4); return v; }
+
+static inline uint64_t round(uint64_t acc, uint64_t input) {
+    acc += input * kPrime2;
+    acc = rotl(acc, 31);
+    return acc * kPrime1;
+}
+
+static inline uint64_t mergeRound(uint64_t acc, uint64_t val) {
+    acc ^= round(0, val);
+    return acc * kPrime1 + kPrime4;
+}
+
+uint64_t hash64(const void* data, size_t size, uint64_t seed) {
+    const uint8_t* p = (const uint8_t*)data;
+    const uint8_t* end = p + size;
+    uint64_t h;
+    if(size >= 32) {
+        // four independent lanes over 32-byte stripes
+        uint64_t v1 = seed + kPrime1 + kPrime2;
+        uint64_t v2 = seed + kPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kPrime1;
+        const uint8_t* limit = end - 32;
+        do {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+            p += 32;
+        } while(p <= limit);
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = mergeRound(h, v1);
+        h = mergeRound(h, v2);
+        h = mergeRound(h, v3);
+        h = mergeRound(h, v4);
+    } else {
+        h = seed + kPrime5;
+    }
+    h += (uint64_t)size;
+
+    for(; p + 8 <= end; p += 8) h = rotl(h ^ round(0, read64(p)), 27) * kPrime1 + kPrime4;
+    if(p + 4 <= end) { h = rotl(h ^ ((uint64_t)read32(p) * kPrime1), 23) * kPrime2 + kPrime3; p += 4; }
+    for(; p < end; ++p) h = rotl(h ^ (*p * kPrime5), 11) * kPrime1;
+
+    // avalanche
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+}
+
+} // namespace XXHash
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// XXH64 (xxHash, 64-bit variant): fast non-cryptographic hash for content keys.
+// Output matches the reference implementation, so keys are stable across runs and platforms.
+namespace XXHash {
+    uint64_t hash64(const void* data, size_t size, uint64_t seed = 0);
+}